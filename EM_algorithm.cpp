@@ -15,336 +15,382 @@
 using namespace std;
 
 //------------------------------------------------
-// EM algorithm under no-admixture model
-void EM_noAdmix(globals &globals, int Kindex) {
+// draw random starting allele frequencies for a single repeat of the EM algorithm
+void EM_initialiseFreqs(globals &globals, int Kindex, int EMrep, vector<double> &alleleFreqs) {
     int K = globals.Kmin+Kindex;
     
-    // create empty objects
-    vector< vector<double> > logProbMat(globals.n,vector<double>(K));
-    double logProbSum;
-    vector< vector< vector<double> > > logAlleleFreqs(K);
-    double logAlleleFreqsSum;
-    double logLike=0;
-    double logLike_this_i=0;
-    double logLike_this_ik=0;
-    
-    // initialise logAlleleFreqs and zero global maximum likelihood allele frequencies
-    globals.max_alleleFreqs = vector< vector< vector<double> > >(K);
+    // use the stream of random numbers allocated to this repeat
+    RNGobject RNG = RNGstream(globals.seed, Kindex, RNG_EM, EMrep);
     for (int k=0; k<K; k++) {
-        logAlleleFreqs[k] = vector< vector<double> >(globals.loci);
-        globals.max_alleleFreqs[k] = vector< vector<double> >(globals.loci);
         for (int l=0; l<globals.loci; l++) {
-            logAlleleFreqs[k][l] = vector<double>(globals.J[l]);
-            globals.max_alleleFreqs[k][l] = vector<double>(globals.J[l]);
+            double alleleFreqsSum = 0;
+            for (int j=0; j<globals.J[l]; j++) {
+                alleleFreqs[(globals.J_offset[l]+j)*K+k] = RNG.runif1(0.1,0.9);
+                alleleFreqsSum += alleleFreqs[(globals.J_offset[l]+j)*K+k];
+            }
+            for (int j=0; j<globals.J[l]; j++) {
+                alleleFreqs[(globals.J_offset[l]+j)*K+k] /= alleleFreqsSum;
+            }
+        }
+    }
+}
+
+//------------------------------------------------
+// report the number of iterations taken by each repeat of the EM algorithm
+void EM_reportIterations(globals &globals, int Kindex, const vector<EMrepeat> &repeats) {
+    string s = "  iterations by repeat:";
+    for (int EMrep=0; EMrep<int(repeats.size()); EMrep++) {
+        s += (EMrep==0) ? " " : ", ";
+        s += to_string((long long)repeats[EMrep].iterations);
+        if (!repeats[EMrep].converged) {
+            s += " (not converged)";
         }
     }
+    coutAndLog_K(s+"\n", globals, Kindex);
+}
+
+//------------------------------------------------
+// EM algorithm under no-admixture model
+void EM_noAdmix(globals &globals, int Kindex, profileObject *profile) {
+    int K = globals.Kmin+Kindex;
     
-    // repeat EM multiple times
-    globals.maxLike = log(double(0));
+    // run all repeats, spread over threads
+    vector<int> tasks(globals.EMrepeats);
     for (int EMrep=0; EMrep<globals.EMrepeats; EMrep++) {
-        
-        // initialise random allele frequencies
-        for (int k=0; k<K; k++) {
-            for (int l=0; l<globals.loci; l++) {
-                logAlleleFreqsSum = log(double(0));
-                for (int j=0; j<globals.J[l]; j++) {
-                    logAlleleFreqs[k][l][j] = log(runif1(0.1,0.9));
-                    logAlleleFreqsSum = logSum(logAlleleFreqsSum, logAlleleFreqs[k][l][j]);
-                }
-                for (int j=0; j<globals.J[l]; j++) {
-                    logAlleleFreqs[k][l][j] -= logAlleleFreqsSum;
-                }
+        tasks[EMrep] = EMrep;
+    }
+    vector<EMrepeat> repeats(globals.EMrepeats);
+    parallelFor(tasks, [&](int EMrep) {
+        repeats[EMrep] = EM_noAdmix_repeat(globals, Kindex, EMrep);
+    });
+    EM_reportIterations(globals, Kindex, repeats);
+    for (int EMrep=0; EMrep<globals.EMrepeats; EMrep++) {
+        profileCount(profile, COUNT_EM_ITERATIONS, repeats[EMrep].iterations);
+    }
+    
+    // keep the most likely repeat (the first one in the event of a tie)
+    int best = 0;
+    for (int EMrep=1; EMrep<globals.EMrepeats; EMrep++) {
+        if (repeats[EMrep].logLike>repeats[best].logLike) {
+            best = EMrep;
+        }
+    }
+    globals.maxLike[Kindex] = repeats[best].logLike;
+    globals.max_alleleFreqs[Kindex] = vector< vector< vector<double> > >(K);
+    for (int k=0; k<K; k++) {
+        globals.max_alleleFreqs[Kindex][k] = vector< vector<double> >(globals.loci);
+        for (int l=0; l<globals.loci; l++) {
+            globals.max_alleleFreqs[Kindex][k][l] = vector<double>(globals.J[l]);
+            for (int j=0; j<globals.J[l]; j++) {
+                globals.max_alleleFreqs[Kindex][k][l][j] = repeats[best].alleleFreqs[(globals.J_offset[l]+j)*K+k];
             }
         }
+    }
+    
+    // calculate model comparison statistics
+    if (globals.outputComparisonStatistics_on) {
+        
+        int freeParameters = K*(sum(globals.J)-globals.loci);
+        globals.AIC[Kindex] = 2*freeParameters - 2*globals.maxLike[Kindex];
+        globals.BIC[Kindex] = freeParameters*log(double(globals.n)) - 2*globals.maxLike[Kindex];
+        globals.DIC_Spiegelhalter[Kindex] = -4*globals.structure_loglike_mean[Kindex][0] + 2*globals.maxLike[Kindex];
+        globals.DIC_Gelman[Kindex] = -2*globals.structure_loglike_mean[Kindex][0] + 2*globals.structure_loglike_var[Kindex][0];
         
-        // EM iterations
-        for (int EMiter=0; EMiter<globals.EMiterations; EMiter++) {
-            
-            // calculate assignment probability matrix
-            for (int i=0; i<globals.n; i++) {
-                logProbSum = log(double(0));
-                for (int k=0; k<K; k++) {
-                    logProbMat[i][k] = 0;
-                    for (int l=0; l<globals.loci; l++) {
-                        for (int p=0; p<globals.ploidy_vec[i]; p++) {
-                            if (globals.data[i][l][p]!=0) {
-                                logProbMat[i][k] += logAlleleFreqs[k][l][globals.data[i][l][p]-1];
-                            }
+    }
+    
+}
+
+//------------------------------------------------
+// single repeat of EM algorithm under no-admixture model
+EMrepeat EM_noAdmix_repeat(globals &globals, int Kindex, int EMrep) {
+    int K = globals.Kmin+Kindex;
+    int n = globals.n;
+    int loci = globals.loci;
+    int alleles = globals.J_offset[loci-1]+globals.J[loci-1];
+    
+    // create empty objects. All arrays have deme as the fastest-changing index, so that the inner loops over demes run over contiguous memory
+    EMrepeat output;
+    output.alleleFreqs = vector<double>(alleles*K);
+    vector<double> &alleleFreqs = output.alleleFreqs;
+    vector<double> logAlleleFreqs(alleles*K);
+    vector<double> alleleWeights(alleles*K);
+    vector<double> probMat(n*K);
+    vector<double> logProbRow(K);
+    
+    // initialise random allele frequencies
+    EM_initialiseFreqs(globals, Kindex, EMrep, alleleFreqs);
+    
+    // E-step. Calculate assignment probability matrix from current allele frequencies, and return the log-likelihood of these frequencies. The log-probability of each individual in each deme is a sum over loci, and so is accumulated in log space, but each row is rescaled by its maximum before moving to linear space.
+    auto Estep = [&]() {
+        for (int i=0; i<alleles*K; i++) {
+            logAlleleFreqs[i] = (alleleFreqs[i]>0) ? log(alleleFreqs[i]) : -1e300;
+        }
+        double logLike = 0;
+        for (int i=0; i<n; i++) {
+            fill(logProbRow.begin(), logProbRow.end(), 0.0);
+            for (int l=0; l<loci; l++) {
+                for (int p=0; p<globals.ploidy_vec[i]; p++) {
+                    int thisData = (*globals.data)[globals.data_indStart[i] + l*globals.ploidy_vec[i] + p];
+                    if (thisData!=0) {
+                        const double *logFreq = &logAlleleFreqs[(globals.J_offset[l]+thisData-1)*K];
+                        for (int k=0; k<K; k++) {
+                            logProbRow[k] += logFreq[k];
                         }
                     }
-                    logProbSum = logSum(logProbSum, logProbMat[i][k]);
-                }
-                for (int k=0; k<K; k++) {
-                    logProbMat[i][k] -= logProbSum;
                 }
             }
-            
-            // zero allele frequencies
+            double rowMax = *max_element(logProbRow.begin(), logProbRow.end());
+            double rowSum = 0;
+            double *prob = &probMat[i*K];
             for (int k=0; k<K; k++) {
-                for (int l=0; l<globals.loci; l++) {
-                    for (int j=0; j<globals.J[l]; j++) {
-                        logAlleleFreqs[k][l][j] = log(double(0));
-                    }
-                }
+                prob[k] = exp(logProbRow[k]-rowMax);
+                rowSum += prob[k];
             }
-            
-            // add probability-weighted contribution to allele frequencies
-            for (int i=0; i<globals.n; i++) {
-                for (int l=0; l<globals.loci; l++) {
-                    for (int p=0; p<globals.ploidy_vec[i]; p++) {
-                        if (globals.data[i][l][p]!=0) {
-                            for (int k=0; k<K; k++) {
-                                logAlleleFreqs[k][l][globals.data[i][l][p]-1] = logSum(logAlleleFreqs[k][l][globals.data[i][l][p]-1], logProbMat[i][k]);
-                            }
-                        }
-                    }
-                }
-            }
-            
-            // normalise allele frequencies
             for (int k=0; k<K; k++) {
-                for (int l=0; l<globals.loci; l++) {
-                    logAlleleFreqsSum = log(double(0));
-                    for (int j=0; j<globals.J[l]; j++) {
-                        // control for underflow
-                        if (logAlleleFreqs[k][l][j] < -1e300)
-                            logAlleleFreqs[k][l][j] = -1e300;
-                        logAlleleFreqsSum = logSum(logAlleleFreqsSum, logAlleleFreqs[k][l][j]);
-                    }
-                    for (int j=0; j<globals.J[l]; j++) {
-                        logAlleleFreqs[k][l][j] -= logAlleleFreqsSum;
-                    }
-                }
+                prob[k] /= rowSum;
             }
-            
-        } // end of EM iterations loop
+            logLike += rowMax + log(rowSum) - log(double(K));
+        }
+        return(logLike);
+    };
+    
+    // EM iterations
+    output.iterations = globals.EMiterations;
+    output.converged = false;
+    double logLike_old = 0;
+    for (int EMiter=0; EMiter<globals.EMiterations; EMiter++) {
         
-        // calculate log-likelihood
-        logLike = 0;
-        for (int i=0; i<globals.n; i++) {
-            logLike_this_i = log(double(0));
-            for (int k=0; k<K; k++) {
-                logLike_this_ik = 0;
-                for (int l=0; l<globals.loci; l++) {
-                    for (int p=0; p<globals.ploidy_vec[i]; p++) {
-                        if (globals.data[i][l][p]!=0) {
-                            logLike_this_ik += logAlleleFreqs[k][l][globals.data[i][l][p]-1];
+        // stop if the improvement in log-likelihood has fallen below the tolerance
+        output.logLike = Estep();
+        if (globals.EMtolerance>0 && EMiter>0 && (output.logLike-logLike_old)<globals.EMtolerance) {
+            output.iterations = EMiter;
+            output.converged = true;
+            break;
+        }
+        logLike_old = output.logLike;
+        
+        // M-step. Add probability-weighted contribution to allele frequencies
+        fill(alleleWeights.begin(), alleleWeights.end(), 0.0);
+        for (int i=0; i<n; i++) {
+            const double *prob = &probMat[i*K];
+            for (int l=0; l<loci; l++) {
+                for (int p=0; p<globals.ploidy_vec[i]; p++) {
+                    int thisData = (*globals.data)[globals.data_indStart[i] + l*globals.ploidy_vec[i] + p];
+                    if (thisData!=0) {
+                        double *weight = &alleleWeights[(globals.J_offset[l]+thisData-1)*K];
+                        for (int k=0; k<K; k++) {
+                            weight[k] += prob[k];
                         }
                     }
                 }
-                logLike_this_i = logSum(logLike_this_i, logLike_this_ik - log(double(K)));
             }
-            logLike += logLike_this_i;
         }
         
-        // replace current values if more likely
-        if (logLike>globals.maxLike) {
-            globals.maxLike = logLike;
+        // normalise allele frequencies. Demes with no weight at a locus are given uniform frequencies
+        for (int l=0; l<loci; l++) {
             for (int k=0; k<K; k++) {
-                for (int l=0; l<globals.loci; l++) {
-                    for (int j=0; j<globals.J[l]; j++) {
-                        globals.max_alleleFreqs[k][l][j] = exp(logAlleleFreqs[k][l][j]);
-                    }
+                double weightSum = 0;
+                for (int j=0; j<globals.J[l]; j++) {
+                    weightSum += alleleWeights[(globals.J_offset[l]+j)*K+k];
+                }
+                for (int j=0; j<globals.J[l]; j++) {
+                    alleleFreqs[(globals.J_offset[l]+j)*K+k] = (weightSum>0) ? alleleWeights[(globals.J_offset[l]+j)*K+k]/weightSum : 1.0/double(globals.J[l]);
                 }
             }
         }
         
-    } // end of repeat EM loop
+    } // end of EM iterations loop
     
-    // calculate model comparison statistics
-    if (globals.outputComparisonStatistics_on) {
-        
-        int freeParameters = K*(sum(globals.J)-globals.loci);
-        globals.AIC[Kindex] = 2*freeParameters - 2*globals.maxLike;
-        globals.BIC[Kindex] = freeParameters*log(double(globals.n)) - 2*globals.maxLike;
-        globals.DIC_Spiegelhalter[Kindex] = -4*globals.structure_loglike_mean[Kindex][0] + 2*globals.maxLike;
-        globals.DIC_Gelman[Kindex] = -2*globals.structure_loglike_mean[Kindex][0] + 2*globals.structure_loglike_var[Kindex][0];
-        
+    // calculate log-likelihood of final allele frequencies
+    if (!output.converged) {
+        output.logLike = Estep();
     }
     
+    return(output);
 }
 
 //------------------------------------------------
 // EM algorithm under admixture model
-void EM_admix(globals &globals, int Kindex) {
+void EM_admix(globals &globals, int Kindex, profileObject *profile) {
     int K = globals.Kmin+Kindex;
     
-    // create empty objects
-    int geneCopies = sum(globals.ploidy_vec)*globals.loci;
-    vector< vector<double> > logProbMat(geneCopies,vector<double>(K,-log(double(K))));
-    double logProbSum;
-    vector< vector< vector<double> > > logAlleleFreqs(K);
-    double logAlleleFreqsSum;
-    vector< vector<double> > logAdmixFreqs(globals.n,vector<double>(K));
-    double logLike=0;
-    double logLike_this_i=0;
-    double logLike_this_ik=0;
+    // run all repeats, spread over threads
+    vector<int> tasks(globals.EMrepeats);
+    for (int EMrep=0; EMrep<globals.EMrepeats; EMrep++) {
+        tasks[EMrep] = EMrep;
+    }
+    vector<EMrepeat> repeats(globals.EMrepeats);
+    parallelFor(tasks, [&](int EMrep) {
+        repeats[EMrep] = EM_admix_repeat(globals, Kindex, EMrep);
+    });
+    EM_reportIterations(globals, Kindex, repeats);
+    for (int EMrep=0; EMrep<globals.EMrepeats; EMrep++) {
+        profileCount(profile, COUNT_EM_ITERATIONS, repeats[EMrep].iterations);
+    }
     
-    // initialise logAlleleFreqs and logAdmixFreqs and zero global maximum likelihood allele frequencies
-    globals.max_alleleFreqs = vector< vector< vector<double> > >(K);
-    globals.max_admixFreqs = vector< vector<double> >(globals.n,vector<double>(K));
+    // keep the most likely repeat (the first one in the event of a tie)
+    int best = 0;
+    for (int EMrep=1; EMrep<globals.EMrepeats; EMrep++) {
+        if (repeats[EMrep].logLike>repeats[best].logLike) {
+            best = EMrep;
+        }
+    }
+    globals.maxLike[Kindex] = repeats[best].logLike;
+    globals.max_alleleFreqs[Kindex] = vector< vector< vector<double> > >(K);
     for (int k=0; k<K; k++) {
-        logAlleleFreqs[k] = vector< vector<double> >(globals.loci);
-        globals.max_alleleFreqs[k] = vector< vector<double> >(globals.loci);
+        globals.max_alleleFreqs[Kindex][k] = vector< vector<double> >(globals.loci);
         for (int l=0; l<globals.loci; l++) {
-            logAlleleFreqs[k][l] = vector<double>(globals.J[l]);
-            globals.max_alleleFreqs[k][l] = vector<double>(globals.J[l]);
+            globals.max_alleleFreqs[Kindex][k][l] = vector<double>(globals.J[l]);
+            for (int j=0; j<globals.J[l]; j++) {
+                globals.max_alleleFreqs[Kindex][k][l][j] = repeats[best].alleleFreqs[(globals.J_offset[l]+j)*K+k];
+            }
         }
     }
-    
-    // repeat EM multiple times
-    globals.maxLike = log(double(0));
-    for (int EMrep=0; EMrep<globals.EMrepeats; EMrep++) {
-        
-        // initialise random allele frequencies
+    globals.max_admixFreqs[Kindex] = vector< vector<double> >(globals.n,vector<double>(K));
+    for (int i=0; i<globals.n; i++) {
         for (int k=0; k<K; k++) {
-            for (int l=0; l<globals.loci; l++) {
-                logAlleleFreqsSum = log(double(0));
-                for (int j=0; j<globals.J[l]; j++) {
-                    logAlleleFreqs[k][l][j] = log(runif1(0.1,0.9));
-                    logAlleleFreqsSum = logSum(logAlleleFreqsSum, logAlleleFreqs[k][l][j]);
-                }
-                for (int j=0; j<globals.J[l]; j++) {
-                    logAlleleFreqs[k][l][j] -= logAlleleFreqsSum;
-                }
-            }
+            globals.max_admixFreqs[Kindex][i][k] = repeats[best].admixFreqs[i*K+k];
         }
+    }
+    
+    // calculate model comparison statistics
+    if (globals.outputComparisonStatistics_on) {
         
-        // EM iterations
-        for (int EMiter=0; EMiter<globals.EMiterations; EMiter++) {
-            
-            // loop through all individuals
-            int groupIndex = -1;
-            for (int i=0; i<globals.n; i++) {
-                
-                // zero admixture freqs for this individual
-                for (int k=0; k<K; k++) {
-                    logAdmixFreqs[i][k] = log(double(0));
-                }
-                
-                // calculate probability matrix and contribute to ML admixture freqs
-                for (int l=0; l<globals.loci; l++) {
-                    for (int p=0; p<globals.ploidy_vec[i]; p++) {
-                        groupIndex++;
-                        if (globals.data[i][l][p]!=0) {
-                            logProbSum = log(double(0));
-                            for (int k=0; k<K; k++) {
-                                logProbMat[groupIndex][k] = logAlleleFreqs[k][l][globals.data[i][l][p]-1];
-                                logProbSum = logSum(logProbSum,logProbMat[groupIndex][k]);
-                            }
-                            for (int k=0; k<K; k++) {
-                                logProbMat[groupIndex][k] -= logProbSum;
-                            }
-                        }
+        int freeParameters = K*(sum(globals.J)-globals.loci) + globals.n*(K-1);
+        globals.AIC[Kindex] = 2*freeParameters - 2*globals.maxLike[Kindex];
+        globals.BIC[Kindex] = freeParameters*log(double(globals.geneCopies)) - 2*globals.maxLike[Kindex];
+        globals.DIC_Spiegelhalter[Kindex] = -4*globals.structure_loglike_mean[Kindex][0] + 2*globals.maxLike[Kindex];
+        globals.DIC_Gelman[Kindex] = -2*globals.structure_loglike_mean[Kindex][0] + 2*globals.structure_loglike_var[Kindex][0];
+        
+    }
+    
+}
+
+//------------------------------------------------
+// single repeat of EM algorithm under admixture model
+EMrepeat EM_admix_repeat(globals &globals, int Kindex, int EMrep) {
+    int K = globals.Kmin+Kindex;
+    int n = globals.n;
+    int loci = globals.loci;
+    int alleles = globals.J_offset[loci-1]+globals.J[loci-1];
+    
+    // create empty objects. All arrays have deme as the fastest-changing index, so that the inner loops over demes run over contiguous memory. Gene copies are in the same order as the data, and gene copies with missing data keep uniform assignment probabilities throughout.
+    EMrepeat output;
+    output.alleleFreqs = vector<double>(alleles*K);
+    output.admixFreqs = vector<double>(n*K);
+    vector<double> &alleleFreqs = output.alleleFreqs;
+    vector<double> &admixFreqs = output.admixFreqs;
+    vector<double> alleleWeights(alleles*K);
+    vector<double> probMat(globals.geneCopies*K, 1.0/double(K));
+    
+    // initialise random allele frequencies
+    EM_initialiseFreqs(globals, Kindex, EMrep, alleleFreqs);
+    
+    // log-likelihood of current allele and admixture frequencies
+    auto calculateLogLike = [&]() {
+        double logLike = 0;
+        for (int i=0; i<n; i++) {
+            const double *admix = &admixFreqs[i*K];
+            for (int l=0; l<loci; l++) {
+                for (int p=0; p<globals.ploidy_vec[i]; p++) {
+                    int thisData = (*globals.data)[globals.data_indStart[i] + l*globals.ploidy_vec[i] + p];
+                    if (thisData!=0) {
+                        const double *freq = &alleleFreqs[(globals.J_offset[l]+thisData-1)*K];
+                        double like = 0;
                         for (int k=0; k<K; k++) {
-                            logAdmixFreqs[i][k] = logSum(logAdmixFreqs[i][k],logProbMat[groupIndex][k]-log(double(globals.loci))-log(double(globals.ploidy_vec[i])));
+                            like += admix[k]*freq[k];
                         }
-                    }
-                }
-            } // i loop
-            
-            // zero allele frequencies
-            for (int k=0; k<K; k++) {
-                for (int l=0; l<globals.loci; l++) {
-                    for (int j=0; j<globals.J[l]; j++) {
-                        logAlleleFreqs[k][l][j] = log(double(0));
+                        logLike += log(like);
                     }
                 }
             }
-            
-            // add contribution to allele frequencies
-            groupIndex = -1;
-            for (int i=0; i<globals.n; i++) {
-                for (int l=0; l<globals.loci; l++) {
-                    for (int p=0; p<globals.ploidy_vec[i]; p++) {
-                        groupIndex++;
-                        if (globals.data[i][l][p]!=0) {
-                            for (int k=0; k<K; k++) {
-                                logAlleleFreqs[k][l][globals.data[i][l][p]-1] = logSum(logAlleleFreqs[k][l][globals.data[i][l][p]-1], logAdmixFreqs[i][k]+logProbMat[groupIndex][k]);
-                            }
+        }
+        return(logLike);
+    };
+    
+    // EM iterations
+    output.iterations = globals.EMiterations;
+    output.converged = false;
+    double logLike_old = 0;
+    for (int EMiter=0; EMiter<globals.EMiterations; EMiter++) {
+        
+        // calculate assignment probability matrix from allele frequencies, and average over gene copies to obtain admixture freqs
+        for (int i=0; i<n; i++) {
+            double *admix = &admixFreqs[i*K];
+            fill(admix, admix+K, 0.0);
+            for (int l=0; l<loci; l++) {
+                for (int p=0; p<globals.ploidy_vec[i]; p++) {
+                    int g = globals.data_indStart[i] + l*globals.ploidy_vec[i] + p;
+                    double *prob = &probMat[g*K];
+                    if ((*globals.data)[g]!=0) {
+                        const double *freq = &alleleFreqs[(globals.J_offset[l]+(*globals.data)[g]-1)*K];
+                        double probSum = 0;
+                        for (int k=0; k<K; k++) {
+                            probSum += freq[k];
+                        }
+                        for (int k=0; k<K; k++) {
+                            prob[k] = (probSum>0) ? freq[k]/probSum : 1.0/double(K);
                         }
                     }
-                }
-            }
-            
-            // normalise allele frequencies
-            for (int k=0; k<K; k++) {
-                for (int l=0; l<globals.loci; l++) {
-                    logProbSum = log(double(0));
-                    for (int j=0; j<globals.J[l]; j++) {
-                        logProbSum = logSum(logProbSum, logAlleleFreqs[k][l][j]);
-                    }
-                    for (int j=0; j<globals.J[l]; j++) {
-                        logAlleleFreqs[k][l][j] -= logProbSum;
+                    for (int k=0; k<K; k++) {
+                        admix[k] += prob[k];
                     }
                 }
             }
-            
-        } // end of EM iterations loop
-        
-        
-        logLike = 0;
-        for (int i=0; i<globals.n; i++) {
-            logLike_this_i = log(double(0));
+            double copies = double(loci)*double(globals.ploidy_vec[i]);
             for (int k=0; k<K; k++) {
-                logLike_this_ik = 0;
-                for (int l=0; l<globals.loci; l++) {
-                    for (int p=0; p<globals.ploidy_vec[i]; p++) {
-                        if (globals.data[i][l][p]!=0) {
-                            logLike_this_ik += logAlleleFreqs[k][l][globals.data[i][l][p]-1];
-                        }
-                    }
-                }
-                logLike_this_i = logSum(logLike_this_i, logLike_this_ik - log(double(K)));
+                admix[k] /= copies;
             }
-            logLike += logLike_this_i;
-        }
+        } // i loop
         
-        // calculate log-likelihood
+        // add contribution to allele frequencies, and at the same time calculate the log-likelihood of the new admixture freqs and the current allele frequencies
         double logLike = 0;
-        double temp;
-        for (int i=0; i<globals.n; i++) {
-            for (int l=0; l<globals.loci; l++) {
-                for (int p=0; p<globals.ploidy; p++) {
-                    if (globals.data[i][l][p]!=0) {
-                        temp = log(double(0));
+        fill(alleleWeights.begin(), alleleWeights.end(), 0.0);
+        for (int i=0; i<n; i++) {
+            const double *admix = &admixFreqs[i*K];
+            for (int l=0; l<loci; l++) {
+                for (int p=0; p<globals.ploidy_vec[i]; p++) {
+                    int g = globals.data_indStart[i] + l*globals.ploidy_vec[i] + p;
+                    if ((*globals.data)[g]!=0) {
+                        const double *prob = &probMat[g*K];
+                        const double *freq = &alleleFreqs[(globals.J_offset[l]+(*globals.data)[g]-1)*K];
+                        double *weight = &alleleWeights[(globals.J_offset[l]+(*globals.data)[g]-1)*K];
+                        double like = 0;
                         for (int k=0; k<K; k++) {
-                            temp = logSum(temp, logAdmixFreqs[i][k]+logAlleleFreqs[k][l][globals.data[i][l][p]-1]);
+                            weight[k] += admix[k]*prob[k];
+                            like += admix[k]*freq[k];
                         }
-                        logLike += temp;
+                        logLike += log(like);
                     }
                 }
             }
         }
         
-        // replace current values if more likely
-        if (logLike>globals.maxLike) {
-            globals.maxLike = logLike;
+        // normalise allele frequencies. Demes with no weight at a locus are given uniform frequencies
+        for (int l=0; l<loci; l++) {
             for (int k=0; k<K; k++) {
-                for (int l=0; l<globals.loci; l++) {
-                    for (int j=0; j<globals.J[l]; j++) {
-                        globals.max_alleleFreqs[k][l][j] = exp(logAlleleFreqs[k][l][j]);
-                    }
+                double weightSum = 0;
+                for (int j=0; j<globals.J[l]; j++) {
+                    weightSum += alleleWeights[(globals.J_offset[l]+j)*K+k];
                 }
-            }
-            for (int i=0; i<globals.n; i++) {
-                for (int k=0; k<K; k++) {
-                    globals.max_admixFreqs[i][k] = exp(logAdmixFreqs[i][k]);
+                for (int j=0; j<globals.J[l]; j++) {
+                    alleleFreqs[(globals.J_offset[l]+j)*K+k] = (weightSum>0) ? alleleWeights[(globals.J_offset[l]+j)*K+k]/weightSum : 1.0/double(globals.J[l]);
                 }
             }
         }
         
-    } // end of repeat EM loop
-    
-    // calculate model comparison statistics
-    if (globals.outputComparisonStatistics_on) {
-        
-        int freeParameters = K*(sum(globals.J)-globals.loci) + globals.n*(K-1);
-        globals.AIC[Kindex] = 2*freeParameters - 2*globals.maxLike;
-        globals.BIC[Kindex] = freeParameters*log(double(globals.geneCopies)) - 2*globals.maxLike;
-        globals.DIC_Spiegelhalter[Kindex] = -4*globals.structure_loglike_mean[Kindex][0] + 2*globals.maxLike;
-        globals.DIC_Gelman[Kindex] = -2*globals.structure_loglike_mean[Kindex][0] + 2*globals.structure_loglike_var[Kindex][0];
+        // stop if the improvement in log-likelihood has fallen below the tolerance
+        if (globals.EMtolerance>0 && EMiter>0 && (logLike-logLike_old)<globals.EMtolerance) {
+            output.iterations = EMiter+1;
+            output.converged = true;
+            break;
+        }
+        logLike_old = logLike;
         
-    }
+    } // end of EM iterations loop
+    
+    // calculate log-likelihood of final allele and admixture frequencies
+    output.logLike = calculateLogLike();
     
+    return(output);
 }
\ No newline at end of file
@@ -6,7 +6,7 @@
 //
 //  Distributed under the MIT software licence - see Notes.c file for details
 //
-//  These functions implement the expectation-maximization (EM) algorithm to find maximum likelihood allele frequencies and admixture proportions under both the with- and wothout-admixture models. The final maximum likelihood values are used by various model comparison statistics.
+//  These functions implement the expectation-maximization (EM) algorithm to find maximum likelihood allele frequencies and admixture proportions under both the with- and wothout-admixture models. The final maximum likelihood values are used by various model comparison statistics. Independent repeats from different random starting points are spread over threads, and each repeat stops early once the improvement in log-likelihood between iterations falls below EMtolerance.
 //
 // ---------------------------------------------------------------------------
 
@@ -18,13 +18,40 @@
 #include "globals.h"
 #include "probability.h"
 #include "misc.h"
+#include "parallel.h"
 
 //------------------------------------------------
-// EM algorithm under no-admixture model
-void EM_noAdmix(globals &globals, int Kindex);
+// result of a single repeat of the EM algorithm. Allele frequencies are stored as a flat array with deme as the fastest-changing index, so that the frequency of allele j at locus l in deme k is found at alleleFreqs[(J_offset[l]+j)*K+k]. Admixture frequencies (admixture model only) are found at admixFreqs[i*K+k].
+struct EMrepeat {
+    double logLike;
+    int iterations;
+    bool converged;
+    std::vector<double> alleleFreqs;
+    std::vector<double> admixFreqs;
+};
 
 //------------------------------------------------
-// EM algorithm under admixture model
-void EM_admix(globals &globals, int Kindex);
+// draw random starting allele frequencies for a single repeat of the EM algorithm
+void EM_initialiseFreqs(globals &globals, int Kindex, int EMrep, std::vector<double> &alleleFreqs);
+
+//------------------------------------------------
+// report the number of iterations taken by each repeat of the EM algorithm
+void EM_reportIterations(globals &globals, int Kindex, const std::vector<EMrepeat> &repeats);
+
+//------------------------------------------------
+// EM algorithm under no-admixture model. If profile is set then the total number of iterations over all repeats is added to it.
+void EM_noAdmix(globals &globals, int Kindex, profileObject *profile=0);
+
+//------------------------------------------------
+// single repeat of EM algorithm under no-admixture model
+EMrepeat EM_noAdmix_repeat(globals &globals, int Kindex, int EMrep);
+
+//------------------------------------------------
+// EM algorithm under admixture model. If profile is set then the total number of iterations over all repeats is added to it.
+void EM_admix(globals &globals, int Kindex, profileObject *profile=0);
+
+//------------------------------------------------
+// single repeat of EM algorithm under admixture model
+EMrepeat EM_admix_repeat(globals &globals, int Kindex, int EMrep);
 
 #endif
@@ -59,7 +59,7 @@ vector<int> augmentRight(int j, vector< vector<double> > &M, vector<int> &edgesR
 
 //------------------------------------------------
 // carry out Hungarian algorithm to find best matching given cost matrix M
-vector<int> hungarian(vector< vector<double> > &M, vector<int> &edgesLeft, vector<int> &edgesRight, vector<int> &blockedLeft, vector<int> &blockedRight, bool outputLog_on, ofstream &outputLog_fileStream) {
+vector<int> hungarian(vector< vector<double> > &M, vector<int> &edgesLeft, vector<int> &edgesRight, vector<int> &blockedLeft, vector<int> &blockedRight, bool outputLog_on, ofstream &outputLog_fileStream, int *iterations) {
     int n = int(M.size());
     
     // define maximum number of reps in Hungarian algorithm before aborting
@@ -108,8 +108,11 @@ vector<int> hungarian(vector< vector<double> > &M, vector<int> &edgesLeft, vecto
         }
         
         // if this matching is perfect then we are done
-        if (numberAssigned==n)
+        if (numberAssigned==n) {
+            if (iterations)
+                *iterations = rep+1;
             return(edgesLeft);
+        }
         
         // continue augmenting paths until no more possible
         //vector<int> blockedLeft(n);
@@ -138,6 +141,8 @@ vector<int> hungarian(vector< vector<double> > &M, vector<int> &edgesLeft, vecto
                         
                         // if best matching found then finish
                         if (numberAssigned==n) {
+                            if (iterations)
+                                *iterations = rep+1;
                             return(edgesLeft);
                         }
                     }
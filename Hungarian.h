@@ -25,7 +25,7 @@ std::vector<int> augmentLeft(int i, std::vector< std::vector<double> > &M, std::
 std::vector<int> augmentRight(int j, std::vector< std::vector<double> > &M, std::vector<int> &edgesRight, std::vector<int> &blockedLeft, std::vector<int> &blockedRight);
 
 //------------------------------------------------
-// carry out Hungarian algorithm to find best matching given cost matrix M
-std::vector<int> hungarian(std::vector< std::vector<double> > &M, std::vector<int> &edgesLeft, std::vector<int> &edgesRight, std::vector<int> &blockedLeft, std::vector<int> &blockedRight, bool outputLog_on, std::ofstream &outputLog_fileStream);
+// carry out Hungarian algorithm to find best matching given cost matrix M. If iterations is given then the number of passes of the algorithm needed is stored there.
+std::vector<int> hungarian(std::vector< std::vector<double> > &M, std::vector<int> &edgesLeft, std::vector<int> &edgesRight, std::vector<int> &blockedLeft, std::vector<int> &blockedRight, bool outputLog_on, std::ofstream &outputLog_fileStream, int *iterations=0);
 
 #endif
@@ -16,18 +16,18 @@ using namespace std;
 
 //------------------------------------------------
 // MCMCobject_admixture::
-// constructor for class containing all elements required for MCMC under admixture model
-MCMCobject_admixture::MCMCobject_admixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta) {
+// constructor for class containing all elements required for MCMC under admixture model. Qmatrices are only allocated if _fixLabels is true, in which case perform_MCMC() must also be run with fixLabels.
+MCMCobject_admixture::MCMCobject_admixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta, bool _fixLabels) : data(*globals.data), data_indStart(globals.data_indStart), lookup(*globals.lookup) {
     
     // copy some values over from globals object
-    data = globals.data;
-    
     Kindex = _Kindex;
     K = globals.Kmin+Kindex;
     n = globals.n;
     loci = globals.loci;
     J = globals.J;
+    J_offset = globals.J_offset;
     ploidy_vec = globals.ploidy_vec;
+    missing_vec = globals.missing_vec;
     uniquePops = globals.uniquePops;
     geneCopies = globals.geneCopies;
     
@@ -39,61 +39,118 @@ MCMCobject_admixture::MCMCobject_admixture(globals &globals, int _Kindex, int _b
     
     outputQmatrix_pop_on = globals.outputQmatrix_pop_on;
     
+    outputFlushInterval = globals.outputFlushInterval;
+    posteriorGrouping_binary = globals.outputPosteriorGrouping_binary_on;
+    labelBytes = (globals.Kmax>255) ? 2 : 1;
+    buffer_lines = 0;
+    
+    firstIteration = 0;
+    checkpoint = 0;
+    profile = 0;
+    checkpointChain = 0;
+    checkpointInterval = globals.checkpointInterval;
+    
     burnin = _burnin;
     samples = _samples;
     thinning = _thinning;
     
-    log_lookup = globals.log_lookup;
+    burninMax = burnin;
+    samplesMax = samples;
+    adaptiveBurnin = false;
+    targetSE = 0;
+    checkInterval = globals.mainCheckInterval;
     
     linearGroup = vector<int>(geneCopies);
-    group = vector< vector< vector<int> > >(n);
-    for (unsigned int ind=0; ind<n; ind++) {
-        group[ind] = vector< vector<int> >(loci);
-        for (unsigned int l=0; l<loci; l++) {
-            group[ind][l] = vector<int>(ploidy_vec[ind]);
-        }
-    }
     
     // initialise allele counts and frequencies
-    alleleCounts = vector< vector< vector<int> > >(K);
-    alleleCountsTotals = vector< vector<int> >(K);
-    alleleFreqs = vector< vector< vector<double> > >(K);
-    for (int k=0; k<K; k++) {
-        alleleCounts[k] = vector< vector<int> >(loci);
-        alleleCountsTotals[k] = vector<int>(loci);
-        alleleFreqs[k] = vector< vector<double> >(loci);
-        for (int l=0; l<loci; l++) {
-            alleleCounts[k][l] = vector<int>(J[l]);
-            alleleFreqs[k][l] = vector<double>(J[l]);
-        }
+    alleleCounts = vector<int>(J_offset[loci]*K);
+    alleleCountsTotals = vector<int>(loci*K);
+    alleleFreqs = vector<double>(J_offset[loci]*K);
+    
+    // columns of the lookup tables used at each locus
+    log_1 = lookup.logColumn(1);
+    lgamma_1 = lookup.lgammaColumn(1);
+    log_J = vector<const double*>(loci);
+    lgamma_J = vector<const double*>(loci);
+    for (int l=0; l<loci; l++) {
+        log_J[l] = lookup.logColumn(J[l]);
+        lgamma_J[l] = lookup.lgammaColumn(J[l]);
     }
     
     // initialise admix counts and frequencies
-    admixCounts = vector< vector<int> >(n,vector<int>(K));
+    admixCounts = vector<int>(n*K);
     admixCountsTotals = vector<int>(n);
     admixFreqs = vector< vector<double> >(n,vector<double>(K));
     
+    // the total admix count of each individual is simply its number of non-missing gene copies, and so does not change during the MCMC. Store the distinct totals and the number of individuals with each, along with the largest total (which bounds the size of the admix count histogram)
+    int maxTotal = 0;
+    map<int,int> totalsMap;
+    for (int i=0; i<n; i++) {
+        int total = 0;
+        for (int j=data_indStart[i]; j<data_indStart[i+1]; j++) {
+            if (data[j]!=0)
+                total++;
+        }
+        totalsMap[total]++;
+        maxTotal = (total>maxTotal) ? total : maxTotal;
+    }
+    for (map<int,int>::iterator it=totalsMap.begin(); it!=totalsMap.end(); ++it) {
+        admixTotals_value.push_back(it->first);
+        admixTotals_freq.push_back(it->second);
+    }
+    admixHist = vector<int>(maxTotal+1);
+    admixLgamma = vector<double>(maxTotal+1);
+    admixLgamma_new = vector<double>(maxTotal+1);
+    admixLgamma_alpha = -1;
+    
+    alphaUpdates = globals.alphaUpdates;
+    alphaAdapt_on = globals.alphaAdapt_on;
+    
     // initialise objects for calculating assignment probabilities
     logProbVec = vector<double>(K);
     logProbVecSum = 0;  // (used in Qmatrix calculation)
     logProbVecMax = 0;
     probVec = vector<double>(K);
+    cumProbVec = vector<double>(K);
     probVecSum = 0;
+    int maxPloidy = *max_element(ploidy_vec.begin(), ploidy_vec.end());
+    indLevel_allele = vector<int>(loci*maxPloidy);
+    indLevel_newGroup = vector<int>(loci*maxPloidy);
+    indLevel_changed = vector<int>(loci*maxPloidy);
     
-    // initialise Qmatrices
-    logQmatrix_gene_old = vector< vector<double> >(geneCopies, vector<double>(K));
-    logQmatrix_gene_new = vector< vector<double> >(geneCopies, vector<double>(K));
-    Qmatrix_gene_new = vector< vector<double> >(geneCopies, vector<double>(K));
-    logQmatrix_gene_running = vector< vector<double> >(geneCopies, vector<double>(K));
+    // split individuals and loci into blocks for the Gibbs sweep. Individual blocks hold roughly equal numbers of gene copies, and every block holds at least one individual and one locus.
+    blocks = min(globals.gibbsBlocks, min(n, loci));
+    indBlock_start = vector<int>(blocks+1);
+    lociBlock_start = vector<int>(blocks+1);
+    for (int b=1; b<blocks; b++) {
+        int target = int((long long)(data_indStart[n])*b/blocks);
+        int i = indBlock_start[b-1]+1;
+        while (i<(n-blocks+b) && data_indStart[i]<target) {
+            i++;
+        }
+        indBlock_start[b] = i;
+        lociBlock_start[b] = int((long long)(loci)*b/blocks);
+    }
+    indBlock_start[blocks] = n;
+    lociBlock_start[blocks] = loci;
+    block_RNG = vector<RNGobject>(blocks);
+    block_probVec = vector< vector<double> >(blocks, vector<double>(K));
+    block_cumProbVec = vector< vector<double> >(blocks, vector<double>(K));
+    block_logLike = vector<double>(blocks);
     
-    logQmatrix_gene = vector< vector<double> >(geneCopies, vector<double>(K));
-    Qmatrix_gene = vector< vector<double> >(geneCopies, vector<double>(K));
-    Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
-    Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    // initialise Qmatrices
+    QmatrixFloat_on = globals.QmatrixFloat_on;
+    fixLabels_on = _fixLabels;
+    if (fixLabels_on) {
+        Qmatrix_gene_new = vector<double>(geneCopies*K);
+        Qmatrix_gene_running.reset(geneCopies, K, QmatrixFloat_on, false, 1/double(K));
+    }
+    logQ_running = vector<double>(K);
     
     // initialise objects for Hungarian algorithm
     costMat = vector< vector<double> >(K, vector<double>(K));
-    bestPermOrder = vector<int>(K);
+    labelMap = vector<int>(K);
+    fixLabelsInterval = globals.fixLabelsInterval;
     
     edgesLeft = vector<int>(K);
     edgesRight = vector<int>(K);
@@ -107,28 +164,40 @@ MCMCobject_admixture::MCMCobject_admixture(globals &globals, int _Kindex, int _b
 // reset objects used in MCMC
 void MCMCobject_admixture::reset(bool reset_Qmatrix_running) {
     
+    // reset run lengths, which may have been cut short in the last run
+    burnin = burninMax;
+    samples = samplesMax;
+    
     // reset likelihoods
     logLikeGroup = 0;
-    logLikeGroup_sum = 0;
+    logLikeGroup_stats.reset();
     logLikeGroup_store = vector<double>(samples);
-    logLikeGroup_sumSquared = 0;
+    logLikeBurnin_store.clear();
+    logLikeJoint_store = vector<double>(samples);
     logLikeJoint = 0;
-    logLikeJoint_sum = 0;
-    logLikeJoint_sumSquared = 0;
+    logLikeJoint_stats.reset();
     harmonic = log(double(0));
     
-    // reset Qmatrices
-    logQmatrix_gene_old = vector< vector<double> >(geneCopies, vector<double>(K));
-    logQmatrix_gene_new = vector< vector<double> >(geneCopies, vector<double>(K));
-    Qmatrix_gene_new = vector< vector<double> >(geneCopies, vector<double>(K));
-    if (reset_Qmatrix_running) {
-        logQmatrix_gene_running = vector< vector<double> >(geneCopies, vector<double>(K,-log(double(K))));
+    // reset alpha acceptance counts
+    alphaAccept = 0;
+    alphaProposals = 0;
+    
+    // reset Qmatrices and labelling
+    if (fixLabels_on) {
+        if (reset_Qmatrix_running) {
+            Qmatrix_gene_running.reset(geneCopies, K, QmatrixFloat_on, false, 1/double(K));
+        }
+        Qmatrix_gene_store.reset(geneCopies, K, QmatrixFloat_on, true, 0);
+        Qmatrix_gene = vector< vector<double> >(geneCopies, vector<double>(K));
+        Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
+        Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    }
+    for (int k=0; k<K; k++) {
+        labelMap[k] = k;
     }
     
-    logQmatrix_gene = vector< vector<double> >(geneCopies, vector<double>(K, log(double(0))));
-    Qmatrix_gene = vector< vector<double> >(geneCopies, vector<double>(K));
-    Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
-    Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    // start from the first iteration
+    firstIteration = 0;
     
     // initialise group with random allocation
     vector<double> equalK(K,1/double(K));
@@ -137,21 +206,18 @@ void MCMCobject_admixture::reset(bool reset_Qmatrix_running) {
         for (int l=0; l<loci; l++) {
             for (int p=0; p<ploidy_vec[i]; p++) {
                 groupIndex++;
-                linearGroup[groupIndex] = sample1(equalK,1.0);
-                group[i][l][p] = linearGroup[groupIndex];
+                linearGroup[groupIndex] = RNG.sample1(equalK,1.0);
             }
         }
     }
     
     // zero allele counts and admix counts
-    for (int k=0; k<K; k++) {
-        alleleCountsTotals[k] = vector<int>(loci);
-        for (int l=0; l<loci; l++) {
-            alleleCounts[k][l] = vector<int>(J[l]);
-        }
-    }
-    admixCounts = vector< vector<int> > (n,vector<int>(K));
-    admixCountsTotals = vector<int> (n);
+    fill(alleleCounts.begin(), alleleCounts.end(), 0);
+    fill(alleleCountsTotals.begin(), alleleCountsTotals.end(), 0);
+    fill(admixCounts.begin(), admixCounts.end(), 0);
+    fill(admixCountsTotals.begin(), admixCountsTotals.end(), 0);
+    fill(admixHist.begin(), admixHist.end(), 0);
+    admixHist[0] = n*K;
     
     // populate allele counts and admix counts
     groupIndex=-1;
@@ -159,12 +225,10 @@ void MCMCobject_admixture::reset(bool reset_Qmatrix_running) {
         for (int l=0; l<loci; l++) {
             for (int p=0; p<ploidy_vec[ind]; p++) {
                 groupIndex++;
-                if (data[ind][l][p]!=0) {
-                    alleleCounts[linearGroup[groupIndex]-1][l][data[ind][l][p]-1]++;
-                    alleleCountsTotals[linearGroup[groupIndex]-1][l]++;
+                if (data[groupIndex]!=0) {
+                    addGeneCopy(l, data[groupIndex], linearGroup[groupIndex]-1);
                     
-                    admixCounts[ind][linearGroup[groupIndex]-1]++;
-                    admixCountsTotals[ind]++;
+                    addAdmixCount(ind, linearGroup[groupIndex]-1);
                 }
             }
         }
@@ -177,91 +241,277 @@ void MCMCobject_admixture::reset(bool reset_Qmatrix_running) {
 // perform complete MCMC under admixture model
 void MCMCobject_admixture::perform_MCMC(globals &globals, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep) {
     
-    // perform MCMC
-    int thinSwitch = 1;
-    for (int rep=0; rep<(burnin+samples); rep++) {
+    // perform MCMC, saving the state of the chain to the checkpoint at regular intervals
+    for (int rep=firstIteration; rep<(burnin+samples); rep++) {
+        MCMC_iteration(globals, rep, drawAlleleFreqs, storeLoglike, fixLabels, outputLikelihood, outputPosteriorGrouping, mainRep);
         
-        // thinning loop (becomes active after burn-in)
-        for (int thin=0; thin<thinSwitch; thin++) {
-            
-            // update group allocation at the gene copy level
-            group_update();
-            
-            // update group allocation at individual level. Improves mixing when alpha very small.
-            group_update_indLevel();
-            
-            // if alpha not fixed update by Metropolis step
-            if (globals.fixAlpha_on==0)
-                alpha_update();
-            
+        // adaptive run lengths. Shortening burnin or samples takes effect from the next iteration.
+        if (rep<burnin) {
+            if (adaptiveBurnin) {
+                logLikeBurnin_store.push_back(logLikeGroup);
+                if ((rep+1)%checkInterval==0 && (rep+1)>=2*checkInterval && (rep+1)<burnin && burninConverged()) {
+                    burnin = rep+1;
+                }
+            }
+        } else if (targetSE>0 && (rep+1-burnin)%checkInterval==0 && (rep+1)<(burnin+samples)) {
+            if (structureSE()<=targetSE) {
+                samples = rep+1-burnin;
+            }
         }
-        if (rep==burnin)
-            thinSwitch = thinning;
         
-        // if fix label-switching problem
-        if (fixLabels) {
-            // calculate logQmatrix_gene_new for this iteration
-            produceQmatrix();
-            
-            // fix label-switching problem
-            chooseBestLabelPermutation(globals, rep);
-            
-            // add logQmatrix_gene_new to logQmatrix_gene_running
-            updateQmatrix(rep);
+        if (checkpoint!=0 && (rep+1)%checkpointInterval==0) {
+            string state;
+            writeState(state, mainRep, rep+1);
+            checkpoint->saveChain(globals, checkpointChain, state);
+        }
+    }
+    
+    // finish off Qmatrices and harmonic mean
+    finalise_MCMC(globals, fixLabels);
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// carry out a single iteration of MCMC. rep is the iteration number, counting from the start of the burn-in phase.
+void MCMCobject_admixture::MCMC_iteration(globals &globals, int rep, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep) {
+    
+    // thinning loop (becomes active after burn-in)
+    int thinSwitch = (rep>burnin) ? thinning : 1;
+    for (int thin=0; thin<thinSwitch; thin++) {
         
-            // store Qmatrix values if no longer in burn-in
-            if (rep>=burnin)
-                storeQmatrix();
+        // update group allocation at the gene copy level
+        {
+            profileTimer timer(profile, PROFILE_GIBBS);
+            group_update();
         }
-            
-        // calculate marginal likelihood
-        d_logLikeGroup();
+        profileCount(profile, COUNT_SWEEPS);
         
-        // optionally draw allele frequencies and admixture proportions and calculate joint likelihood
-        if (drawAlleleFreqs) {
-            drawFreqs();
-            d_logLikeJoint();
+        // update group allocation at individual level. Improves mixing when alpha very small.
+        {
+            profileTimer timer(profile, PROFILE_INDLEVEL);
+            data.packed ? group_update_indLevel<true>() : group_update_indLevel<false>();
         }
         
-        // add likelihoods to running sums
-        if (rep>=burnin) {
-            logLikeGroup_sum += logLikeGroup;
-            logLikeGroup_sumSquared += logLikeGroup*logLikeGroup;
-            
-            if (storeLoglike) {
-                logLikeGroup_store[rep-burnin] = logLikeGroup;
-            }
-            
-            harmonic = logSum(harmonic, -logLikeGroup);
-            if (drawAlleleFreqs==true) {
-                logLikeJoint_sum += logLikeJoint;
-                logLikeJoint_sumSquared += logLikeJoint*logLikeJoint;
+        // if alpha not fixed update by one or more Metropolis steps. The proposal standard deviation can optionally be tuned during the burn-in phase
+        if (globals.fixAlpha_on==0) {
+            profileTimer timer(profile, PROFILE_ALPHA);
+            for (int a=0; a<alphaUpdates; a++) {
+                alpha_update(alphaAdapt_on && rep<burnin);
             }
         }
         
-        // write to outputLikelihoods file
-        if (outputLikelihood) {
-            globals.outputLikelihood_fileStream << K << "," << mainRep+1 << "," << rep-burnin+1 << "," << logLikeGroup << "," << logLikeJoint << "," << alpha << "\n";
-			globals.outputLikelihood_fileStream.flush();
-        }
-        // write to outputPosteriorGrouping file
-        if (outputPosteriorGrouping) {
-            globals.outputPosteriorGrouping_fileStream << K << "," << mainRep+1 << "," << rep-burnin+1;
-            groupIndex=-1;
-            for (int i=0; i<n; i++) {
-                for (int l=0; l<loci; l++) {
-                    for (int p=0; p<ploidy_vec[i]; p++) {
-                        groupIndex++;
-                        globals.outputPosteriorGrouping_fileStream << "," << linearGroup[groupIndex];
-                    }
-                }
-            }
-            globals.outputPosteriorGrouping_fileStream << "\n";
-			globals.outputPosteriorGrouping_fileStream.flush();
+    }
+    
+    // if fix label-switching problem. Labels are only updated every fixLabelsInterval iterations, and in between the Qmatrix is only needed after burn-in
+    if (fixLabels) {
+        bool relabel = (rep%fixLabelsInterval==0);
+        
+        // calculate Qmatrix_gene_new for this iteration, along with the cost matrix if relabelling
+        if (relabel || rep>=burnin) {
+            profileTimer timer(profile, PROFILE_QMATRIX);
+            data.packed ? produceQmatrix<true>(relabel) : produceQmatrix<false>(relabel);
+        }
+        
+        // fix label-switching problem, and add Qmatrix_gene_new to Qmatrix_gene_running
+        if (relabel) {
+            profileTimer timer(profile, PROFILE_LABELS);
+            chooseBestLabelPermutation(globals, rep);
+            updateQmatrix(rep);
+        }
+        
+        // store Qmatrix values if no longer in burn-in
+        if (rep>=burnin)
+            storeQmatrix();
+    }
+        
+    // recalculate marginal likelihood in full every LOGLIKE_RECOMPUTE iterations. Between times it is updated as gene copies move between groups
+    if ((rep+1)%LOGLIKE_RECOMPUTE==0) {
+        profileTimer timer(profile, PROFILE_LIKELIHOOD);
+        d_logLikeGroup();
+    }
+    
+    // optionally draw allele frequencies and admixture proportions and calculate joint likelihood
+    if (drawAlleleFreqs) {
+        profileTimer timer(profile, PROFILE_FREQS);
+        drawFreqs();
+        data.packed ? d_logLikeJoint<true>() : d_logLikeJoint<false>();
+    }
+    
+    // add likelihoods to running sums
+    if (rep>=burnin) {
+        logLikeGroup_stats.add(logLikeGroup);
+        
+        if (storeLoglike) {
+            logLikeGroup_store[rep-burnin] = logLikeGroup;
+            logLikeJoint_store[rep-burnin] = logLikeJoint;
         }
         
-    } // end of MCMC
+        harmonic = logSum(harmonic, -logLikeGroup);
+        if (drawAlleleFreqs==true) {
+            logLikeJoint_stats.add(logLikeJoint);
+        }
+    }
+    
+    // everything from here on is output, and is timed as such
+    profileTimer outputTimer(profile, PROFILE_OUTPUT);
+    
+    // add to outputLikelihoods buffer
+    if (outputLikelihood) {
+        ostringstream line;
+        line << K << "," << mainRep+1 << "," << rep-burnin+1 << "," << logLikeGroup << "," << logLikeJoint << "," << alpha << "\n";
+        likelihood_buffer += line.str();
+    }
+    
+    // add to outputPosteriorGrouping buffer, either as text or as a binary record (see Notes.c for the layout)
+    if (outputPosteriorGrouping) {
+        if (posteriorGrouping_binary) {
+            appendBinary(grouping_buffer, int32_t(K));
+            appendBinary(grouping_buffer, int32_t(mainRep+1));
+            appendBinary(grouping_buffer, int32_t(rep-burnin+1));
+        } else {
+            appendInt(grouping_buffer, K);
+            grouping_buffer += ',';
+            appendInt(grouping_buffer, mainRep+1);
+            grouping_buffer += ',';
+            appendInt(grouping_buffer, rep-burnin+1);
+        }
+        for (int i=0; i<geneCopies; i++) {
+            appendGroup(labelMap[linearGroup[i]-1]+1);
+        }
+        if (!posteriorGrouping_binary) {
+            grouping_buffer += '\n';
+        }
+    }
+    
+    // pass buffered output to the background writers every outputFlushInterval iterations
+    if (outputLikelihood || outputPosteriorGrouping) {
+        buffer_lines++;
+        if (buffer_lines>=outputFlushInterval)
+            flushOutput(globals);
+    }
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// append the group of a single individual or gene copy to the outputPosteriorGrouping buffer
+void MCMCobject_admixture::appendGroup(int g) {
+    if (!posteriorGrouping_binary) {
+        grouping_buffer += ',';
+        appendInt(grouping_buffer, g);
+    } else if (labelBytes==1) {
+        appendBinary(grouping_buffer, uint8_t(g));
+    } else {
+        appendBinary(grouping_buffer, uint16_t(g));
+    }
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// pass any buffered outputLikelihood and outputPosteriorGrouping lines to the background writers
+void MCMCobject_admixture::flushOutput(globals &globals) {
+    globals.outputLikelihood_writer.write(likelihood_buffer);
+    globals.outputPosteriorGrouping_writer.write(grouping_buffer);
+    buffer_lines = 0;
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// write the state of the chain (everything needed to carry on from iteration nextIteration of repeat mainRep) in binary form. Quantities that are recalculated from scratch on every iteration are not included.
+void MCMCobject_admixture::writeState(string &state, int mainRep, int nextIteration) {
+    appendValue(state, mainRep);
+    appendValue(state, nextIteration);
+    appendValue(state, burnin);
+    appendValue(state, samples);
+    appendValue(state, RNG);
+    appendValue(state, linearGroup);
+    appendValue(state, alleleCounts);
+    appendValue(state, alleleCountsTotals);
+    appendValue(state, alleleFreqs);
+    appendValue(state, admixCounts);
+    appendValue(state, admixCountsTotals);
+    appendValue(state, admixHist);
+    appendValue(state, alpha);
+    appendValue(state, alphaPropSD);
+    appendValue(state, alphaAccept);
+    appendValue(state, alphaProposals);
+    appendValue(state, labelMap);
+    appendValue(state, logLikeGroup);
+    appendValue(state, logLikeGroup_stats);
+    appendValue(state, logLikeGroup_store);
+    appendValue(state, logLikeBurnin_store);
+    appendValue(state, logLikeJoint_store);
+    appendValue(state, logLikeJoint);
+    appendValue(state, logLikeJoint_stats);
+    appendValue(state, harmonic);
+    appendValue(state, Qmatrix_gene_running);
+    appendValue(state, Qmatrix_gene_store);
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// read back the state of the chain written by writeState(), such that perform_MCMC() carries on from where the state was saved. Returns false if the state does not match the dimensions of this chain.
+bool MCMCobject_admixture::readState(const string &state, int &mainRep) {
+    binaryReader r(state);
+    int nextIteration = 0;
+    readValue(r, mainRep);
+    readValue(r, nextIteration);
+    
+    // the size of each object is fixed by the data and K, so anything else means the state belongs to a different chain
+    size_t groupSize = linearGroup.size();
+    size_t countsSize = alleleCounts.size();
+    size_t totalsSize = alleleCountsTotals.size();
+    readValue(r, burnin);
+    readValue(r, samples);
+    readValue(r, RNG);
+    readValue(r, linearGroup);
+    readValue(r, alleleCounts);
+    readValue(r, alleleCountsTotals);
+    readValue(r, alleleFreqs);
+    readValue(r, admixCounts);
+    readValue(r, admixCountsTotals);
+    readValue(r, admixHist);
+    readValue(r, alpha);
+    readValue(r, alphaPropSD);
+    readValue(r, alphaAccept);
+    readValue(r, alphaProposals);
+    readValue(r, labelMap);
+    readValue(r, logLikeGroup);
+    readValue(r, logLikeGroup_stats);
+    readValue(r, logLikeGroup_store);
+    readValue(r, logLikeBurnin_store);
+    readValue(r, logLikeJoint_store);
+    readValue(r, logLikeJoint);
+    readValue(r, logLikeJoint_stats);
+    readValue(r, harmonic);
+    readValue(r, Qmatrix_gene_running);
+    readValue(r, Qmatrix_gene_store);
+    
+    if (r.failed || linearGroup.size()!=groupSize || alleleCounts.size()!=countsSize || alleleCountsTotals.size()!=totalsSize || nextIteration<0 || nextIteration>(burnin+samples)) {
+        return(false);
+    }
+    firstIteration = nextIteration;
+    buffer_lines = 0;
+    
+    // final Qmatrices are built up from zero in finalise_MCMC()
+    if (fixLabels_on) {
+        Qmatrix_gene = vector< vector<double> >(geneCopies, vector<double>(K));
+        Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
+        Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    }
+    
+    // the table of lgamma values is rebuilt for the restored value of alpha
+    admixLgamma_alpha = -1;
+    
+    return(true);
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// finish off Qmatrices and harmonic mean once all iterations are complete
+void MCMCobject_admixture::finalise_MCMC(globals &globals, bool fixLabels) {
     
+    // write out any remaining buffered output
+    flushOutput(globals);
     
     // finish off Qmatrices
     if (fixLabels) {
@@ -273,7 +523,7 @@ void MCMCobject_admixture::perform_MCMC(globals &globals, bool drawAlleleFreqs,
                 for (int p=0; p<ploidy_vec[ind]; p++) {
                     groupIndex++;
                     for (int k=0; k<K; k++) {
-                        Qmatrix_gene[groupIndex][k] = exp(logQmatrix_gene[groupIndex][k] - log(double(samples)));
+                        Qmatrix_gene[groupIndex][k] = Qmatrix_gene_store.get(groupIndex, k);
                     } // k
                 } // p
             } // l
@@ -312,205 +562,384 @@ void MCMCobject_admixture::perform_MCMC(globals &globals, bool drawAlleleFreqs,
         
     } // end of if fixLabels
     
+    // drop any storage for samples that were not needed
+    logLikeGroup_store.resize(samples);
+    logLikeJoint_store.resize(samples);
+    
     // finish off harmonic mean
     harmonic = log(double(samples))-harmonic;
      
 }
 
+//------------------------------------------------
+// MCMCobject_admixture::
+// exchange the current state of this chain with that of another chain. Only the objects that define the current position of the chain are exchanged, while running sums and stored values stay with the chain that produced them.
+void MCMCobject_admixture::swapState(MCMCobject_admixture &other) {
+    swap(linearGroup, other.linearGroup);
+    swap(alleleCounts, other.alleleCounts);
+    swap(alleleCountsTotals, other.alleleCountsTotals);
+    swap(admixCounts, other.admixCounts);
+    swap(admixCountsTotals, other.admixCountsTotals);
+    swap(admixHist, other.admixHist);
+    swap(labelMap, other.labelMap);
+    swap(alpha, other.alpha);
+    swap(logLikeGroup, other.logLikeGroup);
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// save the current state of the chain
+void MCMCobject_admixture::saveState(chainState &state) const {
+    state.linearGroup = linearGroup;
+    state.alleleCounts = alleleCounts;
+    state.alleleCountsTotals = alleleCountsTotals;
+    state.admixCounts = admixCounts;
+    state.admixCountsTotals = admixCountsTotals;
+    state.admixHist = admixHist;
+    state.labelMap = labelMap;
+    state.alpha = alpha;
+    state.logLikeGroup = logLikeGroup;
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// copy over a state saved by saveState()
+void MCMCobject_admixture::copyState(const chainState &state) {
+    linearGroup = state.linearGroup;
+    alleleCounts = state.alleleCounts;
+    alleleCountsTotals = state.alleleCountsTotals;
+    admixCounts = state.admixCounts;
+    admixCountsTotals = state.admixCountsTotals;
+    admixHist = state.admixHist;
+    labelMap = state.labelMap;
+    alpha = state.alpha;
+    logLikeGroup = state.logLikeGroup;
+}
+
 //------------------------------------------------
 // MCMCobject_admixture::
 // resample group allocation of all gene copies by drawing from conditional posterior
 void MCMCobject_admixture::group_update() {
     
-    // update group allocation for this gene copy
+    // optionally split the sweep into blocks that can be run in parallel
+    if (blocks>1) {
+        group_update_blocked();
+        return;
+    }
+    
+    // choose the representation of the data once for the whole sweep
+    if (data.packed) {
+        group_update_sweep<true>();
+    } else {
+        group_update_sweep<false>();
+    }
+    
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// carry out a single unblocked sweep of group_update(), with PACKED set if the data are packed into 2-bit codes
+template<bool PACKED>
+void MCMCobject_admixture::group_update_sweep() {
+    
+    // update group allocation of each individual in turn, using the version of the update specialised to its ploidy and missing data
     groupIndex=-1;
-    for (unsigned int ind=0; ind<n; ind++) {
-        for (unsigned int l=0; l<loci; l++) {
-            for (unsigned int p=0; p<ploidy_vec[ind]; p++) {
-                groupIndex++;
-                
-                // subtract this gene copy from allele counts and admix counts
-                if (data[ind][l][p]!=0) {   // if not missing data
-                    alleleCounts[linearGroup[groupIndex]-1][l][data[ind][l][p]-1]--;
-                    alleleCountsTotals[linearGroup[groupIndex]-1][l]--;
-                    
-                    admixCounts[ind][linearGroup[groupIndex]-1]--;
-                    admixCountsTotals[ind]--;
+    bool tempered = (beta!=1.0);
+    for (int ind=0; ind<n; ind++) {
+        bool missing = (missing_vec[ind]>0);
+        switch (ploidy_vec[ind]) {
+            case 1:
+                if (tempered) {
+                    missing ? group_update_ind<1,true,true,PACKED>(ind) : group_update_ind<1,true,false,PACKED>(ind);
+                } else {
+                    missing ? group_update_ind<1,false,true,PACKED>(ind) : group_update_ind<1,false,false,PACKED>(ind);
                 }
-                
-                // calculate probability of this gene copy from all demes
-                probVecSum = 0;
-                for (unsigned int k=0; k<K; k++) {
-                    if (data[ind][l][p]==0) {
-                        probVec[k] = 1.0;
-                    } else {
-                        probVec[k] = double(alleleCounts[k][l][data[ind][l][p]-1]+lambda)/double(alleleCountsTotals[k][l]+J[l]*lambda);
-                        if (beta!=1.0) {
-                            probVec[k] = pow(probVec[k],beta);
-                        }
-                    }
-                    probVec[k] *= double(admixCounts[ind][k]+alpha);  // (denominator of this expression is the same for all k, so is omitted)
-                    probVecSum += probVec[k];
+                break;
+            case 2:
+                if (tempered) {
+                    missing ? group_update_ind<2,true,true,PACKED>(ind) : group_update_ind<2,true,false,PACKED>(ind);
+                } else {
+                    missing ? group_update_ind<2,false,true,PACKED>(ind) : group_update_ind<2,false,false,PACKED>(ind);
+                }
+                break;
+            default:
+                if (tempered) {
+                    missing ? group_update_ind<0,true,true,PACKED>(ind) : group_update_ind<0,true,false,PACKED>(ind);
+                } else {
+                    missing ? group_update_ind<0,false,true,PACKED>(ind) : group_update_ind<0,false,false,PACKED>(ind);
                 }
+                break;
+        }
+    }
+    
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// resample group allocation of all gene copies of individual ind, advancing groupIndex past them. PLOIDY is the ploidy of the individual (or 0 to read it from ploidy_vec), TEMPERED is set if the likelihood is raised to the power beta, MISSING is set if the individual has any missing data, and PACKED is set if the data are packed into 2-bit codes. If MISSING is not set then no gene copy is checked for missing data.
+template<int PLOIDY, bool TEMPERED, bool MISSING, bool PACKED>
+void MCMCobject_admixture::group_update_ind(int ind) {
+    
+    const int ploidy = (PLOIDY>0) ? PLOIDY : ploidy_vec[ind];
+    for (int l=0; l<loci; l++) {
+        for (int p=0; p<ploidy; p++) {
+            groupIndex++;
+            int d = data.get<PACKED>(groupIndex);
+            
+            // subtract this gene copy from allele counts and admix counts
+            if (!MISSING || d!=0) {   // if not missing data
+                subtractGeneCopy(l, d, linearGroup[groupIndex]-1);
                 
-                // resample grouping
-                linearGroup[groupIndex] = sample1(probVec, probVecSum);
-                group[ind][l][p] = linearGroup[groupIndex];
+                subtractAdmixCount(ind, linearGroup[groupIndex]-1);
+            }
+            
+            // calculate probability of this gene copy from all demes
+            probVecSum = geneCopyProbs_kernel<TEMPERED,MISSING>(ind, l, d, &probVec[0], &cumProbVec[0]);
+            
+            // resample grouping
+            linearGroup[groupIndex] = RNG.sample1_cumulative(cumProbVec);
+            
+            // add this gene copy to allele counts and admix counts
+            if (!MISSING || d!=0) {   // if not missing data
+                addGeneCopy(l, d, linearGroup[groupIndex]-1);
                 
-                // add this gene copy to allele counts and admix counts
-                if (data[ind][l][p]!=0) {   // if not missing data
-                    alleleCounts[linearGroup[groupIndex]-1][l][data[ind][l][p]-1]++;
-                    alleleCountsTotals[linearGroup[groupIndex]-1][l]++;
-                    
-                    admixCounts[ind][linearGroup[groupIndex]-1]++;
-                    admixCountsTotals[ind]++;
+                addAdmixCount(ind, linearGroup[groupIndex]-1);
+            }
+        } // p
+    } // l
+    
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// version of group_update() used when the sweep is split into blocks (see gibbsBlocks). Individuals are split into blocks of roughly equal numbers of gene copies, and loci into blocks of roughly equal size. The sweep is carried out in blocks phases, and in phase s block b updates the gene copies of individual block b at locus block (b+s)%blocks. Given all other gene copies, a gene copy depends only on the allele counts at its own locus and on the admix counts of its own individual, so the blocks updated within a phase share no counts and are conditionally independent. Updating them at the same time is therefore exactly equivalent to updating them one after another, and the sweep remains an exact Gibbs sampler, visiting gene copies in a different order to group_update(). Each block draws from its own stream of random numbers, split off the stream of the chain at the start of the sweep, so results depend on the number of blocks but not on the number of threads.
+void MCMCobject_admixture::group_update_blocked() {
+    
+    // split off a stream of random numbers for each block
+    block_RNG[0] = RNGobject(RNG.next());
+    for (int b=1; b<blocks; b++) {
+        block_RNG[b] = block_RNG[b-1];
+        block_RNG[b].jump();
+    }
+    
+    // carry out each phase over the available threads
+    vector<int> tasks(blocks);
+    for (int b=0; b<blocks; b++) {
+        tasks[b] = b;
+        block_logLike[b] = 0;
+    }
+    bool tempered = (beta!=1.0);
+    bool packed = data.packed;
+    for (int s=0; s<blocks; s++) {
+        parallelFor(tasks, [&](int b) {
+            if (packed) {
+                group_update_block<true>(b, (b+s)%blocks, tempered);
+            } else {
+                group_update_block<false>(b, (b+s)%blocks, tempered);
+            }
+        });
+    }
+    
+    // add up the change in logLikeGroup over all blocks, in a fixed order
+    for (int b=0; b<blocks; b++) {
+        logLikeGroup += block_logLike[b];
+    }
+    
+    // the histogram of admix counts is shared between blocks, so is rebuilt once the sweep is complete
+    fill(admixHist.begin(), admixHist.end(), 0);
+    for (int i=0; i<n*K; i++) {
+        admixHist[admixCounts[i]]++;
+    }
+    
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// resample group allocation of the gene copies of individual block b at locus block lb, using the version of the update specialised to the ploidy and missing data of each individual. PACKED is set if the data are packed into 2-bit codes.
+template<bool PACKED>
+void MCMCobject_admixture::group_update_block(int b, int lb, bool tempered) {
+    
+    // work on local copies of the stream of random numbers and the change in logLikeGroup, so that blocks running at the same time do not write to neighbouring memory
+    RNGobject blockRNG = block_RNG[b];
+    double d_logLike = 0;
+    int l0 = lociBlock_start[lb];
+    int l1 = lociBlock_start[lb+1];
+    for (int ind=indBlock_start[b]; ind<indBlock_start[b+1]; ind++) {
+        bool missing = (missing_vec[ind]>0);
+        switch (ploidy_vec[ind]) {
+            case 1:
+                if (tempered) {
+                    missing ? group_update_indBlock<1,true,true,PACKED>(ind, l0, l1, b, blockRNG, d_logLike) : group_update_indBlock<1,true,false,PACKED>(ind, l0, l1, b, blockRNG, d_logLike);
+                } else {
+                    missing ? group_update_indBlock<1,false,true,PACKED>(ind, l0, l1, b, blockRNG, d_logLike) : group_update_indBlock<1,false,false,PACKED>(ind, l0, l1, b, blockRNG, d_logLike);
                 }
-            } // p
-        } // l
-    } // ind
+                break;
+            case 2:
+                if (tempered) {
+                    missing ? group_update_indBlock<2,true,true,PACKED>(ind, l0, l1, b, blockRNG, d_logLike) : group_update_indBlock<2,true,false,PACKED>(ind, l0, l1, b, blockRNG, d_logLike);
+                } else {
+                    missing ? group_update_indBlock<2,false,true,PACKED>(ind, l0, l1, b, blockRNG, d_logLike) : group_update_indBlock<2,false,false,PACKED>(ind, l0, l1, b, blockRNG, d_logLike);
+                }
+                break;
+            default:
+                if (tempered) {
+                    missing ? group_update_indBlock<0,true,true,PACKED>(ind, l0, l1, b, blockRNG, d_logLike) : group_update_indBlock<0,true,false,PACKED>(ind, l0, l1, b, blockRNG, d_logLike);
+                } else {
+                    missing ? group_update_indBlock<0,false,true,PACKED>(ind, l0, l1, b, blockRNG, d_logLike) : group_update_indBlock<0,false,false,PACKED>(ind, l0, l1, b, blockRNG, d_logLike);
+                }
+                break;
+        }
+    }
+    block_RNG[b] = blockRNG;
+    block_logLike[b] += d_logLike;
+    
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// as group_update_ind(), but only for loci l0 to l1-1, using the scratch space of block b, the given stream of random numbers, and adding the change in the marginal likelihood to d_logLike. Only the allele counts of these loci and the admix counts of this individual are touched. The total admix count of the individual is unchanged by each update, and the histogram of admix counts is left to the caller.
+template<int PLOIDY, bool TEMPERED, bool MISSING, bool PACKED>
+void MCMCobject_admixture::group_update_indBlock(int ind, int l0, int l1, int b, RNGobject &blockRNG, double &d_logLike) {
+    
+    const int ploidy = (PLOIDY>0) ? PLOIDY : ploidy_vec[ind];
+    int *admixCounts_ind = &admixCounts[ind*K];
+    double *probVec_b = &block_probVec[b][0];
+    vector<double> &cumProbVec_b = block_cumProbVec[b];
+    for (int l=l0; l<l1; l++) {
+        int index = data_indStart[ind] + l*ploidy;
+        for (int p=0; p<ploidy; p++, index++) {
+            int d = data.get<PACKED>(index);
+            
+            // subtract this gene copy from allele counts and admix counts
+            if (!MISSING || d!=0) {
+                int k = linearGroup[index]-1;
+                int &a = alleleCounts[(J_offset[l]+d-1)*K+k];
+                int &a_t = alleleCountsTotals[l*K+k];
+                a--;
+                a_t--;
+                d_logLike -= logPredictive(a, a_t, l);
+                admixCounts_ind[k]--;
+            }
+            
+            // calculate probability of this gene copy from all demes, and resample grouping
+            geneCopyProbs_kernel<TEMPERED,MISSING>(ind, l, d, probVec_b, &cumProbVec_b[0]);
+            linearGroup[index] = blockRNG.sample1_cumulative(cumProbVec_b);
+            
+            // add this gene copy to allele counts and admix counts
+            if (!MISSING || d!=0) {
+                int k = linearGroup[index]-1;
+                int &a = alleleCounts[(J_offset[l]+d-1)*K+k];
+                int &a_t = alleleCountsTotals[l*K+k];
+                d_logLike += logPredictive(a, a_t, l);
+                a++;
+                a_t++;
+                admixCounts_ind[k]++;
+            }
+        } // p
+    } // l
     
 }
 
 //------------------------------------------------
 // MCMCobject_admixture::
-// Metropolis-Hastings step to update all gene copies within an individual simultaneously. This helps with mixing when alpha is small, as otherwise it can be very difficult for an individual allocated to the wrong group to move freely.
+// Metropolis-Hastings step to update all gene copies within an individual simultaneously. This helps with mixing when alpha is small, as otherwise it can be very difficult for an individual allocated to the wrong group to move freely. The likelihood of each gene copy is probVec[k]/(denominator of the admixture term), and the probability of proposing it is probVec[k]/probVecSum. The denominator is the same under the old and new groupings, so the Metropolis-Hastings ratio reduces to the product of probVecSum over the proposal divided by the same product over the old grouping. These products are held as exp(logScale)*scale, so that a log is only needed every few hundred gene copies. The two products are taken at different allele and admix counts (the old grouping is scored as gene copies are removed, the proposal as they are added back), so no probVecSum can be carried over from one pass to the other, and each pass needs a full geneCopyProbs() for every gene copy. Only the genotypes are shared, being read from the data once per individual into indLevel_allele.
+template<bool PACKED>
 void MCMCobject_admixture::group_update_indLevel() {
     
-    double logLike_old;
-    double logLike_new;
-    double propose_logProb_old;
-    double propose_logProb_new;
-    double MH_diff;
-    double rand1;
-    int d;
-    int thisGroup;
-    vector< vector<double> > newGroup(loci);
+    const double rescale_max = 1e150;
+    const double rescale_min = 1e-150;
     
     // loop over all individuals
-    groupIndex=-1;
     for (int ind=0; ind<n; ind++) {
+        int start = data_indStart[ind];
         
-        // subtract all gene copies in this individual and calculate likelihood of current grouping at the same time
-        logLike_old = 0;
-        propose_logProb_old = 0;
-        for (unsigned int l=0; l<loci; l++) {
-            for (unsigned int p=0; p<ploidy_vec[ind]; p++) {
-                d = data[ind][l][p];
+        // subtract all gene copies in this individual and calculate probability of current grouping at the same time
+        double scale_old = 1;
+        double logScale_old = 0;
+        int c = 0;
+        for (int l=0; l<loci; l++) {
+            for (int p=0; p<ploidy_vec[ind]; p++) {
+                int d = data.get<PACKED>(start+c);
+                indLevel_allele[c] = d;
                 
                 // subtract this gene copy from allele counts and admix counts
                 if (d!=0) {   // if not missing data
-                    thisGroup = group[ind][l][p];
-                    alleleCounts[thisGroup-1][l][d-1]--;
-                    alleleCountsTotals[thisGroup-1][l]--;
-                    
-                    admixCounts[ind][thisGroup-1]--;
-                    admixCountsTotals[ind]--;
+                    int thisGroup = linearGroup[start+c];
+                    subtractGeneCopy(l, d, thisGroup-1);
+                    subtractAdmixCount(ind, thisGroup-1);
                 }
                 
                 // calculate probability of this gene copy from all demes
-                probVecSum = 0;
-                for (unsigned int k=0; k<K; k++) {
-                    if (d==0) {
-                        probVec[k] = 1.0;
-                    } else {
-                        probVec[k] = double(alleleCounts[k][l][d-1]+lambda)/double(alleleCountsTotals[k][l]+J[l]*lambda);
-                        if (beta!=1.0) {
-                            probVec[k] = pow(probVec[k],beta);
-                        }
-                    }
-                    probVec[k] *= double(admixCounts[ind][k]+alpha);  // (denominator of this expression is the same for all k, so is omitted)
-                    probVecSum += probVec[k];
+                geneCopyProbs(ind, l, d, true);
+                scale_old *= probVecSum;
+                if (scale_old>rescale_max || scale_old<rescale_min) {
+                    logScale_old += log(scale_old);
+                    scale_old = 1;
                 }
-                
-                // calculate probability of chosen grouping
-                propose_logProb_old += log(probVec[group[ind][l][p]-1]/probVecSum);
-                logLike_old += log(probVec[group[ind][l][p]-1]);
-                
+                c++;
             }
         }
         
-        // propose a new grouping and calculate likelihood
-        logLike_new = 0;
-        propose_logProb_new = 0;
-        for (unsigned int l=0; l<loci; l++) {
-            newGroup[l] = vector<double>(ploidy_vec[ind]);
-            for (unsigned int p=0; p<ploidy_vec[ind]; p++) {
-                d = data[ind][l][p];
+        // propose a new grouping, keeping track of the gene copies that change group
+        double scale_new = 1;
+        double logScale_new = 0;
+        int changed = 0;
+        c = 0;
+        for (int l=0; l<loci; l++) {
+            for (int p=0; p<ploidy_vec[ind]; p++) {
+                int d = indLevel_allele[c];
                 
-                // calculate probability of this gene copy from all demes
-                probVecSum = 0;
-                for (unsigned int k=0; k<K; k++) {
-                    if (d==0) {
-                        probVec[k] = 1.0;
-                    } else {
-                        probVec[k] = double(alleleCounts[k][l][d-1]+lambda)/double(alleleCountsTotals[k][l]+J[l]*lambda);
-                        if (beta!=1.0) {
-                            probVec[k] = pow(probVec[k],beta);
-                        }
-                    }
-                    probVec[k] *= double(admixCounts[ind][k]+alpha);  // (denominator of this expression is the same for all k, so is omitted)
-                    probVecSum += probVec[k];
+                // calculate probability of this gene copy from all demes, and resample grouping
+                geneCopyProbs(ind, l, d, true);
+                int thisGroup = RNG.sample1_cumulative(cumProbVec);
+                indLevel_newGroup[c] = thisGroup;
+                scale_new *= probVecSum;
+                if (scale_new>rescale_max || scale_new<rescale_min) {
+                    logScale_new += log(scale_new);
+                    scale_new = 1;
                 }
                 
-                // resample grouping
-                newGroup[l][p] = sample1(probVec, probVecSum);
-                
-                // calculate probability of new grouping
-                propose_logProb_new += log(probVec[newGroup[l][p]-1]/probVecSum);
-                logLike_new += log(probVec[newGroup[l][p]-1]);
-                
                 // add this gene copy to allele counts and admix counts
                 if (d!=0) {   // if not missing data
-                    thisGroup = newGroup[l][p];
-                    alleleCounts[thisGroup-1][l][d-1]++;
-                    alleleCountsTotals[thisGroup-1][l]++;
-                    
-                    admixCounts[ind][thisGroup-1]++;
-                    admixCountsTotals[ind]++;
+                    addGeneCopy(l, d, thisGroup-1);
+                    addAdmixCount(ind, thisGroup-1);
+                }
+                if (thisGroup!=linearGroup[start+c]) {
+                    indLevel_changed[changed++] = c;
                 }
+                c++;
             }
         }
         
-        // Metropolis-Hastings step. If accept then stick with new grouping, otherwise revert back
-        MH_diff = (logLike_new - propose_logProb_new) - (logLike_old - propose_logProb_old);
-        rand1 = runif1(0,1);
+        // Metropolis-Hastings step. If accept then stick with new grouping, otherwise put back the old group of those gene copies that changed
+        double MH_diff = (logScale_new + log(scale_new)) - (logScale_old + log(scale_old));
+        double rand1 = RNG.runif1(0,1);
+        profileCount(profile, COUNT_INDLEVEL_PROPOSED);
         if (log(rand1)<MH_diff) {
             
             // accept move
-            for (unsigned int l=0; l<loci; l++) {
-                for (unsigned int p=0; p<ploidy_vec[ind]; p++) {
-                    groupIndex++;
-                    linearGroup[groupIndex] = newGroup[l][p];
-                    group[ind][l][p] = newGroup[l][p];
-                }
+            profileCount(profile, COUNT_INDLEVEL_ACCEPTED);
+            for (int i=0; i<changed; i++) {
+                c = indLevel_changed[i];
+                linearGroup[start+c] = indLevel_newGroup[c];
             }
             
         } else {
             
             // reject move
-            for (unsigned int l=0; l<loci; l++) {
-                for (unsigned int p=0; p<ploidy_vec[ind]; p++) {
-                    groupIndex++;
-                    d = data[ind][l][p];
-                    if (d!=0) {   // if not missing data
-                        
-                        // subtract new group
-                        thisGroup = newGroup[l][p];
-                        alleleCounts[thisGroup-1][l][d-1]--;
-                        alleleCountsTotals[thisGroup-1][l]--;
-                        
-                        admixCounts[ind][thisGroup-1]--;
-                        admixCountsTotals[ind]--;
-                        
-                        // reinstate old group
-                        thisGroup = group[ind][l][p];
-                        alleleCounts[thisGroup-1][l][d-1]++;
-                        alleleCountsTotals[thisGroup-1][l]++;
-                        
-                        admixCounts[ind][thisGroup-1]++;
-                        admixCountsTotals[ind]++;
-                    }
+            for (int i=0; i<changed; i++) {
+                c = indLevel_changed[i];
+                int d = indLevel_allele[c];
+                if (d!=0) {   // if not missing data
+                    int l = c/ploidy_vec[ind];
+                    
+                    // subtract new group
+                    subtractGeneCopy(l, d, indLevel_newGroup[c]-1);
+                    subtractAdmixCount(ind, indLevel_newGroup[c]-1);
                     
+                    // reinstate old group
+                    addGeneCopy(l, d, linearGroup[start+c]-1);
+                    addAdmixCount(ind, linearGroup[start+c]-1);
                 }
             }
             
@@ -520,6 +949,56 @@ void MCMCobject_admixture::group_update_indLevel() {
     
 }
 
+//------------------------------------------------
+// MCMCobject_admixture::
+// calculate probability of a single gene copy (of individual ind at locus l, with observed allele d) coming from each deme, writing the result to probVec, cumProbVec and probVecSum. The denominator of the admixture term is the same for all demes, so is omitted. If tempered, the likelihood term is raised to the power beta.
+void MCMCobject_admixture::geneCopyProbs(int ind, int l, int d, bool tempered) {
+    if (tempered && beta!=1.0) {
+        probVecSum = geneCopyProbs_kernel<true,true>(ind, l, d, &probVec[0], &cumProbVec[0]);
+    } else {
+        probVecSum = geneCopyProbs_kernel<false,true>(ind, l, d, &probVec[0], &cumProbVec[0]);
+    }
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// as geneCopyProbs(), with tempering and the check for missing data fixed at compile time, writing to probVec_out and cumProbVec_out and returning the sum of the probabilities. TEMPERED must only be set if beta is not 1, and MISSING must be set if d can be 0.
+template<bool TEMPERED, bool MISSING>
+double MCMCobject_admixture::geneCopyProbs_kernel(int ind, int l, int d, double *probVec_out, double *cumProbVec_out) const {
+    const int *admixCounts_ind = &admixCounts[ind*K];
+    
+    // missing data contributes the admixture term only
+    double sum = 0;
+    if (MISSING && d==0) {
+        for (int k=0; k<K; k++) {
+            probVec_out[k] = admixCounts_ind[k]+alpha;
+            sum += probVec_out[k];
+            cumProbVec_out[k] = sum;
+        }
+        return(sum);
+    }
+    
+    const int *alleleCounts_lj = &alleleCounts[(J_offset[l]+d-1)*K];
+    const int *alleleCountsTotals_l = &alleleCountsTotals[l*K];
+    
+    // untempered case uses the vectorised kernel
+    if (!TEMPERED) {
+        return(admixProbs(alleleCounts_lj, alleleCountsTotals_l, admixCounts_ind, K, lambda, J[l]*lambda, alpha, probVec_out, cumProbVec_out));
+    }
+    
+    // tempered case. Raise likelihood to the power beta in log space, using the log lookup table
+    int a, a_t;
+    double logRatio;
+    for (int k=0; k<K; k++) {
+        a = alleleCounts_lj[k];
+        a_t = alleleCountsTotals_l[k];
+        logRatio = log_1[a]-log_J[l][a_t];
+        probVec_out[k] = exp(beta*logRatio)*(admixCounts_ind[k]+alpha);
+        sum += probVec_out[k];
+        cumProbVec_out[k] = sum;
+    }
+    return(sum);
+}
 
 //------------------------------------------------
 // MCMCobject_admixture::
@@ -532,11 +1011,11 @@ void MCMCobject_admixture::drawFreqs() {
         for (int l=0; l<loci; l++) {
             randSum = 0;
             for (int j=0; j<J[l]; j++) {
-                alleleFreqs[k][l][j] = rgamma1(alleleCounts[k][l][j]+lambda, 1.0);
-                randSum += alleleFreqs[k][l][j];
+                alleleFreqs[(J_offset[l]+j)*K+k] = RNG.rgamma1(alleleCounts[(J_offset[l]+j)*K+k]+lambda, 1.0);
+                randSum += alleleFreqs[(J_offset[l]+j)*K+k];
             }
             for (int j=0; j<J[l]; j++) {
-                alleleFreqs[k][l][j] /= randSum;
+                alleleFreqs[(J_offset[l]+j)*K+k] /= randSum;
             }
             
         }
@@ -546,7 +1025,7 @@ void MCMCobject_admixture::drawFreqs() {
     for (int i=0; i<n; i++) {
         randSum = 0;
         for (int k=0; k<K; k++) {
-            admixFreqs[i][k] = rgamma1(admixCounts[i][k]+alpha, 1.0);
+            admixFreqs[i][k] = RNG.rgamma1(admixCounts[i*K+k]+alpha, 1.0);
             randSum += admixFreqs[i][k];
         }
         for (int k=0; k<K; k++) {
@@ -559,9 +1038,9 @@ void MCMCobject_admixture::drawFreqs() {
 //------------------------------------------------
 // MCMCobject_admixture::
 // resample alpha by Metropolis algorithm
-void MCMCobject_admixture::alpha_update() {
+void MCMCobject_admixture::alpha_update(bool adapt) {
     
-    double alpha_new = rnorm1(alpha,alphaPropSD);
+    double alpha_new = RNG.rnorm1(alpha,alphaPropSD);
     
     // reflect off boundries at 0 and 10
     if (alpha_new<0 || alpha_new>10) {
@@ -583,117 +1062,139 @@ void MCMCobject_admixture::alpha_update() {
         alpha_new = UNDERFLO;
     }
     
-    // calculate likelihood under old and new alpha values. Likelihood only derives from admixture proportions - not allele freqencies
-    double logProb_old = 0;
-    double logProb_new = 0;
-    for (int i=0; i<n; i++) {
-        logProb_old += lgamma(K*alpha)-lgamma(admixCountsTotals[i]+K*alpha);
-        logProb_new += lgamma(K*alpha_new)-lgamma(admixCountsTotals[i]+K*alpha_new);
-        for (int k=0; k<K; k++) {
-            logProb_old += lgamma(admixCounts[i][k]+alpha)-lgamma(alpha);
-            logProb_new += lgamma(admixCounts[i][k]+alpha_new)-lgamma(alpha_new);
-        }
+    // calculate likelihood under old and new alpha values. Likelihood only derives from admixture proportions - not allele freqencies. The table of lgamma values for the current alpha is retained between calls, and is only rebuilt when alpha changes
+    if (admixLgamma_alpha!=alpha) {
+        fill(admixLgamma.begin(), admixLgamma.end(), NAN);
+        admixLgamma_alpha = alpha;
     }
+    fill(admixLgamma_new.begin(), admixLgamma_new.end(), NAN);
+    double logProb_old = logLikeAlpha(alpha, admixLgamma);
+    double logProb_new = logLikeAlpha(alpha_new, admixLgamma_new);
+    
     // perform Metropolis step
-    if (runif1(0.0,1.0)<exp(logProb_new-logProb_old)) {
+    bool accept = (RNG.runif1(0.0,1.0)<exp(logProb_new-logProb_old));
+    if (accept) {
         alpha = alpha_new;
+        swap(admixLgamma, admixLgamma_new);
+        admixLgamma_alpha = alpha;
+        alphaAccept++;
+        profileCount(profile, COUNT_ALPHA_ACCEPTED);
+    }
+    alphaProposals++;
+    profileCount(profile, COUNT_ALPHA_PROPOSED);
+    
+    // Robbins-Monro update to the log of the proposal standard deviation, aiming for an acceptance rate of 0.44 (optimal for a one-dimensional random walk). Step sizes shrink over time so that the standard deviation settles down
+    if (adapt) {
+        double step = pow(double(alphaProposals), -0.6);
+        alphaPropSD *= exp(step*((accept ? 1.0 : 0.0) - 0.44));
+        alphaPropSD = (alphaPropSD>10) ? 10 : alphaPropSD;
+        alphaPropSD = (alphaPropSD<1e-6) ? 1e-6 : alphaPropSD;
     }
     
 }
 
 //------------------------------------------------
 // MCMCobject_admixture::
-// choose best permutation of labels using method of Stephens (2000)
-void MCMCobject_admixture::chooseBestLabelPermutation(globals &globals, int rep) {
+// log-probability of all admix counts given a value of alpha, integrated over unknown admixture proportions. Calculated from the histogram of admix counts, so the cost scales with the number of distinct counts rather than with the number of individuals. lgamma_alpha holds lgamma(c+a) for each count c, and is filled in where values are missing (marked NAN).
+double MCMCobject_admixture::logLikeAlpha(double a, vector<double> &lgamma_alpha) {
     
-    // calculate cost matrix from old and new Qmatrices
-    for (int k1=0; k1<K; k1++) {
-        for (int k2=0; k2<K; k2++) {
-            costMat[k1][k2] = 0;
-            for (int i=0; i<geneCopies; i++) {
-                costMat[k1][k2] += Qmatrix_gene_new[i][k1]*(logQmatrix_gene_new[i][k1]-logQmatrix_gene_running[i][k2]);
-            }
+    if (std::isnan(lgamma_alpha[0]))
+        lgamma_alpha[0] = lgamma(a);
+    
+    double ret = 0;
+    for (int c=1; c<int(admixHist.size()); c++) {
+        if (admixHist[c]>0) {
+            if (std::isnan(lgamma_alpha[c]))
+                lgamma_alpha[c] = lgamma(c+a);
+            ret += admixHist[c]*(lgamma_alpha[c]-lgamma_alpha[0]);
         }
     }
+    double lgamma_Ka = lgamma(K*a);
+    for (int t=0; t<int(admixTotals_value.size()); t++) {
+        ret += admixTotals_freq[t]*(lgamma_Ka-lgamma(admixTotals_value[t]+K*a));
+    }
+    return(ret);
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// add a single gene copy of individual ind to the admix counts of deme k (coded 0:K-1), keeping the histogram of admix counts up to date
+void MCMCobject_admixture::addAdmixCount(int ind, int k) {
+    int &c = admixCounts[ind*K+k];
+    admixHist[c]--;
+    c++;
+    admixHist[c]++;
+    admixCountsTotals[ind]++;
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// subtract a single gene copy of individual ind from the admix counts of deme k, keeping the histogram of admix counts up to date
+void MCMCobject_admixture::subtractAdmixCount(int ind, int k) {
+    int &c = admixCounts[ind*K+k];
+    admixHist[c]--;
+    c--;
+    admixHist[c]++;
+    admixCountsTotals[ind]--;
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// choose best permutation of labels using method of Stephens (2000). The cost matrix has already been calculated by produceQmatrix(), so all that remains is to find the best permutation and update labelMap
+void MCMCobject_admixture::chooseBestLabelPermutation(globals &globals, int rep) {
     
     // find best permutation of current labels
-    bestPerm = hungarian(costMat, edgesLeft, edgesRight, blockedLeft, blockedRight, globals.outputLog_on, globals.outputLog_fileStream);
-
-    // define bestPermOrder. If the numbers 1:m_K are placed in best-perm-order then we arrive back at bestPerm. In R terms we would say bestPermOrder=order(bestPerm).
-    bool performSwap = false;
-    for (int k=0; k<K; k++) {
-        bestPermOrder[bestPerm[k]] = k;
-        if (bestPerm[k]!=k)
-            performSwap = true;
-    }
+    int iterations;
+    bestPerm = hungarian(costMat, edgesLeft, edgesRight, blockedLeft, blockedRight, globals.outputLog_on, globals.outputLog_fileStream, &iterations);
+    profileCount(profile, COUNT_HUNGARIAN_CALLS);
+    profileCount(profile, COUNT_HUNGARIAN_ITERATIONS, iterations);
     
-    // swap labels if necessary
-    if (performSwap) {
-        
-        groupIndex=-1;
-        for (int ind=0; ind<n; ind++) {
-            for (int l=0; l<loci; l++) {
-                for (int p=0; p<ploidy_vec[ind]; p++) {
-                    groupIndex++;
-                    linearGroup[groupIndex] = bestPerm[linearGroup[groupIndex]-1]+1;
-                    group[ind][l][p] = linearGroup[groupIndex];
-                }
-            }
-        }
-        
-        // update allele counts to reflect swapped labels
-        old_alleleCounts = alleleCounts;
-        old_alleleCountsTotals = alleleCountsTotals;
-        for (int k=0; k<K; k++) {
-            alleleCounts[k] = old_alleleCounts[bestPermOrder[k]];
-            alleleCountsTotals[k] = old_alleleCountsTotals[bestPermOrder[k]];
-        }
-        
-        // update admix counts to reflect swapped labels
-        old_admixCounts = admixCounts;
-        for (int i=0; i<n; i++) {
-            for (int k=0; k<K; k++) {
-                admixCounts[i][k] = old_admixCounts[i][bestPermOrder[k]];
-            }
-        }
-        
-        // update logQmatrix_gene_new to reflect swapped labels. No need to swap Qmatrix_gene_new, as this is not used again until after it is recalcualted
-        logQmatrix_gene_old = logQmatrix_gene_new;
-        for (int i=0; i<geneCopies; i++) {
-            for (int k=0; k<K; k++) {
-                logQmatrix_gene_new[i][k] = logQmatrix_gene_old[i][bestPermOrder[k]];
-            }
-        }
-        
+    // relabel demes
+    bool changed = false;
+    for (int k=0; k<K; k++) {
+        changed = changed || (bestPerm[k]!=k);
+        labelMap[k] = bestPerm[labelMap[k]];
     }
+    if (changed)
+        profileCount(profile, COUNT_RELABELS);
     
 }
 
 //------------------------------------------------
 // MCMCobject_admixture::
-// calculate logQmatrix_gene_new for this iteration
-void MCMCobject_admixture::produceQmatrix() {
+// calculate Qmatrix_gene_new for this iteration. If updateCost is true then the cost matrix used in chooseBestLabelPermutation() is built up in the same pass, with rows in the order of the current labels and columns in the order of Qmatrix_gene_running. The full cost of assigning deme k1 to label k2 would be sum_i(Q[i][k1]*(log(Q[i][k1])-log(Qrunning[i][k2]))), but the first part of this is the same for every k2. As the Hungarian algorithm starts by subtracting the smallest value from every row, which removes any such constant, only the second part needs to be calculated.
+template<bool PACKED>
+void MCMCobject_admixture::produceQmatrix(bool updateCost) {
+    
+    if (updateCost) {
+        for (int k=0; k<K; k++) {
+            fill(costMat[k].begin(), costMat[k].end(), 0);
+        }
+    }
     
     // populate Qmatrix_gene_new
     groupIndex=-1;
-    for (unsigned int ind=0; ind<n; ind++) {
-        for (unsigned int l=0; l<loci; l++) {
-            for (unsigned int p=0; p<ploidy_vec[ind]; p++) {
+    for (int ind=0; ind<n; ind++) {
+        for (int l=0; l<loci; l++) {
+            for (int p=0; p<ploidy_vec[ind]; p++) {
                 groupIndex++;
                 
-                probVecSum = 0;
-                for (unsigned int k=0; k<K; k++) {
-                    if (data[ind][l][p]==0) {
-                        probVec[k] = 1.0;
-                    } else {
-                        probVec[k] = double(alleleCounts[k][l][data[ind][l][p]-1]+lambda)/double(alleleCountsTotals[k][l]+J[l]*lambda);
-                    }
-                    probVec[k] *= double(admixCounts[ind][k]+alpha); // (denominator of this expression is the same for all k, so is omitted)
-                    probVecSum += probVec[k];
+                geneCopyProbs(ind, l, data.get<PACKED>(groupIndex), false);
+                double *Qnew = &Qmatrix_gene_new[groupIndex*K];
+                double probVecSum_inv = 1.0/probVecSum;
+                for (int k=0; k<K; k++) {
+                    Qnew[k] = probVec[k]*probVecSum_inv;
                 }
-                for (unsigned int k=0; k<K; k++) {
-                    Qmatrix_gene_new[groupIndex][k] = probVec[k]/probVecSum;
-                    logQmatrix_gene_new[groupIndex][k] = log(Qmatrix_gene_new[groupIndex][k]);
+                
+                // add to cost matrix
+                if (updateCost) {
+                    Qmatrix_gene_running.logRow(groupIndex, &logQ_running[0]);
+                    for (int k1=0; k1<K; k1++) {
+                        double *costRow = &costMat[labelMap[k1]][0];
+                        for (int k2=0; k2<K; k2++) {
+                            costRow[k2] -= Qnew[k1]*logQ_running[k2];
+                        }
+                    }
                 }
                 
             } // p
@@ -703,105 +1204,88 @@ void MCMCobject_admixture::produceQmatrix() {
 
 //------------------------------------------------
 // MCMCobject_admixture::
-// add logQmatrix_gene_new to logQmatrix_gene_running
+// add Qmatrix_gene_new to Qmatrix_gene_running
 void MCMCobject_admixture::updateQmatrix(int rep) {
-    
-    // add logQmatrix_gene_new to logQmatrix_gene_running
-    for (int i=0; i<geneCopies; i++) {
-        for (int k=0; k<K; k++) {
-            logQmatrix_gene_running[i][k] = logSum(logQmatrix_gene_running[i][k], logQmatrix_gene_new[i][k]);
-        }
-    }
-    
+    Qmatrix_gene_running.add(Qmatrix_gene_new, labelMap);
 }
 
 //------------------------------------------------
 // MCMCobject_admixture::
 // store Qmatrix values
 void MCMCobject_admixture::storeQmatrix() {
-    
-    // store individual-level Qmatrix
-    groupIndex=-1;
-    for (int ind=0; ind<n; ind++) {
-        for (int l=0; l<loci; l++) {
-            for (int p=0; p<ploidy_vec[ind]; p++) {
-                groupIndex++;
-                for (int k=0; k<K; k++) {
-                    logQmatrix_gene[groupIndex][k] = logSum(logQmatrix_gene[groupIndex][k], logQmatrix_gene_new[groupIndex][k]);
-                }
-            }
-        }
-    }
-    
+    Qmatrix_gene_store.add(Qmatrix_gene_new, labelMap);
 }
 
 //------------------------------------------------
 // MCMCobject_admixture::
-// conditional probability of ith individual from kth deme (output in log space). Only considers groupings currently equal to targetGroup.
-void MCMCobject_admixture::d_logLikeConditional(int i, int k, int targetGroup) {
-    
-    /*
-    // calculate conditional probability of data
-    logProbVec[k] = 0;
-    int d, a, a_t;  // for making temporary copies of data, alleleCounts, and alleleCountsTotals respectively
-    for (unsigned int l=0; l<loci; l++) {
-        a_t = alleleCountsTotals[k][l];
-        for (unsigned int p=0; p<ploidy_vec[i]; p++) {
-            d = data[i][l][p];
-            a = alleleCounts[k][l][d-1];
-            if (d!=0 && group[i][l][p]==targetGroup) {  // if data not missing AND group equal to targetGroup
-                if ((a<int(1e4)) && (a_t<int(1e4))) {
-                    logProbVec[k] += log_lookup[a][1]-log_lookup[a_t][J[l]];
-                } else {
-                    logProbVec[k] += log((a + lambda)/double(a_t + J[l]*lambda));
-                }
-                alleleCounts[k][l][d-1] ++;
-                a_t ++;
-            }
-        }
-        for (unsigned int p=0; p<ploidy_vec[i]; p++) {
-            d = data[i][l][p];
-            if (d!=0 && group[i][l][p]==targetGroup) {
-                alleleCounts[k][l][d-1] --;
-            }
-        }
-    }
-    */
-}
-
-//------------------------------------------------
-// MCMCobject_admixture::
-// probability of data given grouping only, integrated over unknown allele frequencies
+// probability of data given grouping only, integrated over unknown allele frequencies. This full calculation is only carried out periodically, as logLikeGroup is otherwise kept up to date by addGeneCopy() and subtractGeneCopy().
 void MCMCobject_admixture::d_logLikeGroup() {
     
     // Multinomial-Dirichlet likelihood
     logLikeGroup = 0;
+    int a;
     for (int k=0; k<K; k++) {
         for (int l=0; l<loci; l++) {
             for (int j=0; j<J[l]; j++) {
-                logLikeGroup += lgamma(lambda + alleleCounts[k][l][j]) - lgamma(lambda);
+                a = alleleCounts[(J_offset[l]+j)*K+k];
+                logLikeGroup += lgamma_1[a] - lgamma_1[0];
             }
-            logLikeGroup += lgamma(J[l]*lambda) - lgamma(J[l]*lambda + alleleCountsTotals[k][l]);
+            a = alleleCountsTotals[l*K+k];
+            logLikeGroup += lgamma_J[l][0] - lgamma_J[l][a];
         }
     }
     
 }
 
+//------------------------------------------------
+// MCMCobject_admixture::
+// log of the predictive probability of a single allele, given that it has been observed a times in a deme in which a_t gene copies at locus l have been observed in total. This is also the change in the Multinomial-Dirichlet likelihood when the allele is added to the deme.
+double MCMCobject_admixture::logPredictive(int a, int a_t, int l) {
+    return(log_1[a]-log_J[l][a_t]);
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// add a single gene copy carrying allele d (coded 1:J[l]) at locus l to the allele counts of deme k (coded 0:K-1), updating logLikeGroup to match
+void MCMCobject_admixture::addGeneCopy(int l, int d, int k) {
+    int &a = alleleCounts[(J_offset[l]+d-1)*K+k];
+    int &a_t = alleleCountsTotals[l*K+k];
+    logLikeGroup += logPredictive(a, a_t, l);
+    a++;
+    a_t++;
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// subtract a single gene copy carrying allele d at locus l from the allele counts of deme k, updating logLikeGroup to match
+void MCMCobject_admixture::subtractGeneCopy(int l, int d, int k) {
+    int &a = alleleCounts[(J_offset[l]+d-1)*K+k];
+    int &a_t = alleleCountsTotals[l*K+k];
+    a--;
+    a_t--;
+    logLikeGroup -= logPredictive(a, a_t, l);
+}
+
 //------------------------------------------------
 // MCMCobject_admixture::
 // probability of data given grouping and known allele frequencies and admixture proportions
+template<bool PACKED>
 void MCMCobject_admixture::d_logLikeJoint() {
     
     // calculate likelihood
     logLikeJoint = 0;
     double temp1;
+    int d;
+    groupIndex=-1;
     for (int i=0; i<n; i++) {
         for (int l=0; l<loci; l++) {
             for (int p=0; p<ploidy_vec[i]; p++) {
-                if (data[i][l][p]!=0) {
+                groupIndex++;
+                d = data.get<PACKED>(groupIndex);
+                if (d!=0) {
                     temp1 = 0;
                     for (int k=0; k<K; k++) {
-                        temp1 += admixFreqs[i][k]*alleleFreqs[k][l][data[i][l][p]-1];
+                        temp1 += admixFreqs[i][k]*alleleFreqs[(J_offset[l]+d-1)*K+k];
                     }
                     logLikeJoint += log(temp1);
                 }
@@ -811,3 +1295,24 @@ void MCMCobject_admixture::d_logLikeJoint() {
     
 }
 
+//------------------------------------------------
+// MCMCobject_admixture::
+// check whether burn-in has converged, by applying the Geweke test to the second half of the marginal likelihoods so far (so that a chain must have been stationary for at least half of the burn-in)
+bool MCMCobject_admixture::burninConverged() {
+    vector<double> secondHalf(logLikeBurnin_store.begin()+logLikeBurnin_store.size()/2, logLikeBurnin_store.end());
+    return(fabs(gewekeZ(secondHalf))<GEWEKE_Z);
+}
+
+//------------------------------------------------
+// MCMCobject_admixture::
+// standard error of the Structure estimator over the samples so far. The estimator mean(L)-var(L)/2 is equal to the mean of L-(L-mean(L))^2/2, so its standard error is that of the mean of these values, allowing for autocorrelation.
+double MCMCobject_admixture::structureSE() {
+    int count = int(logLikeJoint_stats.n);
+    vector<double> y(count);
+    for (int i=0; i<count; i++) {
+        double d = logLikeJoint_store[i]-logLikeJoint_stats.mean;
+        y[i] = logLikeJoint_store[i]-0.5*d*d;
+    }
+    return(standardErrorMCMC(y));
+}
+
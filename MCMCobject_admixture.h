@@ -18,6 +18,12 @@
 #include "probability.h"
 #include "misc.h"
 #include "Hungarian.h"
+#include "kernels.h"
+#include "QmatrixMean.h"
+#include "welford.h"
+#include "checkpoint.h"
+#include "profile.h"
+#include "parallel.h"
 
 //------------------------------------------------
 // class containing all elements required for MCMC under admixture model
@@ -25,17 +31,41 @@ class MCMCobject_admixture {
     
 public:
     
+    // the objects that define the current position of a chain (see swapState()), held separately so that a chain can later be started from this position without keeping the whole chain
+    struct chainState {
+        std::vector<int> linearGroup;
+        std::vector<int> alleleCounts;
+        std::vector<int> alleleCountsTotals;
+        std::vector<int> admixCounts;
+        std::vector<int> admixCountsTotals;
+        std::vector<int> admixHist;
+        std::vector<int> labelMap;
+        double alpha;
+        double logLikeGroup;
+    };
+    
     // PUBLIC OBJECTS
     
-    // basic quantities (copied over from globals object)
-    std::vector< std::vector< std::vector<int> > > data;
+    // data and lookup tables are shared between all MCMC objects, and are held by reference to the globals object. The data may be packed into 2-bit codes if all loci are biallelic (see genotypeData.h), in which case every function that reads the data in the course of the MCMC takes PACKED as a template argument, chosen once per call from data.packed.
+    const genotypeData &data;
+    const std::vector<int> &data_indStart;
+    const lookupTable &lookup;
+    
+    // columns of the lookup tables for a single allele (log_1[c] = log(c+lambda)) and for the J[l] alleles of each locus (log_J[l][c] = log(c+J[l]*lambda)), and likewise for lgamma
+    const double *log_1;
+    const double *lgamma_1;
+    std::vector<const double*> log_J;
+    std::vector<const double*> lgamma_J;
     
+    // basic quantities (copied over from globals object)
     int Kindex;
     int K;
     int n;
     int loci;
     std::vector<int> J;
+    std::vector<int> J_offset;
     std::vector<int> ploidy_vec;
+    std::vector<int> missing_vec;
     std::vector<std::string> uniquePops;
     int geneCopies;
     
@@ -43,53 +73,109 @@ public:
     bool fixAlpha_on;
     double alpha;
     double alphaPropSD;
+    int alphaUpdates;
+    bool alphaAdapt_on;
+    int alphaAccept;
+    int alphaProposals;
     double beta;
     
     bool outputQmatrix_pop_on;
     
+    // output written on every iteration is buffered here, and passed to the background writers in the globals object every outputFlushInterval iterations
+    int outputFlushInterval;
+    bool posteriorGrouping_binary;
+    int labelBytes;
+    int buffer_lines;
+    std::string likelihood_buffer;
+    std::string grouping_buffer;
+    
     int burnin;
     int samples;
     int thinning;
     
-    std::vector< std::vector<double> > log_lookup;
+    // adaptive run lengths (used by the main MCMC only). burninMax and samplesMax are hard caps on the length of each phase. Burn-in ends early once the marginal likelihood passes the Geweke test, and sampling ends early once the standard error of the Structure estimator is no more than targetSE. Both are checked every checkInterval iterations (with burn-in lasting at least two intervals), and burnin and samples are cut short to the point at which the check is passed.
+    int burninMax;
+    int samplesMax;
+    bool adaptiveBurnin;
+    double targetSE;
+    int checkInterval;
     
+    // stream of random numbers used by this chain
+    RNGobject RNG;
+    
+    // MCMC starts from iteration firstIteration, which is 0 after reset() but can be later when the state of the chain has been read back from a checkpoint. If checkpoint is set then the state of the chain is saved there (as chain number checkpointChain) every checkpointInterval iterations.
+    int firstIteration;
+    checkpointObject *checkpoint;
+    int checkpointChain;
+    int checkpointInterval;
+    
+    // if profile is set then the time spent in each phase of the MCMC, and the number of sweeps and Metropolis-Hastings moves, are added to it (see profile.h)
+    profileObject *profile;
+    
+    // group allocation of each gene copy, in the same order as the data
     std::vector<int> linearGroup;
-    std::vector< std::vector< std::vector<int> > > group;
     int groupIndex;
-    std::vector< std::vector< std::vector<int> > > alleleCounts;
-    std::vector< std::vector<int> > alleleCountsTotals;
-    std::vector< std::vector< std::vector<double> > > alleleFreqs;
-    std::vector< std::vector< std::vector<int> > > old_alleleCounts;
-    std::vector< std::vector<int> > old_alleleCountsTotals;
     
-    std::vector< std::vector<int> > admixCounts;
+    // allele counts and frequencies are stored as flat arrays with deme as the fastest-changing index, so that the count of allele j at locus l in deme k is found at alleleCounts[(J_offset[l]+j)*K+k], and the total count at locus l in deme k is found at alleleCountsTotals[l*K+k]. Similarly, the admix count of individual i in deme k is found at admixCounts[i*K+k].
+    std::vector<int> alleleCounts;
+    std::vector<int> alleleCountsTotals;
+    std::vector<double> alleleFreqs;
+    
+    std::vector<int> admixCounts;
     std::vector<int> admixCountsTotals;
     std::vector< std::vector<double> > admixFreqs;
-    std::vector< std::vector<int> > old_admixCounts;
     
-    // likelihoods
+    // current labelling of demes. Deme k (coded 0:K-1) in linearGroup and in the allele and admix counts corresponds to label labelMap[k] in the Qmatrices and in the outputPosteriorGrouping file. Solving the label switching problem only changes labelMap, so the counts themselves never need to be rearranged.
+    std::vector<int> labelMap;
+    int fixLabelsInterval;
+    
+    // histogram of admix counts over all individuals and demes, such that admixHist[c] is the number of elements of admixCounts equal to c. Together with the distinct values of admixCountsTotals (which are fixed by the data) this is sufficient to evaluate the likelihood of alpha. admixLgamma holds lgamma(c+alpha) for the value of alpha given by admixLgamma_alpha.
+    std::vector<int> admixHist;
+    std::vector<int> admixTotals_value;
+    std::vector<int> admixTotals_freq;
+    std::vector<double> admixLgamma;
+    std::vector<double> admixLgamma_new;
+    double admixLgamma_alpha;
+    
+    // likelihoods. The mean and variance of the likelihoods over all iterations after burn-in are accumulated in logLikeGroup_stats and logLikeJoint_stats.
     double logLikeGroup;
-    double logLikeGroup_sum;
+    welford logLikeGroup_stats;
     std::vector<double> logLikeGroup_store;
-    double logLikeGroup_sumSquared;
+    std::vector<double> logLikeBurnin_store;
+    std::vector<double> logLikeJoint_store;
     double logLikeJoint;
-    double logLikeJoint_sum;
-    double logLikeJoint_sumSquared;
+    welford logLikeJoint_stats;
     double harmonic;
     
     std::vector<double> logProbVec;
     double logProbVecSum;
     double logProbVecMax;
     std::vector<double> probVec;
+    std::vector<double> cumProbVec;
     double probVecSum;
     
-    // Qmatrices. logQmatrix_ind_old, logQmatrix_ind_new and logQmatrix_running are used throughout MCMC (including burn-in phase) when solving label switching problem. Other Qmatrix objects are final outputs, and are only produced after burn-in phase.
-    std::vector< std::vector<double> > logQmatrix_gene_old;
-    std::vector< std::vector<double> > logQmatrix_gene_new;
-    std::vector< std::vector<double> > Qmatrix_gene_new;
-    std::vector< std::vector<double> > logQmatrix_gene_running;
+    // scratch space for group_update_indLevel(), sized for the individual with the most gene copies. indLevel_allele holds the observed allele of each gene copy of the individual, indLevel_newGroup the proposed group of each gene copy, and indLevel_changed the gene copies (as offsets from data_indStart) whose group differs from the current one, which are the only ones that need to be put back if the move is rejected.
+    std::vector<int> indLevel_allele;
+    std::vector<int> indLevel_newGroup;
+    std::vector<int> indLevel_changed;
+    
+    // objects used when the Gibbs sweep is split into blocks that can be run in parallel (see group_update_blocked()). blocks is the number of blocks actually used, which is gibbsBlocks limited by the number of individuals and loci. Individual block b runs from indBlock_start[b] to indBlock_start[b+1]-1, and likewise for loci. Each block has its own stream of random numbers, scratch space for assignment probabilities, and change in logLikeGroup over the current sweep.
+    int blocks;
+    std::vector<int> indBlock_start;
+    std::vector<int> lociBlock_start;
+    std::vector<RNGobject> block_RNG;
+    std::vector< std::vector<double> > block_probVec;
+    std::vector< std::vector<double> > block_cumProbVec;
+    std::vector<double> block_logLike;
+    
+    // Qmatrices. Qmatrix_gene_new (flat array, with the value for gene copy i in deme k found at Qmatrix_gene_new[i*K+k]) and Qmatrix_gene_running are used throughout MCMC (including burn-in phase) when solving label switching problem. Qmatrix_gene_new is stored in the order of the demes in the allele counts, while all other Qmatrices are stored in the order of labels (see labelMap). Qmatrix_gene_store is the mean over all iterations after burn-in. When QmatrixFloat_on, both are held in single precision, and Qmatrix_gene_store (which is written out) keeps a compensation term for every value so that its precision is close to double. Other Qmatrix objects are final outputs, and are only produced at the end of the MCMC. None of these are allocated unless fixLabels_on, as each holds a value for every gene copy in every deme.
+    bool fixLabels_on;
+    std::vector<double> Qmatrix_gene_new;
+    QmatrixMean Qmatrix_gene_running;
+    QmatrixMean Qmatrix_gene_store;
+    bool QmatrixFloat_on;
+    std::vector<double> logQ_running;
     
-    std::vector< std::vector<double> > logQmatrix_gene;
     std::vector< std::vector<double> > Qmatrix_gene;
     std::vector< std::vector<double> > Qmatrix_ind;
     std::vector< std::vector<double> > Qmatrix_pop;
@@ -97,7 +183,6 @@ public:
     // objects for Hungarian algorithm
     std::vector< std::vector<double> > costMat;
     std::vector<int> bestPerm;
-    std::vector<int> bestPermOrder;
     
     std::vector<int>edgesLeft;
     std::vector<int>edgesRight;
@@ -107,29 +192,68 @@ public:
     // PUBLIC FUNCTIONS
     
     // constructor
-    MCMCobject_admixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta);
+    MCMCobject_admixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta, bool _fixLabels);
     
     // perform MCMC
     void reset(bool reset_Qmatrix_running);
     void perform_MCMC(globals &globals, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep);
+    void MCMC_iteration(globals &globals, int rep, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep);
+    void finalise_MCMC(globals &globals, bool fixLabels);
+    void appendGroup(int g);
+    void flushOutput(globals &globals);
+    
+    // write the state of the chain (everything needed to carry on from iteration nextIteration of repeat mainRep) in binary form, or read it back. readState() returns false if the state does not match this chain.
+    void writeState(std::string &state, int mainRep, int nextIteration);
+    bool readState(const std::string &state, int &mainRep);
+    
+    // exchange the current state of the chain with another chain (used when running multiple temperatures together), or save it and copy it back later
+    void swapState(MCMCobject_admixture &other);
+    void saveState(chainState &state) const;
+    void copyState(const chainState &state);
     
     // update objects
     void group_update();
+    template<bool PACKED>
+    void group_update_sweep();
+    void group_update_blocked();
+    template<bool PACKED>
+    void group_update_block(int b, int lb, bool tempered);
+    template<bool PACKED>
     void group_update_indLevel();
+    void geneCopyProbs(int ind, int l, int d, bool tempered);
+    
+    // versions of the Gibbs update of a single individual and of geneCopyProbs() that are specialised at compile time on the ploidy (1, 2, or 0 meaning any), on whether the likelihood is tempered, and on whether the individual has any missing data. The Gibbs updates are also specialised on whether the data are packed. group_update() chooses between them once per individual. group_update_indBlock() is the same update restricted to a block of loci (see group_update_blocked()).
+    template<int PLOIDY, bool TEMPERED, bool MISSING, bool PACKED>
+    void group_update_ind(int ind);
+    template<int PLOIDY, bool TEMPERED, bool MISSING, bool PACKED>
+    void group_update_indBlock(int ind, int l0, int l1, int b, RNGobject &blockRNG, double &d_logLike);
+    template<bool TEMPERED, bool MISSING>
+    double geneCopyProbs_kernel(int ind, int l, int d, double *probVec_out, double *cumProbVec_out) const;
     void drawFreqs();
-    void alpha_update();
+    void alpha_update(bool adapt);
+    double logLikeAlpha(double a, std::vector<double> &lgamma_alpha);
+    void addAdmixCount(int ind, int k);
+    void subtractAdmixCount(int ind, int k);
     
     // label switching
     void chooseBestLabelPermutation(globals &globals, int rep);
-    void produceQmatrix();
+    template<bool PACKED>
+    void produceQmatrix(bool updateCost);
     void updateQmatrix(int rep);
     void storeQmatrix();
     
     // likelihoods
-    void d_logLikeConditional(int i, int k, int targetGroup);
     void d_logLikeGroup();
+    double logPredictive(int a, int a_t, int l);
+    void addGeneCopy(int l, int d, int k);
+    void subtractGeneCopy(int l, int d, int k);
+    template<bool PACKED>
     void d_logLikeJoint();
     
+    // adaptive run lengths
+    bool burninConverged();
+    double structureSE();
+    
 };
 
 #endif
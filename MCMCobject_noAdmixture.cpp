@@ -16,8 +16,8 @@ using namespace std;
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// constructor for class containing all elements required for MCMC under no-admixture model
-MCMCobject_noAdmixture::MCMCobject_noAdmixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta) {
+// constructor for class containing all elements required for MCMC under no-admixture model. Qmatrices are only allocated if _fixLabels is true, in which case perform_MCMC() must also be run with fixLabels.
+MCMCobject_noAdmixture::MCMCobject_noAdmixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta, bool _fixLabels) : data(*globals.data), data_indStart(globals.data_indStart), lookup(*globals.lookup) {
     
     // copy some values over from globals object
     outputQmatrix_pop_on = globals.outputQmatrix_pop_on;
@@ -27,33 +27,41 @@ MCMCobject_noAdmixture::MCMCobject_noAdmixture(globals &globals, int _Kindex, in
     n = globals.n;
     loci = globals.loci;
     J = globals.J;
+    J_offset = globals.J_offset;
     ploidy_vec = globals.ploidy_vec;
-    data = globals.data;
+    missing_vec = globals.missing_vec;
+    biallelic = globals.biallelic;
     lambda = globals.lambda;
     beta = _beta;
     uniquePops = globals.uniquePops;
     
+    outputFlushInterval = globals.outputFlushInterval;
+    posteriorGrouping_binary = globals.outputPosteriorGrouping_binary_on;
+    labelBytes = (globals.Kmax>255) ? 2 : 1;
+    buffer_lines = 0;
+    
+    firstIteration = 0;
+    checkpoint = 0;
+    profile = 0;
+    checkpointChain = 0;
+    checkpointInterval = globals.checkpointInterval;
+    
     burnin = _burnin;
     samples = _samples;
     thinning = _thinning;
     
-    log_lookup = globals.log_lookup;
+    burninMax = burnin;
+    samplesMax = samples;
+    adaptiveBurnin = false;
+    targetSE = 0;
+    checkInterval = globals.mainCheckInterval;
     
     group = vector<int>(n,1);
     
     // initialise allele counts and frequencies
-    alleleCounts = vector< vector< vector<int> > >(K);
-    alleleCountsTotals = vector< vector<int> >(K);
-    alleleFreqs = vector< vector< vector<double> > >(K);
-    for (int k=0; k<K; k++) {
-        alleleCounts[k] = vector< vector<int> >(loci);
-        alleleCountsTotals[k] = vector<int>(loci);
-        alleleFreqs[k] = vector< vector<double> >(loci);
-        for (int l=0; l<loci; l++) {
-            alleleCounts[k][l] = vector<int>(J[l]);
-            alleleFreqs[k][l] = vector<double>(J[l]);
-        }
-    }
+    alleleCounts = vector<int>(J_offset[loci]*K);
+    alleleCountsTotals = vector<int>(loci*K);
+    alleleFreqs = vector<double>(J_offset[loci]*K);
     
     // initialise objects for calculating assignment probabilities
     logProbVec = vector<double>(K);
@@ -62,18 +70,35 @@ MCMCobject_noAdmixture::MCMCobject_noAdmixture(globals &globals, int _Kindex, in
     probVec = vector<double>(K);
     probVecSum = 0;
     
-    // initialise Qmatrices
-    logQmatrix_ind_old = vector< vector<double> >(n, vector<double>(K));
-    logQmatrix_ind_new = vector< vector<double> >(n, vector<double>(K));
-    logQmatrix_ind_running = vector< vector<double> >(n, vector<double>(K));
+    // columns of the lookup tables used at each locus
+    log_1 = lookup.logColumn(1);
+    lgamma_1 = lookup.lgammaColumn(1);
+    log_J = vector<const double*>(loci);
+    lgamma_J = vector<const double*>(loci);
+    for (int l=0; l<loci; l++) {
+        log_J[l] = lookup.logColumn(J[l]);
+        lgamma_J[l] = lookup.lgammaColumn(J[l]);
+    }
     
-    logQmatrix_ind = vector< vector<double> >(n, vector<double>(K));
-    Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
-    Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    // choose the version of d_logLikeConditional() for each individual
+    conditional_ind = vector<conditionalFunction>(n);
+    for (int i=0; i<n; i++) {
+        conditional_ind[i] = chooseConditional(i);
+    }
+    
+    // initialise Qmatrices
+    QmatrixFloat_on = globals.QmatrixFloat_on;
+    fixLabels_on = _fixLabels;
+    if (fixLabels_on) {
+        Qmatrix_ind_new = vector<double>(n*K);
+        Qmatrix_ind_running.reset(n, K, QmatrixFloat_on, false, 1/double(K));
+    }
+    logQ_running = vector<double>(K);
     
     // initialise objects for Hungarian algorithm
     costMat = vector< vector<double> >(K, vector<double>(K));
-    bestPermOrder = vector<int>(K);
+    labelMap = vector<int>(K);
+    fixLabelsInterval = globals.fixLabelsInterval;
     
     edgesLeft = vector<int>(K);
     edgesRight = vector<int>(K);
@@ -87,133 +112,295 @@ MCMCobject_noAdmixture::MCMCobject_noAdmixture(globals &globals, int _Kindex, in
 // reset objects used in MCMC
 void MCMCobject_noAdmixture::reset(bool reset_Qmatrix_running) {
     
+    // reset run lengths, which may have been cut short in the last run
+    burnin = burninMax;
+    samples = samplesMax;
+    
     // reset likelihoods
     logLikeGroup = 0;
-    logLikeGroup_sum = 0;
+    logLikeGroup_stats.reset();
     logLikeGroup_store = vector<double>(samples);
-    logLikeGroup_sumSquared = 0;
+    logLikeBurnin_store.clear();
+    logLikeJoint_store = vector<double>(samples);
     logLikeJoint = 0;
-    logLikeJoint_sum = 0;
-    logLikeJoint_sumSquared = 0;
+    logLikeJoint_stats.reset();
     harmonic = log(double(0));
     
-    // reset Qmatrices
-    logQmatrix_ind_old = vector< vector<double> >(n, vector<double>(K));
-    logQmatrix_ind_new = vector< vector<double> >(n, vector<double>(K));
-    if (reset_Qmatrix_running) {
-        logQmatrix_ind_running = vector< vector<double> >(n, vector<double>(K,-log(double(K))));
+    // reset Qmatrices and labelling
+    if (fixLabels_on) {
+        if (reset_Qmatrix_running) {
+            Qmatrix_ind_running.reset(n, K, QmatrixFloat_on, false, 1/double(K));
+        }
+        Qmatrix_ind_store.reset(n, K, QmatrixFloat_on, true, 0);
+        Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
+        Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    }
+    for (int k=0; k<K; k++) {
+        labelMap[k] = k;
     }
     
-    logQmatrix_ind = vector< vector<double> >(n, vector<double>(K, log(double(0))));
-    Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
-    Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    // start from the first iteration
+    firstIteration = 0;
     
     // initialise group with random allocation
     vector<double> equalK(K,1/double(K));
     for (int i=0; i<n; i++) {
-        group[i] = sample1(equalK,1.0);
+        group[i] = RNG.sample1(equalK,1.0);
     }
     
     // zero allele counts
-    for (int k=0; k<K; k++) {
-        alleleCountsTotals[k] = vector<int>(loci);
-        for (int l=0; l<loci; l++) {
-            alleleCounts[k][l] = vector<int>(J[l]);
-        }
-    }
+    fill(alleleCounts.begin(), alleleCounts.end(), 0);
+    fill(alleleCountsTotals.begin(), alleleCountsTotals.end(), 0);
     
     // populate allele counts
     for (int ind=0; ind<n; ind++) {
-        for (int l=0; l<loci; l++) {
-            for (int p=0; p<ploidy_vec[ind]; p++) {
-                if (data[ind][l][p]!=0) {
-                    alleleCounts[group[ind]-1][l][data[ind][l][p]-1]++;
-                    alleleCountsTotals[group[ind]-1][l]++;
+        biallelic ? addInd<true>(ind) : addInd<false>(ind);
+    }
+    
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// perform complete MCMC under no-admixture model
+void MCMCobject_noAdmixture::perform_MCMC(globals &globals, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep) {
+    
+    // perform MCMC, saving the state of the chain to the checkpoint at regular intervals
+    for (int rep=firstIteration; rep<(burnin+samples); rep++) {
+        MCMC_iteration(globals, rep, drawAlleleFreqs, storeLoglike, fixLabels, outputLikelihood, outputPosteriorGrouping, mainRep);
+        
+        // adaptive run lengths. Shortening burnin or samples takes effect from the next iteration.
+        if (rep<burnin) {
+            if (adaptiveBurnin) {
+                logLikeBurnin_store.push_back(logLikeGroup);
+                if ((rep+1)%checkInterval==0 && (rep+1)>=2*checkInterval && (rep+1)<burnin && burninConverged()) {
+                    burnin = rep+1;
                 }
             }
+        } else if (targetSE>0 && (rep+1-burnin)%checkInterval==0 && (rep+1)<(burnin+samples)) {
+            if (structureSE()<=targetSE) {
+                samples = rep+1-burnin;
+            }
+        }
+        
+        if (checkpoint!=0 && (rep+1)%checkpointInterval==0) {
+            string state;
+            writeState(state, mainRep, rep+1);
+            checkpoint->saveChain(globals, checkpointChain, state);
         }
     }
     
+    // finish off Qmatrices and harmonic mean
+    finalise_MCMC(globals, fixLabels);
 }
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// perform complete MCMC under no-admixture model
-void MCMCobject_noAdmixture::perform_MCMC(globals &globals, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep) {
+// carry out a single iteration of MCMC. rep is the iteration number, counting from the start of the burn-in phase.
+void MCMCobject_noAdmixture::MCMC_iteration(globals &globals, int rep, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep) {
     
-    // perform MCMC
-    int thinSwitch = 1;
-    for (int rep=0; rep<(burnin+samples); rep++) {
+    // thinning loop (becomes active after burn-in)
+    int thinSwitch = (rep>burnin) ? thinning : 1;
+    for (int thin=0; thin<thinSwitch; thin++) {
         
-        // thinning loop (becomes active after burn-in)
-        for (int thin=0; thin<thinSwitch; thin++) {
-            
-            // update group allocation of all individuals
-            group_update();
-            
+        // update group allocation of all individuals. The Qmatrix for this iteration is calculated along the way in the last sweep, if it is needed.
+        {
+            profileTimer timer(profile, PROFILE_GIBBS);
+            group_update(fixLabels && (thin==thinSwitch-1) && (rep%fixLabelsInterval==0 || rep>=burnin));
         }
-        if (rep==burnin)
-            thinSwitch = thinning;
+        profileCount(profile, COUNT_SWEEPS);
         
-        // if fix label-switching problem
-        if (fixLabels) {
-            // calculate logQmatrix_ind_new for this iteration
-            produceQmatrix();
+    }
+    
+    // if fix label-switching problem. Labels are only updated every fixLabelsInterval iterations, and in between the Qmatrix is only needed after burn-in
+    if (fixLabels) {
+        bool relabel = (rep%fixLabelsInterval==0);
         
-            // fix label-switching problem
+        // fix label-switching problem, and add Qmatrix_ind_new to Qmatrix_ind_running
+        if (relabel) {
+            {
+                profileTimer timer(profile, PROFILE_QMATRIX);
+                produceCostMatrix();
+            }
+            profileTimer timer(profile, PROFILE_LABELS);
             chooseBestLabelPermutation(globals, rep);
-        
-            // add logQmatrix_ind_new to logQmatrix_ind_running
             updateQmatrix(rep);
-            
-            // store Qmatrix values if no longer in burn-in
-            if (rep>=burnin)
-                storeQmatrix();
         }
         
-        // calculate marginal likelihood
+        // store Qmatrix values if no longer in burn-in
+        if (rep>=burnin)
+            storeQmatrix();
+    }
+    
+    // recalculate marginal likelihood in full every LOGLIKE_RECOMPUTE iterations. Between times it is updated as gene copies move between groups
+    if ((rep+1)%LOGLIKE_RECOMPUTE==0) {
+        profileTimer timer(profile, PROFILE_LIKELIHOOD);
         d_logLikeGroup();
+    }
+    
+    // optionally draw allele frequencies and calculate joint likelihood
+    if (drawAlleleFreqs) {
+        profileTimer timer(profile, PROFILE_FREQS);
+        drawFreqs();
+        biallelic ? d_logLikeJoint<true>() : d_logLikeJoint<false>();
+    }
+    
+    // add likelihoods to running sums
+    if (rep>=burnin) {
+        logLikeGroup_stats.add(logLikeGroup);
         
-        // optionally draw allele frequencies and calculate joint likelihood
-        if (drawAlleleFreqs) {
-            drawFreqs();
-            d_logLikeJoint();
+        if (storeLoglike) {
+            logLikeGroup_store[rep-burnin] = logLikeGroup;
+            logLikeJoint_store[rep-burnin] = logLikeJoint;
         }
-        
-        // add likelihoods to running sums
-        if (rep>=burnin) {
-            logLikeGroup_sum += logLikeGroup;
-            logLikeGroup_sumSquared += logLikeGroup*logLikeGroup;
-            
-            if (storeLoglike) {
-                logLikeGroup_store[rep-burnin] = logLikeGroup;
-            }
 
-            harmonic = logSum(harmonic, -logLikeGroup);
-            if (drawAlleleFreqs) {
-                logLikeJoint_sum += logLikeJoint;
-                logLikeJoint_sumSquared += logLikeJoint*logLikeJoint;
-            }
+        harmonic = logSum(harmonic, -logLikeGroup);
+        if (drawAlleleFreqs) {
+            logLikeJoint_stats.add(logLikeJoint);
         }
-        
-        // write to outputLikelihoods file
-        if (outputLikelihood) {
-            globals.outputLikelihood_fileStream << K << "," << mainRep+1 << "," << rep-burnin+1 << "," << logLikeGroup << "," << logLikeJoint << "\n";
-            globals.outputLikelihood_fileStream.flush();
+    }
+    
+    // everything from here on is output, and is timed as such
+    profileTimer outputTimer(profile, PROFILE_OUTPUT);
+    
+    // add to outputLikelihoods buffer
+    if (outputLikelihood) {
+        ostringstream line;
+        line << K << "," << mainRep+1 << "," << rep-burnin+1 << "," << logLikeGroup << "," << logLikeJoint << "\n";
+        likelihood_buffer += line.str();
+    }
+    
+    // add to outputPosteriorGrouping buffer, either as text or as a binary record (see Notes.c for the layout)
+    if (outputPosteriorGrouping) {
+        if (posteriorGrouping_binary) {
+            appendBinary(grouping_buffer, int32_t(K));
+            appendBinary(grouping_buffer, int32_t(mainRep+1));
+            appendBinary(grouping_buffer, int32_t(rep-burnin+1));
+        } else {
+            appendInt(grouping_buffer, K);
+            grouping_buffer += ',';
+            appendInt(grouping_buffer, mainRep+1);
+            grouping_buffer += ',';
+            appendInt(grouping_buffer, rep-burnin+1);
         }
-        
-        // write to outputPosteriorGrouping file
-        if (outputPosteriorGrouping) {
-            globals.outputPosteriorGrouping_fileStream << K << "," << mainRep+1 << "," << rep-burnin+1;
-            for (int i=0; i<n; i++) {
-                globals.outputPosteriorGrouping_fileStream << "," << group[i];
-            }
-            globals.outputPosteriorGrouping_fileStream << "\n";
-            globals.outputPosteriorGrouping_fileStream.flush();
+        for (int i=0; i<n; i++) {
+            appendGroup(labelMap[group[i]-1]+1);
         }
-            
-    } // end of MCMC
+        if (!posteriorGrouping_binary) {
+            grouping_buffer += '\n';
+        }
+    }
+    
+    // pass buffered output to the background writers every outputFlushInterval iterations
+    if (outputLikelihood || outputPosteriorGrouping) {
+        buffer_lines++;
+        if (buffer_lines>=outputFlushInterval)
+            flushOutput(globals);
+    }
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// append the group of a single individual or gene copy to the outputPosteriorGrouping buffer
+void MCMCobject_noAdmixture::appendGroup(int g) {
+    if (!posteriorGrouping_binary) {
+        grouping_buffer += ',';
+        appendInt(grouping_buffer, g);
+    } else if (labelBytes==1) {
+        appendBinary(grouping_buffer, uint8_t(g));
+    } else {
+        appendBinary(grouping_buffer, uint16_t(g));
+    }
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// pass any buffered outputLikelihood and outputPosteriorGrouping lines to the background writers
+void MCMCobject_noAdmixture::flushOutput(globals &globals) {
+    globals.outputLikelihood_writer.write(likelihood_buffer);
+    globals.outputPosteriorGrouping_writer.write(grouping_buffer);
+    buffer_lines = 0;
+}
 
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// write the state of the chain (everything needed to carry on from iteration nextIteration of repeat mainRep) in binary form. Quantities that are recalculated from scratch on every iteration are not included.
+void MCMCobject_noAdmixture::writeState(string &state, int mainRep, int nextIteration) {
+    appendValue(state, mainRep);
+    appendValue(state, nextIteration);
+    appendValue(state, burnin);
+    appendValue(state, samples);
+    appendValue(state, RNG);
+    appendValue(state, group);
+    appendValue(state, alleleCounts);
+    appendValue(state, alleleCountsTotals);
+    appendValue(state, alleleFreqs);
+    appendValue(state, labelMap);
+    appendValue(state, logLikeGroup);
+    appendValue(state, logLikeGroup_stats);
+    appendValue(state, logLikeGroup_store);
+    appendValue(state, logLikeBurnin_store);
+    appendValue(state, logLikeJoint_store);
+    appendValue(state, logLikeJoint);
+    appendValue(state, logLikeJoint_stats);
+    appendValue(state, harmonic);
+    appendValue(state, Qmatrix_ind_running);
+    appendValue(state, Qmatrix_ind_store);
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// read back the state of the chain written by writeState(), such that perform_MCMC() carries on from where the state was saved. Returns false if the state does not match the dimensions of this chain.
+bool MCMCobject_noAdmixture::readState(const string &state, int &mainRep) {
+    binaryReader r(state);
+    int nextIteration = 0;
+    readValue(r, mainRep);
+    readValue(r, nextIteration);
+    
+    // the size of each object is fixed by the data and K, so anything else means the state belongs to a different chain
+    size_t groupSize = group.size();
+    size_t countsSize = alleleCounts.size();
+    size_t totalsSize = alleleCountsTotals.size();
+    readValue(r, burnin);
+    readValue(r, samples);
+    readValue(r, RNG);
+    readValue(r, group);
+    readValue(r, alleleCounts);
+    readValue(r, alleleCountsTotals);
+    readValue(r, alleleFreqs);
+    readValue(r, labelMap);
+    readValue(r, logLikeGroup);
+    readValue(r, logLikeGroup_stats);
+    readValue(r, logLikeGroup_store);
+    readValue(r, logLikeBurnin_store);
+    readValue(r, logLikeJoint_store);
+    readValue(r, logLikeJoint);
+    readValue(r, logLikeJoint_stats);
+    readValue(r, harmonic);
+    readValue(r, Qmatrix_ind_running);
+    readValue(r, Qmatrix_ind_store);
+    
+    if (r.failed || group.size()!=groupSize || alleleCounts.size()!=countsSize || alleleCountsTotals.size()!=totalsSize || nextIteration<0 || nextIteration>(burnin+samples)) {
+        return(false);
+    }
+    firstIteration = nextIteration;
+    buffer_lines = 0;
+    
+    // final Qmatrices are built up from zero in finalise_MCMC()
+    if (fixLabels_on) {
+        Qmatrix_ind = vector< vector<double> >(n, vector<double>(K));
+        Qmatrix_pop = vector< vector<double> >(uniquePops.size(), vector<double>(K));
+    }
+    
+    return(true);
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// finish off Qmatrices and harmonic mean once all iterations are complete
+void MCMCobject_noAdmixture::finalise_MCMC(globals &globals, bool fixLabels) {
+    
+    // write out any remaining buffered output
+    flushOutput(globals);
     
     // finish off Qmatrices
     if (fixLabels) {
@@ -221,7 +408,7 @@ void MCMCobject_noAdmixture::perform_MCMC(globals &globals, bool drawAlleleFreqs
         // finish off individual level Qmatrix
         for (int i=0; i<n; i++) {
             for (int k=0; k<K; k++) {
-                Qmatrix_ind[i][k] = exp(logQmatrix_ind[i][k] - log(double(samples)));
+                Qmatrix_ind[i][k] = Qmatrix_ind_store.get(i, k);
             }
         }
         
@@ -240,62 +427,141 @@ void MCMCobject_noAdmixture::perform_MCMC(globals &globals, bool drawAlleleFreqs
         }
     } // end if fixLabels
     
+    // drop any storage for samples that were not needed
+    logLikeGroup_store.resize(samples);
+    logLikeJoint_store.resize(samples);
+    
     // finish off harmonic mean
     harmonic = log(double(samples))-harmonic;
 }
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// resample group allocation of all individuals by drawing from conditional posterior
-void MCMCobject_noAdmixture::group_update() {
+// exchange the current state of this chain with that of another chain. Only the objects that define the current position of the chain are exchanged, while running sums and stored values stay with the chain that produced them.
+void MCMCobject_noAdmixture::swapState(MCMCobject_noAdmixture &other) {
+    swap(group, other.group);
+    swap(alleleCounts, other.alleleCounts);
+    swap(alleleCountsTotals, other.alleleCountsTotals);
+    swap(labelMap, other.labelMap);
+    swap(logLikeGroup, other.logLikeGroup);
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// save the current state of the chain
+void MCMCobject_noAdmixture::saveState(chainState &state) const {
+    state.group = group;
+    state.alleleCounts = alleleCounts;
+    state.alleleCountsTotals = alleleCountsTotals;
+    state.labelMap = labelMap;
+    state.logLikeGroup = logLikeGroup;
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// copy over a state saved by saveState()
+void MCMCobject_noAdmixture::copyState(const chainState &state) {
+    group = state.group;
+    alleleCounts = state.alleleCounts;
+    alleleCountsTotals = state.alleleCountsTotals;
+    labelMap = state.labelMap;
+    logLikeGroup = state.logLikeGroup;
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// resample group allocation of all individuals by drawing from conditional posterior. If storeQmatrix is true then the conditional probability of each individual from each deme (untempered) is also written to Qmatrix_ind_new, so that it does not need to be calculated again by produceQmatrix().
+void MCMCobject_noAdmixture::group_update(bool storeQmatrix) {
     
     // update group allocation for all individuals
     for (int ind=0; ind<n; ind++) {
         
         // subtract individual ind from allele counts
-        for (int l=0; l<loci; l++) {
-            for (int p=0; p<ploidy_vec[ind]; p++) {
-                if (data[ind][l][p]!=0) {   // if not missing data
-                    alleleCounts[group[ind]-1][l][data[ind][l][p]-1]--;
-                    alleleCountsTotals[group[ind]-1][l]--;
-                }
-            }
-        }
+        biallelic ? subtractInd<true>(ind) : subtractInd<false>(ind);
         
-        // calculate probability of individual ind from all demes
-        if (beta==0) {    // special case if beta==0 (draw from prior)
-            logProbVec = vector<double>(K,-log(double(K)));
-            probVec = vector<double>(K,1/double(K));
+        // calculate probability of individual ind from all demes. If beta==0 then the group is drawn from the prior, and the conditional probability is only needed for the Qmatrix.
+        if (beta==0 && !storeQmatrix) {
+            fill(probVec.begin(), probVec.end(), 1/double(K));
             probVecSum = 1.0;
         } else {
-            for (int k=0; k<K; k++) {
-                d_logLikeConditional(ind, k);   // update logProbVec[k]
-            }
+            d_logLikeConditional(ind, &logProbVec[0]);
             logProbVecMax = *max_element(begin(logProbVec),end(logProbVec));
             probVecSum = 0;
             for (int k=0; k<K; k++) {
                 probVec[k] = exp(beta*logProbVec[k]-beta*logProbVecMax);
                 probVecSum += probVec[k];
             }
+            
+            // untempered probabilities are the Qmatrix row itself
+            if (storeQmatrix) {
+                double *Qnew = &Qmatrix_ind_new[ind*K];
+                if (beta==1) {
+                    for (int k=0; k<K; k++) {
+                        Qnew[k] = probVec[k]/probVecSum;
+                    }
+                } else {
+                    double Qsum = 0;
+                    for (int k=0; k<K; k++) {
+                        Qnew[k] = exp(logProbVec[k]-logProbVecMax);
+                        Qsum += Qnew[k];
+                    }
+                    for (int k=0; k<K; k++) {
+                        Qnew[k] /= Qsum;
+                    }
+                }
+            }
+            if (beta==0) {
+                fill(probVec.begin(), probVec.end(), 1/double(K));
+                probVecSum = 1.0;
+            }
         }
         
         // resample grouping
-        group[ind] = sample1(probVec, probVecSum);
+        group[ind] = RNG.sample1(probVec, probVecSum);
         
         // add individual ind to allele counts
-        for (int l=0; l<loci; l++) {
-            for (int p=0; p<ploidy_vec[ind]; p++) {
-                if (data[ind][l][p]!=0) {   // if not missing data
-                    alleleCounts[group[ind]-1][l][data[ind][l][p]-1]++;
-                    alleleCountsTotals[group[ind]-1][l]++;
-                }
-            }
-        }
+        biallelic ? addInd<true>(ind) : addInd<false>(ind);
         
     }
     
 }
 
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// add all gene copies of individual ind to the allele counts of its current group (updating logLikeGroup). PACKED is set if the data are packed into 2-bit codes.
+template<bool PACKED>
+void MCMCobject_noAdmixture::addInd(int ind) {
+    size_t g = data_indStart[ind];
+    int ploidy = ploidy_vec[ind];
+    int k = group[ind]-1;
+    for (int l=0; l<loci; l++) {
+        for (int p=0; p<ploidy; p++) {
+            int d = data.get<PACKED>(g++);
+            if (d!=0) {   // if not missing data
+                addGeneCopy(l, d, k);
+            }
+        }
+    }
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// subtract all gene copies of individual ind from the allele counts of its current group (updating logLikeGroup), with PACKED as in addInd()
+template<bool PACKED>
+void MCMCobject_noAdmixture::subtractInd(int ind) {
+    size_t g = data_indStart[ind];
+    int ploidy = ploidy_vec[ind];
+    int k = group[ind]-1;
+    for (int l=0; l<loci; l++) {
+        for (int p=0; p<ploidy; p++) {
+            int d = data.get<PACKED>(g++);
+            if (d!=0) {   // if not missing data
+                subtractGeneCopy(l, d, k);
+            }
+        }
+    }
+}
+
 //------------------------------------------------
 // MCMCobject_noAdmixture::
 // draw allele frequencies given allele counts and lambda prior
@@ -306,11 +572,11 @@ void MCMCobject_noAdmixture::drawFreqs() {
         for (int l=0; l<loci; l++) {
             randSum = 0;
             for (int j=0; j<J[l]; j++) {
-                alleleFreqs[k][l][j] = rgamma1(alleleCounts[k][l][j]+lambda, 1.0);
-                randSum += alleleFreqs[k][l][j];
+                alleleFreqs[(J_offset[l]+j)*K+k] = RNG.rgamma1(alleleCounts[(J_offset[l]+j)*K+k]+lambda, 1.0);
+                randSum += alleleFreqs[(J_offset[l]+j)*K+k];
             }
             for (int j=0; j<J[l]; j++) {
-                alleleFreqs[k][l][j] /= randSum;
+                alleleFreqs[(J_offset[l]+j)*K+k] /= randSum;
             }
             
         }
@@ -320,72 +586,42 @@ void MCMCobject_noAdmixture::drawFreqs() {
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// choose best permutation of labels using method of Stephens (2000)
+// choose best permutation of labels using method of Stephens (2000). The cost matrix has already been calculated by produceQmatrix(), so all that remains is to find the best permutation and update labelMap
 void MCMCobject_noAdmixture::chooseBestLabelPermutation(globals &globals, int rep) {
     
-    // calculate cost matrix from old and new Qmatrices
-    for (int k1=0; k1<K; k1++) {
-        for (int k2=0; k2<K; k2++) {
-            costMat[k1][k2] = 0;
-            for (int i=0; i<n; i++) {
-                costMat[k1][k2] += exp(logQmatrix_ind_new[i][k1])*(logQmatrix_ind_new[i][k1]-logQmatrix_ind_running[i][k2]);
-            }
-        }
-    }
-    
     // find best permutation of current labels
-    bestPerm = hungarian(costMat, edgesLeft, edgesRight, blockedLeft, blockedRight, globals.outputLog_on, globals.outputLog_fileStream);
-
-    // define bestPermOrder. If the numbers 1:m_K are placed in best-perm-order then we arrive back at bestPerm. In R terms we would say bestPermOrder=order(bestPerm).
-    bool performSwap = false;
-    for (int k=0; k<K; k++) {
-        bestPermOrder[bestPerm[k]] = k;
-        if (bestPerm[k]!=k)
-            performSwap = true;
-    }
+    int iterations;
+    bestPerm = hungarian(costMat, edgesLeft, edgesRight, blockedLeft, blockedRight, globals.outputLog_on, globals.outputLog_fileStream, &iterations);
+    profileCount(profile, COUNT_HUNGARIAN_CALLS);
+    profileCount(profile, COUNT_HUNGARIAN_ITERATIONS, iterations);
     
-    // swap labels if necessary
-    if (performSwap) {
-        
-        // update grouping to reflect swapped labels
-        for (int i=0; i<n; i++) {
-            group[i] = bestPerm[group[i]-1]+1;
-        }
-        
-        // update allele counts to reflect swapped labels
-        old_alleleCounts = alleleCounts;
-        old_alleleCountsTotals = alleleCountsTotals;
-        for (int k=0; k<K; k++) {
-            alleleCounts[k] = old_alleleCounts[bestPermOrder[k]];
-            alleleCountsTotals[k] = old_alleleCountsTotals[bestPermOrder[k]];
-        }
-        
-        // update logQmatrix_ind_new to reflect swapped labels
-        logQmatrix_ind_old = logQmatrix_ind_new;
-        for (int i=0; i<n; i++) {
-            for (int k=0; k<K; k++) {
-                logQmatrix_ind_new[i][k] = logQmatrix_ind_old[i][bestPermOrder[k]];
-            }
-        }
-        
+    // relabel demes
+    bool changed = false;
+    for (int k=0; k<K; k++) {
+        changed = changed || (bestPerm[k]!=k);
+        labelMap[k] = bestPerm[labelMap[k]];
     }
+    if (changed)
+        profileCount(profile, COUNT_RELABELS);
     
 }
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// calculate logQmatrix_ind_new for this iteration
-void MCMCobject_noAdmixture::produceQmatrix() {
+// build up the cost matrix used in chooseBestLabelPermutation() from Qmatrix_ind_new, which has already been calculated by group_update() in the last sweep of this iteration. Rows are in the order of the current labels and columns in the order of Qmatrix_ind_running. As in the admixture model, only the part of the cost that differs between columns needs to be calculated (see MCMCobject_admixture::produceQmatrix()).
+void MCMCobject_noAdmixture::produceCostMatrix() {
     
-    // populate Qmatrix_ind_new
+    for (int k=0; k<K; k++) {
+        fill(costMat[k].begin(), costMat[k].end(), 0);
+    }
     for (int i=0; i<n; i++) {
-        logProbVecSum = log(double(0));
-        for (int k=0; k<K; k++) {
-            d_logLikeConditional(i, k);   // update logProbVec[k]
-            logProbVecSum = logSum(logProbVecSum, logProbVec[k]);
-        }
-        for (int k=0; k<K; k++) {
-            logQmatrix_ind_new[i][k] = logProbVec[k]-logProbVecSum;
+        const double *Qnew = &Qmatrix_ind_new[i*K];
+        Qmatrix_ind_running.logRow(i, &logQ_running[0]);
+        for (int k1=0; k1<K; k1++) {
+            double *costRow = &costMat[labelMap[k1]][0];
+            for (int k2=0; k2<K; k2++) {
+                costRow[k2] -= Qnew[k1]*logQ_running[k2];
+            }
         }
     }
     
@@ -393,57 +629,112 @@ void MCMCobject_noAdmixture::produceQmatrix() {
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// add logQmatrix_ind_new to logQmatrix_ind_running
+// add Qmatrix_ind_new to Qmatrix_ind_running
 void MCMCobject_noAdmixture::updateQmatrix(int &rep) {
-    
-    for (int i=0; i<n; i++) {
-        for (int k=0; k<K; k++) {
-            logQmatrix_ind_running[i][k] = logSum(logQmatrix_ind_running[i][k], logQmatrix_ind_new[i][k]);
-        }
-    }
+    Qmatrix_ind_running.add(Qmatrix_ind_new, labelMap);
 }
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
 // store Qmatrix values
 void MCMCobject_noAdmixture::storeQmatrix() {
-    
-    // store individual-level Qmatrix
-    for (int i=0; i<n; i++) {
-        for (int k=0; k<K; k++) {
-            logQmatrix_ind[i][k] = logSum(logQmatrix_ind[i][k], logQmatrix_ind_new[i][k]);
-        }
+    Qmatrix_ind_store.add(Qmatrix_ind_new, labelMap);
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// conditional probability of ith individual from every deme (output in log space to logProb[0] to logProb[K-1]). The allele counts are only read, so this can be called on any state of the counts without disturbing it.
+void MCMCobject_noAdmixture::d_logLikeConditional(int i, double *logProb) const {
+    (this->*conditional_ind[i])(i, logProb);
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// choose the version of d_logLikeConditional() to use for individual i
+MCMCobject_noAdmixture::conditionalFunction MCMCobject_noAdmixture::chooseConditional(int i) {
+    
+    bool missing = (missing_vec[i]>0);
+    switch (ploidy_vec[i]) {
+        case 1:
+            if (biallelic)
+                return(missing ? &MCMCobject_noAdmixture::conditional_biallelic<1,true> : &MCMCobject_noAdmixture::conditional_biallelic<1,false>);
+            return(missing ? &MCMCobject_noAdmixture::conditional_general<1,true> : &MCMCobject_noAdmixture::conditional_general<1,false>);
+        case 2:
+            if (biallelic)
+                return(missing ? &MCMCobject_noAdmixture::conditional_biallelic<2,true> : &MCMCobject_noAdmixture::conditional_biallelic<2,false>);
+            return(missing ? &MCMCobject_noAdmixture::conditional_general<2,true> : &MCMCobject_noAdmixture::conditional_general<2,false>);
+        default:
+            if (biallelic)
+                return(missing ? &MCMCobject_noAdmixture::conditional_biallelic<0,true> : &MCMCobject_noAdmixture::conditional_biallelic<0,false>);
+            return(missing ? &MCMCobject_noAdmixture::conditional_general<0,true> : &MCMCobject_noAdmixture::conditional_general<0,false>);
     }
-    
 }
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// conditional probability of ith individual from kth deme (output in log space)
-void MCMCobject_noAdmixture::d_logLikeConditional(int i, int k) {
-    
-    // calculate conditional probability of data
-    logProbVec[k] = 0;
-    int d, a, a_t;  // for making temporary copies of data, alleleCounts, and alleleCountsTotals respectively
-    for (unsigned int l=0; l<loci; l++) {
-        a_t = alleleCountsTotals[k][l];
-        for (unsigned int p=0; p<ploidy_vec[i]; p++) {
-            d = data[i][l][p];
-            a = alleleCounts[k][l][d-1];
-            if (d!=0) {
-                if ((a<int(1e4)) && (a_t<int(1e4))) {
-                    logProbVec[k] += log_lookup[a][1]-log_lookup[a_t][J[l]];
-                } else {
-                    logProbVec[k] += log((a + lambda)/double(a_t + J[l]*lambda));
+// general version of d_logLikeConditional(), scoring individual i against all demes in a single pass over the loci. Later copies of the same allele within individual i are conditioned on earlier ones, by adding the number of earlier copies of the allele (same) and of earlier non-missing copies (seen) at this locus to the counts that are read, rather than by changing the counts themselves. PLOIDY is the ploidy of the individual (or 0 to read it from ploidy_vec) and MISSING is set if the individual has any missing data. The terms added to logProb[k] are added in the same order as when scoring one deme at a time.
+template<int PLOIDY, bool MISSING>
+void MCMCobject_noAdmixture::conditional_general(int i, double *logProb) const {
+    
+    for (int k=0; k<K; k++) {
+        logProb[k] = 0;
+    }
+    const uint16_t *data_i = &data.values[data_indStart[i]];
+    const int ploidy = (PLOIDY>0) ? PLOIDY : ploidy_vec[i];
+    for (int l=0; l<loci; l++) {
+        const uint16_t *data_il = &data_i[l*ploidy];
+        const int *alleleCountsTotals_l = &alleleCountsTotals[l*K];
+        const double *log_Jl = log_J[l];
+        int seen = 0;
+        for (int p=0; p<ploidy; p++) {
+            int d = data_il[p];
+            if (!MISSING || d!=0) {
+                int same = 0;
+                for (int q=0; q<p; q++) {
+                    same += (data_il[q]==d);
                 }
-                alleleCounts[k][l][d-1] ++;
-                a_t ++;
+                const int *alleleCounts_lj = &alleleCounts[(J_offset[l]+d-1)*K];
+                for (int k=0; k<K; k++) {
+                    logProb[k] += log_1[alleleCounts_lj[k]+same]-log_Jl[alleleCountsTotals_l[k]+seen];
+                }
+                seen++;
             }
         }
-        for (unsigned int p=0; p<ploidy_vec[i]; p++) {
-            d = data[i][l][p];
-            if (d!=0) {
-                alleleCounts[k][l][d-1] --;
+    }
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// version of d_logLikeConditional() for packed biallelic data, with template arguments as in conditional_general(). Only the count of the first allele and the total count are read at each locus, with the count of the second allele found from the difference. The terms added to logProb[k] are exactly those added by the general version.
+template<int PLOIDY, bool MISSING>
+void MCMCobject_noAdmixture::conditional_biallelic(int i, double *logProb) const {
+    
+    for (int k=0; k<K; k++) {
+        logProb[k] = 0;
+    }
+    size_t g = data_indStart[i];
+    const int ploidy = (PLOIDY>0) ? PLOIDY : ploidy_vec[i];
+    for (int l=0; l<loci; l++) {
+        const int *alleleCounts_l1 = &alleleCounts[J_offset[l]*K];
+        const int *alleleCountsTotals_l = &alleleCountsTotals[l*K];
+        const double *log_Jl = log_J[l];
+        
+        // earlier gene copies of individual i at this locus carrying the first allele, and all earlier non-missing gene copies
+        int seen_1 = 0;
+        int seen = 0;
+        for (int p=0; p<ploidy; p++) {
+            int d = data.code(g++);
+            if (!MISSING || d!=0) {
+                // (written without branching on the allele, which is unpredictable)
+                int first = (d==1);
+                for (int k=0; k<K; k++) {
+                    int a_1 = alleleCounts_l1[k]+seen_1;
+                    int a_t = alleleCountsTotals_l[k]+seen;
+                    int a = first ? a_1 : a_t-a_1;
+                    logProb[k] += log_1[a]-log_Jl[a_t];
+                }
+                seen_1 += first;
+                seen++;
             }
         }
     }
@@ -451,35 +742,70 @@ void MCMCobject_noAdmixture::d_logLikeConditional(int i, int k) {
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
-// probability of data given grouping only, integrated over unknown allele frequencies
+// probability of data given grouping only, integrated over unknown allele frequencies. This full calculation is only carried out periodically, as logLikeGroup is otherwise kept up to date by addGeneCopy() and subtractGeneCopy().
 void MCMCobject_noAdmixture::d_logLikeGroup() {
     
     // Multinomial-Dirichlet likelihood
     logLikeGroup = 0;
+    int a;
     for (int k=0; k<K; k++) {
         for (int l=0; l<loci; l++) {
             for (int j=0; j<J[l]; j++) {
-                logLikeGroup += lgamma(lambda + alleleCounts[k][l][j]) - lgamma(lambda);
+                a = alleleCounts[(J_offset[l]+j)*K+k];
+                logLikeGroup += lgamma_1[a] - lgamma_1[0];
             }
-            logLikeGroup += lgamma(J[l]*lambda) - lgamma(J[l]*lambda + alleleCountsTotals[k][l]);
+            a = alleleCountsTotals[l*K+k];
+            logLikeGroup += lgamma_J[l][0] - lgamma_J[l][a];
         }
     }
+    
+}
 
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// log of the predictive probability of a single allele, given that it has been observed a times in a deme in which a_t gene copies at locus l have been observed in total. This is also the change in the Multinomial-Dirichlet likelihood when the allele is added to the deme.
+double MCMCobject_noAdmixture::logPredictive(int a, int a_t, int l) {
+    return(log_1[a]-log_J[l][a_t]);
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// add a single gene copy carrying allele d (coded 1:J[l]) at locus l to the allele counts of deme k (coded 0:K-1), updating logLikeGroup to match
+void MCMCobject_noAdmixture::addGeneCopy(int l, int d, int k) {
+    int &a = alleleCounts[(J_offset[l]+d-1)*K+k];
+    int &a_t = alleleCountsTotals[l*K+k];
+    logLikeGroup += logPredictive(a, a_t, l);
+    a++;
+    a_t++;
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// subtract a single gene copy carrying allele d at locus l from the allele counts of deme k, updating logLikeGroup to match
+void MCMCobject_noAdmixture::subtractGeneCopy(int l, int d, int k) {
+    int &a = alleleCounts[(J_offset[l]+d-1)*K+k];
+    int &a_t = alleleCountsTotals[l*K+k];
+    a--;
+    a_t--;
+    logLikeGroup -= logPredictive(a, a_t, l);
 }
 
 //------------------------------------------------
 // MCMCobject_noAdmixture::
 // probability of data given grouping and allele frequencies
+template<bool PACKED>
 void MCMCobject_noAdmixture::d_logLikeJoint() {
     
     // calculate likelihood
     logLikeJoint = 0;
     double running = 1.0;
     for (int i=0; i<n; i++) {
+        size_t g = data_indStart[i];
         for (int l=0; l<loci; l++) {
             for (int p=0; p<ploidy_vec[i]; p++) {
-                if (data[i][l][p]!=0) {
-                    running *= alleleFreqs[group[i]-1][l][data[i][l][p]-1];
+                int d = data.get<PACKED>(g++);
+                if (d!=0) {
+                    running *= alleleFreqs[(J_offset[l]+d-1)*K+group[i]-1];
                 }
                 if (running<UNDERFLO) {
                     logLikeJoint += log(running);
@@ -491,3 +817,24 @@ void MCMCobject_noAdmixture::d_logLikeJoint() {
     logLikeJoint += log(running);
     
 }
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// check whether burn-in has converged, by applying the Geweke test to the second half of the marginal likelihoods so far (so that a chain must have been stationary for at least half of the burn-in)
+bool MCMCobject_noAdmixture::burninConverged() {
+    vector<double> secondHalf(logLikeBurnin_store.begin()+logLikeBurnin_store.size()/2, logLikeBurnin_store.end());
+    return(fabs(gewekeZ(secondHalf))<GEWEKE_Z);
+}
+
+//------------------------------------------------
+// MCMCobject_noAdmixture::
+// standard error of the Structure estimator over the samples so far. The estimator mean(L)-var(L)/2 is equal to the mean of L-(L-mean(L))^2/2, so its standard error is that of the mean of these values, allowing for autocorrelation.
+double MCMCobject_noAdmixture::structureSE() {
+    int count = int(logLikeJoint_stats.n);
+    vector<double> y(count);
+    for (int i=0; i<count; i++) {
+        double d = logLikeJoint_store[i]-logLikeJoint_stats.mean;
+        y[i] = logLikeJoint_store[i]-0.5*d*d;
+    }
+    return(standardErrorMCMC(y));
+}
@@ -18,6 +18,10 @@
 #include "probability.h"
 #include "misc.h"
 #include "Hungarian.h"
+#include "QmatrixMean.h"
+#include "welford.h"
+#include "checkpoint.h"
+#include "profile.h"
 
 //------------------------------------------------
 // class containing all elements required for MCMC under no-admixture model
@@ -25,17 +29,38 @@ class MCMCobject_noAdmixture {
     
 public:
     
+    // the objects that define the current position of a chain (see swapState()), held separately so that a chain can later be started from this position without keeping the whole chain
+    struct chainState {
+        std::vector<int> group;
+        std::vector<int> alleleCounts;
+        std::vector<int> alleleCountsTotals;
+        std::vector<int> labelMap;
+        double logLikeGroup;
+    };
+    
     // PUBLIC OBJECTS
     
-    // basic quantities (copied over from globals object)
-    std::vector< std::vector< std::vector<int> > > data;
+    // data and lookup tables are shared between all MCMC objects, and are held by reference to the globals object. If biallelic is set then the data are packed into 2-bit codes, and the whole of the likelihood is worked out from the count of the first allele and the total count at each locus. Functions that read the data take PACKED as a template argument, chosen once per call from biallelic.
+    const genotypeData &data;
+    bool biallelic;
+    const std::vector<int> &data_indStart;
+    const lookupTable &lookup;
     
+    // columns of the lookup tables for a single allele (log_1[c] = log(c+lambda)) and for the J[l] alleles of each locus (log_J[l][c] = log(c+J[l]*lambda)), and likewise for lgamma
+    const double *log_1;
+    const double *lgamma_1;
+    std::vector<const double*> log_J;
+    std::vector<const double*> lgamma_J;
+    
+    // basic quantities (copied over from globals object)
     int Kindex;
     int K;
     int n;
     int loci;
     std::vector<int> J;
+    std::vector<int> J_offset;
     std::vector<int> ploidy_vec;
+    std::vector<int> missing_vec;
     std::vector<std::string> uniquePops;
     
     double lambda;
@@ -43,49 +68,81 @@ public:
     
     bool outputQmatrix_pop_on;
     
+    // output written on every iteration is buffered here, and passed to the background writers in the globals object every outputFlushInterval iterations
+    int outputFlushInterval;
+    bool posteriorGrouping_binary;
+    int labelBytes;
+    int buffer_lines;
+    std::string likelihood_buffer;
+    std::string grouping_buffer;
+    
     int burnin;
     int samples;
     int thinning;
     
-    std::vector< std::vector<double> > log_lookup;
+    // adaptive run lengths (used by the main MCMC only). burninMax and samplesMax are hard caps on the length of each phase. Burn-in ends early once the marginal likelihood passes the Geweke test, and sampling ends early once the standard error of the Structure estimator is no more than targetSE. Both are checked every checkInterval iterations (with burn-in lasting at least two intervals), and burnin and samples are cut short to the point at which the check is passed.
+    int burninMax;
+    int samplesMax;
+    bool adaptiveBurnin;
+    double targetSE;
+    int checkInterval;
+    
+    // stream of random numbers used by this chain
+    RNGobject RNG;
+    
+    // MCMC starts from iteration firstIteration, which is 0 after reset() but can be later when the state of the chain has been read back from a checkpoint. If checkpoint is set then the state of the chain is saved there (as chain number checkpointChain) every checkpointInterval iterations.
+    int firstIteration;
+    checkpointObject *checkpoint;
+    int checkpointChain;
+    int checkpointInterval;
     
+    // if profile is set then the time spent in each phase of the MCMC, and the number of sweeps and Metropolis-Hastings moves, are added to it (see profile.h)
+    profileObject *profile;
+    
+    // allele counts and frequencies are stored as flat arrays with deme as the fastest-changing index, so that the count of allele j at locus l in deme k is found at alleleCounts[(J_offset[l]+j)*K+k], and the total count at locus l in deme k is found at alleleCountsTotals[l*K+k]
     std::vector<int> group;
-    std::vector< std::vector< std::vector<int> > > alleleCounts;
-    std::vector< std::vector<int> > alleleCountsTotals;
-    std::vector< std::vector< std::vector<double> > > alleleFreqs;
+    std::vector<int> alleleCounts;
+    std::vector<int> alleleCountsTotals;
+    std::vector<double> alleleFreqs;
     
-    std::vector< std::vector< std::vector<int> > > old_alleleCounts;
-    std::vector< std::vector<int> > old_alleleCountsTotals;
+    // current labelling of demes. Deme k (coded 0:K-1) in group and in the allele counts corresponds to label labelMap[k] in the Qmatrices and in the outputPosteriorGrouping file. Solving the label switching problem only changes labelMap, so the counts themselves never need to be rearranged.
+    std::vector<int> labelMap;
+    int fixLabelsInterval;
     
-    // likelihoods
+    // likelihoods. The mean and variance of the likelihoods over all iterations after burn-in are accumulated in logLikeGroup_stats and logLikeJoint_stats.
     double logLikeGroup;
-    double logLikeGroup_sum;
+    welford logLikeGroup_stats;
     std::vector<double> logLikeGroup_store;
-    double logLikeGroup_sumSquared;
+    std::vector<double> logLikeBurnin_store;
+    std::vector<double> logLikeJoint_store;
     double logLikeJoint;
-    double logLikeJoint_sum;
-    double logLikeJoint_sumSquared;
+    welford logLikeJoint_stats;
     double harmonic;
     
+    // version of d_logLikeConditional() used for each individual, chosen in the constructor from its ploidy and missing data (see chooseConditional())
+    typedef void (MCMCobject_noAdmixture::*conditionalFunction)(int i, double *logProb) const;
+    std::vector<conditionalFunction> conditional_ind;
+    
     std::vector<double> logProbVec;
     double logProbVecSum;
     double logProbVecMax;
     std::vector<double> probVec;
     double probVecSum;
     
-    // Qmatrices. logQmatrix_ind_old, logQmatrix_ind_new and logQmatrix_ind_running are used throughout MCMC (including burn-in phase) when solving label switching problem. Other Qmatrix objects are final outputs, and are only produced after burn-in phase.
-    std::vector< std::vector<double> > logQmatrix_ind_old;
-    std::vector< std::vector<double> > logQmatrix_ind_new;
-    std::vector< std::vector<double> > logQmatrix_ind_running;
+    // Qmatrices. Qmatrix_ind_new (flat array, with the value for individual i in deme k found at Qmatrix_ind_new[i*K+k]) and Qmatrix_ind_running are used throughout MCMC (including burn-in phase) when solving label switching problem. Qmatrix_ind_new is filled in by group_update() during the last sweep of each iteration in which it is needed, and holds the conditional probability of each individual given the rest at the point at which it was updated. It is stored in the order of the demes in the allele counts, while all other Qmatrices are stored in the order of labels (see labelMap). Qmatrix_ind_store is the mean over all iterations after burn-in. When QmatrixFloat_on, both are held in single precision, and Qmatrix_ind_store (which is written out) keeps a compensation term for every value so that its precision is close to double. Other Qmatrix objects are final outputs, and are only produced at the end of the MCMC. None of these are allocated unless fixLabels_on.
+    bool fixLabels_on;
+    std::vector<double> Qmatrix_ind_new;
+    QmatrixMean Qmatrix_ind_running;
+    QmatrixMean Qmatrix_ind_store;
+    bool QmatrixFloat_on;
+    std::vector<double> logQ_running;
     
-    std::vector< std::vector<double> > logQmatrix_ind;
     std::vector< std::vector<double> > Qmatrix_ind;
     std::vector< std::vector<double> > Qmatrix_pop;
     
     // objects for Hungarian algorithm
     std::vector< std::vector<double> > costMat;
     std::vector<int> bestPerm;
-    std::vector<int> bestPermOrder;
     
     std::vector<int>edgesLeft;
     std::vector<int>edgesRight;
@@ -95,26 +152,58 @@ public:
     // PUBLIC FUNCTIONS
     
     // constructor
-    MCMCobject_noAdmixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta);
+    MCMCobject_noAdmixture(globals &globals, int _Kindex, int _burnin, int _samples, int _thinning, double _beta, bool _fixLabels);
     
     // perform MCMC
     void reset(bool reset_Qmatrix_running);
     void perform_MCMC(globals &globals, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep);
+    void MCMC_iteration(globals &globals, int rep, bool drawAlleleFreqs, bool storeLoglike, bool fixLabels, bool outputLikelihood, bool outputPosteriorGrouping, int mainRep);
+    void finalise_MCMC(globals &globals, bool fixLabels);
+    void appendGroup(int g);
+    void flushOutput(globals &globals);
+    
+    // write the state of the chain (everything needed to carry on from iteration nextIteration of repeat mainRep) in binary form, or read it back. readState() returns false if the state does not match this chain.
+    void writeState(std::string &state, int mainRep, int nextIteration);
+    bool readState(const std::string &state, int &mainRep);
+    
+    // exchange the current state of the chain with another chain (used when running multiple temperatures together), or save it and copy it back later
+    void swapState(MCMCobject_noAdmixture &other);
+    void saveState(chainState &state) const;
+    void copyState(const chainState &state);
     
     // update objects
-    void group_update();
+    void group_update(bool storeQmatrix);
+    template<bool PACKED>
+    void addInd(int ind);
+    template<bool PACKED>
+    void subtractInd(int ind);
     void drawFreqs();
     
     // label switching
     void chooseBestLabelPermutation(globals &globals, int rep);
-    void produceQmatrix();
+    void produceCostMatrix();
     void updateQmatrix(int &rep);
     void storeQmatrix();
     
     // likelihoods
-    void d_logLikeConditional(int i, int k);
+    void d_logLikeConditional(int i, double *logProb) const;
+    conditionalFunction chooseConditional(int i);
+    
+    // versions of d_logLikeConditional() specialised at compile time on the ploidy (1, 2, or 0 meaning any) and on whether the individual has any missing data. The biallelic versions are used on packed biallelic data.
+    template<int PLOIDY, bool MISSING>
+    void conditional_general(int i, double *logProb) const;
+    template<int PLOIDY, bool MISSING>
+    void conditional_biallelic(int i, double *logProb) const;
     void d_logLikeGroup();
+    double logPredictive(int a, int a_t, int l);
+    void addGeneCopy(int l, int d, int k);
+    void subtractGeneCopy(int l, int d, int k);
+    template<bool PACKED>
     void d_logLikeJoint();
+    
+    // adaptive run lengths
+    bool burninConverged();
+    double structureSE();
 
 };
 
@@ -58,6 +58,77 @@ Taking a more complex example, the partition {1 1 1 2 2 3} can be written as fol
 This is why log-likelihoods are weighted by lgamma(double(K)+1)-lgamma(double(K)-double(uniques)+1) in the exhaustive approach.
 
 
+------------------------------------------------
+BINARY FORMAT OF THE POSTERIOR GROUPING FILE
+
+ When outputPosteriorGrouping_binary_on is true, the posterior grouping is written in a compact binary form instead of as comma-separated text (the ".csv" extension of the file name is replaced with ".bin"). All values are little-endian. The file begins with a header:
+ 
+ bytes 0-7      the characters "MVKPG1" followed by two zero bytes
+ uint32         n, the number of individuals
+ uint32         loci, the number of loci
+ uint32         1 if the admixture model was used, otherwise 0
+ uint32         columns, the number of group labels per record (n without admixture, or the total number of gene copies with admixture)
+ uint32         labelBytes, the size of each group label in bytes (1, or 2 if Kmax>255)
+ uint32 x n     the ploidy of each individual
+ 
+ This is followed by one record per MCMC iteration, in the same order as the rows of the text version:
+ 
+ int32          K
+ int32          mainRep
+ int32          MCMCsample (negative during the burn-in phase, as in the text version)
+ uint8 x columns (or uint16 if labelBytes=2) the group of each individual, or of each gene copy ordered by individual, then locus, then copy within locus
+ 
+ Every record has the same size (12 + columns*labelBytes bytes), so record r can be found directly at offset (header size) + r*(record size). In R, for example, the whole file can be read with readBin() in a few lines.
+
+
+------------------------------------------------
+BINARY FORMAT OF THE QMATRIX FILES
+
+ When outputQmatrix_binary_on is true, every Qmatrix and QmatrixError file (at the gene, individual and population level) is written in binary form instead of as comma-separated text, with the extension ".bin" in place of ".csv". Values are not rounded, and are stored as 4-byte floats, which at the gene level gives files several times smaller than the text version. Files in Structure format are not affected. All values are little-endian. Each file begins with a header:
+ 
+ bytes 0-7      the characters "MVKQM1" followed by two zero bytes
+ uint32         rows, the number of gene copies, individuals or populations
+ uint32         K
+ 
+ This is followed by the K columns of the matrix one after another, each holding rows values of type float32. Rows are in the same order as in the text version, so gene copies are ordered by individual, then locus, then copy within locus, and populations are in the order in which they first appear in the data. The value for row i in deme k is therefore found at offset 16 + 4*(k*rows + i), and in R a whole file can be read with readBin() and turned into a matrix with matrix(..., ncol=K).
+
+
+------------------------------------------------
+CACHED DATA FILES
+
+ When dataCache_on is true, the parsed data are written to a binary file next to the original data file (with ".mvkbin" appended to the file name). On later runs this file is read instead of parsing the text file again, provided that the data file has the same size and the same 64-bit hash of its contents as when the cache was created, and that headerRow_on, popCol_on, ploidyCol_on, ploidy and missingData have not changed. Otherwise the data file is parsed as normal and the cache is rewritten. The hash is not cryptographic, but two different data files of the same size give the same hash with a probability of around 1 in 10^19, so in practice a stale cache is never used, whatever happens to the modification time of the file. Hashing still requires the data file to be read, but at close to the speed of the disk rather than the much slower speed of parsing. The cache file can safely be deleted at any time. The cache stores the individual labels, populations and ploidies, the original allele names at each locus, and the recoded genotypes, in that order.
+
+
+------------------------------------------------
+RUNNING OVER MULTIPLE THREADS
+
+ When threads is greater than 1, different values of K are analysed at the same time (largest K first), as are the repeats of the main MCMC when parallelRepeats_on is true. Console output, the log and all per-K output files are still written in order of K. The outputLikelihood and outputPosteriorGrouping files receive a line on every iteration of every chain, and lines from chains running at the same time would be interleaved in an order that changes from run to run, so these files can only be produced when a single chain runs at a time, i.e. with threads set to 1, or with a single value of K and parallelRepeats_on set to false. Within a single chain, threads can still be put to use through gibbsBlocks (see below).
+
+
+------------------------------------------------
+RUNNING OVER MULTIPLE PROCESSES
+
+ MavericK can spread the analysis of different K over several processes (for example over the nodes of a cluster) using MPI. Build with "make mpi" (which requires mpicxx) to produce MavericK_mpi, and launch with mpirun in the usual way, e.g. "mpirun -np 5 MavericK_mpi -parameters parameters.txt". Process 0 reads the data and passes it to the other processes, hands out values of K to them one at a time (largest K first), and writes all output once the results come back. Process 0 does not analyse any K itself, so at least two processes are needed. Each K is analysed by a single process, which can also make use of multiple threads through the threads parameter. Results are identical to a single process run with the same seed. The outputLikelihood and outputPosteriorGrouping files cannot be produced in this mode. With a single process MavericK_mpi behaves exactly like MavericK.
+
+
+------------------------------------------------
+PARALLEL GIBBS SWEEPS WITHIN A CHAIN
+
+ Under the admixture model, the Gibbs update of the group allocation of every gene copy (the most expensive part of each MCMC iteration) can be split into blocks that are run in parallel, by setting gibbsBlocks greater than 1. This speeds up a single chain on large data sets, independently of the number of values of K and repeats being run, and makes use of any of the threads given by the threads parameter that are not already busy. Individuals and loci are each split into gibbsBlocks blocks, and the sweep is carried out in gibbsBlocks phases, in each of which every block of individuals is updated at a different block of loci. Blocks updated within the same phase share no allele counts or admix counts, so the sampler is exact rather than an approximation; it simply visits gene copies in a different order. Results therefore differ from those with gibbsBlocks=1, but for a given seed and value of gibbsBlocks they are the same whatever the number of threads. gibbsBlocks is limited to the number of individuals and the number of loci, and has no effect without admixture, where the group of each individual is shared by all of its loci. The individual-level update and the update of alpha are not split. A value around the number of threads is a reasonable choice, as each phase waits for its slowest block.
+
+
+------------------------------------------------
+PROFILE FILE
+
+ When outputProfile_on is true, the time spent in each stage of the analysis of each K is written to the outputProfile file, along with counts of the events that drive it. There is one row for each stage that is run (exhaustive, main, TI and EM). The TI row covers the whole ladder, and is followed by a row for each rung in order of increasing power. time_total is the wall time of the stage, and the remaining times are those spent in each phase of the MCMC, added up over all repeats (or over all rungs), so with multiple threads they can add up to more than time_total. Swaps between adjacent rungs are counted against the lower rung. Profiling has no effect on the results, and costs nothing when switched off. Stages restored from a checkpoint keep the profile from the run in which they were carried out.
+
+
+------------------------------------------------
+USING MAVERICK AS A LIBRARY
+
+ library.h gives an interface for running MavericK from within another program. A datasetObject reads in and checks a data file once, and can then be analysed any number of times under different settings, each given as a runConfig, without reading the file again. runAnalysis() carries out the same analysis as the command line program over all K, and runExhaustive(), runMainMCMC(), runThermodynamic() and runEM() carry out a single stage at a single K. Results are returned as structs rather than written to file, along with the console output of each K. Given the same settings and seed, results are identical to those of the command line program. The datasetObject is never changed, and all analyses of it share a single copy of the genotypes and lookup tables. Invalid settings and data are checked in the same way as in the command line program, but rather than the program exiting, a maverickError is thrown holding the error message, so that the calling program can carry on. To build a program against the library, compile it together with all MavericK source files except main.cpp.
+
+
  ------------------------------------------------
  MIT License
  
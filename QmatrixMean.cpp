@@ -0,0 +1,112 @@
+//
+//  MavericK
+//  QmatrixMean.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include "QmatrixMean.h"
+
+using namespace std;
+
+//------------------------------------------------
+// update running mean held in array of any precision. Written as a separate loop for each precision so that the compiler can vectorise the arithmetic.
+template<class TYPE>
+static void addToMean(TYPE *values, const double *Qnew, const int *labelMap, int rows, int K, double weight) {
+    for (int i=0; i<rows; i++) {
+        TYPE *values_i = values + i*K;
+        const double *Qnew_i = Qnew + i*K;
+        for (int k=0; k<K; k++) {
+            TYPE &x = values_i[labelMap[k]];
+            x += TYPE((Qnew_i[k]-x)*weight);
+        }
+    }
+}
+
+//------------------------------------------------
+// update running mean held as the sum of two floats. The update is carried out in double precision and split back into a float and the float rounding error of that float, so that small changes are never lost.
+static void addToMeanCompensated(float *values, float *errors, const double *Qnew, const int *labelMap, int rows, int K, double weight) {
+    for (int i=0; i<rows; i++) {
+        float *values_i = values + i*K;
+        float *errors_i = errors + i*K;
+        const double *Qnew_i = Qnew + i*K;
+        for (int k=0; k<K; k++) {
+            int j = labelMap[k];
+            double x = double(values_i[j]) + double(errors_i[j]);
+            x += (Qnew_i[k]-x)*weight;
+            values_i[j] = float(x);
+            errors_i[j] = float(x-double(values_i[j]));
+        }
+    }
+}
+
+//------------------------------------------------
+// QmatrixMean::
+// constructor
+QmatrixMean::QmatrixMean() {
+    rows = 0;
+    K = 0;
+    useFloat = false;
+    compensated = false;
+    count = 0;
+}
+
+//------------------------------------------------
+// QmatrixMean::
+// resize and reset. If useFloat is true then values are held in single precision, with a compensation term for each value if compensated is also true. If initialValue is positive then every element starts at this value, and counts as one Qmatrix already added. Otherwise the mean starts empty.
+void QmatrixMean::reset(int _rows, int _K, bool _useFloat, bool _compensated, double initialValue) {
+    rows = _rows;
+    K = _K;
+    useFloat = _useFloat;
+    compensated = _useFloat && _compensated;
+    count = (initialValue>0) ? 1 : 0;
+    if (useFloat) {
+        values_float = vector<float>(rows*K, float(initialValue));
+        vector<double>().swap(values_double);
+    } else {
+        values_double = vector<double>(rows*K, initialValue);
+        vector<float>().swap(values_float);
+    }
+    if (compensated) {
+        errors_float = vector<float>(rows*K, float(initialValue-double(float(initialValue))));
+    } else {
+        vector<float>().swap(errors_float);
+    }
+}
+
+//------------------------------------------------
+// QmatrixMean::
+// add a new Qmatrix (flat array with rows*K elements) to the running mean. Column k of Qnew is added to column labelMap[k] of the mean.
+void QmatrixMean::add(const vector<double> &Qnew, const vector<int> &labelMap) {
+    count++;
+    double weight = 1.0/count;
+    if (compensated) {
+        addToMeanCompensated(&values_float[0], &errors_float[0], &Qnew[0], &labelMap[0], rows, K, weight);
+    } else if (useFloat) {
+        addToMean(&values_float[0], &Qnew[0], &labelMap[0], rows, K, weight);
+    } else {
+        addToMean(&values_double[0], &Qnew[0], &labelMap[0], rows, K, weight);
+    }
+}
+
+//------------------------------------------------
+// QmatrixMean::
+// return current mean of element in row i and column k
+double QmatrixMean::get(int i, int k) const {
+    if (compensated) {
+        return(double(values_float[i*K+k]) + double(errors_float[i*K+k]));
+    }
+    return(useFloat ? double(values_float[i*K+k]) : values_double[i*K+k]);
+}
+
+//------------------------------------------------
+// QmatrixMean::
+// write log of current mean of row i to output (K values)
+void QmatrixMean::logRow(int i, double *output) const {
+    for (int k=0; k<K; k++) {
+        output[k] = log(get(i,k));
+    }
+}
@@ -0,0 +1,50 @@
+//
+//  MavericK
+//  QmatrixMean.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines a class for accumulating the running mean of a Qmatrix over MCMC iterations. Values are held in linear space in a single flat array, so adding a new Qmatrix costs one multiply-add per element rather than the exp() and log() of a log-space sum. As every value is a mean of probabilities it stays between 0 and 1 however many iterations are added, and so the array can optionally be held in single precision to save memory. In single precision a plain update loses accuracy once the change made by each new Qmatrix falls below the resolution of a float, so a mean that is written out can keep a second float per element holding the rounding error of the first, giving close to double precision.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__QmatrixMean__
+#define __Maverick1_0__QmatrixMean__
+
+#include <vector>
+#include <cmath>
+
+//------------------------------------------------
+// class holding the running mean of a Qmatrix with a given number of rows and K columns
+class QmatrixMean {
+    
+public:
+    
+    // PUBLIC OBJECTS
+    
+    int rows;
+    int K;
+    bool useFloat;
+    bool compensated;
+    
+    // number of Qmatrices added so far (including any initial value)
+    double count;
+    
+    // values are stored in exactly one of these, depending on useFloat. The value in row i and column k is found at element i*K+k. When compensated is true, errors_float holds the part of each value that could not be represented in values_float, so the value is values_float+errors_float.
+    std::vector<double> values_double;
+    std::vector<float> values_float;
+    std::vector<float> errors_float;
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor
+    QmatrixMean();
+    
+    void reset(int _rows, int _K, bool _useFloat, bool _compensated, double initialValue);
+    void add(const std::vector<double> &Qnew, const std::vector<int> &labelMap);
+    double get(int i, int k) const;
+    void logRow(int i, double *output) const;
+    
+};
+
+#endif
@@ -11,138 +11,448 @@
 // ---------------------------------------------------------------------------
 
 #include "TI.h"
+#include "parallel.h"
 
 using namespace std;
 
 //------------------------------------------------
-// thermodynamic integral estimator for no-admixture model
-void TI_noAdmixture(globals &globals, int Kindex) {
-    int K = globals.Kmin+Kindex;
+// define the MCMC object for a single rung of the thermodynamic ladder, drawing random numbers from stream rungNumber of those allocated to TI. The rung starts from a random allocation, or from the saved state warmStart if this is not null. Labels are never fixed in TI, so no Qmatrices are allocated.
+template<class MCMCobject>
+static unique_ptr<MCMCobject> newRung(globals &globals, int Kindex, double beta, int rungNumber, const typename MCMCobject::chainState *warmStart, profileObject *profile) {
+    unique_ptr<MCMCobject> rung(new MCMCobject(globals, Kindex, globals.thermodynamicBurnin, globals.thermodynamicSamples, globals.thermodynamicThinning, beta, false));
+    rung->RNG = RNGstream(globals.seed, Kindex, RNG_TI, rungNumber);
+    rung->reset(true);
+    if (warmStart!=nullptr) {
+        rung->copyState(*warmStart);
+    }
+    rung->profile = profile;
+    return(rung);
+}
+
+//------------------------------------------------
+// write the final state of a rung in binary form, or read it back
+static void appendState(string &s, const MCMCobject_noAdmixture::chainState &x) {
+    appendValue(s, x.group);
+    appendValue(s, x.alleleCounts);
+    appendValue(s, x.alleleCountsTotals);
+    appendValue(s, x.labelMap);
+    appendValue(s, x.logLikeGroup);
+}
+static void appendState(string &s, const MCMCobject_admixture::chainState &x) {
+    appendValue(s, x.linearGroup);
+    appendValue(s, x.alleleCounts);
+    appendValue(s, x.alleleCountsTotals);
+    appendValue(s, x.admixCounts);
+    appendValue(s, x.admixCountsTotals);
+    appendValue(s, x.admixHist);
+    appendValue(s, x.labelMap);
+    appendValue(s, x.alpha);
+    appendValue(s, x.logLikeGroup);
+}
+static void readState(binaryReader &r, MCMCobject_noAdmixture::chainState &x) {
+    readValue(r, x.group);
+    readValue(r, x.alleleCounts);
+    readValue(r, x.alleleCountsTotals);
+    readValue(r, x.labelMap);
+    readValue(r, x.logLikeGroup);
+}
+static void readState(binaryReader &r, MCMCobject_admixture::chainState &x) {
+    readValue(r, x.linearGroup);
+    readValue(r, x.alleleCounts);
+    readValue(r, x.alleleCountsTotals);
+    readValue(r, x.admixCounts);
+    readValue(r, x.admixCountsTotals);
+    readValue(r, x.admixHist);
+    readValue(r, x.labelMap);
+    readValue(r, x.alpha);
+    readValue(r, x.logLikeGroup);
+}
+
+//------------------------------------------------
+// write the results of a completed rung in binary form, for saving to the checkpoint. The profile and final state are only included if they are not null.
+template<class MCMCobject>
+static void appendRung(string &s, double beta, double mean, double var, double SE, const profileObject *profile, const typename MCMCobject::chainState *state) {
+    appendValue(s, beta);
+    appendValue(s, mean);
+    appendValue(s, var);
+    appendValue(s, SE);
+    appendValue(s, profile!=0);
+    if (profile!=0) {
+        appendValue(s, *profile);
+    }
+    appendValue(s, state!=0);
+    if (state!=0) {
+        appendState(s, *state);
+    }
+}
+
+//------------------------------------------------
+// read back the results of a completed rung written by appendRung(). The profile is only read into if it is already allocated, and the final state only if state is not null. Returns false if the results are damaged, or do not belong to a rung at the given power.
+template<class MCMCobject>
+static bool readRung(const string &s, double beta, double &mean, double &var, double &SE, profileObject *profile, typename MCMCobject::chainState *state) {
+    binaryReader r(s);
+    double beta_saved = 0;
+    bool hasProfile = false;
+    bool hasState = false;
+    readValue(r, beta_saved);
+    readValue(r, mean);
+    readValue(r, var);
+    readValue(r, SE);
+    readValue(r, hasProfile);
+    if (hasProfile) {
+        profileObject saved;
+        readValue(r, saved);
+        if (profile!=0) {
+            *profile = saved;
+        }
+    }
+    readValue(r, hasState);
+    if (hasState) {
+        typename MCMCobject::chainState saved;
+        readState(r, saved);
+        if (state!=0) {
+            *state = move(saved);
+        }
+    } else if (state!=0) {
+        return(false);
+    }
+    return(!r.failed && r.pos==s.size() && beta_saved==beta);
+}
+
+//------------------------------------------------
+// extract the mean and variance of the log-likelihood from a completed rung, along with the standard error of the mean (allowing for autocorrelation via the effective sample size)
+template<class MCMCobject>
+static void rungResults(MCMCobject &rung, double &mean, double &var, double &SE) {
+    double ESS = calculateESS(rung.logLikeGroup_store);
+    mean = rung.logLikeGroup_stats.mean;
+    var = rung.logLikeGroup_stats.var(false);
+    SE = sqrt(var/ESS);
+}
+
+//------------------------------------------------
+// run MCMC at every rung of the thermodynamic ladder, spreading rungs over the available threads, and store the results of each rung in mean, var and SE. Rungs use the streams of random numbers numbered from firstRung upwards, and are identified in the checkpoint by this number. Without tempering each rung is an independent chain, which is only defined once its task starts and is freed as soon as its results have been extracted. With tempering all rungs must be held together: every rung starts from a random allocation, and all rungs are run together through both burn-in and sampling, with adjacent rungs proposing to swap states every thermodynamicSwapInterval iterations. If warmStart[TIrep] is not null then rung TIrep is instead started from that saved state (the final state of a previously completed rung). If finalStates is not null then the final state of every rung is saved in it before the rung is freed. If profiling, each rung is given its own profile in profiles, and proposed swaps are counted against the lower of the two rungs. If checkpoint is not null then rungs whose results are held in the checkpoint are restored rather than run again. Independent rungs that were part way through carry on from their last saved state, and save their state every checkpointInterval iterations and their results on completion. Tempered rungs complete together, so their results are only restored if every rung completed, and otherwise the state of all rungs and of the swap proposals is saved at the end of the first block of iterations after every checkpointInterval iterations, and resumed from there.
+template<class MCMCobject>
+static void runRungs(globals &globals, int Kindex, vector<double> &betaVec, int firstRung, vector<const typename MCMCobject::chainState*> &warmStart, vector<double> &mean, vector<double> &var, vector<double> &SE, vector< unique_ptr<profileObject> > &profiles, vector<typename MCMCobject::chainState> *finalStates, checkpointObject *checkpoint) {
+    int nRungs = int(betaVec.size());
     
-    // special case if K==1
-    if (K==1) {
-        for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
-            globals.TIpoint_mean[Kindex][TIrep] = globals.logEvidence_exhaustive[Kindex];
-            globals.TIpoint_var[Kindex][TIrep] = 0;
-            globals.TIpoint_SE[Kindex][TIrep] = 0;
+    mean = vector<double>(nRungs);
+    var = vector<double>(nRungs);
+    SE = vector<double>(nRungs);
+    profiles = vector< unique_ptr<profileObject> >(nRungs);
+    if (finalStates!=0) {
+        *finalStates = vector<typename MCMCobject::chainState>(nRungs);
+    }
+    for (int TIrep=0; TIrep<nRungs; TIrep++) {
+        if (globals.outputProfile_on) {
+            profiles[TIrep] = unique_ptr<profileObject>(new profileObject("TI", 0, betaVec[TIrep]));
         }
-        globals.logEvidence_TI[Kindex] = globals.logEvidence_exhaustive[Kindex];
-        globals.logEvidence_TI_SE[Kindex] = 0;
-        return;
     }
     
-    // set up beta vector
-    vector<double> betaVec(globals.thermodynamicRungs);
-    for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++)
-        betaVec[TIrep] = double(TIrep)/(globals.thermodynamicRungs-1);
+    // restore rungs that completed before the checkpoint was written, and take a copy of the saved state of any that were part way through (as the checkpoint is written to by rungs while they run)
+    bool saving = (checkpoint!=0 && checkpoint->write_on);
+    vector<bool> restored(nRungs, false);
+    vector<string> savedState(nRungs);
+    if (checkpoint!=0) {
+        for (int TIrep=0; TIrep<nRungs; TIrep++) {
+            int rungNumber = firstRung+TIrep;
+            if (rungNumber<int(checkpoint->TIrungs.size()) && !checkpoint->TIrungs[rungNumber].empty()) {
+                if (!readRung<MCMCobject>(checkpoint->TIrungs[rungNumber], betaVec[TIrep], mean[TIrep], var[TIrep], SE[TIrep], profiles[TIrep].get(), (finalStates!=0) ? &(*finalStates)[TIrep] : 0)) {
+                    errorExit("\nError: unable to read checkpoint file "+checkpoint->filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+                }
+                restored[TIrep] = true;
+            } else if (rungNumber<int(checkpoint->chainState.size())) {
+                savedState[TIrep] = checkpoint->chainState[rungNumber];
+            }
+        }
+    }
+    bool allRestored = (find(restored.begin(), restored.end(), false)==restored.end());
+    if (globals.thermodynamicTempering_on && !allRestored) {
+        restored = vector<bool>(nRungs, false);
+    }
     
-    // carry out thermodynamic integration
-    for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
-        double beta = betaVec[TIrep];
-        
+    for (int TIrep=0; TIrep<nRungs; TIrep++) {
         char * buffer = new char[255];
-        sprintf(buffer, "%.2f", beta);
+        sprintf(buffer, "%.4f", betaVec[TIrep]);
         string s = buffer;
-        coutAndLog("  power = "+s+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        // define MCMC object
-        MCMCobject_noAdmixture TI_MCMC(globals, Kindex, globals.thermodynamicBurnin, globals.thermodynamicSamples, globals.thermodynamicThinning, beta);
-        
-        // perform MCMC
-        TI_MCMC.reset(true);
-        TI_MCMC.perform_MCMC(globals, false, true, false, false, false, 1);
-        
-        // calculate autocorrelation
-        double autoCorr = calculateAutoCorr(TI_MCMC.logLikeGroup_store);
-        double ESS = globals.thermodynamicSamples/autoCorr;
-        
-        // save results of this power
-        globals.TIpoint_mean[Kindex][TIrep] = TI_MCMC.logLikeGroup_sum/double(globals.thermodynamicSamples);
-        globals.TIpoint_var[Kindex][TIrep] = TI_MCMC.logLikeGroup_sumSquared/double(globals.thermodynamicSamples) - globals.TIpoint_mean[Kindex][TIrep]*globals.TIpoint_mean[Kindex][TIrep];
-		// avoid arithmetic underflow
-		if (globals.TIpoint_var[Kindex][TIrep]<0)
-			globals.TIpoint_var[Kindex][TIrep] = 0;
-        globals.TIpoint_SE[Kindex][TIrep] = sqrt(globals.TIpoint_var[Kindex][TIrep]/ESS);
-        
+        coutAndLog_K("  power = "+s+(restored[TIrep] ? ", restored from checkpoint" : "")+"\n", globals, Kindex);
     }
     
-    // calculate thermodynamic integral estimate. Note that at this stage we assume equally spaced rungs.
-    double Dsum = 0.5*globals.TIpoint_mean[Kindex][0] + 0.5*globals.TIpoint_mean[Kindex][globals.thermodynamicRungs-1];
-    double Vsum = 0.25*globals.TIpoint_SE[Kindex][0]*globals.TIpoint_SE[Kindex][0] + 0.25*globals.TIpoint_SE[Kindex][globals.thermodynamicRungs-1]*globals.TIpoint_SE[Kindex][globals.thermodynamicRungs-1];
-    if (globals.thermodynamicRungs>2) {
-        for (int TIrep=1; TIrep<(globals.thermodynamicRungs-1); TIrep++) {
-            Dsum += globals.TIpoint_mean[Kindex][TIrep];
-            Vsum += globals.TIpoint_SE[Kindex][TIrep]*globals.TIpoint_SE[Kindex][TIrep];
+    // hand out rungs from beta=1 downwards, as these are the most expensive
+    vector<int> rungOrder;
+    for (int TIrep=nRungs-1; TIrep>=0; TIrep--) {
+        if (!restored[TIrep]) {
+            rungOrder.push_back(TIrep);
         }
     }
-    Dsum /= double(globals.thermodynamicRungs-1);
-    Vsum /= double(globals.thermodynamicRungs-1)*double(globals.thermodynamicRungs-1);
-    globals.logEvidence_TI[Kindex] = Dsum;
-    globals.logEvidence_TI_SE[Kindex] = sqrt(Vsum);
     
+    // independent rungs
+    if (!globals.thermodynamicTempering_on) {
+        parallelFor(rungOrder, [&](int TIrep) {
+            int rungNumber = firstRung+TIrep;
+            unique_ptr<MCMCobject> rung = newRung<MCMCobject>(globals, Kindex, betaVec[TIrep], rungNumber, warmStart[TIrep], profiles[TIrep].get());
+            if (!savedState[TIrep].empty()) {
+                int savedRep = -1;
+                if (!rung->readState(savedState[TIrep], savedRep) || savedRep!=TIrep) {
+                    errorExit("\nError: unable to read checkpoint file "+checkpoint->filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+                }
+            }
+            if (saving) {
+                rung->checkpoint = checkpoint;
+                rung->checkpointChain = rungNumber;
+            }
+            {
+                profileTimer timer(profiles[TIrep].get(), PROFILE_TOTAL);
+                rung->perform_MCMC(globals, false, true, false, false, false, TIrep);
+            }
+            rungResults(*rung, mean[TIrep], var[TIrep], SE[TIrep]);
+            if (finalStates!=0) {
+                rung->saveState((*finalStates)[TIrep]);
+            }
+            if (saving) {
+                string results;
+                appendRung<MCMCobject>(results, betaVec[TIrep], mean[TIrep], var[TIrep], SE[TIrep], profiles[TIrep].get(), (finalStates!=0) ? &(*finalStates)[TIrep] : 0);
+                checkpoint->saveRung(globals, rungNumber, results);
+            }
+        });
+        return;
+    }
+    if (allRestored) {
+        return;
+    }
+    
+    // define MCMC object for each rung
+    vector< unique_ptr<MCMCobject> > rungs(nRungs);
+    parallelFor(rungOrder, [&](int TIrep) {
+        rungs[TIrep] = newRung<MCMCobject>(globals, Kindex, betaVec[TIrep], firstRung+TIrep, warmStart[TIrep], profiles[TIrep].get());
+    });
+    
+    // burn-in and sampling phase. Rungs are run together in blocks of thermodynamicSwapInterval iterations, after which adjacent rungs propose to swap states. Swaps are proposed from the start of burn-in, so that good states found at any rung are passed up and down the ladder while all rungs burn in at once. The swap between rungs with powers b1 and b2 and log-likelihoods L1 and L2 is accepted with probability min(1, exp((b2-b1)(L1-L2))).
+    RNGobject swapRNG = RNGstream(globals.seed, Kindex, RNG_TISWAP, firstRung);
+    int swapsProposed = 0;
+    int swapsAccepted = 0;
+    int totalReps = globals.thermodynamicBurnin + globals.thermodynamicSamples;
+    
+    // when resuming, carry on from the last checkpoint of these rungs, provided that the state of every rung was saved there. Otherwise all rungs start again from the beginning.
+    int firstBlock = 0;
+    if (checkpoint!=0 && !checkpoint->TItempering.empty() && find(savedState.begin(), savedState.end(), string())==savedState.end()) {
+        binaryReader r(checkpoint->TItempering);
+        int savedFirstRung = -1;
+        readValue(r, savedFirstRung);
+        if (savedFirstRung==firstRung) {
+            readValue(r, firstBlock);
+            readValue(r, swapRNG);
+            readValue(r, swapsProposed);
+            readValue(r, swapsAccepted);
+            bool ok = (!r.failed && r.pos==checkpoint->TItempering.size());
+            for (int TIrep=0; TIrep<nRungs && ok; TIrep++) {
+                int savedRep = -1;
+                ok = rungs[TIrep]->readState(savedState[TIrep], savedRep) && savedRep==TIrep;
+            }
+            if (!ok) {
+                errorExit("\nError: unable to read checkpoint file "+checkpoint->filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+            }
+        }
+    }
+    
+    for (int blockStart=firstBlock; blockStart<totalReps; blockStart+=globals.thermodynamicSwapInterval) {
+        int blockEnd = min(blockStart+globals.thermodynamicSwapInterval, totalReps);
+        parallelFor(rungOrder, [&](int TIrep) {
+            profileTimer timer(profiles[TIrep].get(), PROFILE_TOTAL);
+            for (int rep=blockStart; rep<blockEnd; rep++) {
+                rungs[TIrep]->MCMC_iteration(globals, rep, false, true, false, false, false, TIrep);
+            }
+        });
+        if (blockEnd==totalReps) {
+            break;
+        }
+        for (int TIrep=0; TIrep<(nRungs-1); TIrep++) {
+            double logAccept = (betaVec[TIrep+1]-betaVec[TIrep])*(rungs[TIrep]->logLikeGroup - rungs[TIrep+1]->logLikeGroup);
+            swapsProposed++;
+            profileCount(profiles[TIrep].get(), COUNT_SWAPS_PROPOSED);
+            if (log(swapRNG.runif_0_1())<logAccept) {
+                rungs[TIrep]->swapState(*rungs[TIrep+1]);
+                swapsAccepted++;
+                profileCount(profiles[TIrep].get(), COUNT_SWAPS_ACCEPTED);
+            }
+        }
+        
+        // save the state of all rungs once checkpointInterval iterations have passed since the last checkpoint
+        if (saving && blockEnd/globals.checkpointInterval>blockStart/globals.checkpointInterval) {
+            string tempering;
+            appendValue(tempering, firstRung);
+            appendValue(tempering, blockEnd);
+            appendValue(tempering, swapRNG);
+            appendValue(tempering, swapsProposed);
+            appendValue(tempering, swapsAccepted);
+            vector<string> states(nRungs);
+            for (int TIrep=0; TIrep<nRungs; TIrep++) {
+                rungs[TIrep]->writeState(states[TIrep], TIrep, blockEnd);
+            }
+            checkpoint->saveTempering(globals, tempering, firstRung, states);
+        }
+    }
+    for (int TIrep=0; TIrep<nRungs; TIrep++) {
+        rungs[TIrep]->finalise_MCMC(globals, false);
+        rungResults(*rungs[TIrep], mean[TIrep], var[TIrep], SE[TIrep]);
+        if (finalStates!=0) {
+            rungs[TIrep]->saveState((*finalStates)[TIrep]);
+        }
+        if (saving) {
+            string results;
+            appendRung<MCMCobject>(results, betaVec[TIrep], mean[TIrep], var[TIrep], SE[TIrep], profiles[TIrep].get(), (finalStates!=0) ? &(*finalStates)[TIrep] : 0);
+            checkpoint->saveRung(globals, firstRung+TIrep, results);
+        }
+    }
+    
+    if (swapsProposed>0) {
+        char * buffer = new char[255];
+        sprintf(buffer, "%.3f", swapsAccepted/double(swapsProposed));
+        string s = buffer;
+        coutAndLog_K("  swap acceptance rate = "+s+"\n", globals, Kindex);
+    }
 }
 
 //------------------------------------------------
-// thermodynamic integral estimator for admixture model
-void TI_admixture(globals &globals, int Kindex) {
+// integrate the mean log-likelihood over the power of each rung by the trapezoidal rule, allowing for unequal spacing. Rungs must be in order of increasing power. Point estimates are independent between rungs, so the variance of the integral is the sum of the squared trapezoidal weights times the squared standard errors.
+static void integrateRungs(const vector<double> &beta, const vector<double> &mean, const vector<double> &SE, double &integral, double &integral_SE) {
+    int nRungs = int(beta.size());
+    integral = 0;
+    double integral_var = 0;
+    for (int TIrep=0; TIrep<nRungs; TIrep++) {
+        double weight = 0;
+        if (TIrep>0) {
+            weight += 0.5*(beta[TIrep]-beta[TIrep-1]);
+        }
+        if (TIrep<(nRungs-1)) {
+            weight += 0.5*(beta[TIrep+1]-beta[TIrep]);
+        }
+        integral += weight*mean[TIrep];
+        integral_var += weight*weight*SE[TIrep]*SE[TIrep];
+    }
+    integral_SE = sqrt(integral_var);
+}
+
+//------------------------------------------------
+// thermodynamic integral estimator, for either model. Rungs are initially placed at powers (i/(thermodynamicRungs-1))^thermodynamicPower. If thermodynamicTargetSE is greater than zero then further rungs are then added, each at the midpoint of an existing interval, until the standard error of the integral falls below the target or thermodynamicMaxRungs is reached. Results of completed rungs are kept, so that only new rungs are run in each round, and each new rung is started from the final state of the rung at the lower end of its interval. Only this final state is kept, rather than the whole rung. If rungProfiles is not null then the profile of each rung is stored there, in order of increasing power. As the rungs added in each round depend only on the results of earlier rounds, a run resumed from a checkpoint places new rungs exactly as the original run did.
+template<class MCMCobject>
+static void runTI(globals &globals, int Kindex, vector<profileObject> *rungProfiles, checkpointObject *checkpoint) {
     int K = globals.Kmin+Kindex;
     
+    // set up beta vector
+    vector<double> betaVec(globals.thermodynamicRungs);
+    for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++)
+        betaVec[TIrep] = pow(double(TIrep)/(globals.thermodynamicRungs-1), globals.thermodynamicPower);
+    
     // special case if K==1
     if (K==1) {
         for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
+            globals.TIpoint_beta[Kindex][TIrep] = betaVec[TIrep];
             globals.TIpoint_mean[Kindex][TIrep] = globals.logEvidence_exhaustive[Kindex];
             globals.TIpoint_var[Kindex][TIrep] = 0;
             globals.TIpoint_SE[Kindex][TIrep] = 0;
         }
+        globals.TIrungs[Kindex] = globals.thermodynamicRungs;
         globals.logEvidence_TI[Kindex] = globals.logEvidence_exhaustive[Kindex];
         globals.logEvidence_TI_SE[Kindex] = 0;
         return;
     }
     
-    // set up beta vector
-    vector<double> betaVec(globals.thermodynamicRungs);
-    for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++)
-        betaVec[TIrep] = double(TIrep)/(globals.thermodynamicRungs-1);
-    
-    // carry out thermodynamic integration
-    for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
-        double beta = betaVec[TIrep];
+    // results at each completed rung, in order of increasing power. The final state of each rung is only kept if further rungs may be added, as it is needed to warm-start the new rungs.
+    bool adaptive = (globals.thermodynamicTargetSE>0);
+    vector<typename MCMCobject::chainState> states;
+    vector< unique_ptr<profileObject> > profiles;
+    vector<double> beta, mean, var, SE;
+    vector<const typename MCMCobject::chainState*> warmStart(betaVec.size(), nullptr);
+    double integral, integral_SE;
+    int rungsRun = 0;
+    while (true) {
         
-        char * buffer = new char[8];
-        sprintf(buffer, "%.2f", beta);
-        string s = buffer;
-        coutAndLog("  power = "+s+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        // carry out MCMC at all new rungs
+        vector<typename MCMCobject::chainState> newStates;
+        vector< unique_ptr<profileObject> > newProfiles;
+        vector<double> newMean, newVar, newSE;
+        runRungs<MCMCobject>(globals, Kindex, betaVec, rungsRun, warmStart, newMean, newVar, newSE, newProfiles, adaptive ? &newStates : 0, checkpoint);
+        rungsRun += int(betaVec.size());
+        
+        // merge the results of each new rung into the ladder of completed rungs
+        for (int TIrep=0; TIrep<int(betaVec.size()); TIrep++) {
+            int pos = int(upper_bound(beta.begin(), beta.end(), betaVec[TIrep]) - beta.begin());
+            beta.insert(beta.begin()+pos, betaVec[TIrep]);
+            mean.insert(mean.begin()+pos, newMean[TIrep]);
+            var.insert(var.begin()+pos, newVar[TIrep]);
+            SE.insert(SE.begin()+pos, newSE[TIrep]);
+            if (adaptive) {
+                states.insert(states.begin()+pos, move(newStates[TIrep]));
+            }
+            profiles.insert(profiles.begin()+pos, move(newProfiles[TIrep]));
+        }
         
-        // define MCMC object
-        MCMCobject_admixture TI_MCMC(globals, Kindex, globals.thermodynamicBurnin, globals.thermodynamicSamples, globals.thermodynamicThinning, beta);
+        // calculate thermodynamic integral estimate
+        integrateRungs(beta, mean, SE, integral, integral_SE);
         
-        // perform MCMC
-        TI_MCMC.reset(true);
-		TI_MCMC.perform_MCMC(globals, false, true, false, false, false, TIrep);
+        // stop if the target standard error has been reached, or if no more rungs can be added
+        int nRungs = int(beta.size());
+        if (!adaptive || integral_SE<=globals.thermodynamicTargetSE || nRungs>=globals.thermodynamicMaxRungs) {
+            break;
+        }
         
-        // calculate autocorrelation
-        double autoCorr = calculateAutoCorr(TI_MCMC.logLikeGroup_store);
-        double ESS = globals.thermodynamicSamples/autoCorr;
+        // score each interval by its width times the change in mean log-likelihood across it plus the standard error at its ends, so that refinement is concentrated where the curve is steepest or least certain. Split the highest scoring half of intervals (at least one) at their midpoints.
+        vector< pair<double,int> > score(nRungs-1);
+        for (int i=0; i<(nRungs-1); i++) {
+            double width = beta[i+1]-beta[i];
+            score[i] = make_pair(-width*(fabs(mean[i+1]-mean[i]) + sqrt(SE[i]*SE[i]+SE[i+1]*SE[i+1])), i);
+        }
+        sort(score.begin(), score.end());
+        int newRungsNum = min(max(1, (nRungs-1)/2), globals.thermodynamicMaxRungs-nRungs);
+        vector<int> splitIntervals;
+        for (int i=0; i<newRungsNum; i++) {
+            splitIntervals.push_back(score[i].second);
+        }
+        sort(splitIntervals.begin(), splitIntervals.end());
         
-        // save results of this power
-        globals.TIpoint_mean[Kindex][TIrep] = TI_MCMC.logLikeGroup_sum/double(globals.thermodynamicSamples);
-        globals.TIpoint_var[Kindex][TIrep] = TI_MCMC.logLikeGroup_sumSquared/double(globals.thermodynamicSamples) - globals.TIpoint_mean[Kindex][TIrep]*globals.TIpoint_mean[Kindex][TIrep];
-        globals.TIpoint_SE[Kindex][TIrep] = sqrt(globals.TIpoint_var[Kindex][TIrep]/ESS);
+        betaVec.clear();
+        warmStart.clear();
+        for (int i=0; i<newRungsNum; i++) {
+            betaVec.push_back(0.5*(beta[splitIntervals[i]]+beta[splitIntervals[i]+1]));
+            warmStart.push_back(&states[splitIntervals[i]]);
+        }
         
+        char * buffer = new char[255];
+        sprintf(buffer, "%.4f", integral_SE);
+        string s = buffer;
+        coutAndLog_K("  standard error = "+s+", adding "+to_string((long long)newRungsNum)+" rungs\n", globals, Kindex);
     }
     
-    // calculate thermodynamic integral estimate. Note that at this stage we assume equally spaced rungs.
-    double Dsum = 0.5*globals.TIpoint_mean[Kindex][0] + 0.5*globals.TIpoint_mean[Kindex][globals.thermodynamicRungs-1];
-    double Vsum = 0.25*globals.TIpoint_SE[Kindex][0]*globals.TIpoint_SE[Kindex][0] + 0.25*globals.TIpoint_SE[Kindex][globals.thermodynamicRungs-1]*globals.TIpoint_SE[Kindex][globals.thermodynamicRungs-1];
-    if (globals.thermodynamicRungs>2) {
-        for (int TIrep=1; TIrep<(globals.thermodynamicRungs-1); TIrep++) {
-            Dsum += globals.TIpoint_mean[Kindex][TIrep];
-            Vsum += globals.TIpoint_SE[Kindex][TIrep]*globals.TIpoint_SE[Kindex][TIrep];
+    // save results
+    int nRungs = int(beta.size());
+    globals.TIrungs[Kindex] = nRungs;
+    for (int TIrep=0; TIrep<nRungs; TIrep++) {
+        globals.TIpoint_beta[Kindex][TIrep] = beta[TIrep];
+        globals.TIpoint_mean[Kindex][TIrep] = mean[TIrep];
+        globals.TIpoint_var[Kindex][TIrep] = var[TIrep];
+        globals.TIpoint_SE[Kindex][TIrep] = SE[TIrep];
+    }
+    globals.logEvidence_TI[Kindex] = integral;
+    globals.logEvidence_TI_SE[Kindex] = integral_SE;
+    
+    // save profiles, numbering rungs from 1
+    if (rungProfiles!=0) {
+        for (int TIrep=0; TIrep<nRungs; TIrep++) {
+            profiles[TIrep]->rung = TIrep+1;
+            rungProfiles->push_back(*profiles[TIrep]);
         }
     }
-    Dsum /= double(globals.thermodynamicRungs-1);
-    Vsum /= double(globals.thermodynamicRungs-1)*double(globals.thermodynamicRungs-1);
-    globals.logEvidence_TI[Kindex] = Dsum;
-    globals.logEvidence_TI_SE[Kindex] = sqrt(Vsum);
     
+}
+
+//------------------------------------------------
+// thermodynamic integral estimator for no-admixture model
+void TI_noAdmixture(globals &globals, int Kindex, vector<profileObject> *rungProfiles, checkpointObject *checkpoint) {
+    runTI<MCMCobject_noAdmixture>(globals, Kindex, rungProfiles, checkpoint);
+}
+
+//------------------------------------------------
+// thermodynamic integral estimator for admixture model
+void TI_admixture(globals &globals, int Kindex, vector<profileObject> *rungProfiles, checkpointObject *checkpoint) {
+    runTI<MCMCobject_admixture>(globals, Kindex, rungProfiles, checkpoint);
 }
\ No newline at end of file
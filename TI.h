@@ -6,7 +6,7 @@
 //
 //  Distributed under the MIT software licence - see Notes.c file for details
 //
-//  Carries out thermodynamic integration for models both with- and without-admixture.
+//  Carries out thermodynamic integration for models both with- and without-admixture. Rungs are run in parallel, and can optionally be coupled by parallel tempering (swapping states between adjacent rungs). Rungs can be spaced unequally (by a power law), and further rungs can be added adaptively until a target standard error is reached. The integral is calculated by the trapezoidal rule over whatever spacing results. Progress can be saved to a checkpoint rung by rung, and resumed from it.
 //
 // ---------------------------------------------------------------------------
 
@@ -14,17 +14,19 @@
 #define __Maverick1_0__TI__
 
 #include <iostream>
+#include <memory>
 #include "globals.h"
 #include "MCMCobject_noAdmixture.h"
 #include "MCMCobject_admixture.h"
+#include "checkpoint.h"
 #include "misc.h"
 
 //------------------------------------------------
-// thermodynamic integral estimator for no-admixture model
-void TI_noAdmixture(globals &globals, int Kindex);
+// thermodynamic integral estimator for no-admixture model. If rungProfiles is not null then the profile of each rung of the ladder is added to it. If checkpoint is not null then rungs that completed before the checkpoint was written are restored from it rather than run again, rungs that were part way through carry on from their last saved state, and progress is saved to it as the ladder is run.
+void TI_noAdmixture(globals &globals, int Kindex, std::vector<profileObject> *rungProfiles=0, checkpointObject *checkpoint=0);
 
 //------------------------------------------------
-// thermodynamic integral estimator for admixture model
-void TI_admixture(globals &globals, int Kindex);
+// thermodynamic integral estimator for admixture model. If rungProfiles is not null then the profile of each rung of the ladder is added to it. Checkpoints are handled as in TI_noAdmixture().
+void TI_admixture(globals &globals, int Kindex, std::vector<profileObject> *rungProfiles=0, checkpointObject *checkpoint=0);
 
 #endif
@@ -0,0 +1,295 @@
+//
+//  MavericK
+//  benchmark.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Benchmark harness for MavericK. Simulates a fixed grid of data sets with simulateData, runs MavericK on each one at a fixed seed with outputProfile_on, and reports the time spent in each phase of the analysis (MCMC sweeps, label switching, thermodynamic integration, EM and the exhaustive approach) together with the throughput in gene copy updates per second and the peak resident memory of each run. Everything except the timings is deterministic, so the output of two builds can be compared line by line. Runs under Unix-like systems only, as it launches MavericK with fork() and reads its memory use with wait4().
+//
+//  Usage:
+//    benchmark <MavericK> <simulateData> <working directory> [-quick]
+//        run the benchmark grid and write results as csv to standard output. -quick runs far fewer iterations, and is intended only to check that the harness works.
+//    benchmark -compare <old.csv> <new.csv> [threshold]
+//        compare two sets of results, reporting the ratio of new to old throughput for every phase, and flagging phases that are slower by more than threshold (default 0.1, i.e. 10%)
+//
+// ---------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+//------------------------------------------------
+// a single point of the benchmark grid
+struct benchCase {
+    string name;
+    bool admix;
+    int n;
+    int loci;
+    int J;
+    int ploidy;
+    double missing;
+    int K;
+    bool exhaustive;
+    bool TI;
+    bool EM;
+};
+
+//------------------------------------------------
+// the benchmark grid. Cases are only ever added to the end of this list, so that results remain comparable across versions.
+static vector<benchCase> benchGrid() {
+    vector<benchCase> grid;
+    //                 name               admix  n    loci J   ploidy missing K  exhaustive TI     EM
+    grid.push_back({"exhaustive_noAdmix", false, 8,   20,  2,  2,     0.0,    3, true,      false, false});
+    grid.push_back({"exhaustive_admix",   true,  2,   5,   2,  2,     0.0,    2, true,      false, false});
+    grid.push_back({"noAdmix_small",      false, 100, 50,  2,  2,     0.02,   3, false,     true,  true});
+    grid.push_back({"noAdmix_loci",       false, 100, 400, 2,  2,     0.02,   3, false,     true,  true});
+    grid.push_back({"noAdmix_ind",        false, 800, 50,  2,  2,     0.02,   3, false,     true,  true});
+    grid.push_back({"noAdmix_multi",      false, 200, 100, 10, 2,     0.02,   5, false,     true,  true});
+    grid.push_back({"noAdmix_haploid",    false, 200, 100, 2,  1,     0.00,   3, false,     false, true});
+    grid.push_back({"admix_small",        true,  100, 50,  2,  2,     0.02,   3, false,     true,  true});
+    grid.push_back({"admix_loci",         true,  100, 200, 2,  2,     0.02,   3, false,     true,  true});
+    grid.push_back({"admix_ind",          true,  400, 50,  2,  2,     0.02,   3, false,     true,  true});
+    grid.push_back({"admix_multi",        true,  200, 100, 10, 2,     0.02,   5, false,     true,  true});
+    return(grid);
+}
+
+//------------------------------------------------
+// split a line of csv into fields
+static vector<string> splitLine(const string &line) {
+    vector<string> output;
+    string field;
+    istringstream stream(line);
+    while (getline(stream, field, ',')) {
+        output.push_back(field);
+    }
+    return(output);
+}
+
+//------------------------------------------------
+// run a command, waiting for it to finish. Returns the exit status, and the peak resident memory of the command in kB.
+static int runCommand(const vector<string> &args, long &peakRSS_kB) {
+    vector<char*> argv;
+    for (size_t i=0; i<args.size(); i++) {
+        argv.push_back(const_cast<char*>(args[i].c_str()));
+    }
+    argv.push_back(0);
+
+    // anything still buffered would otherwise be written a second time by the child
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid==0) {
+        // silence the console output of the child
+        if (freopen("/dev/null", "w", stdout)==0) {
+            _exit(127);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+#ifdef __APPLE__
+    peakRSS_kB = usage.ru_maxrss/1024;
+#else
+    peakRSS_kB = usage.ru_maxrss;
+#endif
+    return(WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+}
+
+//------------------------------------------------
+// read the profile file written by MavericK, as one map from column name to value per row
+static vector< map<string,string> > readProfile(const string &filePath) {
+    vector< map<string,string> > output;
+    ifstream stream(filePath.c_str());
+    string line;
+    if (!getline(stream, line)) {
+        return(output);
+    }
+    vector<string> header = splitLine(line);
+    while (getline(stream, line)) {
+        vector<string> fields = splitLine(line);
+        map<string,string> row;
+        for (size_t i=0; i<header.size() && i<fields.size(); i++) {
+            row[header[i]] = fields[i];
+        }
+        output.push_back(row);
+    }
+    return(output);
+}
+
+//------------------------------------------------
+// write a single result. Throughput is NA if there is nothing to measure it by.
+static void writeResult(const benchCase &c, const string &phase, double seconds, double updates, long peakRSS_kB) {
+    cout << c.name << "," << (c.admix ? "admixture" : "noAdmixture") << "," << c.n << "," << c.loci << "," << c.J << "," << c.ploidy << "," << c.K << "," << phase << "," << seconds << ",";
+    if (updates>0 && seconds>0) {
+        cout << updates/seconds;
+    } else {
+        cout << "NA";
+    }
+    cout << "," << peakRSS_kB << "\n";
+    cout.flush();
+}
+
+//------------------------------------------------
+// run a single case of the grid
+static bool runCase(const benchCase &c, const string &MavericK, const string &simulateData, const string &workDir, bool quick) {
+    string caseDir = workDir + c.name + "/";
+    mkdir(caseDir.c_str(), 0755);
+
+    // simulate data
+    long peakRSS_kB = 0;
+    vector<string> simArgs = {simulateData, "-output", caseDir+"data.txt", "-K", to_string((long long)c.K), "-n", to_string((long long)c.n), "-loci", to_string((long long)c.loci), "-J", to_string((long long)c.J), "-ploidy", to_string((long long)c.ploidy), "-missing", to_string(c.missing), "-alpha", c.admix ? "1" : "0", "-seed", "1"};
+    if (runCommand(simArgs, peakRSS_kB)!=0) {
+        cerr << "Error: failed to simulate data for case " << c.name << "\n";
+        return(false);
+    }
+
+    // write parameters file
+    int burnin = quick ? 10 : 500;
+    int samples = quick ? 20 : 1000;
+    ofstream params((caseDir+"parameters.txt").c_str());
+    params << "headerRow_on\tfalse\npopCol_on\ttrue\nploidyCol_on\ttrue\n";
+    params << "Kmin\t" << c.K << "\nKmax\t" << c.K << "\n";
+    params << "admix_on\t" << (c.admix ? "true" : "false") << "\n";
+    params << "exhaustive_on\t" << (c.exhaustive ? "true" : "false") << "\n";
+    params << "mainRepeats\t1\nmainBurnin\t" << burnin << "\nmainSamples\t" << samples << "\n";
+    params << "thermodynamic_on\t" << (c.TI ? "true" : "false") << "\n";
+    params << "thermodynamicRungs\t5\nthermodynamicBurnin\t" << burnin/5 << "\nthermodynamicSamples\t" << samples/5 << "\n";
+    params << "EMalgorithm_on\t" << (c.EM ? "true" : "false") << "\n";
+    params << "EMrepeats\t5\nEMiterations\t" << (quick ? 20 : 200) << "\n";
+    params << "outputProfile_on\ttrue\n";
+    params.close();
+
+    // run MavericK, timing the whole process
+    vector<string> args = {MavericK, "-masterRoot", caseDir, "-data", "data.txt", "-parameters", "parameters.txt", "-seed", "1"};
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (runCommand(args, peakRSS_kB)!=0) {
+        cerr << "Error: MavericK failed on case " << c.name << " (see " << caseDir << "outputLog.txt)\n";
+        return(false);
+    }
+    double wallTime = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+    // each sweep updates every gene copy once (including missing gene copies, which are skipped quickly)
+    double geneCopies = double(c.n)*c.ploidy*c.loci;
+
+    // report phases from the profile
+    vector< map<string,string> > profile = readProfile(caseDir+"outputProfile.csv");
+    if (profile.empty()) {
+        cerr << "Error: no profile written for case " << c.name << "\n";
+        return(false);
+    }
+    for (size_t i=0; i<profile.size(); i++) {
+        map<string,string> &row = profile[i];
+        string stage = row["stage"];
+        if (row["rung"]!="NA") {
+            continue;
+        }
+        double total = atof(row["time_total"].c_str());
+        double Gibbs = atof(row["time_Gibbs"].c_str());
+        double sweeps = atof(row["sweeps"].c_str());
+        if (stage=="exhaustive") {
+            writeResult(c, "exhaustive", total, 0, peakRSS_kB);
+        } else if (stage=="main") {
+            writeResult(c, "main_sweep", Gibbs, sweeps*geneCopies, peakRSS_kB);
+            if (c.admix) {
+                writeResult(c, "main_indLevel", atof(row["time_indLevel"].c_str()), sweeps*geneCopies, peakRSS_kB);
+            }
+            writeResult(c, "main_labels", atof(row["time_Qmatrix"].c_str())+atof(row["time_labels"].c_str()), 0, peakRSS_kB);
+            writeResult(c, "main_total", total, sweeps*geneCopies, peakRSS_kB);
+        } else if (stage=="TI") {
+            writeResult(c, "TI_total", total, sweeps*geneCopies, peakRSS_kB);
+        } else if (stage=="EM") {
+            writeResult(c, "EM_total", total, atof(row["EM_iterations"].c_str())*geneCopies, peakRSS_kB);
+        }
+    }
+    writeResult(c, "process", wallTime, 0, peakRSS_kB);
+    return(true);
+}
+
+//------------------------------------------------
+// compare two sets of results, matching rows by case and phase
+static int compareResults(const string &oldPath, const string &newPath, double threshold) {
+    map<string,double> oldThroughput;
+    ifstream oldStream(oldPath.c_str());
+    ifstream newStream(newPath.c_str());
+    if (!oldStream.is_open() || !newStream.is_open()) {
+        cerr << "Error: unable to read results files\n";
+        return(1);
+    }
+
+    // speed is measured by throughput where there is one, and otherwise by time
+    auto speed = [](const vector<string> &fields) {
+        return((fields[9]!="NA") ? atof(fields[9].c_str()) : 1.0/atof(fields[8].c_str()));
+    };
+
+    string line;
+    getline(oldStream, line);
+    while (getline(oldStream, line)) {
+        vector<string> fields = splitLine(line);
+        if (fields.size()>=11) {
+            oldThroughput[fields[0]+","+fields[7]] = speed(fields);
+        }
+    }
+
+    cout << "case,phase,speed_ratio,peak_RSS_kB,flag\n";
+    int regressions = 0;
+    getline(newStream, line);
+    while (getline(newStream, line)) {
+        vector<string> fields = splitLine(line);
+        if (fields.size()<11 || oldThroughput.count(fields[0]+","+fields[7])==0) {
+            continue;
+        }
+        double ratio = speed(fields)/oldThroughput[fields[0]+","+fields[7]];
+        bool slower = (ratio<(1.0-threshold));
+        regressions += slower;
+        cout << fields[0] << "," << fields[7] << "," << ratio << "," << fields[10] << "," << (slower ? "SLOWER" : "") << "\n";
+    }
+    cerr << regressions << " phases slower by more than " << threshold*100 << "%\n";
+    return(0);
+}
+
+//------------------------------------------------
+// main
+int main(int argc, const char * argv[]) {
+
+    if (argc>=4 && string(argv[1])=="-compare") {
+        double threshold = (argc>=5) ? atof(argv[4]) : 0.1;
+        return(compareResults(argv[2], argv[3], threshold));
+    }
+
+    if (argc<4) {
+        cerr << "Usage: benchmark <MavericK> <simulateData> <working directory> [-quick]\n       benchmark -compare <old.csv> <new.csv> [threshold]\n";
+        return(1);
+    }
+    string MavericK = argv[1];
+    string simulateData = argv[2];
+    string workDir = argv[3];
+    if (workDir.back()!='/') {
+        workDir += "/";
+    }
+    bool quick = (argc>=5 && string(argv[4])=="-quick");
+    mkdir(workDir.c_str(), 0755);
+
+    cout << "case,model,n,loci,J,ploidy,K,phase,seconds,updates_per_second,peak_RSS_kB\n";
+    vector<benchCase> grid = benchGrid();
+    bool success = true;
+    for (size_t i=0; i<grid.size(); i++) {
+        success = runCase(grid[i], MavericK, simulateData, workDir, quick) && success;
+    }
+    return(success ? 0 : 1);
+}
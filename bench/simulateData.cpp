@@ -0,0 +1,167 @@
+//
+//  MavericK
+//  simulateData.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Simulates a population-structured data set from the same model that MavericK fits, and writes it in the format read by readData(), with one row per gene copy, a population column and a ploidy column, and no header row. Allele frequencies at each locus are drawn from a symmetric Dirichlet(lambda=1) prior in each of K demes. Under the no-admixture model (alpha=0) each individual is assigned to a deme uniformly at random, and under the admixture model each individual draws admixture proportions from a symmetric Dirichlet(alpha) and each gene copy draws its deme from these proportions. The population column gives the deme of each individual (or the deme with the largest admixture proportion), so that the true structure can be compared against the Qmatrix output. Alleles are coded 1:J, and each gene copy is independently missing (coded -9) with probability missing.
+//
+//  All random numbers are drawn from the same generator as MavericK itself (see probability.h), so a given seed produces exactly the same data set on every platform.
+//
+//  Usage: simulateData -output <file> [-K 3] [-n 100] [-loci 50] [-J 2] [-ploidy 2] [-missing 0] [-alpha 0] [-seed 1]
+//
+// ---------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "../probability.h"
+
+using namespace std;
+
+//------------------------------------------------
+// draw from a symmetric Dirichlet distribution with the given number of categories and concentration parameter. Returned in cumulative form, ready for sample1_cumulative()
+static vector<double> rdirichlet_cumulative(RNGobject &RNG, int categories, double concentration) {
+    vector<double> output(categories);
+    double sum = 0;
+    for (int i=0; i<categories; i++) {
+        sum += RNG.rgamma1(concentration, 1.0);
+        output[i] = sum;
+    }
+    for (int i=0; i<categories; i++) {
+        output[i] /= sum;
+    }
+    return(output);
+}
+
+//------------------------------------------------
+// read the value following a command line flag, exiting with an error if there is none
+static string readValue(int argc, const char * argv[], int &i) {
+    if ((i+1)>=argc) {
+        cerr << "Error: missing value for argument " << argv[i] << "\n";
+        exit(1);
+    }
+    i++;
+    return(argv[i]);
+}
+
+//------------------------------------------------
+// main
+int main(int argc, const char * argv[]) {
+
+    // default parameters
+    string output;
+    int K = 3;
+    int n = 100;
+    int loci = 50;
+    int J = 2;
+    int ploidy = 2;
+    double missing = 0;
+    double alpha = 0;
+    long long seed = 1;
+
+    // read command line arguments
+    for (int i=1; i<argc; i++) {
+        string flag = argv[i];
+        if (flag=="-output") {
+            output = readValue(argc, argv, i);
+        } else if (flag=="-K") {
+            K = atoi(readValue(argc, argv, i).c_str());
+        } else if (flag=="-n") {
+            n = atoi(readValue(argc, argv, i).c_str());
+        } else if (flag=="-loci") {
+            loci = atoi(readValue(argc, argv, i).c_str());
+        } else if (flag=="-J") {
+            J = atoi(readValue(argc, argv, i).c_str());
+        } else if (flag=="-ploidy") {
+            ploidy = atoi(readValue(argc, argv, i).c_str());
+        } else if (flag=="-missing") {
+            missing = atof(readValue(argc, argv, i).c_str());
+        } else if (flag=="-alpha") {
+            alpha = atof(readValue(argc, argv, i).c_str());
+        } else if (flag=="-seed") {
+            seed = atoll(readValue(argc, argv, i).c_str());
+        } else {
+            cerr << "Error: unrecognised argument " << flag << "\n";
+            exit(1);
+        }
+    }
+    if (output=="") {
+        cerr << "Error: output file must be given with -output\n";
+        exit(1);
+    }
+    if (K<1 || n<1 || loci<1 || J<1 || ploidy<1 || missing<0 || missing>=1 || alpha<0) {
+        cerr << "Error: K, n, loci, J and ploidy must be positive integers, missing must be in [0,1) and alpha must be non-negative\n";
+        exit(1);
+    }
+
+    RNGobject RNG = RNGstream(uint64_t(seed), -1, 0, 0);
+
+    // draw allele frequencies of each deme at each locus
+    vector< vector< vector<double> > > alleleFreqs(K, vector< vector<double> >(loci));
+    for (int k=0; k<K; k++) {
+        for (int l=0; l<loci; l++) {
+            alleleFreqs[k][l] = rdirichlet_cumulative(RNG, J, 1.0);
+        }
+    }
+
+    ofstream stream(output.c_str());
+    if (!stream.is_open()) {
+        cerr << "Error: unable to write to file " << output << "\n";
+        exit(1);
+    }
+
+    // draw genotypes of each individual, one gene copy at a time
+    vector< vector<int> > genotypes(ploidy, vector<int>(loci));
+    for (int i=0; i<n; i++) {
+
+        // deme of this individual, or its admixture proportions
+        vector<double> admixFreqs;
+        int deme = 0;
+        if (alpha>0) {
+            admixFreqs = rdirichlet_cumulative(RNG, K, alpha);
+            double best = 0;
+            for (int k=0; k<K; k++) {
+                double q = admixFreqs[k] - ((k==0) ? 0 : admixFreqs[k-1]);
+                if (q>best) {
+                    best = q;
+                    deme = k;
+                }
+            }
+        } else {
+            deme = int(RNG.runif_0_1()*K);
+            deme = (deme>=K) ? K-1 : deme;
+        }
+
+        for (int l=0; l<loci; l++) {
+            for (int p=0; p<ploidy; p++) {
+                int k = (alpha>0) ? RNG.sample1_cumulative(admixFreqs)-1 : deme;
+                genotypes[p][l] = RNG.sample1_cumulative(alleleFreqs[k][l]);
+                if (missing>0 && RNG.runif_0_1()<missing) {
+                    genotypes[p][l] = -9;
+                }
+            }
+        }
+
+        // write one row per gene copy, with the population and ploidy given on the first row only
+        for (int p=0; p<ploidy; p++) {
+            ostringstream line;
+            line << "ind" << i+1 << "\t";
+            if (p==0) {
+                line << "pop" << deme+1 << "\t" << ploidy;
+            } else {
+                line << "\t";
+            }
+            for (int l=0; l<loci; l++) {
+                line << "\t" << genotypes[p][l];
+            }
+            stream << line.str() << "\n";
+        }
+    }
+
+    return(0);
+}
@@ -0,0 +1,422 @@
+//
+//  MavericK
+//  checkpoint.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include <fstream>
+#include <sstream>
+
+#include "checkpoint.h"
+#include "misc.h"
+
+using namespace std;
+
+// first bytes of every checkpoint file, including a version number that should be changed whenever the layout changes
+#define CHECKPOINT_MAGIC "MavericK checkpoint 5"
+
+//------------------------------------------------
+// binaryReader::
+// constructor
+binaryReader::binaryReader(const string &_buffer) : buffer(_buffer) {
+    pos = 0;
+    failed = false;
+}
+
+//------------------------------------------------
+// binaryReader::
+// check that at least n values of the given size remain to be read
+bool binaryReader::canRead(uint64_t n, size_t size) {
+    if (failed || n>(buffer.size()-pos)/size) {
+        failed = true;
+    }
+    return(!failed);
+}
+
+//------------------------------------------------
+// append values to string in binary form
+void appendValue(string &s, const string &x) {
+    appendBinary(s, uint64_t(x.size()));
+    s.append(x);
+}
+void appendValue(string &s, const RNGobject &x) {
+    for (int i=0; i<4; i++) {
+        appendBinary(s, x.s[i]);
+    }
+    appendBinary(s, x.normal_saved);
+    appendBinary(s, x.normal_spare);
+}
+void appendValue(string &s, const welford &x) {
+    appendBinary(s, x.n);
+    appendBinary(s, x.mean);
+    appendBinary(s, x.M2);
+}
+void appendValue(string &s, const welfordMatrix &x) {
+    appendBinary(s, x.rows);
+    appendBinary(s, x.cols);
+    appendBinary(s, x.n);
+    appendValue(s, x.mean);
+    appendValue(s, x.M2);
+}
+void appendValue(string &s, const QmatrixMean &x) {
+    appendBinary(s, x.rows);
+    appendBinary(s, x.K);
+    appendBinary(s, x.useFloat);
+    appendBinary(s, x.compensated);
+    appendBinary(s, x.count);
+    appendValue(s, x.values_double);
+    appendValue(s, x.values_float);
+    appendValue(s, x.errors_float);
+}
+void appendValue(string &s, const profileObject &x) {
+    appendValue(s, x.stage);
+    appendBinary(s, x.rung);
+    appendBinary(s, x.beta);
+    appendValue(s, x.seconds);
+    appendValue(s, x.counts);
+}
+
+//------------------------------------------------
+// read back values written by appendValue()
+void readValue(binaryReader &r, string &x) {
+    uint64_t size = 0;
+    r.read(size);
+    if (!r.canRead(size, 1)) {
+        x.clear();
+        return;
+    }
+    x.assign(r.buffer, r.pos, size_t(size));
+    r.pos += size_t(size);
+}
+void readValue(binaryReader &r, RNGobject &x) {
+    for (int i=0; i<4; i++) {
+        r.read(x.s[i]);
+    }
+    r.read(x.normal_saved);
+    r.read(x.normal_spare);
+}
+void readValue(binaryReader &r, welford &x) {
+    r.read(x.n);
+    r.read(x.mean);
+    r.read(x.M2);
+}
+void readValue(binaryReader &r, welfordMatrix &x) {
+    r.read(x.rows);
+    r.read(x.cols);
+    r.read(x.n);
+    readValue(r, x.mean);
+    readValue(r, x.M2);
+}
+void readValue(binaryReader &r, QmatrixMean &x) {
+    r.read(x.rows);
+    r.read(x.K);
+    r.read(x.useFloat);
+    r.read(x.compensated);
+    r.read(x.count);
+    readValue(r, x.values_double);
+    readValue(r, x.values_float);
+    readValue(r, x.errors_float);
+}
+void readValue(binaryReader &r, profileObject &x) {
+    readValue(r, x.stage);
+    r.read(x.rung);
+    r.read(x.beta);
+    readValue(r, x.seconds);
+    readValue(r, x.counts);
+}
+
+//------------------------------------------------
+// all parameter values that affect the results, in a single string. Used to check that a run is resumed with the same parameters it was started with. The range of K, the number of threads and the checkpoint interval can all be changed between runs, and the seed is checked separately.
+static string parameterSignature(globals &globals) {
+    string signature;
+    for (map< string, pair<string,int> >::iterator it=globals.parameterStrings.begin(); it!=globals.parameterStrings.end(); ++it) {
+        if (it->first=="Kmin" || it->first=="Kmax" || it->first=="threads" || it->first=="seed" || it->first=="checkpointInterval") {
+            continue;
+        }
+        signature += it->first+"="+it->second.first+"\n";
+    }
+    return(signature);
+}
+
+//------------------------------------------------
+// append all results of a single K (everything that is printed to file by outputK())
+void appendResults(string &s, globals &globals, int Kindex) {
+    appendValue(s, globals.Qmatrix_gene[Kindex]);
+    appendValue(s, globals.QmatrixError_gene[Kindex]);
+    appendValue(s, globals.Qmatrix_ind[Kindex]);
+    appendValue(s, globals.QmatrixError_ind[Kindex]);
+    appendValue(s, globals.Qmatrix_pop[Kindex]);
+    appendValue(s, globals.QmatrixError_pop[Kindex]);
+
+    appendValue(s, globals.logEvidence_exhaustive[Kindex]);
+    appendValue(s, globals.logEvidence_harmonic[Kindex]);
+    appendValue(s, globals.logEvidence_harmonic_grandMean[Kindex]);
+    appendValue(s, globals.logEvidence_harmonic_grandSE[Kindex]);
+    appendValue(s, globals.structure_loglike_mean[Kindex]);
+    appendValue(s, globals.structure_loglike_var[Kindex]);
+    appendValue(s, globals.logEvidence_structure[Kindex]);
+    appendValue(s, globals.logEvidence_structure_grandMean[Kindex]);
+    appendValue(s, globals.logEvidence_structure_grandSE[Kindex]);
+    appendValue(s, globals.logLikeGroup_ESS[Kindex]);
+    appendValue(s, globals.mainBurnin_used[Kindex]);
+    appendValue(s, globals.mainSamples_used[Kindex]);
+
+    appendValue(s, globals.TIrungs[Kindex]);
+    appendValue(s, globals.TIpoint_beta[Kindex]);
+    appendValue(s, globals.TIpoint_mean[Kindex]);
+    appendValue(s, globals.TIpoint_var[Kindex]);
+    appendValue(s, globals.TIpoint_SE[Kindex]);
+    appendValue(s, globals.logEvidence_TI[Kindex]);
+    appendValue(s, globals.logEvidence_TI_SE[Kindex]);
+
+    appendValue(s, globals.maxLike[Kindex]);
+    appendValue(s, globals.max_alleleFreqs[Kindex]);
+    appendValue(s, globals.max_admixFreqs[Kindex]);
+    appendValue(s, globals.AIC[Kindex]);
+    appendValue(s, globals.BIC[Kindex]);
+    appendValue(s, globals.DIC_Spiegelhalter[Kindex]);
+    appendValue(s, globals.DIC_Gelman[Kindex]);
+    
+    appendValue(s, globals.profile[Kindex]);
+}
+
+//------------------------------------------------
+// read back the results written by appendResults()
+void readResults(binaryReader &r, globals &globals, int Kindex) {
+    readValue(r, globals.Qmatrix_gene[Kindex]);
+    readValue(r, globals.QmatrixError_gene[Kindex]);
+    readValue(r, globals.Qmatrix_ind[Kindex]);
+    readValue(r, globals.QmatrixError_ind[Kindex]);
+    readValue(r, globals.Qmatrix_pop[Kindex]);
+    readValue(r, globals.QmatrixError_pop[Kindex]);
+
+    readValue(r, globals.logEvidence_exhaustive[Kindex]);
+    readValue(r, globals.logEvidence_harmonic[Kindex]);
+    readValue(r, globals.logEvidence_harmonic_grandMean[Kindex]);
+    readValue(r, globals.logEvidence_harmonic_grandSE[Kindex]);
+    readValue(r, globals.structure_loglike_mean[Kindex]);
+    readValue(r, globals.structure_loglike_var[Kindex]);
+    readValue(r, globals.logEvidence_structure[Kindex]);
+    readValue(r, globals.logEvidence_structure_grandMean[Kindex]);
+    readValue(r, globals.logEvidence_structure_grandSE[Kindex]);
+    readValue(r, globals.logLikeGroup_ESS[Kindex]);
+    readValue(r, globals.mainBurnin_used[Kindex]);
+    readValue(r, globals.mainSamples_used[Kindex]);
+
+    readValue(r, globals.TIrungs[Kindex]);
+    readValue(r, globals.TIpoint_beta[Kindex]);
+    readValue(r, globals.TIpoint_mean[Kindex]);
+    readValue(r, globals.TIpoint_var[Kindex]);
+    readValue(r, globals.TIpoint_SE[Kindex]);
+    readValue(r, globals.logEvidence_TI[Kindex]);
+    readValue(r, globals.logEvidence_TI_SE[Kindex]);
+
+    readValue(r, globals.maxLike[Kindex]);
+    readValue(r, globals.max_alleleFreqs[Kindex]);
+    readValue(r, globals.max_admixFreqs[Kindex]);
+    readValue(r, globals.AIC[Kindex]);
+    readValue(r, globals.BIC[Kindex]);
+    readValue(r, globals.DIC_Spiegelhalter[Kindex]);
+    readValue(r, globals.DIC_Gelman[Kindex]);
+    
+    readValue(r, globals.profile[Kindex]);
+}
+
+//------------------------------------------------
+// read the whole of a binary file into a string. Returns false if the file cannot be opened.
+static bool readFile(const string &filePath, string &contents) {
+    ifstream stream(filePath.c_str(), ios::binary);
+    if (!stream.is_open()) {
+        return(false);
+    }
+    ostringstream buffer;
+    buffer << stream.rdbuf();
+    contents = buffer.str();
+    return(true);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// constructor
+checkpointObject::checkpointObject(globals &globals, int _Kindex) {
+    Kindex = _Kindex;
+    K = globals.Kmin+Kindex;
+    filePath = checkpoint_filePath(globals, Kindex);
+    write_on = (globals.checkpointInterval>0);
+
+    stage = CHECKPOINT_NONE;
+    mainRepsSaved = 0;
+    chainState = vector<string>(globals.mainRepeats);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// read in the checkpoint file of this K if resuming. Returns false if not resuming or if there is no checkpoint file, in which case the analysis of this K starts from the beginning. A checkpoint that is damaged, or that was written with different parameters, is an error.
+bool checkpointObject::load(globals &globals) {
+
+    string contents;
+    if (!globals.resume_on || !readFile(filePath, contents)) {
+        return(false);
+    }
+
+    binaryReader r(contents);
+    string magic, signature;
+    int K_file = 0, seed_file = 0, n_file = 0, geneCopies_file = 0;
+    readValue(r, magic);
+    readValue(r, K_file);
+    readValue(r, seed_file);
+    readValue(r, n_file);
+    readValue(r, geneCopies_file);
+    readValue(r, signature);
+    if (r.failed || magic!=CHECKPOINT_MAGIC || K_file!=K) {
+        errorExit("\nError: unable to read checkpoint file "+filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    if (seed_file!=globals.seed || n_file!=globals.n || geneCopies_file!=globals.geneCopies || signature!=parameterSignature(globals)) {
+        errorExit("\nError: checkpoint file "+filePath+" was written using different data, parameters or seed. Either run with the original settings, or delete the checkpoint file to start this K again.\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+
+    readValue(r, stage);
+    readResults(r, globals, Kindex);
+    readValue(r, mainRepsSaved);
+    readValue(r, mainAccumulators);
+    readValue(r, chainState);
+    readValue(r, TIrungs);
+    readValue(r, TItempering);
+    if (r.failed || int(chainState.size())<globals.mainRepeats) {
+        errorExit("\nError: unable to read checkpoint file "+filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+
+    return(true);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// save the state of a chain part way through the main MCMC or a rung of thermodynamic integration. The state is emptied.
+void checkpointObject::saveChain(globals &globals, int chain, string &state) {
+    lock_guard<mutex> lock(checkpoint_mutex);
+    if (chain>=int(chainState.size())) {
+        chainState.resize(chain+1);
+    }
+    chainState[chain].swap(state);
+    state.clear();
+    write(globals);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// save the accumulators of the main MCMC once repsSaved repeats are complete, along with the state of the chain that is carried over to the next repeat. Both strings are emptied.
+void checkpointObject::saveRepeat(globals &globals, int repsSaved, string &accumulators, int chain, string &state) {
+    lock_guard<mutex> lock(checkpoint_mutex);
+    mainRepsSaved = repsSaved;
+    mainAccumulators.swap(accumulators);
+    accumulators.clear();
+    chainState[chain].swap(state);
+    state.clear();
+    write(globals);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// save the results of a completed rung of thermodynamic integration. The state of the rung is no longer needed. The results are emptied.
+void checkpointObject::saveRung(globals &globals, int rung, string &results) {
+    lock_guard<mutex> lock(checkpoint_mutex);
+    if (rung>=int(TIrungs.size())) {
+        TIrungs.resize(rung+1);
+    }
+    TIrungs[rung].swap(results);
+    results.clear();
+    if (rung<int(chainState.size())) {
+        string().swap(chainState[rung]);
+    }
+    write(globals);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// save the position of the swap proposals of a set of tempered rungs, along with the state of each rung (states[i] being the state of rung firstRung+i). All strings are emptied.
+void checkpointObject::saveTempering(globals &globals, string &tempering, int firstRung, vector<string> &states) {
+    lock_guard<mutex> lock(checkpoint_mutex);
+    TItempering.swap(tempering);
+    tempering.clear();
+    int nRungs = int(states.size());
+    if (firstRung+nRungs>int(chainState.size())) {
+        chainState.resize(firstRung+nRungs);
+    }
+    for (int i=0; i<nRungs; i++) {
+        chainState[firstRung+i].swap(states[i]);
+        states[i].clear();
+    }
+    write(globals);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// record that a stage of the analysis has completed. Any saved progress through the main MCMC or thermodynamic integration is no longer needed.
+void checkpointObject::completeStage(globals &globals, int _stage) {
+    lock_guard<mutex> lock(checkpoint_mutex);
+    stage = _stage;
+    mainRepsSaved = 0;
+    mainAccumulators.clear();
+    chainState = vector<string>(globals.mainRepeats);
+    TIrungs.clear();
+    TItempering.clear();
+    write(globals);
+}
+
+//------------------------------------------------
+// checkpointObject::
+// pass the complete checkpoint to the background writer. Must be called with checkpoint_mutex held.
+void checkpointObject::write(globals &globals) {
+    if (!write_on) {
+        return;
+    }
+
+    string contents;
+    appendValue(contents, string(CHECKPOINT_MAGIC));
+    appendValue(contents, K);
+    appendValue(contents, globals.seed);
+    appendValue(contents, globals.n);
+    appendValue(contents, globals.geneCopies);
+    appendValue(contents, parameterSignature(globals));
+
+    appendValue(contents, stage);
+    appendResults(contents, globals, Kindex);
+    appendValue(contents, mainRepsSaved);
+    appendValue(contents, mainAccumulators);
+    appendValue(contents, chainState);
+    appendValue(contents, TIrungs);
+    appendValue(contents, TItempering);
+
+    globals.checkpoint_writer.write(filePath, contents);
+}
+
+//------------------------------------------------
+// path of the checkpoint file for a given K
+string checkpoint_filePath(globals &globals, int Kindex) {
+    return(globals.outputRoot_filePath+"checkpoint_K"+to_string((long long)(globals.Kmin+Kindex))+".bin");
+}
+
+//------------------------------------------------
+// when resuming a run whose seed was chosen at random, return the seed recorded in the first checkpoint file that can be found (or 0 if there are none)
+int checkpoint_seed(globals &globals) {
+    for (int Kindex=0; Kindex<(globals.Kmax-globals.Kmin+1); Kindex++) {
+        string contents;
+        if (!readFile(checkpoint_filePath(globals, Kindex), contents)) {
+            continue;
+        }
+        binaryReader r(contents);
+        string magic;
+        int K_file = 0, seed_file = 0;
+        readValue(r, magic);
+        readValue(r, K_file);
+        readValue(r, seed_file);
+        if (!r.failed && magic==CHECKPOINT_MAGIC) {
+            return(seed_file);
+        }
+    }
+    return(0);
+}
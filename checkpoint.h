@@ -0,0 +1,198 @@
+//
+//  MavericK
+//  checkpoint.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines functions for writing the state of an analysis to binary checkpoint files, and for reading it back when the program is restarted with the -resume flag. Each K has its own checkpoint file, which records the last stage of the analysis to have completed (exhaustive approach, main MCMC, thermodynamic integration, EM algorithm) along with all results for that K so far. Within the main MCMC the checkpoint also holds the complete state of every chain, written every checkpointInterval iterations, so that a resumed run carries on exactly where the last checkpoint left off and produces the same output as if it had never stopped. Within thermodynamic integration the results of every rung are saved as soon as the rung completes, along with the state of every rung still running, so that a resumed run only repeats the iterations since the last checkpoint of the rungs that were unfinished. Files are written on a background thread (see outputWriter.h).
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__checkpoint__
+#define __Maverick1_0__checkpoint__
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstring>
+#include <type_traits>
+#include <stdint.h>
+#include "globals.h"
+#include "probability.h"
+#include "welford.h"
+#include "QmatrixMean.h"
+
+// stages of the analysis of a single K, in the order they are carried out
+#define CHECKPOINT_NONE 0
+#define CHECKPOINT_EXHAUSTIVE 1
+#define CHECKPOINT_MAIN 2
+#define CHECKPOINT_TI 3
+#define CHECKPOINT_EM 4
+
+//------------------------------------------------
+// class for reading back values written by appendValue()
+class binaryReader {
+
+public:
+
+    // PUBLIC OBJECTS
+
+    const std::string &buffer;
+    size_t pos;
+
+    // set if an attempt is made to read past the end of the buffer
+    bool failed;
+
+    // PUBLIC FUNCTIONS
+
+    // constructor
+    binaryReader(const std::string &_buffer);
+
+    // check that at least n values of the given size remain to be read
+    bool canRead(uint64_t n, size_t size);
+
+    // read the raw bytes of value x
+    template<class TYPE>
+    void read(TYPE &x) {
+        if (!canRead(1, sizeof(TYPE))) {
+            x = TYPE();
+            return;
+        }
+        memcpy(&x, buffer.data()+pos, sizeof(TYPE));
+        pos += sizeof(TYPE);
+    }
+
+};
+
+//------------------------------------------------
+// append a value to string s in binary form. Vectors (including nested vectors) are written as their length followed by their elements.
+template<class TYPE>
+void appendValue(std::string &s, const TYPE &x) {
+    appendBinary(s, x);
+}
+void appendValue(std::string &s, const std::string &x);
+void appendValue(std::string &s, const RNGobject &x);
+void appendValue(std::string &s, const welford &x);
+void appendValue(std::string &s, const welfordMatrix &x);
+void appendValue(std::string &s, const QmatrixMean &x);
+void appendValue(std::string &s, const profileObject &x);
+
+template<class TYPE>
+void appendValue(std::string &s, const std::vector<TYPE> &x) {
+    appendBinary(s, uint64_t(x.size()));
+    if (std::is_arithmetic<TYPE>::value) {
+        s.append(reinterpret_cast<const char*>(x.data()), x.size()*sizeof(TYPE));
+    } else {
+        for (size_t i=0; i<x.size(); i++) {
+            appendValue(s, x[i]);
+        }
+    }
+}
+
+//------------------------------------------------
+// read back a value written by appendValue()
+template<class TYPE>
+void readValue(binaryReader &r, TYPE &x) {
+    r.read(x);
+}
+void readValue(binaryReader &r, std::string &x);
+void readValue(binaryReader &r, RNGobject &x);
+void readValue(binaryReader &r, welford &x);
+void readValue(binaryReader &r, welfordMatrix &x);
+void readValue(binaryReader &r, QmatrixMean &x);
+void readValue(binaryReader &r, profileObject &x);
+
+template<class TYPE>
+void readValue(binaryReader &r, std::vector<TYPE> &x) {
+    uint64_t size = 0;
+    r.read(size);
+    if (!r.canRead(size, std::is_arithmetic<TYPE>::value ? sizeof(TYPE) : 1)) {
+        x.clear();
+        return;
+    }
+    x.resize(size_t(size));
+    if (std::is_arithmetic<TYPE>::value) {
+        memcpy(reinterpret_cast<char*>(x.data()), r.buffer.data()+r.pos, x.size()*sizeof(TYPE));
+        r.pos += x.size()*sizeof(TYPE);
+    } else {
+        for (size_t i=0; i<x.size(); i++) {
+            readValue(r, x[i]);
+        }
+    }
+}
+
+//------------------------------------------------
+// class holding the checkpoint of a single K. Chains running in parallel can all save their state to the same object.
+class checkpointObject {
+
+public:
+
+    // PUBLIC OBJECTS
+
+    int Kindex;
+    int K;
+    std::string filePath;
+
+    // checkpoints are only written if checkpointInterval is positive
+    bool write_on;
+
+    // last stage of the analysis to have completed
+    int stage;
+
+    // progress through the main MCMC. The first mainRepsSaved repeats have been completed and added to the accumulators of mainMCMC.cpp, which are held here in binary form. chainState holds the state of each chain at its last checkpoint (or is empty if there is none), indexed by chain. Chains are numbered by repeat within the main MCMC, and by rung number (the stream of random numbers used by the rung, see TI.cpp) within thermodynamic integration.
+    int mainRepsSaved;
+    std::string mainAccumulators;
+    std::vector<std::string> chainState;
+    
+    // progress through thermodynamic integration. TIrungs holds the results of each completed rung in binary form, indexed by rung number, and is empty for rungs that have not completed. When rungs are coupled by tempering, TItempering holds the position of the swap proposals at the last checkpoint, at which point the state of every rung was saved to chainState.
+    std::vector<std::string> TIrungs;
+    std::string TItempering;
+
+    std::mutex checkpoint_mutex;
+
+    // PUBLIC FUNCTIONS
+
+    // constructor
+    checkpointObject(globals &globals, int _Kindex);
+
+    // read in the checkpoint file of this K if resuming. Returns false if there is nothing to resume from.
+    bool load(globals &globals);
+
+    // save the state of a chain part way through the main MCMC or a rung of thermodynamic integration. The state is emptied.
+    void saveChain(globals &globals, int chain, std::string &state);
+
+    // save the accumulators of the main MCMC once repsSaved repeats are complete, along with the state of the chain that is carried over to the next repeat. Both strings are emptied.
+    void saveRepeat(globals &globals, int repsSaved, std::string &accumulators, int chain, std::string &state);
+
+    // save the results of a completed rung of thermodynamic integration. The state of the rung is no longer needed. The results are emptied.
+    void saveRung(globals &globals, int rung, std::string &results);
+    
+    // save the position of the swap proposals of a set of tempered rungs, along with the state of each rung (states[i] being the state of rung firstRung+i). All strings are emptied.
+    void saveTempering(globals &globals, std::string &tempering, int firstRung, std::vector<std::string> &states);
+    
+    // record that a stage of the analysis has completed
+    void completeStage(globals &globals, int _stage);
+
+private:
+
+    // PRIVATE FUNCTIONS
+
+    // pass the complete checkpoint to the background writer. Must be called with checkpoint_mutex held.
+    void write(globals &globals);
+
+};
+
+//------------------------------------------------
+// append all results of a single K (everything that is printed to file by outputK()) in binary form, or read them back. Also used to pass results between processes (see distributed.h).
+void appendResults(std::string &s, globals &globals, int Kindex);
+void readResults(binaryReader &r, globals &globals, int Kindex);
+
+//------------------------------------------------
+// path of the checkpoint file for a given K
+std::string checkpoint_filePath(globals &globals, int Kindex);
+
+//------------------------------------------------
+// when resuming a run whose seed was chosen at random, return the seed recorded in the first checkpoint file that can be found (or 0 if there are none)
+int checkpoint_seed(globals &globals);
+
+#endif
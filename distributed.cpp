@@ -0,0 +1,179 @@
+//
+//  MavericK
+//  distributed.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include <climits>
+#include <algorithm>
+
+#ifdef MAVERICK_MPI
+#include <mpi.h>
+#endif
+
+#include "distributed.h"
+#include "checkpoint.h"
+#include "readIn.h"
+
+using namespace std;
+
+// message tags. Free processes send TAG_RESULT to process 0, holding the results of the last K they analysed (if any), and receive the next Kindex to analyse (or -1 if there are none left) in TAG_WORK.
+#define TAG_RESULT 1
+#define TAG_WORK 2
+
+// largest number of bytes passed to a single MPI call. MPI counts are ints, so longer strings (for example the results of a large K, or a large dataset) are sent in several pieces of at most this size.
+#define MAX_CHUNK size_t(INT_MAX)
+
+//------------------------------------------------
+// start MPI
+void distributed_init(globals &globals) {
+#ifdef MAVERICK_MPI
+    MPI_Init(NULL, NULL);
+    MPI_Comm_rank(MPI_COMM_WORLD, &globals.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &globals.ranks);
+    if (globals.rank>0)
+        cout.rdbuf(NULL);
+#else
+    (void)globals;
+#endif
+}
+
+//------------------------------------------------
+// shut down MPI
+void distributed_finalise() {
+#ifdef MAVERICK_MPI
+    MPI_Finalize();
+#endif
+}
+
+//------------------------------------------------
+// copy a string from process 0 to all other processes
+void distributed_broadcast(string &s) {
+#ifdef MAVERICK_MPI
+    uint64_t size = s.size();
+    MPI_Bcast(&size, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    s.resize(size_t(size));
+    for (size_t pos=0; pos<s.size(); pos+=MAX_CHUNK) {
+        size_t chunk = min(MAX_CHUNK, s.size()-pos);
+        MPI_Bcast(&s[pos], int(chunk), MPI_CHAR, 0, MPI_COMM_WORLD);
+    }
+#else
+    (void)s;
+#endif
+}
+
+//------------------------------------------------
+// copy an integer from process 0 to all other processes
+void distributed_broadcast(int &x) {
+#ifdef MAVERICK_MPI
+    MPI_Bcast(&x, 1, MPI_INT, 0, MPI_COMM_WORLD);
+#else
+    (void)x;
+#endif
+}
+
+#ifdef MAVERICK_MPI
+
+//------------------------------------------------
+// send a string to process dest. The length is sent first, followed by the string itself in pieces of at most MAX_CHUNK bytes (messages between two processes with the same tag arrive in the order they were sent).
+static void sendString(const string &s, int dest, int tag) {
+    uint64_t size = s.size();
+    MPI_Send(&size, 1, MPI_UINT64_T, dest, tag, MPI_COMM_WORLD);
+    for (size_t pos=0; pos<s.size(); pos+=MAX_CHUNK) {
+        size_t chunk = min(MAX_CHUNK, s.size()-pos);
+        MPI_Send(const_cast<char*>(s.data()+pos), int(chunk), MPI_CHAR, dest, tag, MPI_COMM_WORLD);
+    }
+}
+
+//------------------------------------------------
+// receive a string sent by sendString from any process, returning the rank of the sender
+static int receiveString(string &s, int tag) {
+    MPI_Status status;
+    uint64_t size = 0;
+    MPI_Recv(&size, 1, MPI_UINT64_T, MPI_ANY_SOURCE, tag, MPI_COMM_WORLD, &status);
+    int source = status.MPI_SOURCE;
+    s.resize(size_t(size));
+    for (size_t pos=0; pos<s.size(); pos+=MAX_CHUNK) {
+        size_t chunk = min(MAX_CHUNK, s.size()-pos);
+        MPI_Recv(&s[pos], int(chunk), MPI_CHAR, source, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    return(source);
+}
+
+#endif
+
+//------------------------------------------------
+// analyse all values of K over all processes
+void distributed_runK(globals &globals, const function<void(int)> &analyse, const function<void(int)> &output) {
+#ifdef MAVERICK_MPI
+    int Kvalues = globals.Kmax-globals.Kmin+1;
+    
+    // process 0 hands out K (largest first) and collects results
+    if (globals.rank==0) {
+        int nextK = Kvalues-1;
+        int nextOutput = 0;
+        int working = globals.ranks-1;
+        vector<bool> Kcomplete(Kvalues, false);
+        string message;
+        while (working>0) {
+            
+            // receive results of the last K analysed by this process (if any)
+            int source = receiveString(message, TAG_RESULT);
+            binaryReader r(message);
+            int Kindex = -1;
+            r.read(Kindex);
+            if (Kindex>=0) {
+                readValue(r, globals.Kbuffer[Kindex]);
+                readResults(r, globals, Kindex);
+                if (r.failed || r.pos!=message.size()) {
+                    cerrAndLog("\nError: results of K="+to_string((long long)globals.Kmin+Kindex)+" received from process "+to_string((long long)source)+" are damaged\n", globals.outputLog_on, globals.outputLog_fileStream);
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+                Kcomplete[Kindex] = true;
+                while (nextOutput<Kvalues && Kcomplete[nextOutput]) {
+                    output(nextOutput);
+                    nextOutput++;
+                }
+            }
+            
+            // hand out the next K, or tell the process to stop
+            int work = nextK;
+            if (nextK>=0) {
+                nextK--;
+            } else {
+                working--;
+            }
+            MPI_Send(&work, 1, MPI_INT, source, TAG_WORK, MPI_COMM_WORLD);
+        }
+        return;
+    }
+    
+    // all other processes analyse whatever K they are given until there are none left
+    string message;
+    appendBinary(message, int(-1));
+    while (true) {
+        sendString(message, 0, TAG_RESULT);
+        int Kindex = -1;
+        MPI_Recv(&Kindex, 1, MPI_INT, 0, TAG_WORK, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (Kindex<0)
+            break;
+        
+        analyse(Kindex);
+        
+        message.clear();
+        appendBinary(message, Kindex);
+        appendValue(message, globals.Kbuffer[Kindex]);
+        appendResults(message, globals, Kindex);
+    }
+#else
+    (void)globals;
+    (void)analyse;
+    (void)output;
+#endif
+}
@@ -0,0 +1,35 @@
+//
+//  MavericK
+//  distributed.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines functions for spreading the analysis over several processes (for example over the nodes of a cluster) using MPI. MPI support is only compiled in when MAVERICK_MPI is defined (see the "mpi" target of the Makefile), and otherwise these functions do nothing and the program runs as a single process. Process 0 reads the data and passes it to all other processes, then hands out values of K one at a time to whichever process is free, largest K first. Each K is analysed from start to finish by a single process (using as many threads as the "threads" parameter allows), and its results are sent back to process 0, which writes all output. As every K draws on its own random number streams, the results are the same as for a single process run with the same seed.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__distributed__
+#define __Maverick1_0__distributed__
+
+#include <string>
+#include <functional>
+#include "globals.h"
+
+//------------------------------------------------
+// start MPI and record the rank of this process and the number of processes in the globals object. Console output is switched off for all processes other than process 0.
+void distributed_init(globals &globals);
+
+//------------------------------------------------
+// shut down MPI
+void distributed_finalise();
+
+//------------------------------------------------
+// copy a value from process 0 to all other processes
+void distributed_broadcast(std::string &s);
+void distributed_broadcast(int &x);
+
+//------------------------------------------------
+// analyse all values of K over all processes. On process 0, output(Kindex) is called for each K in order as soon as the results of that K (and of all smaller K) have been received. On all other processes analyse(Kindex) is called for each K handed out, and the results are sent back.
+void distributed_runK(globals &globals, const std::function<void(int)> &analyse, const std::function<void(int)> &output);
+
+#endif
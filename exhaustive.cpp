@@ -14,226 +14,350 @@
 
 using namespace std;
 
+//------------------------------------------------
+// log of the predictive probability of a single allele, given that it has been observed a times in a deme in which a_t gene copies at locus l have been observed in total
+inline double exhaustive_logPredictive(globals &globals, int a, int a_t, int l) {
+    return(globals.lookup->logColumn(1)[a]-globals.lookup->logColumn(globals.J[l])[a_t]);
+}
+
+//------------------------------------------------
+// list all prefixes of restricted growth strings with maximum value K (coded 0:K-1) that are needed to split the enumeration of strings of length N into roughly minTasks independent tasks. All prefixes returned have the same length.
+vector< vector<int> > restrictedGrowth_prefixes(int N, int K, int minTasks) {
+    
+    // the first element of a restricted growth string is always 0. Extend all prefixes by one element at a time until there are enough of them. When K==1 there is only ever a single prefix, so there is nothing to be gained by extending it.
+    vector< vector<int> > prefixes(1, vector<int>(1,0));
+    vector<int> prefixMax(1,0);
+    int length = 1;
+    while (int(prefixes.size())<minTasks && length<N && K>1) {
+        vector< vector<int> > newPrefixes;
+        vector<int> newPrefixMax;
+        for (int i=0; i<int(prefixes.size()); i++) {
+            for (int k=0; k<=min(K-1, prefixMax[i]+1); k++) {
+                newPrefixes.push_back(prefixes[i]);
+                newPrefixes.back().push_back(k);
+                newPrefixMax.push_back(max(prefixMax[i], k));
+            }
+        }
+        prefixes = newPrefixes;
+        prefixMax = newPrefixMax;
+        length++;
+    }
+    
+    return(prefixes);
+}
+
 //------------------------------------------------
 // exhaustive analysis under no-admixture model
 void exhaustive_noAdmix(globals &globals, int Kindex) {
     int K = globals.Kmin+Kindex;
     
-    // initialise group
-    vector<int> group(globals.n,1);
-    vector<int> newGroup = group;
+    // split partitions into tasks by prefix. Prefixes that already use more demes have more completions, so these are handed out first
+    vector< vector<int> > prefixes = restrictedGrowth_prefixes(globals.n, K, 256);
+    int tasks = int(prefixes.size());
+    vector<int> taskOrder(tasks);
+    for (int i=0; i<tasks; i++) {
+        taskOrder[i] = i;
+    }
+    stable_sort(taskOrder.begin(), taskOrder.end(), [&](int a, int b) {
+        return(*max_element(prefixes[a].begin(), prefixes[a].end()) > *max_element(prefixes[b].begin(), prefixes[b].end()));
+    });
     
-    // initialise alleleCounts array
-    vector< vector< vector<int> > > alleleCounts(K);
-    vector< vector<int> > alleleCountsTotals(K);
-    for (int k=0; k<K; k++) {
-        alleleCounts[k] = vector< vector<int> >(globals.loci);
-        alleleCountsTotals[k] = vector<int>(globals.loci);
-        for (int l=0; l<globals.loci; l++) {
-            alleleCounts[k][l] = vector<int>(globals.J[l]);
-        }
+    vector<logSumExp> results(tasks);
+    parallelFor(taskOrder, [&](int task) {
+        results[task] = exhaustive_noAdmix_prefix(globals, K, prefixes[task]);
+    });
+    
+    // combine results in a fixed order, so the answer does not depend on the number of threads
+    logSumExp total;
+    for (int i=0; i<tasks; i++) {
+        total.merge(results[i]);
     }
     
-    // populate alleleCounts array and calculate starting likelihood
-    double logLike=0;
-    for (int ind=0; ind<globals.n; ind++) {
-        for (int l=0; l<globals.loci; l++) {
+    globals.logEvidence_exhaustive[Kindex] = total.value();
+    
+}
+
+//------------------------------------------------
+// sum of likelihoods over all partitions of individuals that begin with the given prefix, under no-admixture model
+logSumExp exhaustive_noAdmix_prefix(globals &globals, int K, const vector<int> &prefix) {
+    
+    int n = globals.n;
+    int loci = globals.loci;
+    int prefixLength = int(prefix.size());
+    
+    // allele counts, using the same flat layout as the MCMC objects
+    vector<int> alleleCounts((globals.J_offset[loci-1]+globals.J[loci-1])*K);
+    vector<int> alleleCountsTotals(loci*K);
+    
+    // add or subtract individual ind in deme k, returning the change in log-likelihood
+    auto addInd = [&](int ind, int k) {
+        double delta = 0;
+        for (int l=0; l<loci; l++) {
+            for (int p=0; p<globals.ploidy_vec[ind]; p++) {
+                int thisData = (*globals.data)[globals.data_indStart[ind] + l*globals.ploidy_vec[ind] + p];
+                if (thisData!=0) {
+                    int &a = alleleCounts[(globals.J_offset[l]+thisData-1)*K+k];
+                    int &a_t = alleleCountsTotals[l*K+k];
+                    delta += exhaustive_logPredictive(globals, a, a_t, l);
+                    a++;
+                    a_t++;
+                }
+            }
+        }
+        return(delta);
+    };
+    auto subtractInd = [&](int ind, int k) {
+        for (int l=0; l<loci; l++) {
             for (int p=0; p<globals.ploidy_vec[ind]; p++) {
-                if (globals.data[ind][l][p]!=0) {
-                    logLike += log(alleleCounts[group[ind]-1][l][globals.data[ind][l][p]-1] + globals.lambda) - log(alleleCountsTotals[group[ind]-1][l] + globals.J[l]*globals.lambda);
-                    alleleCounts[group[ind]-1][l][globals.data[ind][l][p]-1]++;
-                    alleleCountsTotals[group[ind]-1][l]++;
+                int thisData = (*globals.data)[globals.data_indStart[ind] + l*globals.ploidy_vec[ind] + p];
+                if (thisData!=0) {
+                    alleleCounts[(globals.J_offset[l]+thisData-1)*K+k]--;
+                    alleleCountsTotals[l*K+k]--;
                 }
             }
         }
+    };
+    
+    // logLike[d] is the log-likelihood of the first d individuals, and groupMax[d] is the largest deme they occupy. These are stored for every depth of the search, so that moving back up the tree never requires anything to be recalculated.
+    vector<double> logLike(n+1);
+    vector<int> groupMax(n+1,-1);
+    vector<int> group(n,-1);
+    for (int d=0; d<prefixLength; d++) {
+        group[d] = prefix[d];
+        logLike[d+1] = logLike[d] + addInd(d, group[d]);
+        groupMax[d+1] = max(groupMax[d], group[d]);
     }
-    double combined_logLike = logLike -globals.n*log(double(K));
-    combined_logLike += log(double(K));
     
-    // loop through all possible groupings
-    int uniques = 0;  // number of unique elements in group. Forms part of combinatorial constant needed to calculate correct likelihood when only searching over unique partitions (see Notes.c for details)
-    double logLike_total = combined_logLike;
-    while (group[0]!=0) {
-        
-        increment_restrictedGrowth(newGroup,K);
-        if (newGroup[0]==0)
-            break;
+    // combinatorial constant needed to calculate correct likelihood when only searching over unique partitions (see Notes.c for details), by number of unique demes. The prior on the grouping is also included here.
+    vector<double> logConstant(K+1);
+    for (int uniques=1; uniques<=K; uniques++) {
+        logConstant[uniques] = lgamma(double(K)+1)-lgamma(double(K)-double(uniques)+1) - n*log(double(K));
+    }
+    
+    // depth-first search over all completions of the prefix
+    logSumExp output;
+    int depth = prefixLength;
+    while (true) {
         
-        // loop through all individuals
-        for (int ind=0; ind<globals.n; ind++) {
-            
-            // if group allocation for this individual has changed
-            if (newGroup[ind]!=group[ind]) {
-                
-                // subtract old group from allele counts and likelihood
-                for (int l=0; l<globals.loci; l++) {
-                    for (int p=0; p<globals.ploidy_vec[ind]; p++) {
-                        if (globals.data[ind][l][p]!=0) {
-                            alleleCountsTotals[group[ind]-1][l]--;
-                            alleleCounts[group[ind]-1][l][globals.data[ind][l][p]-1]--;
-                            logLike -= log(alleleCounts[group[ind]-1][l][globals.data[ind][l][p]-1] + globals.lambda) - log(alleleCountsTotals[group[ind]-1][l] + globals.J[l]*globals.lambda);
-                        }
-                    }
-                }
-                
-                // add new group to allele counts and likelihood
-                for (int l=0; l<globals.loci; l++) {
-                    for (int p=0; p<globals.ploidy_vec[ind]; p++) {
-                        if (globals.data[ind][l][p]!=0) {
-                            logLike += log(alleleCounts[newGroup[ind]-1][l][globals.data[ind][l][p]-1] + globals.lambda) - log(alleleCountsTotals[newGroup[ind]-1][l] + globals.J[l]*globals.lambda);
-                            alleleCounts[newGroup[ind]-1][l][globals.data[ind][l][p]-1]++;
-                            alleleCountsTotals[newGroup[ind]-1][l]++;
-                        }
-                    }
-                }
-                
+        // complete partition
+        if (depth==n) {
+            output.add(logLike[n] + logConstant[groupMax[n]+1]);
+            depth--;
+            if (depth<prefixLength) {
+                break;
             }
+            continue;
         }
         
-        // update group
-        group = newGroup;
-        
-        // some combinatorics to account for searching unique partitions only (see Notes.c for details)
-        combined_logLike = logLike -globals.n*log(double(K));
-        uniques = *max_element(begin(group),end(group));
-        combined_logLike += lgamma(double(K)+1)-lgamma(double(K)-double(uniques)+1);
-        
-        // add to running sum
-        logLike_total = logSum(logLike_total, combined_logLike);
-    
+        // move individual at this depth to the next deme, or move back up the tree if all demes have been tried
+        if (group[depth]>=0) {
+            subtractInd(depth, group[depth]);
+        }
+        group[depth]++;
+        if (group[depth]>min(K-1, groupMax[depth]+1)) {
+            group[depth] = -1;
+            depth--;
+            if (depth<prefixLength) {
+                break;
+            }
+            continue;
+        }
+        logLike[depth+1] = logLike[depth] + addInd(depth, group[depth]);
+        groupMax[depth+1] = max(groupMax[depth], group[depth]);
+        depth++;
     }
     
-    globals.logEvidence_exhaustive[Kindex] = logLike_total;
-    
+    return(output);
 }
 
 //------------------------------------------------
 // exhaustive analysis under admixture model (alpha fixed or variable)
 void exhaustive_admix(globals &globals, int Kindex) {
+    int K = globals.Kmin+Kindex;
     
-    // alpha fixed
+    // if alpha is variable then integrate over a uniform grid of values by brute force. All values are evaluated together in a single pass over partitions.
+    vector<double> alphaVec;
     if (globals.fixAlpha_on) {
-        
-        globals.logEvidence_exhaustive[Kindex] = exhaustive_admix_fixedAlpha(globals, Kindex, globals.alpha[Kindex]);
-        
-    // alpha variable (integrate over alpha by brute force)
+        alphaVec.push_back(globals.alpha[Kindex]);
     } else {
-        
-        double logEvidence_total = log(double(0));
         for (int i=0; i<100; i++) {
-            double alpha = (i+1)/10.0;
-            logEvidence_total = logSum(logEvidence_total, exhaustive_admix_fixedAlpha(globals, Kindex, alpha));
+            alphaVec.push_back((i+1)/10.0);
+        }
+    }
+    int alphaNum = int(alphaVec.size());
+    
+    // split partitions into tasks by prefix
+    vector< vector<int> > prefixes = restrictedGrowth_prefixes(globals.geneCopies, K, 256);
+    int tasks = int(prefixes.size());
+    vector<int> taskOrder(tasks);
+    for (int i=0; i<tasks; i++) {
+        taskOrder[i] = i;
+    }
+    stable_sort(taskOrder.begin(), taskOrder.end(), [&](int a, int b) {
+        return(*max_element(prefixes[a].begin(), prefixes[a].end()) > *max_element(prefixes[b].begin(), prefixes[b].end()));
+    });
+    
+    vector< vector<logSumExp> > results(tasks);
+    parallelFor(taskOrder, [&](int task) {
+        results[task] = exhaustive_admix_prefix(globals, K, alphaVec, prefixes[task]);
+    });
+    
+    // combine results in a fixed order, so the answer does not depend on the number of threads
+    vector<logSumExp> total(alphaNum);
+    for (int i=0; i<tasks; i++) {
+        for (int a=0; a<alphaNum; a++) {
+            total[a].merge(results[i][a]);
         }
-        logEvidence_total -= log(100.0);
-        globals.logEvidence_exhaustive[Kindex] = logEvidence_total;
-        
     }
     
+    double logEvidence_total = log(double(0));
+    for (int a=0; a<alphaNum; a++) {
+        logEvidence_total = logSum(logEvidence_total, total[a].value());
+    }
+    logEvidence_total -= log(double(alphaNum));
+    globals.logEvidence_exhaustive[Kindex] = logEvidence_total;
+    
 }
 
 //------------------------------------------------
-// exhaustive analysis under admixture model for given alpha
-double exhaustive_admix_fixedAlpha(globals &globals, int Kindex, double alpha) {
-    int K = globals.Kmin+Kindex;
+// sum of likelihoods over all partitions of gene copies that begin with the given prefix, under admixture model. The allele counts part of the likelihood does not depend on alpha, and so a single pass over partitions is used to obtain the result for every value of alpha in alphaVec.
+vector<logSumExp> exhaustive_admix_prefix(globals &globals, int K, const vector<double> &alphaVec, const vector<int> &prefix) {
     
-    // initialise group
-    int geneCopies = sum(globals.ploidy_vec)*globals.loci;
-    vector<int> group(geneCopies,1);
-    vector<int> newGroup = group;
+    int n = globals.n;
+    int loci = globals.loci;
+    int geneCopies = globals.geneCopies;
+    int alphaNum = int(alphaVec.size());
+    int prefixLength = int(prefix.size());
     
-    // initialise alleleCounts array
-    vector< vector< vector<int> > > alleleCounts(K);
-    vector< vector<int> > alleleCountsTotals(K);
-    for (int k=0; k<K; k++) {
-        alleleCounts[k] = vector< vector<int> >(globals.loci);
-        alleleCountsTotals[k] = vector<int>(globals.loci);
-        for (int l=0; l<globals.loci; l++) {
-            alleleCounts[k][l] = vector<int>(globals.J[l]);
+    // individual and locus of each gene copy (gene copies are in the same order as the data). lastCopy[i] is true if gene copy i is the last one belonging to its individual.
+    vector<int> copyInd(geneCopies);
+    vector<int> copyLocus(geneCopies);
+    vector<bool> lastCopy(geneCopies,false);
+    int maxCopies = 0;
+    for (int ind=0; ind<n; ind++) {
+        for (int l=0; l<loci; l++) {
+            for (int p=0; p<globals.ploidy_vec[ind]; p++) {
+                copyInd[globals.data_indStart[ind] + l*globals.ploidy_vec[ind] + p] = ind;
+                copyLocus[globals.data_indStart[ind] + l*globals.ploidy_vec[ind] + p] = l;
+            }
         }
+        lastCopy[globals.data_indStart[ind] + loci*globals.ploidy_vec[ind] - 1] = true;
+        maxCopies = max(maxCopies, loci*globals.ploidy_vec[ind]);
     }
     
-    // initialise admixCounts array
-    vector< vector<int> > admixCounts(globals.n, vector<int>(K));
-    vector<int> admixCountsTotals(globals.n);
+    // the admix part of the likelihood of individual ind is sum_k(lgamma(c_k+alpha)-lgamma(alpha)) - (lgamma(c_t+K*alpha)-lgamma(K*alpha)), where c_k is its admix count in deme k and c_t is its total admix count. Both terms are tabulated against counts for every value of alpha.
+    vector<double> lgammaAdmix((maxCopies+1)*alphaNum);
+    vector<double> lgammaAdmixTotal((maxCopies+1)*alphaNum);
+    for (int c=0; c<=maxCopies; c++) {
+        for (int a=0; a<alphaNum; a++) {
+            lgammaAdmix[c*alphaNum+a] = lgamma(c+alphaVec[a]) - lgamma(alphaVec[a]);
+            lgammaAdmixTotal[c*alphaNum+a] = lgamma(c+K*alphaVec[a]) - lgamma(K*alphaVec[a]);
+        }
+    }
     
-    // populate alleleCounts and admixCounts arrays and calculate starting likelihood
-    double logLike=0;
-    int linearIndex=-1;
-    for (int ind=0; ind<globals.n; ind++) {
-        for (int l=0; l<globals.loci; l++) {
-            for (int p=0; p<globals.ploidy_vec[ind]; p++) {
-                linearIndex++;
-                if (globals.data[ind][l][p]!=0) {
-                    logLike += log(alleleCounts[group[linearIndex]-1][l][globals.data[ind][l][p]-1] + globals.lambda) - log(alleleCountsTotals[group[linearIndex]-1][l] + globals.J[l]*globals.lambda);
-                    alleleCounts[group[linearIndex]-1][l][globals.data[ind][l][p]-1]++;
-                    alleleCountsTotals[group[linearIndex]-1][l]++;
-                    
-                    logLike += log(admixCounts[ind][group[linearIndex]-1] + alpha) - log(admixCountsTotals[ind] + K*alpha);
-                    admixCounts[ind][group[linearIndex]-1]++;
-                    admixCountsTotals[ind]++;
-                }
+    // allele and admix counts, using the same flat layout as the MCMC objects
+    vector<int> alleleCounts((globals.J_offset[loci-1]+globals.J[loci-1])*K);
+    vector<int> alleleCountsTotals(loci*K);
+    vector<int> admixCounts(n*K);
+    vector<int> admixCountsTotals(n);
+    
+    // add or subtract gene copy i in deme k, returning the change in the allele counts part of the log-likelihood. Missing data contributes nothing.
+    auto addCopy = [&](int i, int k) {
+        int thisData = (*globals.data)[i];
+        if (thisData==0) {
+            return(0.0);
+        }
+        int l = copyLocus[i];
+        int &a = alleleCounts[(globals.J_offset[l]+thisData-1)*K+k];
+        int &a_t = alleleCountsTotals[l*K+k];
+        double delta = exhaustive_logPredictive(globals, a, a_t, l);
+        a++;
+        a_t++;
+        admixCounts[copyInd[i]*K+k]++;
+        admixCountsTotals[copyInd[i]]++;
+        return(delta);
+    };
+    auto subtractCopy = [&](int i, int k) {
+        int thisData = (*globals.data)[i];
+        if (thisData==0) {
+            return;
+        }
+        int l = copyLocus[i];
+        alleleCounts[(globals.J_offset[l]+thisData-1)*K+k]--;
+        alleleCountsTotals[l*K+k]--;
+        admixCounts[copyInd[i]*K+k]--;
+        admixCountsTotals[copyInd[i]]--;
+    };
+    
+    // logLikeAdmix[ind*alphaNum+a] is the admix part of the log-likelihood of the first ind individuals for the a-th value of alpha. This is only calculated once all gene copies of an individual have been allocated.
+    vector<double> logLikeAdmix((n+1)*alphaNum);
+    auto finishInd = [&](int ind) {
+        for (int a=0; a<alphaNum; a++) {
+            double x = logLikeAdmix[ind*alphaNum+a] - lgammaAdmixTotal[admixCountsTotals[ind]*alphaNum+a];
+            for (int k=0; k<K; k++) {
+                x += lgammaAdmix[admixCounts[ind*K+k]*alphaNum+a];
             }
+            logLikeAdmix[(ind+1)*alphaNum+a] = x;
+        }
+    };
+    
+    // logLike[d] is the allele counts part of the log-likelihood of the first d gene copies, and groupMax[d] is the largest deme they occupy
+    vector<double> logLike(geneCopies+1);
+    vector<int> groupMax(geneCopies+1,-1);
+    vector<int> group(geneCopies,-1);
+    for (int d=0; d<prefixLength; d++) {
+        group[d] = prefix[d];
+        logLike[d+1] = logLike[d] + addCopy(d, group[d]);
+        groupMax[d+1] = max(groupMax[d], group[d]);
+        if (lastCopy[d]) {
+            finishInd(copyInd[d]);
         }
     }
-    double combined_logLike = logLike + log(double(K));
     
-    // loop through all possible groupings
-    int uniques = 0;  // number of unique elements in group. Forms part of combinatorial constant needed to calculate correct likelihood when only searching over unique partitions (see Notes.c for details)
-    double logLike_total = combined_logLike;
-    while (group[0]!=0) {
-        
-        increment_restrictedGrowth(newGroup,K);
-        if (newGroup[0]==0)
-            break;
-        
-        // loop through all gene copies
-        linearIndex=-1;
-        for (int ind=0; ind<globals.n; ind++) {
-            for (int l=0; l<globals.loci; l++) {
-                for (int p=0; p<globals.ploidy_vec[ind]; p++) {
-                    linearIndex++;
-                    
-                    // if group allocation for this gene copy has changed
-                    if (newGroup[linearIndex]!=group[linearIndex]) {
-                        
-                        // subtract old group from allele counts, admix counts and likelihood
-                        if (globals.data[ind][l][p]!=0) {
-                            alleleCountsTotals[group[linearIndex]-1][l]--;
-                            alleleCounts[group[linearIndex]-1][l][globals.data[ind][l][p]-1]--;
-                            logLike -= log(alleleCounts[group[linearIndex]-1][l][globals.data[ind][l][p]-1] + globals.lambda) - log(alleleCountsTotals[group[linearIndex]-1][l] + globals.J[l]*globals.lambda);
-                            
-                            admixCountsTotals[ind]--;
-                            admixCounts[ind][group[linearIndex]-1]--;
-                            logLike -= log(admixCounts[ind][group[linearIndex]-1] + alpha) - log(admixCountsTotals[ind] + K*alpha);
-                        }
-                        
-                        // add new group to allele counts, admix counts and likelihood
-                        if (globals.data[ind][l][p]!=0) {
-                            logLike += log(alleleCounts[newGroup[linearIndex]-1][l][globals.data[ind][l][p]-1] + globals.lambda) - log(alleleCountsTotals[newGroup[linearIndex]-1][l] + globals.J[l]*globals.lambda);
-                            alleleCounts[newGroup[linearIndex]-1][l][globals.data[ind][l][p]-1]++;
-                            alleleCountsTotals[newGroup[linearIndex]-1][l]++;
-                            
-                            logLike += log(admixCounts[ind][newGroup[linearIndex]-1] + alpha) - log(admixCountsTotals[ind] + K*alpha);
-                            admixCounts[ind][newGroup[linearIndex]-1]++;
-                            admixCountsTotals[ind]++;
-                        }
-                        
-                    }
-                    
-                } // p
-            } // l
-        } // ind
-        
-        // update group
-        group = newGroup;
+    // combinatorial constant needed to calculate correct likelihood when only searching over unique partitions (see Notes.c for details)
+    vector<double> logConstant(K+1);
+    for (int uniques=1; uniques<=K; uniques++) {
+        logConstant[uniques] = lgamma(double(K)+1)-lgamma(double(K)-double(uniques)+1);
+    }
+    
+    // depth-first search over all completions of the prefix
+    vector<logSumExp> output(alphaNum);
+    int depth = prefixLength;
+    while (true) {
         
-        // some combinatorics to account for searching unique partitions only (see Notes.c for details)
-        uniques = *max_element(begin(group),end(group));
-        combined_logLike = logLike + lgamma(double(K)+1)-lgamma(double(K)-double(uniques)+1);
+        // complete partition
+        if (depth==geneCopies) {
+            double x = logLike[geneCopies] + logConstant[groupMax[geneCopies]+1];
+            for (int a=0; a<alphaNum; a++) {
+                output[a].add(x + logLikeAdmix[n*alphaNum+a]);
+            }
+            depth--;
+            if (depth<prefixLength) {
+                break;
+            }
+            continue;
+        }
         
-        // add to running sum
-        logLike_total = logSum(logLike_total, combined_logLike);
+        // move gene copy at this depth to the next deme, or move back up the tree if all demes have been tried
+        if (group[depth]>=0) {
+            subtractCopy(depth, group[depth]);
+        }
+        group[depth]++;
+        if (group[depth]>min(K-1, groupMax[depth]+1)) {
+            group[depth] = -1;
+            depth--;
+            if (depth<prefixLength) {
+                break;
+            }
+            continue;
+        }
+        logLike[depth+1] = logLike[depth] + addCopy(depth, group[depth]);
+        groupMax[depth+1] = max(groupMax[depth], group[depth]);
+        if (lastCopy[depth]) {
+            finishInd(copyInd[depth]);
+        }
+        depth++;
     }
     
-    return(logLike_total);
-}
\ No newline at end of file
+    return(output);
+}
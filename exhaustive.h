@@ -6,7 +6,7 @@
 //
 //  Distributed under the MIT software licence - see Notes.c file for details
 //
-//  These functions search all possible partitions of the data to compute the exact model evidence. This is only possible for extremely small data sets, on the order of n=10 individuals under the without-admixture model, or even fewer under the admixture model.
+//  These functions search all possible partitions of the data to compute the exact model evidence. This is only possible for extremely small data sets, on the order of n=10 individuals under the without-admixture model, or even fewer under the admixture model. Partitions are visited depth-first, so that the likelihood of every shared prefix is only calculated once, and the space of partitions is split by prefix into independent tasks that are spread over threads.
 //
 // ---------------------------------------------------------------------------
 
@@ -14,19 +14,67 @@
 #define __Maverick1_0__exhaustive__
 
 #include <iostream>
+#include <cmath>
 #include "globals.h"
 #include "misc.h"
+#include "parallel.h"
+
+//------------------------------------------------
+// running value of log(sum(exp(x))) over a series of values x. The sum is held as exp(logMax)*sum, so each new value costs a single call to exp() rather than the exp() and log() of logSum().
+class logSumExp {
+    
+public:
+    
+    double logMax;
+    double sum;
+    
+    logSumExp() : logMax(-INFINITY), sum(0) {}
+    
+    void add(double x) {
+        if (x==-INFINITY) {
+            return;
+        }
+        if (x<=logMax) {
+            sum += exp(x-logMax);
+        } else {
+            sum = sum*exp(logMax-x) + 1;
+            logMax = x;
+        }
+    }
+    void merge(const logSumExp &other) {
+        if (other.sum==0) {
+            return;
+        }
+        if (other.logMax<=logMax) {
+            sum += other.sum*exp(other.logMax-logMax);
+        } else {
+            sum = sum*exp(logMax-other.logMax) + other.sum;
+            logMax = other.logMax;
+        }
+    }
+    double value() const {
+        return(logMax + log(sum));
+    }
+};
+
+//------------------------------------------------
+// list all prefixes of restricted growth strings with maximum value K (coded 0:K-1) that are needed to split the enumeration of strings of length N into roughly minTasks independent tasks. All prefixes returned have the same length.
+std::vector< std::vector<int> > restrictedGrowth_prefixes(int N, int K, int minTasks);
 
 //------------------------------------------------
 // exhaustive analysis under no-admixture model
 void exhaustive_noAdmix(globals &globals, int Kindex);
 
+//------------------------------------------------
+// sum of likelihoods over all partitions of individuals that begin with the given prefix, under no-admixture model
+logSumExp exhaustive_noAdmix_prefix(globals &globals, int K, const std::vector<int> &prefix);
+
 //------------------------------------------------
 // exhaustive analysis under admixture model (alpha fixed or variable)
 void exhaustive_admix(globals &globals, int Kindex);
 
 //------------------------------------------------
-// exhaustive analysis under admixture model for given alpha
-double exhaustive_admix_fixedAlpha(globals &globals, int Kindex, double alpha);
+// sum of likelihoods over all partitions of gene copies that begin with the given prefix, under admixture model. The allele counts part of the likelihood does not depend on alpha, and so a single pass over partitions is used to obtain the result for every value of alpha in alphaVec.
+std::vector<logSumExp> exhaustive_admix_prefix(globals &globals, int K, const std::vector<double> &alphaVec, const std::vector<int> &prefix);
 
 #endif
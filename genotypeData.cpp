@@ -0,0 +1,46 @@
+//
+//  MavericK
+//  genotypeData.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include "genotypeData.h"
+
+using namespace std;
+
+//------------------------------------------------
+// genotypeData::
+// constructor for genotypeData class
+genotypeData::genotypeData() {
+    packed = false;
+    length = 0;
+}
+
+//------------------------------------------------
+// genotypeData::
+// pack the data into 2-bit codes
+bool genotypeData::pack() {
+    
+    if (packed)
+        return(true);
+    for (size_t g=0; g<values.size(); g++) {
+        if (values[g]>3)
+            return(false);
+    }
+    
+    length = values.size();
+    codes = vector<uint8_t>((length+3)/4);
+    for (size_t g=0; g<length; g++) {
+        codes[g>>2] |= uint8_t(values[g] << ((g&3)<<1));
+    }
+    
+    // free the unpacked values
+    vector<uint16_t>().swap(values);
+    packed = true;
+    
+    return(true);
+}
@@ -0,0 +1,65 @@
+//
+//  MavericK
+//  genotypeData.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines a class holding the genotype data as a single array indexed by gene copy. Alleles are normally stored as 16-bit values, but when every locus has at most two alleles (as in SNP data) the array can be packed down to 2 bits per gene copy, with code 0 marking missing data. This cuts the memory taken up by the data by a factor of eight, which for large SNP panels is most of the memory used by the program.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__genotypeData__
+#define __Maverick1_0__genotypeData__
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+//------------------------------------------------
+// class containing genotype data, either as 16-bit values or packed into 2-bit codes
+class genotypeData {
+    
+public:
+    
+    // PUBLIC OBJECTS
+    
+    // values holds the data until pack() is called, after which it is emptied and the data are held in codes instead, four gene copies to a byte (gene copy g in bits 2*(g%4) and 2*(g%4)+1 of byte g/4)
+    bool packed;
+    std::vector<uint16_t> values;
+    std::vector<uint8_t> codes;
+    size_t length;
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor
+    genotypeData();
+    
+    // number of gene copies
+    size_t size() const {
+        return(packed ? length : values.size());
+    }
+    
+    // allele carried by gene copy g (coded 1:J[l], with 0 meaning missing data). Checks the representation on every call, so is only used outside the MCMC kernels.
+    int operator[](size_t g) const {
+        if (packed)
+            return((codes[g>>2] >> ((g&3)<<1)) & 3);
+        return(values[g]);
+    }
+    
+    // allele carried by gene copy g of packed data
+    int code(size_t g) const {
+        return((codes[g>>2] >> ((g&3)<<1)) & 3);
+    }
+    
+    // allele carried by gene copy g, with the representation fixed at compile time. The MCMC kernels take PACKED as a template argument, chosen once from packed, so that unpacked data never pay for the check.
+    template<bool PACKED>
+    int get(size_t g) const {
+        return(PACKED ? code(g) : int(values[g]));
+    }
+    
+    // pack the data into 2-bit codes. Returns false (leaving the data unchanged) if any value is too large to be packed.
+    bool pack();
+    
+};
+
+#endif
@@ -44,6 +44,7 @@ globals::globals() {
     outputEvanno_fileName = "outputEvanno.csv";
     outputMaxLike_alleleFreqs_fileName = "outputMaxLike_alleleFreqs.csv";
     outputMaxLike_admixFreqs_fileName = "outputMaxLike_admixFreqs.csv";
+    outputProfile_fileName = "outputProfile.csv";
     
     inputRoot_filePath = masterRoot_filePath + inputRoot_fileName;
     outputRoot_filePath = masterRoot_filePath + outputRoot_fileName;
@@ -64,6 +65,7 @@ globals::globals() {
     outputEvanno_filePath = outputRoot_filePath + outputEvanno_fileName;
     outputMaxLike_alleleFreqs_filePath = outputRoot_filePath + outputMaxLike_alleleFreqs_fileName;
     outputMaxLike_admixFreqs_filePath = outputRoot_filePath + outputMaxLike_admixFreqs_fileName;
+    outputProfile_filePath = outputRoot_filePath + outputProfile_fileName;
     outputPosteriorGrouping_filePath = outputRoot_filePath + outputPosteriorGrouping_fileName;
 
     // define all default parameter values as pair<string,int> objects, as well as in final class-specific form
@@ -72,33 +74,45 @@ globals::globals() {
     parameterStrings["ploidyCol_on"] = pair<string,int>("false",0); ploidyCol_on = false;
     parameterStrings["ploidy"] = pair<string,int>("2",0); ploidy = 2;
     parameterStrings["missingData"] = pair<string,int>("-9",0); missingData = "-9";
+    parameterStrings["dataCache_on"] = pair<string,int>("false",0); dataCache_on = false;
     
     parameterStrings["Kmin"] = pair<string,int>("1",0); Kmin = 1;
     parameterStrings["Kmax"] = pair<string,int>("2",0); Kmax = 2;
     parameterStrings["admix_on"] = pair<string,int>("false",0); admix_on = false;
     parameterStrings["fixAlpha_on"] = pair<string,int>("true",0); fixAlpha_on = true;
     parameterStrings["alpha"] = pair<string,int>("1.0",0); alpha = vector<double>(1,1.0);
-    parameterStrings["alphaPropSD"] = pair<string,int>("0.1",0); vector<double> alphaPropSD(1,0.1);
+    parameterStrings["alphaPropSD"] = pair<string,int>("0.1",0); alphaPropSD = vector<double>(1,0.1);
+    parameterStrings["alphaUpdates"] = pair<string,int>("1",0); alphaUpdates = 1;
+    parameterStrings["alphaAdapt_on"] = pair<string,int>("false",0); alphaAdapt_on = false;
     
     parameterStrings["exhaustive_on"] = pair<string,int>("false",0); exhaustive_on = false;
     parameterStrings["mainRepeats"] = pair<string,int>("1",0); mainRepeats = 1;
     parameterStrings["mainBurnin"] = pair<string,int>("100",0); mainBurnin = 100;
     parameterStrings["mainSamples"] = pair<string,int>("1000",0); mainSamples = 1000;
     parameterStrings["mainThinning"] = pair<string,int>("1",0); mainThinning = 1;
+    parameterStrings["mainAdaptiveBurnin_on"] = pair<string,int>("false",0); mainAdaptiveBurnin_on = false;
+    parameterStrings["mainTargetSE"] = pair<string,int>("0",0); mainTargetSE = 0;
+    parameterStrings["mainCheckInterval"] = pair<string,int>("100",0); mainCheckInterval = 100;
     parameterStrings["thermodynamic_on"] = pair<string,int>("true",0); thermodynamic_on = true;
     parameterStrings["thermodynamicRungs"] = pair<string,int>("21",0); thermodynamicRungs = 21;
     parameterStrings["thermodynamicBurnin"] = pair<string,int>("100",0); thermodynamicBurnin = 100;
     parameterStrings["thermodynamicSamples"] = pair<string,int>("1000",0); thermodynamicSamples = 1000;
     parameterStrings["thermodynamicThinning"] = pair<string,int>("1",0); thermodynamicThinning = 1;
+    parameterStrings["thermodynamicTempering_on"] = pair<string,int>("false",0); thermodynamicTempering_on = false;
+    parameterStrings["thermodynamicSwapInterval"] = pair<string,int>("1",0); thermodynamicSwapInterval = 1;
+    parameterStrings["thermodynamicPower"] = pair<string,int>("1.0",0); thermodynamicPower = 1.0;
+    parameterStrings["thermodynamicTargetSE"] = pair<string,int>("0",0); thermodynamicTargetSE = 0;
+    parameterStrings["thermodynamicMaxRungs"] = pair<string,int>("50",0); thermodynamicMaxRungs = 50;
     parameterStrings["EMalgorithm_on"] = pair<string,int>("false",0); EMalgorithm_on = false;
     parameterStrings["EMrepeats"] = pair<string,int>("10",0); EMrepeats = 10;
     parameterStrings["EMiterations"] = pair<string,int>("100",0); EMiterations = 100;
+    parameterStrings["EMtolerance"] = pair<string,int>("1e-6",0); EMtolerance = 1e-6;
     
     parameterStrings["outputLog_on"] = pair<string,int>("true",0); outputLog_on = true;
     parameterStrings["outputLikelihood_on"] = pair<string,int>("false",0); outputLikelihood_on = false;
     parameterStrings["outputQmatrix_ind_on"] = pair<string,int>("true",0); outputQmatrix_ind_on = true;
     parameterStrings["outputQmatrix_pop_on"] = pair<string,int>("false",0); outputQmatrix_pop_on = false;
-    parameterStrings["outputQmatrix_gene_on"] = pair<string,int>("false",0); outputQmatrixError_gene_on = false;
+    parameterStrings["outputQmatrix_gene_on"] = pair<string,int>("false",0); outputQmatrix_gene_on = false;
     parameterStrings["outputQmatrixError_ind_on"] = pair<string,int>("false",0); outputQmatrixError_ind_on = false;
     parameterStrings["outputQmatrixError_pop_on"] = pair<string,int>("false",0); outputQmatrixError_pop_on = false;
     parameterStrings["outputQmatrixError_gene_on"] = pair<string,int>("false",0); outputQmatrixError_gene_on = false;
@@ -110,12 +124,36 @@ globals::globals() {
     parameterStrings["outputEvanno_on"] = pair<string,int>("false",0); outputEvanno_on = false;
     parameterStrings["outputMaxLike_alleleFreqs_on"] = pair<string,int>("false",0); outputMaxLike_alleleFreqs_on = false;
     parameterStrings["outputMaxLike_admixFreqs_on"] = pair<string,int>("false",0); outputMaxLike_admixFreqs_on = false;
+    parameterStrings["outputProfile_on"] = pair<string,int>("false",0); outputProfile_on = false;
     
     parameterStrings["outputQmatrix_structureFormat_on"] = pair<string,int>("false",0); outputQmatrix_structureFormat_on = false;
+    parameterStrings["outputPosteriorGrouping_binary_on"] = pair<string,int>("false",0); outputPosteriorGrouping_binary_on = false;
+    parameterStrings["outputQmatrix_binary_on"] = pair<string,int>("false",0); outputQmatrix_binary_on = false;
+    parameterStrings["outputFlushInterval"] = pair<string,int>("100",0); outputFlushInterval = 100;
     parameterStrings["suppressWarning1_on"] = pair<string,int>("false",0); suppressWarning1_on = false;
     parameterStrings["fixLabels_on"] = pair<string,int>("true",0); fixLabels_on = true;
+    parameterStrings["fixLabelsInterval"] = pair<string,int>("1",0); fixLabelsInterval = 1;
+    parameterStrings["QmatrixFloat_on"] = pair<string,int>("false",0); QmatrixFloat_on = false;
+    parameterStrings["threads"] = pair<string,int>("1",0); threads = 1;
+    parameterStrings["seed"] = pair<string,int>("0",0); seed = 0;
+    parameterStrings["parallelRepeats_on"] = pair<string,int>("false",0); parallelRepeats_on = false;
+    parameterStrings["gibbsBlocks"] = pair<string,int>("1",0); gibbsBlocks = 1;
+    parameterStrings["checkpointInterval"] = pair<string,int>("0",0); checkpointInterval = 0;
+    
+    // set from the -resume command line flag
+    resume_on = false;
+    
+    // set by the library interface (see library.h)
+    bufferConsole_on = false;
     
     
     // parameters not defined by user
     lambda = 1.0;
+    
+    // set by readData() if all loci are biallelic
+    biallelic = false;
+    
+    // set by distributed_init()
+    rank = 0;
+    ranks = 1;
 };
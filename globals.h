@@ -14,7 +14,14 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <mutex>
+#include <memory>
+#include <stdint.h>
 #include "OSfunctions.h"
+#include "outputWriter.h"
+#include "genotypeData.h"
+#include "lookupTable.h"
+#include "profile.h"
 
 #ifndef __Maverick1_0__globals__
 #define __Maverick1_0__globals__
@@ -50,6 +57,7 @@ public:
     std::string outputEvanno_fileName;
     std::string outputMaxLike_alleleFreqs_fileName;
     std::string outputMaxLike_admixFreqs_fileName;
+    std::string outputProfile_fileName;
     
     std::string inputRoot_filePath;
     std::string outputRoot_filePath;
@@ -72,6 +80,7 @@ public:
     std::string outputEvanno_filePath;
     std::string outputMaxLike_alleleFreqs_filePath;
     std::string outputMaxLike_admixFreqs_filePath;
+    std::string outputProfile_filePath;
     std::string junk_filePath;
     
     // file streams
@@ -93,6 +102,7 @@ public:
     std::ofstream outputEvanno_fileStream;
     std::ofstream outputMaxLike_alleleFreqs_fileStream;
     std::ofstream outputMaxLike_admixFreqs_fileStream;
+    std::ofstream outputProfile_fileStream;
     std::ofstream junk_fileStream;
     
     
@@ -104,6 +114,7 @@ public:
     bool ploidyCol_on;
     int ploidy;
     std::string missingData;
+    bool dataCache_on;
     
     int Kmin;
     int Kmax;
@@ -111,20 +122,31 @@ public:
     bool fixAlpha_on;
     std::vector<double> alpha;
     std::vector<double> alphaPropSD;
+    int alphaUpdates;
+    bool alphaAdapt_on;
     
     bool exhaustive_on;
     int mainRepeats;
     int mainBurnin;
     int mainSamples;
     int mainThinning;
+    bool mainAdaptiveBurnin_on;
+    double mainTargetSE;
+    int mainCheckInterval;
     bool thermodynamic_on;
     int thermodynamicRungs;
     int thermodynamicBurnin;
     int thermodynamicSamples;
     int thermodynamicThinning;
+    bool thermodynamicTempering_on;
+    int thermodynamicSwapInterval;
+    double thermodynamicPower;
+    double thermodynamicTargetSE;
+    int thermodynamicMaxRungs;
     bool EMalgorithm_on;
     int EMrepeats;
     int EMiterations;
+    double EMtolerance;
     
     bool outputLog_on;
     bool outputLikelihood_on;
@@ -143,14 +165,48 @@ public:
     bool outputEvanno_on;
     bool outputMaxLike_alleleFreqs_on;
     bool outputMaxLike_admixFreqs_on;
+    bool outputProfile_on;
     
     bool outputQmatrix_structureFormat_on;
+    bool outputPosteriorGrouping_binary_on;
+    bool outputQmatrix_binary_on;
+    int outputFlushInterval;
     bool suppressWarning1_on;
     bool fixLabels_on;
+    int fixLabelsInterval;
+    bool QmatrixFloat_on;
+    int threads;
+    int seed;
+    bool parallelRepeats_on;
+    int gibbsBlocks;
+    int checkpointInterval;
+    bool resume_on;
     
     // parameters not defined by user
     double lambda;
     
+    // position of this process when running over several processes (see distributed.h). Process 0 reads the data, hands out values of K to the others and writes all output.
+    int rank;
+    int ranks;
+    
+    // objects used when running in parallel. When the K loop is spread over multiple threads, console and log output for each K is held in Kbuffer and released in K order once that K is complete.
+    std::mutex log_mutex;
+    std::vector<std::string> Kbuffer;
+    
+    // if true then console and log output for each K is always held in Kbuffer, whatever the number of threads, and console output from checking parameters and reading the data is held in dataBuffer (used by the library interface, which returns this output with the results, see library.h)
+    bool bufferConsole_on;
+    std::string dataBuffer;
+    
+    // background writers for the outputLikelihood and outputPosteriorGrouping files, which receive a line on every MCMC iteration. Each chain holds up to outputFlushInterval lines in memory before passing them over.
+    outputWriter outputLikelihood_writer;
+    outputWriter outputPosteriorGrouping_writer;
+    
+    // background writer for checkpoint files (see checkpoint.h)
+    checkpointWriter checkpoint_writer;
+    
+    // background writer for Qmatrix files, which can run to several gigabytes at the gene level. Each file is formatted in blocks by whichever thread writes out the results of that K, and written to disk while the analysis of other K carries on.
+    fileWriter Qmatrix_writer;
+    
     
     // data
     std::vector<std::string> indLabels_vec;
@@ -160,15 +216,22 @@ public:
     std::vector<int> pop_index;
     std::vector<int> ploidy_vec;
     std::vector<int> missing_vec;
-    std::vector< std::vector< std::vector<int> > > data;
     int n;
     int loci;
     std::vector<int> J;
+    
+    // genotype data, stored as a single packed array indexed by gene copy. Gene copies are ordered by individual, then by locus, then by copy within locus, so that gene copy p of individual i at locus l is found at data[data_indStart[i] + l*ploidy_vec[i] + p]. Alleles are coded 1:J[l], with 0 meaning missing data. If every locus has at most two alleles then biallelic is set, and the data are packed into 2 bits per gene copy (see genotypeData.h). The data are never changed once read in, and are held through a pointer to const so that all analyses of the same data set through the library (see library.h) can share a single copy.
+    std::shared_ptr<const genotypeData> data;
+    bool biallelic;
+    std::vector<int> data_indStart;
+    
+    // J_offset[l] is the total number of alleles over all loci before l. Used to index flat arrays of allele counts and frequencies, in which the alleles of all loci are placed end to end.
+    std::vector<int> J_offset;
     std::vector< std::vector<std::string> > uniqueAlleles;
     int geneCopies;
     
-    // log lookup table
-    std::vector< std::vector<double> > log_lookup;
+    // lookup tables for log and lgamma functions, covering every count that can arise in the data (see lookupTable.h). Shared in the same way as the data, and null until created by initialiseLookups().
+    std::shared_ptr<const lookupTable> lookup;
     
     // objects for storing results
     std::vector< std::vector< std::vector<double> > > Qmatrix_gene;
@@ -190,6 +253,17 @@ public:
     std::vector<double> logEvidence_structure_grandMean;
     std::vector<double> logEvidence_structure_grandSE;
     
+    // effective sample size of the marginal likelihood in each repeat of the main MCMC
+    std::vector< std::vector<double> > logLikeGroup_ESS;
+    
+    // number of burn-in and sampling iterations actually used in each repeat of the main MCMC (which can be fewer than mainBurnin and mainSamples when using adaptive run lengths)
+    std::vector< std::vector<int> > mainBurnin_used;
+    std::vector< std::vector<int> > mainSamples_used;
+    
+    // results at each rung of the thermodynamic ladder, in order of increasing power. Rungs can be added adaptively, so storage is for the largest number of rungs that can be run (TIrungsMax), and TIrungs[Kindex] gives the number actually used.
+    int TIrungsMax;
+    std::vector<int> TIrungs;
+    std::vector< std::vector<double> > TIpoint_beta;
     std::vector< std::vector<double> > TIpoint_mean;
     std::vector< std::vector<double> > TIpoint_var;
     std::vector< std::vector<double> > TIpoint_SE;
@@ -207,15 +281,18 @@ public:
     std::vector<double> posterior_TI_LL;
     std::vector<double> posterior_TI_UL;
     
-    double maxLike;
-    std::vector< std::vector< std::vector<double> > > max_alleleFreqs;
-    std::vector< std::vector<double> > max_admixFreqs;
+    std::vector<double> maxLike;
+    std::vector< std::vector< std::vector< std::vector<double> > > > max_alleleFreqs;
+    std::vector< std::vector< std::vector<double> > > max_admixFreqs;
     
     std::vector<double> AIC;
     std::vector<double> BIC;
     std::vector<double> DIC_Spiegelhalter;
     std::vector<double> DIC_Gelman;
     
+    // timings and event counts of each stage of the analysis of each K (only recorded if outputProfile_on is true)
+    std::vector< std::vector<profileObject> > profile;
+    
     // first and second derivative of L (structure estimator) for Evanno calculation
     std::vector< std::vector<double> > L_1;
     std::vector< std::vector<double> > L_2;
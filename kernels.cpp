@@ -0,0 +1,25 @@
+//
+//  MavericK
+//  kernels.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include "kernels.h"
+
+using namespace std;
+
+//------------------------------------------------
+// calculate the conditional probability (up to a constant) of a single gene copy coming from each of K demes under the admixture model
+double admixProbs(const int *alleleCounts, const int *alleleCountsTotals, const int *admixCounts, int K, double lambda, double Jlambda, double alpha, double *probVec, double *cumProbVec) {
+    double probVecSum = 0;
+    for (int k=0; k<K; k++) {
+        probVec[k] = (alleleCounts[k]+lambda)/(alleleCountsTotals[k]+Jlambda)*(admixCounts[k]+alpha);
+        probVecSum += probVec[k];
+        cumProbVec[k] = probVecSum;
+    }
+    return(probVecSum);
+}
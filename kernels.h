@@ -0,0 +1,18 @@
+//
+//  MavericK
+//  kernels.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Low-level kernels for the innermost loops of the MCMC. Each kernel reads counts that are stored contiguously over demes, and produces the probabilities and their running sum in a single pass. The kernels are plain scalar code: at the values of K used in practice one of the counts read has nearly always just been updated, and vector versions spent longer waiting on that store than they saved in arithmetic.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__kernels__
+#define __Maverick1_0__kernels__
+
+//------------------------------------------------
+// calculate the conditional probability (up to a constant) of a single gene copy coming from each of K demes under the admixture model, given pointers to the K counts of the observed allele, the K total counts at this locus, and the K admix counts of this individual. Probabilities are written to probVec, such that probVec[k] = (alleleCounts[k]+lambda)/(alleleCountsTotals[k]+Jlambda)*(admixCounts[k]+alpha). The running (cumulative) sum of probabilities is written to cumProbVec, and the total is returned.
+double admixProbs(const int *alleleCounts, const int *alleleCountsTotals, const int *admixCounts, int K, double lambda, double Jlambda, double alpha, double *probVec, double *cumProbVec);
+
+#endif
@@ -0,0 +1,621 @@
+//
+//  MavericK
+//  library.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include "library.h"
+
+using namespace std;
+
+//------------------------------------------------
+// carry out all estimation methods for a single K
+void analyseK(globals &globals, int Kindex) {
+    int K = globals.Kmin+Kindex;
+    
+    coutAndLog_K("-- K="+to_string((long long)K)+" ----------------\n\n", globals, Kindex);
+    
+    // read in the checkpoint of this K if resuming. Stages that completed before the checkpoint was written are skipped, as their results are read back from the checkpoint.
+    checkpointObject checkpoint(globals, Kindex);
+    if (checkpoint.load(globals))
+        coutAndLog_K("Resuming from checkpoint\n\n", globals, Kindex);
+    
+    //#### Carry out various estimation methods
+    
+    // if profiling, each stage that is run adds a row to the profile of this K before it is saved to the checkpoint. Stages restored from the checkpoint keep the profile from the original run.
+    vector<profileObject> &profile = globals.profile[Kindex];
+    bool profile_on = globals.outputProfile_on;
+    
+    // exhaustive analysis
+    if (globals.exhaustive_on || K==1) {
+        coutAndLog_K("Running exhaustive approach...\n", globals, Kindex);
+        if (checkpoint.stage>=CHECKPOINT_EXHAUSTIVE) {
+            coutAndLog_K("  restored from checkpoint\n\n", globals, Kindex);
+        } else {
+            profileObject stageProfile("exhaustive");
+            {
+                profileTimer timer(profile_on ? &stageProfile : 0, PROFILE_TOTAL);
+                if (!globals.admix_on) {
+                    exhaustive_noAdmix(globals, Kindex);
+                } else {
+                    exhaustive_admix(globals, Kindex);
+                }
+            }
+            if (profile_on)
+                profile.push_back(stageProfile);
+            checkpoint.completeStage(globals, CHECKPOINT_EXHAUSTIVE);
+            coutAndLog_K("  complete\n\n", globals, Kindex);
+        }
+    }
+    
+    // ordinary MCMC - repeat multiple times
+    coutAndLog_K("Running ordinary MCMC...\n", globals, Kindex);
+    if (checkpoint.stage>=CHECKPOINT_MAIN) {
+        coutAndLog_K("  restored from checkpoint\n\n", globals, Kindex);
+    } else {
+        profileObject stageProfile("main");
+        {
+            profileObject *p = profile_on ? &stageProfile : 0;
+            profileTimer timer(p, PROFILE_TOTAL);
+            if (!globals.admix_on) {
+                mainMCMC_noAdmixture(globals, Kindex, checkpoint, p);
+            } else {
+                mainMCMC_admixture(globals, Kindex, checkpoint, p);
+            }
+        }
+        if (profile_on)
+            profile.push_back(stageProfile);
+        checkpoint.completeStage(globals, CHECKPOINT_MAIN);
+        coutAndLog_K("  complete\n\n", globals, Kindex);
+    }
+    
+    // thermodynamic integration
+    if (globals.thermodynamic_on) {
+        coutAndLog_K("Carrying out thermodynamic integration...\n", globals, Kindex);
+        if (checkpoint.stage>=CHECKPOINT_TI) {
+            coutAndLog_K("  restored from checkpoint\n\n", globals, Kindex);
+        } else {
+            
+            // the first row covers the whole ladder, and is followed by a row for each rung
+            profileObject stageProfile("TI");
+            vector<profileObject> rungProfiles;
+            {
+                profileTimer timer(profile_on ? &stageProfile : 0, PROFILE_TOTAL);
+                if (!globals.admix_on) {
+                    TI_noAdmixture(globals, Kindex, profile_on ? &rungProfiles : 0, &checkpoint);
+                } else {
+                    TI_admixture(globals, Kindex, profile_on ? &rungProfiles : 0, &checkpoint);
+                }
+            }
+            if (profile_on) {
+                double total = stageProfile.seconds[PROFILE_TOTAL];
+                for (int i=0; i<int(rungProfiles.size()); i++) {
+                    stageProfile.merge(rungProfiles[i]);
+                }
+                stageProfile.seconds[PROFILE_TOTAL] = total;
+                profile.push_back(stageProfile);
+                profile.insert(profile.end(), rungProfiles.begin(), rungProfiles.end());
+            }
+            checkpoint.completeStage(globals, CHECKPOINT_TI);
+            coutAndLog_K("  complete\n\n", globals, Kindex);
+        }
+    }
+    
+    // EM algorithm
+    if (globals.EMalgorithm_on) {
+        coutAndLog_K("Running EM algorithm...\n", globals, Kindex);
+        if (checkpoint.stage>=CHECKPOINT_EM) {
+            coutAndLog_K("  restored from checkpoint\n\n", globals, Kindex);
+        } else {
+            profileObject stageProfile("EM");
+            {
+                profileObject *p = profile_on ? &stageProfile : 0;
+                profileTimer timer(p, PROFILE_TOTAL);
+                if (!globals.admix_on) {
+                    EM_noAdmix(globals, Kindex, p);
+                } else {
+                    EM_admix(globals, Kindex, p);
+                }
+            }
+            if (profile_on)
+                profile.push_back(stageProfile);
+            checkpoint.completeStage(globals, CHECKPOINT_EM);
+            coutAndLog_K("  complete\n\n", globals, Kindex);
+        }
+    }
+}
+
+//------------------------------------------------
+// dataFormat::
+// constructor, taking default values
+dataFormat::dataFormat() {
+    globals defaults;
+    headerRow_on = defaults.headerRow_on;
+    popCol_on = defaults.popCol_on;
+    ploidyCol_on = defaults.ploidyCol_on;
+    ploidy = defaults.ploidy;
+    missingData = defaults.missingData;
+    dataCache_on = defaults.dataCache_on;
+}
+
+//------------------------------------------------
+// runConfig::
+// constructor, taking default values
+runConfig::runConfig() {
+    globals defaults;
+    
+    Kmin = defaults.Kmin;
+    Kmax = defaults.Kmax;
+    admix_on = defaults.admix_on;
+    fixAlpha_on = defaults.fixAlpha_on;
+    alpha = defaults.alpha;
+    alphaPropSD = defaults.alphaPropSD;
+    alphaUpdates = defaults.alphaUpdates;
+    alphaAdapt_on = defaults.alphaAdapt_on;
+    
+    exhaustive_on = defaults.exhaustive_on;
+    mainRepeats = defaults.mainRepeats;
+    mainBurnin = defaults.mainBurnin;
+    mainSamples = defaults.mainSamples;
+    mainThinning = defaults.mainThinning;
+    mainAdaptiveBurnin_on = defaults.mainAdaptiveBurnin_on;
+    mainTargetSE = defaults.mainTargetSE;
+    mainCheckInterval = defaults.mainCheckInterval;
+    thermodynamic_on = defaults.thermodynamic_on;
+    thermodynamicRungs = defaults.thermodynamicRungs;
+    thermodynamicBurnin = defaults.thermodynamicBurnin;
+    thermodynamicSamples = defaults.thermodynamicSamples;
+    thermodynamicThinning = defaults.thermodynamicThinning;
+    thermodynamicTempering_on = defaults.thermodynamicTempering_on;
+    thermodynamicSwapInterval = defaults.thermodynamicSwapInterval;
+    thermodynamicPower = defaults.thermodynamicPower;
+    thermodynamicTargetSE = defaults.thermodynamicTargetSE;
+    thermodynamicMaxRungs = defaults.thermodynamicMaxRungs;
+    EMalgorithm_on = defaults.EMalgorithm_on;
+    EMrepeats = defaults.EMrepeats;
+    EMiterations = defaults.EMiterations;
+    EMtolerance = defaults.EMtolerance;
+    
+    suppressWarning1_on = defaults.suppressWarning1_on;
+    fixLabels_on = defaults.fixLabels_on;
+    fixLabelsInterval = defaults.fixLabelsInterval;
+    QmatrixFloat_on = defaults.QmatrixFloat_on;
+    threads = defaults.threads;
+    seed = defaults.seed;
+    parallelRepeats_on = defaults.parallelRepeats_on;
+    gibbsBlocks = defaults.gibbsBlocks;
+    profile_on = defaults.outputProfile_on;
+    
+    lambda = defaults.lambda;
+}
+
+//------------------------------------------------
+// overwrite the string value of a parameter
+void setParameter(globals &globals, string name, string value) {
+    globals.parameterStrings[name].first = value;
+}
+void setParameter(globals &globals, string name, bool value) {
+    setParameter(globals, name, string(value ? "true" : "false"));
+}
+void setParameter(globals &globals, string name, int value) {
+    setParameter(globals, name, to_string((long long)value));
+}
+void setParameter(globals &globals, string name, double value) {
+    ostringstream ss;
+    ss.precision(17);
+    ss << value;
+    setParameter(globals, name, ss.str());
+}
+void setParameter(globals &globals, string name, const vector<double> &value) {
+    ostringstream ss;
+    ss.precision(17);
+    for (int i=0; i<int(value.size()); i++) {
+        ss << ((i==0) ? "" : ",") << value[i];
+    }
+    setParameter(globals, name, ss.str());
+}
+
+//------------------------------------------------
+// set the parameters describing the format of the data file
+void setFormat(globals &globals, const dataFormat &format) {
+    setParameter(globals, "headerRow_on", format.headerRow_on);
+    setParameter(globals, "popCol_on", format.popCol_on);
+    setParameter(globals, "ploidyCol_on", format.ploidyCol_on);
+    setParameter(globals, "ploidy", format.ploidy);
+    setParameter(globals, "missingData", format.missingData);
+    setParameter(globals, "dataCache_on", format.dataCache_on);
+}
+
+//------------------------------------------------
+// datasetObject::
+// read in data from file. Nothing is written to the console or log, and errors are thrown as a maverickError. The summary of the data that the command line program prints is kept in log.
+datasetObject::datasetObject(const string &data_filePath, const dataFormat &_format) : format(_format), store(new globals) {
+    
+    throwErrors guard;
+    globals &g = *store;
+    setParameter(g, "outputLog_on", false);
+    g.outputLog_on = false;
+    g.bufferConsole_on = true;
+    
+    // check format parameters and read in data
+    setFormat(g, format);
+    checkParameters(g, 0);
+    g.dataBuffer.clear();
+    g.data_filePath = data_filePath;
+    readData(g);
+    log = g.dataBuffer;
+    
+    // create lookup tables for the default value of lambda
+    initialiseLookups(g);
+}
+
+//------------------------------------------------
+// datasetObject::
+// properties of the data
+int datasetObject::n() const {
+    return(store->n);
+}
+int datasetObject::loci() const {
+    return(store->loci);
+}
+int datasetObject::geneCopies() const {
+    return(store->geneCopies);
+}
+const vector<int> &datasetObject::J() const {
+    return(store->J);
+}
+const vector<int> &datasetObject::ploidy() const {
+    return(store->ploidy_vec);
+}
+const vector<string> &datasetObject::indLabels() const {
+    return(store->indLabels_vec);
+}
+const vector<string> &datasetObject::uniquePops() const {
+    return(store->uniquePops);
+}
+
+//------------------------------------------------
+// datasetObject::
+// copy the data into the globals object of an analysis. The genotypes and lookup tables are shared rather than copied.
+void datasetObject::copyTo(globals &globals) const {
+    
+    globals.data_filePath = store->data_filePath;
+    globals.headerRow_on = store->headerRow_on;
+    globals.popCol_on = store->popCol_on;
+    globals.ploidyCol_on = store->ploidyCol_on;
+    globals.ploidy = store->ploidy;
+    globals.missingData = store->missingData;
+    globals.dataCache_on = store->dataCache_on;
+    
+    globals.indLabels_vec = store->indLabels_vec;
+    globals.pop_vec = store->pop_vec;
+    globals.uniquePops = store->uniquePops;
+    globals.uniquePop_counts = store->uniquePop_counts;
+    globals.pop_index = store->pop_index;
+    globals.ploidy_vec = store->ploidy_vec;
+    globals.missing_vec = store->missing_vec;
+    globals.n = store->n;
+    globals.loci = store->loci;
+    globals.J = store->J;
+    
+    globals.data = store->data;
+    globals.biallelic = store->biallelic;
+    globals.data_indStart = store->data_indStart;
+    globals.J_offset = store->J_offset;
+    globals.uniqueAlleles = store->uniqueAlleles;
+    globals.geneCopies = store->geneCopies;
+    
+    if (globals.lambda==store->lookup->lambda) {
+        globals.lookup = store->lookup;
+    } else {
+        globals.lookup.reset();
+    }
+}
+
+//------------------------------------------------
+// prepare a globals object for an analysis. Parameters are checked in exactly the same way as in the command line program, but errors are thrown as a maverickError rather than ending the program. The count of parameters printed by checkParameters() is held in dataBuffer and not returned, as every parameter is set here.
+void setupRun(globals &globals, const datasetObject &data, const runConfig &config, bool comparisonStatistics_on) {
+    
+    throwErrors guard;
+    
+    setParameter(globals, "outputLog_on", false);
+    globals.outputLog_on = false;
+    globals.bufferConsole_on = true;
+    
+    setFormat(globals, data.format);
+    
+    setParameter(globals, "Kmin", config.Kmin);
+    setParameter(globals, "Kmax", config.Kmax);
+    setParameter(globals, "admix_on", config.admix_on);
+    setParameter(globals, "fixAlpha_on", config.fixAlpha_on);
+    setParameter(globals, "alpha", config.alpha);
+    setParameter(globals, "alphaPropSD", config.alphaPropSD);
+    setParameter(globals, "alphaUpdates", config.alphaUpdates);
+    setParameter(globals, "alphaAdapt_on", config.alphaAdapt_on);
+    
+    setParameter(globals, "exhaustive_on", config.exhaustive_on);
+    setParameter(globals, "mainRepeats", config.mainRepeats);
+    setParameter(globals, "mainBurnin", config.mainBurnin);
+    setParameter(globals, "mainSamples", config.mainSamples);
+    setParameter(globals, "mainThinning", config.mainThinning);
+    setParameter(globals, "mainAdaptiveBurnin_on", config.mainAdaptiveBurnin_on);
+    setParameter(globals, "mainTargetSE", config.mainTargetSE);
+    setParameter(globals, "mainCheckInterval", config.mainCheckInterval);
+    setParameter(globals, "thermodynamic_on", config.thermodynamic_on);
+    setParameter(globals, "thermodynamicRungs", config.thermodynamicRungs);
+    setParameter(globals, "thermodynamicBurnin", config.thermodynamicBurnin);
+    setParameter(globals, "thermodynamicSamples", config.thermodynamicSamples);
+    setParameter(globals, "thermodynamicThinning", config.thermodynamicThinning);
+    setParameter(globals, "thermodynamicTempering_on", config.thermodynamicTempering_on);
+    setParameter(globals, "thermodynamicSwapInterval", config.thermodynamicSwapInterval);
+    setParameter(globals, "thermodynamicPower", config.thermodynamicPower);
+    setParameter(globals, "thermodynamicTargetSE", config.thermodynamicTargetSE);
+    setParameter(globals, "thermodynamicMaxRungs", config.thermodynamicMaxRungs);
+    setParameter(globals, "EMalgorithm_on", config.EMalgorithm_on);
+    setParameter(globals, "EMrepeats", config.EMrepeats);
+    setParameter(globals, "EMiterations", config.EMiterations);
+    setParameter(globals, "EMtolerance", config.EMtolerance);
+    
+    setParameter(globals, "suppressWarning1_on", config.suppressWarning1_on);
+    setParameter(globals, "fixLabels_on", config.fixLabels_on);
+    setParameter(globals, "fixLabelsInterval", config.fixLabelsInterval);
+    setParameter(globals, "QmatrixFloat_on", config.QmatrixFloat_on);
+    setParameter(globals, "threads", config.threads);
+    setParameter(globals, "seed", config.seed);
+    setParameter(globals, "parallelRepeats_on", config.parallelRepeats_on);
+    setParameter(globals, "gibbsBlocks", config.gibbsBlocks);
+    setParameter(globals, "checkpointInterval", 0);
+    
+    // no output files are written. The few output options that also control what is calculated are set to match what is returned.
+    for (auto it = globals.parameterStrings.begin(); it != globals.parameterStrings.end(); ++it) {
+        const string &name = it->first;
+        if (name.compare(0, 6, "output")==0 && name.size()>3 && name.compare(name.size()-3, 3, "_on")==0) {
+            it->second.first = "false";
+        }
+    }
+    setParameter(globals, "outputQmatrix_pop_on", data.format.popCol_on && config.fixLabels_on);
+    setParameter(globals, "outputComparisonStatistics_on", comparisonStatistics_on && config.EMalgorithm_on);
+    setParameter(globals, "outputProfile_on", config.profile_on);
+    
+    // check all parameters
+    checkParameters(globals, 0);
+    globals.lambda = config.lambda;
+    checkGrZero("lambda", globals.lambda, globals.outputLog_on, globals.outputLog_fileStream);
+    
+    // copy in data, and check that chosen options make sense for these data
+    data.copyTo(globals);
+    checkOptions(globals);
+    
+    // choose master seed at random if not defined by the user
+    if (globals.seed==0)
+        globals.seed = randomSeed();
+    
+    initialiseGlobals(globals);
+    setThreads(globals.threads);
+}
+
+//------------------------------------------------
+// settings for running a single stage at a single K
+runConfig stageConfig(globals &globals, const runConfig &config, int K, bool keepRange, int &Kindex) {
+    throwErrors guard;
+    runConfig output = config;
+    
+    // keep the range of K if possible
+    if (keepRange && K>=config.Kmin && K<=config.Kmax) {
+        Kindex = K-config.Kmin;
+        return(output);
+    }
+    
+    // otherwise analyse K alone, picking out the values of alpha and alphaPropSD for this K if they are given for each K individually
+    Kindex = 0;
+    output.Kmin = K;
+    output.Kmax = K;
+    int Kvalues = config.Kmax-config.Kmin+1;
+    if (config.alpha.size()>1 || config.alphaPropSD.size()>1) {
+        if (K<config.Kmin || K>config.Kmax) {
+            errorExit("\nError: K must lie between Kmin and Kmax when alpha or alphaPropSD contain a separate value for each K.\n", false, globals.outputLog_fileStream);
+        }
+        if ((config.alpha.size()>1 && int(config.alpha.size())!=Kvalues) || (config.alphaPropSD.size()>1 && int(config.alphaPropSD.size())!=Kvalues)) {
+            errorExit("\nError: alpha and alphaPropSD must contain either a single value to apply to all K, or a list of values of length (Kmax-Kmin+1) to apply to each K individually.\n", false, globals.outputLog_fileStream);
+        }
+        if (config.alpha.size()>1)
+            output.alpha = vector<double>(1, config.alpha[K-config.Kmin]);
+        if (config.alphaPropSD.size()>1)
+            output.alphaPropSD = vector<double>(1, config.alphaPropSD[K-config.Kmin]);
+    }
+    return(output);
+}
+
+//------------------------------------------------
+// extract results of the exhaustive approach for a single K
+exhaustiveResult getExhaustiveResult(globals &globals, int Kindex) {
+    exhaustiveResult output;
+    output.K = globals.Kmin+Kindex;
+    output.logEvidence = globals.logEvidence_exhaustive[Kindex];
+    return(output);
+}
+
+//------------------------------------------------
+// extract results of the main MCMC for a single K
+mainMCMCResult getMainMCMCResult(globals &globals, int Kindex) {
+    mainMCMCResult output;
+    output.K = globals.Kmin+Kindex;
+    output.logEvidence_harmonic = globals.logEvidence_harmonic[Kindex];
+    output.logEvidence_harmonic_grandMean = globals.logEvidence_harmonic_grandMean[Kindex];
+    output.logEvidence_harmonic_grandSE = globals.logEvidence_harmonic_grandSE[Kindex];
+    output.structure_loglike_mean = globals.structure_loglike_mean[Kindex];
+    output.structure_loglike_var = globals.structure_loglike_var[Kindex];
+    output.logEvidence_structure = globals.logEvidence_structure[Kindex];
+    output.logEvidence_structure_grandMean = globals.logEvidence_structure_grandMean[Kindex];
+    output.logEvidence_structure_grandSE = globals.logEvidence_structure_grandSE[Kindex];
+    output.logLikeGroup_ESS = globals.logLikeGroup_ESS[Kindex];
+    output.burnin = globals.mainBurnin_used[Kindex];
+    output.samples = globals.mainSamples_used[Kindex];
+    if (globals.fixLabels_on) {
+        output.Qmatrix_ind = globals.Qmatrix_ind[Kindex];
+        output.QmatrixError_ind = globals.QmatrixError_ind[Kindex];
+        if (globals.outputQmatrix_pop_on) {
+            output.Qmatrix_pop = globals.Qmatrix_pop[Kindex];
+            output.QmatrixError_pop = globals.QmatrixError_pop[Kindex];
+        }
+        if (globals.admix_on) {
+            output.Qmatrix_gene = globals.Qmatrix_gene[Kindex];
+            output.QmatrixError_gene = globals.QmatrixError_gene[Kindex];
+        }
+    }
+    return(output);
+}
+
+//------------------------------------------------
+// extract results of thermodynamic integration for a single K
+TIResult getTIResult(globals &globals, int Kindex) {
+    TIResult output;
+    output.K = globals.Kmin+Kindex;
+    int rungs = globals.thermodynamic_on ? globals.TIrungs[Kindex] : 0;
+    output.beta = vector<double>(globals.TIpoint_beta[Kindex].begin(), globals.TIpoint_beta[Kindex].begin()+rungs);
+    output.mean = vector<double>(globals.TIpoint_mean[Kindex].begin(), globals.TIpoint_mean[Kindex].begin()+rungs);
+    output.var = vector<double>(globals.TIpoint_var[Kindex].begin(), globals.TIpoint_var[Kindex].begin()+rungs);
+    output.SE = vector<double>(globals.TIpoint_SE[Kindex].begin(), globals.TIpoint_SE[Kindex].begin()+rungs);
+    output.logEvidence = globals.logEvidence_TI[Kindex];
+    output.logEvidence_SE = globals.logEvidence_TI_SE[Kindex];
+    return(output);
+}
+
+//------------------------------------------------
+// extract results of the EM algorithm for a single K
+EMResult getEMResult(globals &globals, int Kindex) {
+    EMResult output;
+    output.K = globals.Kmin+Kindex;
+    output.maxLike = globals.maxLike[Kindex];
+    output.alleleFreqs = globals.max_alleleFreqs[Kindex];
+    if (globals.admix_on)
+        output.admixFreqs = globals.max_admixFreqs[Kindex];
+    output.AIC = globals.AIC[Kindex];
+    output.BIC = globals.BIC[Kindex];
+    output.DIC_Spiegelhalter = globals.DIC_Spiegelhalter[Kindex];
+    output.DIC_Gelman = globals.DIC_Gelman[Kindex];
+    return(output);
+}
+
+//------------------------------------------------
+// carry out a full analysis of a data set for all K from Kmin to Kmax
+analysisResult runAnalysis(const datasetObject &data, const runConfig &config) {
+    
+    globals g;
+    setupRun(g, data, config, true);
+    
+    // loop through range of K, largest K first when running over multiple threads
+    int Kvalues = g.Kmax-g.Kmin+1;
+    vector<int> Korder(Kvalues);
+    for (int Kindex=0; Kindex<Kvalues; Kindex++) {
+        Korder[Kindex] = (g.threads>1) ? Kvalues-1-Kindex : Kindex;
+    }
+    parallelFor(Korder, [&](int Kindex) {
+        analyseK(g, Kindex);
+    });
+    
+    // calculate Evanno's delta K if possible. As in the Evanno output file, there is no value at the smallest and largest K, or at K=1.
+    analysisResult output;
+    output.seed = g.seed;
+    output.delta_K = vector<double>(Kvalues, -sqrt(-1.0));
+    if (g.mainRepeats>1 && (g.Kmax-g.Kmin)>=2) {
+        calculateEvanno(g);
+        for (int Kindex=1; Kindex<(Kvalues-1); Kindex++) {
+            if ((g.Kmin+Kindex)>1)
+                output.delta_K[Kindex] = g.delta_K[Kindex];
+        }
+    }
+    
+    // extract results of each K
+    for (int Kindex=0; Kindex<Kvalues; Kindex++) {
+        Kresult K;
+        K.K = g.Kmin+Kindex;
+        K.exhaustive = getExhaustiveResult(g, Kindex);
+        K.main = getMainMCMCResult(g, Kindex);
+        K.TI = getTIResult(g, Kindex);
+        K.EM = getEMResult(g, Kindex);
+        K.profile = g.profile[Kindex];
+        K.log = g.Kbuffer[Kindex];
+        output.K.push_back(K);
+    }
+    
+    return(output);
+}
+
+//------------------------------------------------
+// carry out the exhaustive approach for a single K. There are no random numbers involved, so K is always analysed alone.
+exhaustiveResult runExhaustive(const datasetObject &data, const runConfig &config, int K) {
+    globals g;
+    int Kindex;
+    runConfig c = stageConfig(g, config, K, false, Kindex);
+    c.exhaustive_on = true;
+    setupRun(g, data, c, false);
+    
+    if (!g.admix_on) {
+        exhaustive_noAdmix(g, Kindex);
+    } else {
+        exhaustive_admix(g, Kindex);
+    }
+    return(getExhaustiveResult(g, Kindex));
+}
+
+//------------------------------------------------
+// carry out the main MCMC for a single K
+mainMCMCResult runMainMCMC(const datasetObject &data, const runConfig &config, int K) {
+    globals g;
+    int Kindex;
+    setupRun(g, data, stageConfig(g, config, K, true, Kindex), false);
+    
+    checkpointObject checkpoint(g, Kindex);
+    if (!g.admix_on) {
+        mainMCMC_noAdmixture(g, Kindex, checkpoint);
+    } else {
+        mainMCMC_admixture(g, Kindex, checkpoint);
+    }
+    return(getMainMCMCResult(g, Kindex));
+}
+
+//------------------------------------------------
+// carry out thermodynamic integration for a single K
+TIResult runThermodynamic(const datasetObject &data, const runConfig &config, int K) {
+    globals g;
+    int Kindex;
+    runConfig c = stageConfig(g, config, K, true, Kindex);
+    c.thermodynamic_on = true;
+    setupRun(g, data, c, false);
+    
+    if (K==1) {
+        if (!g.admix_on) {
+            exhaustive_noAdmix(g, Kindex);
+        } else {
+            exhaustive_admix(g, Kindex);
+        }
+    }
+    if (!g.admix_on) {
+        TI_noAdmixture(g, Kindex);
+    } else {
+        TI_admixture(g, Kindex);
+    }
+    return(getTIResult(g, Kindex));
+}
+
+//------------------------------------------------
+// carry out the EM algorithm for a single K
+EMResult runEM(const datasetObject &data, const runConfig &config, int K) {
+    globals g;
+    int Kindex;
+    runConfig c = stageConfig(g, config, K, true, Kindex);
+    c.EMalgorithm_on = true;
+    setupRun(g, data, c, false);
+    
+    if (!g.admix_on) {
+        EM_noAdmix(g, Kindex);
+    } else {
+        EM_admix(g, Kindex);
+    }
+    return(getEMResult(g, Kindex));
+}
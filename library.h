@@ -0,0 +1,256 @@
+//
+//  MavericK
+//  library.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines an interface for running MavericK from within another program, without going through parameters files and output files. A data set is read in once as a datasetObject, which is never changed once loaded, and can then be analysed any number of times under different settings, each given as a runConfig. Results are returned as structs rather than written to file. The command line program uses the same analyseK() function to carry out the analysis of each K, so results are identical to those of the command line program given the same settings and seed.
+//
+//  Invalid settings or data are checked in the same way as in the command line program, but are reported by throwing a maverickError (see readIn.h) holding the error message, so that the calling program can carry on. Nothing is written to the console in this case. Errors that can only arise part way through an analysis (such as failure of the Hungarian algorithm) still end the program.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__library__
+#define __Maverick1_0__library__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include "globals.h"
+#include "checkpoint.h"
+#include "EM_algorithm.h"
+#include "exhaustive.h"
+#include "mainMCMC.h"
+#include "misc.h"
+#include "parallel.h"
+#include "probability.h"
+#include "profile.h"
+#include "readIn.h"
+#include "TI.h"
+#include "writeOut.h"
+
+//------------------------------------------------
+// carry out all estimation methods for a single K, storing results in globals. Used by both the command line program and the library functions below.
+void analyseK(globals &globals, int Kindex);
+
+//------------------------------------------------
+// format of a data file. Members have the same names and default values as the corresponding parameters (see globals.cpp).
+struct dataFormat {
+
+    bool headerRow_on;
+    bool popCol_on;
+    bool ploidyCol_on;
+    int ploidy;
+    std::string missingData;
+    bool dataCache_on;
+
+    // constructor, taking default values
+    dataFormat();
+};
+
+//------------------------------------------------
+// settings of a single analysis, in place of the parameters file and command line. Members have the same names and default values as the corresponding parameters (see globals.cpp). Settings that only control which files are written are not needed here, as all results are returned. If seed is 0 then a seed is chosen at random, and reported in the results.
+struct runConfig {
+
+    int Kmin;
+    int Kmax;
+    bool admix_on;
+    bool fixAlpha_on;
+    std::vector<double> alpha;
+    std::vector<double> alphaPropSD;
+    int alphaUpdates;
+    bool alphaAdapt_on;
+
+    bool exhaustive_on;
+    int mainRepeats;
+    int mainBurnin;
+    int mainSamples;
+    int mainThinning;
+    bool mainAdaptiveBurnin_on;
+    double mainTargetSE;
+    int mainCheckInterval;
+    bool thermodynamic_on;
+    int thermodynamicRungs;
+    int thermodynamicBurnin;
+    int thermodynamicSamples;
+    int thermodynamicThinning;
+    bool thermodynamicTempering_on;
+    int thermodynamicSwapInterval;
+    double thermodynamicPower;
+    double thermodynamicTargetSE;
+    int thermodynamicMaxRungs;
+    bool EMalgorithm_on;
+    int EMrepeats;
+    int EMiterations;
+    double EMtolerance;
+
+    bool suppressWarning1_on;
+    bool fixLabels_on;
+    int fixLabelsInterval;
+    bool QmatrixFloat_on;
+    int threads;
+    int seed;
+    bool parallelRepeats_on;
+    int gibbsBlocks;
+    bool profile_on;
+
+    // strength of the Dirichlet prior on allele frequencies (fixed at 1 in the command line program)
+    double lambda;
+
+    // constructor, taking default values
+    runConfig();
+};
+
+//------------------------------------------------
+// class holding a data set that has been read in and checked, along with the lookup tables that depend only on the data. The data are never changed once loaded, so a single datasetObject can be used for any number of analyses, which share its genotypes and lookup tables (held through pointers to const, see globals.h) and copy the remaining, much smaller, properties of the data rather than reading the file again.
+class datasetObject {
+
+public:
+
+    // PUBLIC FUNCTIONS
+
+    // read in data from file. Nothing is written to the console. Throws a maverickError if the file cannot be read or the data are invalid.
+    datasetObject(const std::string &data_filePath, const dataFormat &format=dataFormat());
+
+    // properties of the data
+    int n() const;
+    int loci() const;
+    int geneCopies() const;
+    const std::vector<int> &J() const;
+    const std::vector<int> &ploidy() const;
+    const std::vector<std::string> &indLabels() const;
+    const std::vector<std::string> &uniquePops() const;
+
+    // copy the data into the globals object of an analysis, sharing the genotypes rather than copying them. Lookup tables are only shared if they were created with the same value of lambda as globals.lambda, otherwise they are left null to be created again by initialiseGlobals().
+    void copyTo(globals &globals) const;
+
+    // format the data were read in with
+    dataFormat format;
+
+    // console output from reading in the data (the summary of the data printed by the command line program)
+    std::string log;
+
+private:
+
+    // PRIVATE OBJECTS
+
+    // read-in data, held in a globals object of which only the data and the lookup tables are used
+    std::unique_ptr<globals> store;
+
+};
+
+//------------------------------------------------
+// results of the exhaustive approach for a single K
+struct exhaustiveResult {
+    int K;
+    double logEvidence;
+};
+
+//------------------------------------------------
+// results of the main MCMC for a single K, with one element of each vector per repeat. Qmatrices are only filled if fixLabels_on, and Qmatrix_pop only if the data contain populations. Qmatrix_gene is only filled under the admixture model.
+struct mainMCMCResult {
+    int K;
+    std::vector<double> logEvidence_harmonic;
+    double logEvidence_harmonic_grandMean;
+    double logEvidence_harmonic_grandSE;
+    std::vector<double> structure_loglike_mean;
+    std::vector<double> structure_loglike_var;
+    std::vector<double> logEvidence_structure;
+    double logEvidence_structure_grandMean;
+    double logEvidence_structure_grandSE;
+    std::vector<double> logLikeGroup_ESS;
+    std::vector<int> burnin;
+    std::vector<int> samples;
+    std::vector< std::vector<double> > Qmatrix_ind;
+    std::vector< std::vector<double> > QmatrixError_ind;
+    std::vector< std::vector<double> > Qmatrix_pop;
+    std::vector< std::vector<double> > QmatrixError_pop;
+    std::vector< std::vector<double> > Qmatrix_gene;
+    std::vector< std::vector<double> > QmatrixError_gene;
+};
+
+//------------------------------------------------
+// results of thermodynamic integration for a single K, with one element of each vector per rung in order of increasing power
+struct TIResult {
+    int K;
+    std::vector<double> beta;
+    std::vector<double> mean;
+    std::vector<double> var;
+    std::vector<double> SE;
+    double logEvidence;
+    double logEvidence_SE;
+};
+
+//------------------------------------------------
+// results of the EM algorithm for a single K. Model comparison statistics need the output of the main MCMC, so are only filled in by runAnalysis() (and are otherwise NaN). admixFreqs is only filled under the admixture model.
+struct EMResult {
+    int K;
+    double maxLike;
+    std::vector< std::vector< std::vector<double> > > alleleFreqs;
+    std::vector< std::vector<double> > admixFreqs;
+    double AIC;
+    double BIC;
+    double DIC_Spiegelhalter;
+    double DIC_Gelman;
+};
+
+//------------------------------------------------
+// all results for a single K. Stages that were not run hold NaN values and empty vectors. log holds the console output of the analysis of this K.
+struct Kresult {
+    int K;
+    exhaustiveResult exhaustive;
+    mainMCMCResult main;
+    TIResult TI;
+    EMResult EM;
+    std::vector<profileObject> profile;
+    std::string log;
+};
+
+//------------------------------------------------
+// results of a full analysis over all K. delta_K (Evanno's delta K) is NaN unless mainRepeats>1 and at least three values of K were analysed.
+struct analysisResult {
+    int seed;
+    std::vector<Kresult> K;
+    std::vector<double> delta_K;
+};
+
+//------------------------------------------------
+// overwrite the string value of a parameter, as though it had been read from the parameters file. Values are checked and converted to their final form by checkParameters().
+void setParameter(globals &globals, std::string name, std::string value);
+void setParameter(globals &globals, std::string name, bool value);
+void setParameter(globals &globals, std::string name, int value);
+void setParameter(globals &globals, std::string name, double value);
+void setParameter(globals &globals, std::string name, const std::vector<double> &value);
+
+//------------------------------------------------
+// set the parameters describing the format of the data file
+void setFormat(globals &globals, const dataFormat &format);
+
+//------------------------------------------------
+// prepare a globals object for an analysis, taking the place of the parameters file, the command line and readData() in the command line program. No files are written and nothing is written to the console. Console output from the analysis of each K is held in Kbuffer, and the output of checking the settings is discarded. Model comparison statistics are only calculated if comparisonStatistics_on is true. Throws a maverickError if any setting is invalid.
+void setupRun(globals &globals, const datasetObject &data, const runConfig &config, bool comparisonStatistics_on);
+
+//------------------------------------------------
+// settings for running a single stage at a single K. If keepRange is true and K lies between Kmin and Kmax then the range of K is kept, so that the random numbers used at this K (which depend on Kindex) are the same as in runAnalysis(). Otherwise the range is reset to K alone. Kindex is set to the index at which K is analysed. Throws a maverickError if alpha or alphaPropSD cannot be picked out for K.
+runConfig stageConfig(globals &globals, const runConfig &config, int K, bool keepRange, int &Kindex);
+
+//------------------------------------------------
+// extract the results of each stage for a single K from globals
+exhaustiveResult getExhaustiveResult(globals &globals, int Kindex);
+mainMCMCResult getMainMCMCResult(globals &globals, int Kindex);
+TIResult getTIResult(globals &globals, int Kindex);
+EMResult getEMResult(globals &globals, int Kindex);
+
+//------------------------------------------------
+// carry out a full analysis of a data set for all K from Kmin to Kmax, in the same way as the command line program. This and the single stage functions below throw a maverickError if any setting is invalid.
+analysisResult runAnalysis(const datasetObject &data, const runConfig &config);
+
+//------------------------------------------------
+// carry out a single stage of the analysis for a single K, ignoring the settings that switch stages on and off. If K lies between Kmin and Kmax then results are identical to those of the same stage within runAnalysis() for the same seed, otherwise K is analysed alone. Thermodynamic integration at K=1 uses the exhaustive approach, which is run first.
+exhaustiveResult runExhaustive(const datasetObject &data, const runConfig &config, int K);
+mainMCMCResult runMainMCMC(const datasetObject &data, const runConfig &config, int K);
+TIResult runThermodynamic(const datasetObject &data, const runConfig &config, int K);
+EMResult runEM(const datasetObject &data, const runConfig &config, int K);
+
+#endif
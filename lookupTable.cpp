@@ -0,0 +1,56 @@
+//
+//  MavericK
+//  lookupTable.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include "lookupTable.h"
+
+using namespace std;
+
+//------------------------------------------------
+// lookupTable::
+// constructor for lookupTable class
+lookupTable::lookupTable() {
+    lambda = 0;
+    rows = 0;
+}
+
+//------------------------------------------------
+// lookupTable::
+// build tables covering counts 0:maxCount
+void lookupTable::build(int maxCount, const vector<int> &J, double _lambda) {
+    
+    lambda = _lambda;
+    rows = maxCount+1;
+    
+    // find the multiples of lambda that are needed, and give each its own column
+    int Jmax = 1;
+    for (int l=0; l<int(J.size()); l++) {
+        Jmax = (J[l]>Jmax) ? J[l] : Jmax;
+    }
+    columnIndex = vector<int>(Jmax+1,-1);
+    vector<int> multiples;
+    columnIndex[1] = 0;
+    multiples.push_back(1);
+    for (int l=0; l<int(J.size()); l++) {
+        if (columnIndex[J[l]]==-1) {
+            columnIndex[J[l]] = int(multiples.size());
+            multiples.push_back(J[l]);
+        }
+    }
+    
+    // fill in values
+    logValues = vector<double>(multiples.size()*rows);
+    lgammaValues = vector<double>(multiples.size()*rows);
+    for (int m=0; m<int(multiples.size()); m++) {
+        for (int c=0; c<rows; c++) {
+            logValues[size_t(m)*rows+c] = log(double(c+multiples[m]*lambda));
+            lgammaValues[size_t(m)*rows+c] = lgamma(double(c+multiples[m]*lambda));
+        }
+    }
+}
@@ -0,0 +1,60 @@
+//
+//  MavericK
+//  lookupTable.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines a class holding lookup tables of log(c+j*lambda) and lgamma(c+j*lambda), which are the only logs needed by the Multinomial-Dirichlet likelihood. Counts c run from 0 up to the largest count that can arise in the data, so the tables are read without checking. There is one column for each multiple j of lambda that is actually used, which is j=1 for a single allele plus the distinct numbers of alleles per locus. Each column is a contiguous block of values indexed by count, so the likelihood at a locus needs just two column pointers.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__lookupTable__
+#define __Maverick1_0__lookupTable__
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+
+//------------------------------------------------
+// class containing lookup tables for log and lgamma functions
+class lookupTable {
+    
+public:
+    
+    // PUBLIC OBJECTS
+    
+    // value of lambda the tables were built for, and number of counts covered (0:rows-1)
+    double lambda;
+    int rows;
+    
+    // columnIndex[j] is the column holding multiple j of lambda, or -1 if there is none
+    std::vector<int> columnIndex;
+    
+    // values of log(c+j*lambda) and lgamma(c+j*lambda), at position columnIndex[j]*rows+c
+    std::vector<double> logValues;
+    std::vector<double> lgammaValues;
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor
+    lookupTable();
+    
+    // build tables covering counts 0:maxCount, for a single allele and for each number of alleles in J
+    void build(int maxCount, const std::vector<int> &J, double _lambda);
+    
+    // true if the tables have not been built
+    bool empty() const {
+        return(rows==0);
+    }
+    
+    // column of log(c+j*lambda) or lgamma(c+j*lambda) values for multiple j, indexed by count c
+    const double *logColumn(int j) const {
+        return(&logValues[size_t(columnIndex[j])*rows]);
+    }
+    const double *lgammaColumn(int j) const {
+        return(&lgammaValues[size_t(columnIndex[j])*rows]);
+    }
+    
+};
+
+#endif
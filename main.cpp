@@ -14,18 +14,24 @@
 // include standard library header files
 #include <iostream>
 #include <ctime>
+#include <vector>
+#include <mutex>
 
 // include MavericK header files
+#include "checkpoint.h"
+#include "distributed.h"
 #include "EM_algorithm.h"
 #include "exhaustive.h"
 #include "globals.h"
 #include "Hungarian.h"
+#include "library.h"
 #include "mainMCMC.h"
 #include "MCMCobject_admixture.h"
 #include "MCMCobject_noAdmixture.h"
 #include "misc.h"
 #include "MCMCobject_noAdmixture.h"
 #include "OSfunctions.h"
+#include "parallel.h"
 #include "probability.h"
 #include "readIn.h"
 #include "TI.h"
@@ -33,11 +39,114 @@
 
 using namespace std;
 
+//------------------------------------------------
+// write results for a single K to file, and report estimates to console and log. Any console and log output held back while this K was running in parallel is released first.
+void outputK(globals &globals, int Kindex) {
+    
+    if (globals.threads>1 || globals.ranks>1)
+        coutAndLog(globals.Kbuffer[Kindex], globals.outputLog_on, globals.outputLog_fileStream);
+    
+    //#### Print results to file
+    
+    // output Qmatrix files for this K
+    if (globals.outputQmatrix_gene_on)
+        printQmatrix_gene(globals, Kindex);
+    if (globals.outputQmatrix_ind_on)
+        printQmatrix_ind(globals, Kindex);
+    if (globals.outputQmatrix_pop_on)
+        printQmatrix_pop(globals, Kindex);
+    
+    // output Qmatrix error files for this K
+    if (globals.outputQmatrixError_gene_on)
+        printQmatrixError_gene(globals, Kindex);
+    if (globals.outputQmatrixError_ind_on)
+        printQmatrixError_ind(globals, Kindex);
+    if (globals.outputQmatrixError_pop_on)
+        printQmatrixError_pop(globals, Kindex);
+    
+    // print evidence to file
+    printEvidence(globals, Kindex);
+    
+    // print evidence details to file
+    if (globals.outputEvidenceDetails_on)
+        printEvidenceDetails(globals, Kindex);
+    
+    // print max-like allele frequencies to file
+    if (globals.outputMaxLike_alleleFreqs_on)
+        printMaxLike_alleleFreqs(globals, Kindex);
+    
+    // print max-like admixture frequencies to file
+    if (globals.outputMaxLike_admixFreqs_on)
+        printMaxLike_admixFreqs(globals, Kindex);
+    
+    // print comparison statistics to file
+    if (globals.outputComparisonStatistics_on)
+        printComparisonStatistics(globals, Kindex);
+    
+    // print timings and event counts to file
+    if (globals.outputProfile_on)
+        printProfile(globals, Kindex);
+    
+    //#### Report answers from various estimation methods to console and to log
+    
+    coutAndLog("Estimates of (log) model evidence...\n\n", globals.outputLog_on, globals.outputLog_fileStream);
+    
+    // exhaustive
+    if (globals.exhaustive_on)
+        coutAndLog("Exhaustive\n  exact value: "+process_nan(globals.logEvidence_exhaustive[Kindex])+"\n\n", globals.outputLog_on, globals.outputLog_fileStream);
+    
+    // harmonic mean
+    coutAndLog("Harmonic mean", globals.outputLog_on, globals.outputLog_fileStream);
+    if (globals.mainRepeats>1) {
+        coutAndLog(" (averaged over "+to_string((long long)globals.mainRepeats)+" runs)\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  estimate: "+process_nan(globals.logEvidence_harmonic_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  standard error: "+process_nan(globals.logEvidence_harmonic_grandSE[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+    } else {
+        coutAndLog(" (estimated from single run)\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  estimate: "+process_nan(globals.logEvidence_harmonic_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    coutAndLog("\n", globals.outputLog_on, globals.outputLog_fileStream);
+    
+    // structure estimator
+    coutAndLog("Structure estimator", globals.outputLog_on, globals.outputLog_fileStream);
+    if (globals.mainRepeats>1) {
+        coutAndLog(" (averaged over "+to_string((long long)globals.mainRepeats)+" runs)\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  estimate: "+process_nan(globals.logEvidence_structure_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  standard error: "+process_nan(globals.logEvidence_structure_grandSE[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+    } else {
+        coutAndLog(" (estimated from single run)\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  estimate: "+process_nan(globals.logEvidence_structure_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    coutAndLog("\n", globals.outputLog_on, globals.outputLog_fileStream);
+    
+    // thermodynamic integral estimator
+    if (globals.thermodynamic_on) {
+        coutAndLog("Thermodynamic integral estimator\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  estimate: "+process_nan(globals.logEvidence_TI[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  standard error: "+process_nan(globals.logEvidence_TI_SE[Kindex])+"\n\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    
+    // model comparison statistics
+    if (globals.outputComparisonStatistics_on) {
+        coutAndLog("Model comparison statistics\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  AIC: "+process_nan(globals.AIC[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  BIC: "+process_nan(globals.BIC[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  DIC_S (Spiegelhalter): "+process_nan(globals.DIC_Spiegelhalter[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog("  DIC_G (Gelman): "+process_nan(globals.DIC_Gelman[Kindex])+"\n\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
 
+	fflush(stdout);
+}
+
+//------------------------------------------------
 // main function
 int main(int argc, const char * argv[])
 {
     
+    // initialise global object; to contain all file paths, parameter values and data. If running over several processes then MPI is started here, and from now on only process 0 writes to the console.
+    globals globals;
+    distributed_init(globals);
+    
     // start program
     time_t ctt = time(0); // current time
     cout << "------------------------------------------\n";
@@ -61,9 +170,6 @@ int main(int argc, const char * argv[])
     // At this stage we have all parameters defined as strings, and a record of where they were defined. No checking of parameter values has occurred yet.
     
     
-    // initialise global object; to contain all file paths, parameter values and data.
-    globals globals;
-    
     // parse input arguments required to open parameters file
     for (int i=1; i<argc; i++) {
         readPath("-masterRoot", globals.masterRoot_filePath, argc, argv, i);
@@ -86,8 +192,8 @@ int main(int argc, const char * argv[])
     // check that outputLog_on parameter is valid
     checkBoolean(globals.parameterStrings["outputLog_on"].first, globals.outputLog_on, "outputLog_on", false, globals.outputLog_fileStream);
     
-    // open log if necessary
-    if (globals.outputLog_on) {
+    // open log if necessary. Only process 0 writes to the log, so on all other processes the log stream is never opened and anything written to it is discarded.
+    if (globals.outputLog_on && globals.rank==0) {
         
         globals.outputLog_fileStream = safe_ofstream(globals.outputLog_filePath, false, globals.outputLog_fileStream);
         
@@ -127,6 +233,14 @@ int main(int argc, const char * argv[])
     // check that chosen options make sense
     checkOptions(globals);
     
+    // choose master seed at random if not defined by the user (or take the seed of the original run if resuming from a checkpoint). Either way the seed is reported, so that the analysis can be reproduced exactly.
+    if (globals.seed==0 && globals.resume_on)
+        globals.seed = checkpoint_seed(globals);
+    if (globals.seed==0)
+        globals.seed = randomSeed();
+    distributed_broadcast(globals.seed);
+    coutAndLog("Random seed: "+to_string((long long)globals.seed)+"\n\n", globals.outputLog_on, globals.outputLog_fileStream);
+    
     //---------------------------------------------------------------------------------------------------
     
     // Perform inference. Loop through defined range of K, deploying various statistical methods.
@@ -134,160 +248,68 @@ int main(int argc, const char * argv[])
     // initialise objects for storing results
     initialiseGlobals(globals);
     
-    // open file streams that are common to all K
-    openFileStreams(globals);
+    // open file streams that are common to all K (only process 0 writes output)
+    if (globals.rank==0)
+        openFileStreams(globals);
+    
+    // start background writers for checkpoint files and Qmatrix files
+    if (globals.checkpointInterval>0)
+        globals.checkpoint_writer.open();
+    if (globals.rank==0)
+        globals.Qmatrix_writer.open();
     
     // open file stream for junk output (comment out as needed)
     //globals.junk_fileStream = safe_ofstream(globals.outputRoot_filePath + "junk.txt", false, globals.outputLog_fileStream);
     
     
-    // loop through range of K
-    for (int Kindex=0; Kindex<(globals.Kmax-globals.Kmin+1); Kindex++) {
-        int K = globals.Kmin+Kindex;
-        
-        coutAndLog("-- K="+to_string((long long)K)+" ----------------\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        //#### Carry out various estimation methods
-        
-        // exhaustive analysis
-        if (globals.exhaustive_on || K==1) {
-            coutAndLog("Running exhaustive approach...\n", globals.outputLog_on, globals.outputLog_fileStream);
-            if (!globals.admix_on) {
-                exhaustive_noAdmix(globals, Kindex);
-            } else {
-                exhaustive_admix(globals, Kindex);
-            }
-            coutAndLog("  complete\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        }
-        
-        // ordinary MCMC - repeat multiple times
-        coutAndLog("Running ordinary MCMC...\n", globals.outputLog_on, globals.outputLog_fileStream);
-        if (!globals.admix_on) {
-            mainMCMC_noAdmixture(globals, Kindex);
-        } else {
-            mainMCMC_admixture(globals, Kindex);
-        }
-        coutAndLog("  complete\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        // thermodynamic integration
-        if (globals.thermodynamic_on) {
-            coutAndLog("Carrying out thermodynamic integration...\n", globals.outputLog_on, globals.outputLog_fileStream);
-            if (!globals.admix_on) {
-                TI_noAdmixture(globals, Kindex);
-            } else {
-                TI_admixture(globals, Kindex);
-            }
-            coutAndLog("  complete\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        }
-        
-        // EM algorithm
-        if (globals.EMalgorithm_on) {
-            coutAndLog("Running EM algorithm...\n", globals.outputLog_on, globals.outputLog_fileStream);
-            if (!globals.admix_on) {
-                EM_noAdmix(globals, Kindex);
-            } else {
-                EM_admix(globals, Kindex);
+    // loop through range of K. When running over multiple threads the largest K are started first, as they take the longest. Whichever thread completes the next K in line writes out its results, so that output always appears in K order.
+    setThreads(globals.threads);
+    int Kvalues = globals.Kmax-globals.Kmin+1;
+    vector<int> Korder(Kvalues);
+    for (int Kindex=0; Kindex<Kvalues; Kindex++) {
+        Korder[Kindex] = (globals.threads>1) ? Kvalues-1-Kindex : Kindex;
+    }
+    vector<bool> Kcomplete(Kvalues, false);
+    int nextOutput = 0;
+    mutex Kcomplete_mutex;
+    if (globals.ranks>1) {
+        distributed_runK(globals, [&](int Kindex) {
+            analyseK(globals, Kindex);
+        }, [&](int Kindex) {
+            outputK(globals, Kindex);
+        });
+    } else {
+        parallelFor(Korder, [&](int Kindex) {
+            analyseK(globals, Kindex);
+            
+            lock_guard<mutex> lock(Kcomplete_mutex);
+            Kcomplete[Kindex] = true;
+            while (nextOutput<Kvalues && Kcomplete[nextOutput]) {
+                outputK(globals, nextOutput);
+                nextOutput++;
             }
-            coutAndLog("  complete\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        }
-        
-        
-        //#### Print results to file
-        
-        // output Qmatrix files for this K
-        if (globals.outputQmatrix_gene_on)
-            printQmatrix_gene(globals, Kindex);
-        if (globals.outputQmatrix_ind_on)
-            printQmatrix_ind(globals, Kindex);
-        if (globals.outputQmatrix_pop_on)
-            printQmatrix_pop(globals, Kindex);
-        
-        // output Qmatrix error files for this K
-        if (globals.outputQmatrixError_gene_on)
-            printQmatrixError_gene(globals, Kindex);
-        if (globals.outputQmatrixError_ind_on)
-            printQmatrixError_ind(globals, Kindex);
-        if (globals.outputQmatrixError_pop_on)
-            printQmatrixError_pop(globals, Kindex);
-        
-        // print evidence to file
-        printEvidence(globals, Kindex);
-        
-        // print evidence details to file
-        if (globals.outputEvidenceDetails_on)
-            printEvidenceDetails(globals, Kindex);
-        
-        // print max-like allele frequencies to file
-        if (globals.outputMaxLike_alleleFreqs_on)
-            printMaxLike_alleleFreqs(globals, Kindex);
-        
-        // print max-like admixture frequencies to file
-        if (globals.outputMaxLike_admixFreqs_on)
-            printMaxLike_admixFreqs(globals, Kindex);
-        
-        // print comparison statistics to file
-        if (globals.outputComparisonStatistics_on)
-            printComparisonStatistics(globals, Kindex);
-        
-        // print Evanno's delta K to file
-        if (globals.outputEvanno_on && Kindex>0)
-            printEvanno(globals, Kindex-1);
-        
-        //#### Report answers from various estimation methods to console and to log
-        
-        coutAndLog("Estimates of (log) model evidence...\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        // exhaustive
-        if (globals.exhaustive_on)
-            coutAndLog("Exhaustive\n  exact value: "+process_nan(globals.logEvidence_exhaustive[Kindex])+"\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        // harmonic mean
-        coutAndLog("Harmonic mean", globals.outputLog_on, globals.outputLog_fileStream);
-        if (globals.mainRepeats>1) {
-            coutAndLog(" (averaged over "+to_string((long long)globals.mainRepeats)+" runs)\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  estimate: "+process_nan(globals.logEvidence_harmonic_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  standard error: "+process_nan(globals.logEvidence_harmonic_grandSE[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-        } else {
-            coutAndLog(" (estimated from single run)\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  estimate: "+process_nan(globals.logEvidence_harmonic_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-        }
-        coutAndLog("\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        // structure estimator
-        coutAndLog("Structure estimator", globals.outputLog_on, globals.outputLog_fileStream);
-        if (globals.mainRepeats>1) {
-            coutAndLog(" (averaged over "+to_string((long long)globals.mainRepeats)+" runs)\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  estimate: "+process_nan(globals.logEvidence_structure_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  standard error: "+process_nan(globals.logEvidence_structure_grandSE[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-        } else {
-            coutAndLog(" (estimated from single run)\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  estimate: "+process_nan(globals.logEvidence_structure_grandMean[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-        }
-        coutAndLog("\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        // thermodynamic integral estimator
-        if (globals.thermodynamic_on) {
-            coutAndLog("Thermodynamic integral estimator\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  estimate: "+process_nan(globals.logEvidence_TI[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  standard error: "+process_nan(globals.logEvidence_TI_SE[Kindex])+"\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        }
-        
-        // model comparison statistics
-        if (globals.outputComparisonStatistics_on) {
-            coutAndLog("Model comparison statistics\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  AIC: "+process_nan(globals.AIC[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  BIC: "+process_nan(globals.BIC[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  DIC_S (Spiegelhalter): "+process_nan(globals.DIC_Spiegelhalter[Kindex])+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-            coutAndLog("  DIC_G (Gelman): "+process_nan(globals.DIC_Gelman[Kindex])+"\n\n", globals.outputLog_on, globals.outputLog_fileStream);
-        }
-
-		fflush(stdout);
-        
-    } // end loop through K
+        });
+    }
+    
+    // finish writing output produced on every MCMC iteration
+    globals.outputLikelihood_writer.close();
+    globals.outputPosteriorGrouping_writer.close();
+    globals.checkpoint_writer.close();
+    globals.Qmatrix_writer.close();
     
-    // print final value of Evanno's delta K (NA) to file
-    if (globals.outputEvanno_on)
-        printEvanno(globals, globals.Kmax-globals.Kmin);
+    // all remaining output is written by process 0
+    if (globals.rank>0) {
+        distributed_finalise();
+        return(0);
+    }
+    
+    // calculate Evanno's delta K (which depends on neighbouring K) and print to file
+    if (globals.outputEvanno_on) {
+        calculateEvanno(globals);
+        for (int Kindex=0; Kindex<Kvalues; Kindex++) {
+            printEvanno(globals, Kindex);
+        }
+    }
     
     // print normalised evidence to file
     if (globals.outputEvidenceNormalised_on)
@@ -309,6 +331,7 @@ int main(int argc, const char * argv[])
     coutAndLog("------------------------------------------\n", globals.outputLog_on, globals.outputLog_fileStream);
 
     //pauseExit();
+    distributed_finalise();
     return(0);
 }
 
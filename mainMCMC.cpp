@@ -10,212 +10,504 @@
 //
 // ---------------------------------------------------------------------------
 
+#include <memory>
+
 #include "mainMCMC.h"
+#include "parallel.h"
+#include "Hungarian.h"
+#include "welford.h"
 
 using namespace std;
 
 //------------------------------------------------
-// main Structure MCMC under no-admixture model, repeated multiple times
-void mainMCMC_noAdmixture(globals &globals, int Kindex) {
-    int K = globals.Kmin+Kindex;
+// find the permutation of labels that best matches the Qmatrix Q to the reference Qmatrix Qref, using the same Kullback-Leibler cost as when fixing labels within the MCMC. Element k of the result gives the new label of group k.
+vector<int> alignLabels(globals &globals, vector< vector<double> > &Qref, vector< vector<double> > &Q) {
+    int K = int(Qref[0].size());
+    if (K==1) {
+        return(vector<int>(1,0));
+    }
+    
+    // calculate cost matrix
+    vector< vector<double> > costMat(K, vector<double>(K));
+    for (int i=0; i<int(Q.size()); i++) {
+        for (int k1=0; k1<K; k1++) {
+            double q = (Q[i][k1]<UNDERFLO) ? UNDERFLO : Q[i][k1];
+            for (int k2=0; k2<K; k2++) {
+                double qref = (Qref[i][k2]<UNDERFLO) ? UNDERFLO : Qref[i][k2];
+                costMat[k1][k2] += q*(log(q)-log(qref));
+            }
+        }
+    }
     
-    // define temporary Qmatrix objects for calculating mean and sd over mainRepeats
-    vector< vector< vector<double> > > Qmatrix_ind_allReps(globals.n, vector< vector<double> >(K, vector<double>(globals.mainRepeats)));
-    vector< vector< vector<double> > > Qmatrix_pop_allReps(globals.uniquePops.size(), vector< vector<double> >(K, vector<double>(globals.mainRepeats)));
+    // find best permutation
+    vector<int> edgesLeft(K), edgesRight(K), blockedLeft(K), blockedRight(K);
+    return(hungarian(costMat, edgesLeft, edgesRight, blockedLeft, blockedRight, globals.outputLog_on, globals.outputLog_fileStream));
+}
+
+//------------------------------------------------
+// re-order the columns of a Qmatrix, such that column k moves to column bestPerm[k]
+void permuteColumns(vector< vector<double> > &Q, vector<int> &bestPerm) {
+    vector<double> row;
+    for (int i=0; i<int(Q.size()); i++) {
+        row = Q[i];
+        for (int k=0; k<int(bestPerm.size()); k++) {
+            Q[i][bestPerm[k]] = row[k];
+        }
+    }
+}
+
+//------------------------------------------------
+// report effective sample sizes of all repeats, along with the length of burn-in and sampling phases if these were chosen adaptively
+void reportRunLengths(globals &globals, int Kindex) {
+    bool adaptiveSamples = (globals.mainTargetSE>0);
     
-    // define MCMC object
-    MCMCobject_noAdmixture mainMCMC(globals, Kindex, globals.mainBurnin, globals.mainSamples, globals.mainThinning, 1.0);
+    if (globals.mainAdaptiveBurnin_on) {
+        string burnin_string = "  burn-in by repeat:";
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            burnin_string += (mainRep==0) ? " " : ", ";
+            burnin_string += to_string((long long)globals.mainBurnin_used[Kindex][mainRep]);
+        }
+        coutAndLog_K(burnin_string+" (of at most "+to_string((long long)globals.mainBurnin)+")\n", globals, Kindex);
+    }
+    if (adaptiveSamples) {
+        string samples_string = "  samples by repeat:";
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            samples_string += (mainRep==0) ? " " : ", ";
+            samples_string += to_string((long long)globals.mainSamples_used[Kindex][mainRep]);
+        }
+        coutAndLog_K(samples_string+" (of at most "+to_string((long long)globals.mainSamples)+")\n", globals, Kindex);
+    }
     
-    // repeat analysis multiple times
+    string ESS_string = "  effective sample size by repeat:";
     for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
-        coutAndLog("  analysis "+to_string((long long)mainRep+1)+" of "+to_string((long long)globals.mainRepeats)+"\n", globals.outputLog_on, globals.outputLog_fileStream);
-        
-        // perform MCMC
-        if (mainRep==0) {
-            mainMCMC.reset(true);
-        } else {
-            mainMCMC.reset(false);
-        }
-        mainMCMC.perform_MCMC(globals, true, false, globals.fixLabels_on, globals.outputLikelihood_on, globals.outputPosteriorGrouping_on, mainRep);
+        ESS_string += (mainRep==0) ? " " : ", ";
+        ESS_string += to_string((long long)round(globals.logLikeGroup_ESS[Kindex][mainRep]));
+    }
+    if (!adaptiveSamples) {
+        ESS_string += " (of "+to_string((long long)globals.mainSamples)+" samples)";
+    }
+    coutAndLog_K(ESS_string+"\n", globals, Kindex);
+}
+
+//------------------------------------------------
+// main Structure MCMC under no-admixture model, repeated multiple times
+void mainMCMC_noAdmixture(globals &globals, int Kindex, checkpointObject &checkpoint, profileObject *profile) {
+    int K = globals.Kmin+Kindex;
+    
+    // define accumulators for calculating mean and sd of Qmatrices and evidence estimators over mainRepeats
+    welfordMatrix Qmatrix_ind_stats, Qmatrix_pop_stats;
+    Qmatrix_ind_stats.reset(globals.n, K);
+    Qmatrix_pop_stats.reset(int(globals.uniquePops.size()), K);
+    welford harmonic_stats, structure_stats;
+    
+    // save the output of a single completed repeat
+    auto saveRep = [&](MCMCobject_noAdmixture &mainMCMC, int mainRep) {
         
-        // save Qmatrix values
+        // add Qmatrix values to running mean and variance
         if (globals.fixLabels_on) {
-            for (int i=0; i<globals.n; i++) {
-                for (int k=0; k<K; k++) {
-                    Qmatrix_ind_allReps[i][k][mainRep] = mainMCMC.Qmatrix_ind[i][k];
-                }
-            }
+            Qmatrix_ind_stats.add(mainMCMC.Qmatrix_ind);
             if (globals.outputQmatrix_pop_on) {
-                for (int i=0; i<int(globals.uniquePops.size()); i++) {
-                    for (int k=0; k<K; k++) {
-                        Qmatrix_pop_allReps[i][k][mainRep] = mainMCMC.Qmatrix_pop[i][k];
-                    }
-                }
+                Qmatrix_pop_stats.add(mainMCMC.Qmatrix_pop);
             }
         }
         
         // save harmonic mean of marginal likelihoods
         globals.logEvidence_harmonic[Kindex][mainRep] = mainMCMC.harmonic;
+        harmonic_stats.add(mainMCMC.harmonic);
         
         // calculate Structure estimator from joint likelihoods
-        globals.structure_loglike_mean[Kindex][mainRep] = mainMCMC.logLikeJoint_sum/double(globals.mainSamples);
-        globals.structure_loglike_var[Kindex][mainRep] = mainMCMC.logLikeJoint_sumSquared/double(globals.mainSamples) - globals.structure_loglike_mean[Kindex][mainRep]*globals.structure_loglike_mean[Kindex][mainRep];
+        globals.structure_loglike_mean[Kindex][mainRep] = mainMCMC.logLikeJoint_stats.mean;
+        globals.structure_loglike_var[Kindex][mainRep] = mainMCMC.logLikeJoint_stats.var(false);
         globals.logEvidence_structure[Kindex][mainRep] = globals.structure_loglike_mean[Kindex][mainRep] - 0.5*globals.structure_loglike_var[Kindex][mainRep];
+        structure_stats.add(globals.logEvidence_structure[Kindex][mainRep]);
         
-        // calculate elements of Evanno's delta K for the *previous* iteration
-        if (Kindex>0)
-            globals.L_1[Kindex][mainRep] = globals.logEvidence_structure[Kindex][mainRep]-globals.logEvidence_structure[Kindex-1][mainRep];
-        if (Kindex>1) {
-            globals.L_2[Kindex-1][mainRep] = abs(globals.L_1[Kindex][mainRep]-globals.L_1[Kindex-1][mainRep]);
+        // effective sample size of marginal likelihoods
+        globals.logLikeGroup_ESS[Kindex][mainRep] = calculateESS(mainMCMC.logLikeGroup_store);
+        
+        // length of burn-in and sampling phases (which may have been cut short)
+        globals.mainBurnin_used[Kindex][mainRep] = mainMCMC.burnin;
+        globals.mainSamples_used[Kindex][mainRep] = mainMCMC.samples;
+        
+    };
+    
+    // the accumulators are saved to the checkpoint after every repeat. When resuming, they are read back and the repeats that were already complete are skipped.
+    auto writeAccumulators = [&](string &accumulators) {
+        appendValue(accumulators, Qmatrix_ind_stats);
+        appendValue(accumulators, Qmatrix_pop_stats);
+        appendValue(accumulators, harmonic_stats);
+        appendValue(accumulators, structure_stats);
+    };
+    if (checkpoint.mainRepsSaved>0) {
+        binaryReader r(checkpoint.mainAccumulators);
+        readValue(r, Qmatrix_ind_stats);
+        readValue(r, Qmatrix_pop_stats);
+        readValue(r, harmonic_stats);
+        readValue(r, structure_stats);
+        if (r.failed) {
+            errorExit("\nError: unable to read checkpoint file "+checkpoint.filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+        }
+    }
+    
+    if (!globals.parallelRepeats_on) {
+        
+        // define MCMC object
+        MCMCobject_noAdmixture mainMCMC(globals, Kindex, globals.mainBurnin, globals.mainSamples, globals.mainThinning, 1.0, globals.fixLabels_on);
+        mainMCMC.adaptiveBurnin = globals.mainAdaptiveBurnin_on;
+        mainMCMC.targetSE = globals.mainTargetSE;
+        if (globals.checkpointInterval>0) {
+            mainMCMC.checkpoint = &checkpoint;
+        }
+        mainMCMC.profile = profile;
+        
+        // when resuming, read back the state of the chain at the last checkpoint. This is either part way through the first repeat that is not yet complete, or at the end of the repeat before it.
+        int resumeRep = -1;
+        if (!checkpoint.chainState[0].empty()) {
+            if (!mainMCMC.readState(checkpoint.chainState[0], resumeRep)) {
+                errorExit("\nError: unable to read checkpoint file "+checkpoint.filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+            }
+        }
+        
+        // repeat analysis multiple times. The running Qmatrix is carried over between repeats, so that labels are consistent throughout.
+        for (int mainRep=checkpoint.mainRepsSaved; mainRep<globals.mainRepeats; mainRep++) {
+            coutAndLog_K("  analysis "+to_string((long long)mainRep+1)+" of "+to_string((long long)globals.mainRepeats)+"\n", globals, Kindex);
+            
+            // perform MCMC, drawing random numbers from the stream allocated to this repeat
+            if (mainRep==resumeRep) {
+                coutAndLog_K("  resuming from iteration "+to_string((long long)mainMCMC.firstIteration+1)+"\n", globals, Kindex);
+            } else {
+                mainMCMC.RNG = RNGstream(globals.seed, Kindex, RNG_MAIN, mainRep);
+                if (mainRep==0) {
+                    mainMCMC.reset(true);
+                } else {
+                    mainMCMC.reset(false);
+                }
+            }
+            mainMCMC.perform_MCMC(globals, true, true, globals.fixLabels_on, globals.outputLikelihood_on, globals.outputPosteriorGrouping_on, mainRep);
+            
+            saveRep(mainMCMC, mainRep);
+            
+            // save the accumulators and the final state of the chain (including the running Qmatrix that is carried over to the next repeat)
+            if (globals.checkpointInterval>0) {
+                string accumulators, state;
+                writeAccumulators(accumulators);
+                mainMCMC.writeState(state, mainRep, globals.mainBurnin+globals.mainSamples);
+                checkpoint.saveRepeat(globals, mainRep+1, accumulators, 0, state);
+            }
         }
         
+    } else {
+        coutAndLog_K("  analyses 1 to "+to_string((long long)globals.mainRepeats)+" running in parallel\n", globals, Kindex);
+        
+        // run each repeat as an independent chain with its own MCMC object
+        vector< unique_ptr<MCMCobject_noAdmixture> > chains(globals.mainRepeats);
+        vector<int> reps(globals.mainRepeats);
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            reps[mainRep] = mainRep;
+        }
+        
+        // each chain has its own profile, and these are added together once all chains are complete
+        vector<profileObject> chainProfiles(globals.mainRepeats);
+        parallelFor(reps, [&](int mainRep) {
+            chains[mainRep] = unique_ptr<MCMCobject_noAdmixture>(new MCMCobject_noAdmixture(globals, Kindex, globals.mainBurnin, globals.mainSamples, globals.mainThinning, 1.0, globals.fixLabels_on));
+            
+            // when resuming, chains that reached a checkpoint carry on from there, and all others start again
+            if (!checkpoint.chainState[mainRep].empty()) {
+                int savedRep = -1;
+                if (!chains[mainRep]->readState(checkpoint.chainState[mainRep], savedRep) || savedRep!=mainRep) {
+                    errorExit("\nError: unable to read checkpoint file "+checkpoint.filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+                }
+            } else {
+                chains[mainRep]->RNG = RNGstream(globals.seed, Kindex, RNG_MAIN, mainRep);
+                chains[mainRep]->reset(true);
+            }
+            chains[mainRep]->adaptiveBurnin = globals.mainAdaptiveBurnin_on;
+            chains[mainRep]->targetSE = globals.mainTargetSE;
+            if (globals.checkpointInterval>0) {
+                chains[mainRep]->checkpoint = &checkpoint;
+                chains[mainRep]->checkpointChain = mainRep;
+            }
+            if (profile) {
+                chains[mainRep]->profile = &chainProfiles[mainRep];
+            }
+            chains[mainRep]->perform_MCMC(globals, true, true, globals.fixLabels_on, globals.outputLikelihood_on, globals.outputPosteriorGrouping_on, mainRep);
+        });
+        
+        // chains do not share a running Qmatrix, so align the labels of each chain to the first chain before saving. Repeats are saved in order, so that results do not depend on which chain finished first.
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            if (globals.fixLabels_on && mainRep>0) {
+                vector<int> bestPerm = alignLabels(globals, chains[0]->Qmatrix_ind, chains[mainRep]->Qmatrix_ind);
+                permuteColumns(chains[mainRep]->Qmatrix_ind, bestPerm);
+                permuteColumns(chains[mainRep]->Qmatrix_pop, bestPerm);
+            }
+            saveRep(*chains[mainRep], mainRep);
+            if (profile) {
+                profile->merge(chainProfiles[mainRep]);
+            }
+            
+            // the first chain is kept as the reference for aligning labels, but all others can be freed as soon as they are saved
+            if (mainRep>0) {
+                chains[mainRep].reset();
+            }
+        }
     }
     
     // save Qmatrices
     if (globals.fixLabels_on) {
         for (int i=0; i<globals.n; i++) {
             for (int k=0; k<K; k++) {
-                globals.Qmatrix_ind[Kindex][i][k] = mean(Qmatrix_ind_allReps[i][k]);
-                globals.QmatrixError_ind[Kindex][i][k] = sqrt(var(Qmatrix_ind_allReps[i][k])/double(globals.mainRepeats));
+                globals.Qmatrix_ind[Kindex][i][k] = Qmatrix_ind_stats.getMean(i,k);
+                globals.QmatrixError_ind[Kindex][i][k] = sqrt(Qmatrix_ind_stats.var(i,k)/double(globals.mainRepeats));
             }
         }
         if (globals.outputQmatrix_pop_on) {
             for (int i=0; i<int(globals.uniquePops.size()); i++) {
                 for (int k=0; k<K; k++) {
-                    globals.Qmatrix_pop[Kindex][i][k] = mean(Qmatrix_pop_allReps[i][k]);
-                    globals.QmatrixError_pop[Kindex][i][k] = sqrt(var(Qmatrix_pop_allReps[i][k]));
+                    globals.Qmatrix_pop[Kindex][i][k] = Qmatrix_pop_stats.getMean(i,k);
+                    globals.QmatrixError_pop[Kindex][i][k] = sqrt(Qmatrix_pop_stats.var(i,k));
                 }
             }
         }
     }
     
+    reportRunLengths(globals, Kindex);
+    
     // calculate grand mean and standard error of harmonic mean estimator
-    globals.logEvidence_harmonic_grandMean[Kindex] = mean(globals.logEvidence_harmonic[Kindex]);
+    globals.logEvidence_harmonic_grandMean[Kindex] = harmonic_stats.mean;
     if (globals.mainRepeats>1) {
-        globals.logEvidence_harmonic_grandSE[Kindex] = sqrt(var(globals.logEvidence_harmonic[Kindex], 0, true)/globals.mainRepeats);
+        globals.logEvidence_harmonic_grandSE[Kindex] = sqrt(harmonic_stats.var()/globals.mainRepeats);
     }
     
     // calculate grand mean and standard error of Structure estimator
-    globals.logEvidence_structure_grandMean[Kindex] = mean(globals.logEvidence_structure[Kindex]);
+    globals.logEvidence_structure_grandMean[Kindex] = structure_stats.mean;
     if (globals.mainRepeats>1) {
-        globals.logEvidence_structure_grandSE[Kindex] = sqrt(var(globals.logEvidence_structure[Kindex], 0, true)/globals.mainRepeats);
-    }
-    
-    // finalise calculation of Evanno's delta K for *previous* iteration
-    if (Kindex>1) {
-        globals.delta_K[Kindex-1] = mean(globals.L_2[Kindex-1])/sqrt(var(globals.logEvidence_structure[Kindex-1], 0, true));
+        globals.logEvidence_structure_grandSE[Kindex] = sqrt(structure_stats.var()/globals.mainRepeats);
     }
     
 }
 
 //------------------------------------------------
 // main Structure MCMC under admixture model, repeated multiple times
-void mainMCMC_admixture(globals &globals, int Kindex) {
+void mainMCMC_admixture(globals &globals, int Kindex, checkpointObject &checkpoint, profileObject *profile) {
     int K = globals.Kmin+Kindex;
     
-    // define temporary Qmatrix objects for calculating mean and sd over mainRepeats
-    vector< vector< vector<double> > > Qmatrix_gene_allReps(globals.geneCopies, vector< vector<double> >(K, vector<double>(globals.mainRepeats)));
-    vector< vector< vector<double> > > Qmatrix_ind_allReps(globals.n, vector< vector<double> >(K, vector<double>(globals.mainRepeats)));
-    vector< vector< vector<double> > > Qmatrix_pop_allReps(globals.uniquePops.size(), vector< vector<double> >(K, vector<double>(globals.mainRepeats)));
-    
-    // define MCMC object
-    MCMCobject_admixture mainMCMC(globals, Kindex, globals.mainBurnin, globals.mainSamples, globals.mainThinning, 1.0);
+    // define accumulators for calculating mean and sd of Qmatrices and evidence estimators over mainRepeats. Memory use does not depend on the number of repeats.
+    welfordMatrix Qmatrix_gene_stats, Qmatrix_ind_stats, Qmatrix_pop_stats;
+    if (globals.fixLabels_on) {
+        Qmatrix_gene_stats.reset(globals.geneCopies, K);
+    }
+    Qmatrix_ind_stats.reset(globals.n, K);
+    Qmatrix_pop_stats.reset(int(globals.uniquePops.size()), K);
+    welford harmonic_stats, structure_stats;
     
-    // repeat analysis multiple times
-    for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
-        coutAndLog("  analysis "+to_string((long long)mainRep+1)+" of "+to_string((long long)globals.mainRepeats)+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+    // save the output of a single completed repeat
+    auto saveRep = [&](MCMCobject_admixture &mainMCMC, int mainRep) {
         
-        // perform MCMC
-        if (mainRep==0) {
-            mainMCMC.reset(true);
-        } else {
-            mainMCMC.reset(false);
-        }
-		mainMCMC.perform_MCMC(globals, true, false, globals.fixLabels_on, globals.outputLikelihood_on, globals.outputPosteriorGrouping_on, mainRep);
-        
-        // save Qmatrix values
+        // add Qmatrix values to running mean and variance
         if (globals.fixLabels_on) {
-            for (int i=0; i<globals.geneCopies; i++) {
-                for (int k=0; k<K; k++) {
-                    Qmatrix_gene_allReps[i][k][mainRep] = mainMCMC.Qmatrix_gene[i][k];
-                    /*
-                    if (k!=0)
-                        globals.junk_fileStream << "\t";
-                    globals.junk_fileStream << mainMCMC.Qmatrix_gene[i][k];
-                    */
-                }
-                //globals.junk_fileStream << "\n";
-            }
-            for (int i=0; i<globals.n; i++) {
-                for (int k=0; k<K; k++) {
-                    Qmatrix_ind_allReps[i][k][mainRep] = mainMCMC.Qmatrix_ind[i][k];
-                }
-            }
+            Qmatrix_gene_stats.add(mainMCMC.Qmatrix_gene);
+            Qmatrix_ind_stats.add(mainMCMC.Qmatrix_ind);
             if (globals.outputQmatrix_pop_on) {
-                for (int i=0; i<int(globals.uniquePops.size()); i++) {
-                    for (int k=0; k<K; k++) {
-                        Qmatrix_pop_allReps[i][k][mainRep] = mainMCMC.Qmatrix_pop[i][k];
-                    }
-                }
+                Qmatrix_pop_stats.add(mainMCMC.Qmatrix_pop);
             }
         }
         
         // save harmonic mean of marginal likelihoods
         globals.logEvidence_harmonic[Kindex][mainRep] = mainMCMC.harmonic;
+        harmonic_stats.add(mainMCMC.harmonic);
         
         // calculate Structure estimator from joint likelihoods
-        globals.structure_loglike_mean[Kindex][mainRep] = mainMCMC.logLikeJoint_sum/double(globals.mainSamples);
-        globals.structure_loglike_var[Kindex][mainRep] = mainMCMC.logLikeJoint_sumSquared/double(globals.mainSamples) - globals.structure_loglike_mean[Kindex][mainRep]*globals.structure_loglike_mean[Kindex][mainRep];
+        globals.structure_loglike_mean[Kindex][mainRep] = mainMCMC.logLikeJoint_stats.mean;
+        globals.structure_loglike_var[Kindex][mainRep] = mainMCMC.logLikeJoint_stats.var(false);
         globals.logEvidence_structure[Kindex][mainRep] = globals.structure_loglike_mean[Kindex][mainRep] - 0.5*globals.structure_loglike_var[Kindex][mainRep];
+        structure_stats.add(globals.logEvidence_structure[Kindex][mainRep]);
         
-        // calculate elements of Evanno's delta K for the *previous* iteration
-        if (Kindex>0)
-            globals.L_1[Kindex][mainRep] = globals.logEvidence_structure[Kindex][mainRep]-globals.logEvidence_structure[Kindex-1][mainRep];
-        if (Kindex>1) {
-            globals.L_2[Kindex-1][mainRep] = abs(globals.L_1[Kindex][mainRep]-globals.L_1[Kindex-1][mainRep]);
+        // effective sample size of marginal likelihoods
+        globals.logLikeGroup_ESS[Kindex][mainRep] = calculateESS(mainMCMC.logLikeGroup_store);
+        
+        // length of burn-in and sampling phases (which may have been cut short)
+        globals.mainBurnin_used[Kindex][mainRep] = mainMCMC.burnin;
+        globals.mainSamples_used[Kindex][mainRep] = mainMCMC.samples;
+        
+    };
+    
+    // the accumulators are saved to the checkpoint after every repeat. When resuming, they are read back and the repeats that were already complete are skipped.
+    auto writeAccumulators = [&](string &accumulators) {
+        appendValue(accumulators, Qmatrix_gene_stats);
+        appendValue(accumulators, Qmatrix_ind_stats);
+        appendValue(accumulators, Qmatrix_pop_stats);
+        appendValue(accumulators, harmonic_stats);
+        appendValue(accumulators, structure_stats);
+    };
+    if (checkpoint.mainRepsSaved>0) {
+        binaryReader r(checkpoint.mainAccumulators);
+        readValue(r, Qmatrix_gene_stats);
+        readValue(r, Qmatrix_ind_stats);
+        readValue(r, Qmatrix_pop_stats);
+        readValue(r, harmonic_stats);
+        readValue(r, structure_stats);
+        if (r.failed) {
+            errorExit("\nError: unable to read checkpoint file "+checkpoint.filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
         }
+    }
+    
+    if (!globals.parallelRepeats_on) {
         
+        // define MCMC object
+        MCMCobject_admixture mainMCMC(globals, Kindex, globals.mainBurnin, globals.mainSamples, globals.mainThinning, 1.0, globals.fixLabels_on);
+        mainMCMC.adaptiveBurnin = globals.mainAdaptiveBurnin_on;
+        mainMCMC.targetSE = globals.mainTargetSE;
+        if (globals.checkpointInterval>0) {
+            mainMCMC.checkpoint = &checkpoint;
+        }
+        mainMCMC.profile = profile;
+        
+        // when resuming, read back the state of the chain at the last checkpoint. This is either part way through the first repeat that is not yet complete, or at the end of the repeat before it.
+        int resumeRep = -1;
+        if (!checkpoint.chainState[0].empty()) {
+            if (!mainMCMC.readState(checkpoint.chainState[0], resumeRep)) {
+                errorExit("\nError: unable to read checkpoint file "+checkpoint.filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+            }
+        }
+        
+        // repeat analysis multiple times. The running Qmatrix is carried over between repeats, so that labels are consistent throughout.
+        for (int mainRep=checkpoint.mainRepsSaved; mainRep<globals.mainRepeats; mainRep++) {
+            coutAndLog_K("  analysis "+to_string((long long)mainRep+1)+" of "+to_string((long long)globals.mainRepeats)+"\n", globals, Kindex);
+            
+            // perform MCMC, drawing random numbers from the stream allocated to this repeat
+            if (mainRep==resumeRep) {
+                coutAndLog_K("  resuming from iteration "+to_string((long long)mainMCMC.firstIteration+1)+"\n", globals, Kindex);
+            } else {
+                mainMCMC.RNG = RNGstream(globals.seed, Kindex, RNG_MAIN, mainRep);
+                if (mainRep==0) {
+                    mainMCMC.reset(true);
+                } else {
+                    mainMCMC.reset(false);
+                }
+            }
+            mainMCMC.perform_MCMC(globals, true, true, globals.fixLabels_on, globals.outputLikelihood_on, globals.outputPosteriorGrouping_on, mainRep);
+            
+            saveRep(mainMCMC, mainRep);
+            
+            // save the accumulators and the final state of the chain (including the running Qmatrix that is carried over to the next repeat)
+            if (globals.checkpointInterval>0) {
+                string accumulators, state;
+                writeAccumulators(accumulators);
+                mainMCMC.writeState(state, mainRep, globals.mainBurnin+globals.mainSamples);
+                checkpoint.saveRepeat(globals, mainRep+1, accumulators, 0, state);
+            }
+        }
+        
+    } else {
+        coutAndLog_K("  analyses 1 to "+to_string((long long)globals.mainRepeats)+" running in parallel\n", globals, Kindex);
+        
+        // run each repeat as an independent chain with its own MCMC object
+        vector< unique_ptr<MCMCobject_admixture> > chains(globals.mainRepeats);
+        vector<int> reps(globals.mainRepeats);
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            reps[mainRep] = mainRep;
+        }
+        
+        // each chain has its own profile, and these are added together once all chains are complete
+        vector<profileObject> chainProfiles(globals.mainRepeats);
+        parallelFor(reps, [&](int mainRep) {
+            chains[mainRep] = unique_ptr<MCMCobject_admixture>(new MCMCobject_admixture(globals, Kindex, globals.mainBurnin, globals.mainSamples, globals.mainThinning, 1.0, globals.fixLabels_on));
+            
+            // when resuming, chains that reached a checkpoint carry on from there, and all others start again
+            if (!checkpoint.chainState[mainRep].empty()) {
+                int savedRep = -1;
+                if (!chains[mainRep]->readState(checkpoint.chainState[mainRep], savedRep) || savedRep!=mainRep) {
+                    errorExit("\nError: unable to read checkpoint file "+checkpoint.filePath+"\n", globals.outputLog_on, globals.outputLog_fileStream);
+                }
+            } else {
+                chains[mainRep]->RNG = RNGstream(globals.seed, Kindex, RNG_MAIN, mainRep);
+                chains[mainRep]->reset(true);
+            }
+            chains[mainRep]->adaptiveBurnin = globals.mainAdaptiveBurnin_on;
+            chains[mainRep]->targetSE = globals.mainTargetSE;
+            if (globals.checkpointInterval>0) {
+                chains[mainRep]->checkpoint = &checkpoint;
+                chains[mainRep]->checkpointChain = mainRep;
+            }
+            if (profile) {
+                chains[mainRep]->profile = &chainProfiles[mainRep];
+            }
+            chains[mainRep]->perform_MCMC(globals, true, true, globals.fixLabels_on, globals.outputLikelihood_on, globals.outputPosteriorGrouping_on, mainRep);
+        });
+        
+        // chains do not share a running Qmatrix, so align the labels of each chain to the first chain before saving. Repeats are saved in order, so that results do not depend on which chain finished first.
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            if (globals.fixLabels_on && mainRep>0) {
+                vector<int> bestPerm = alignLabels(globals, chains[0]->Qmatrix_gene, chains[mainRep]->Qmatrix_gene);
+                permuteColumns(chains[mainRep]->Qmatrix_gene, bestPerm);
+                permuteColumns(chains[mainRep]->Qmatrix_ind, bestPerm);
+                permuteColumns(chains[mainRep]->Qmatrix_pop, bestPerm);
+            }
+            saveRep(*chains[mainRep], mainRep);
+            if (profile) {
+                profile->merge(chainProfiles[mainRep]);
+            }
+            
+            // the first chain is kept as the reference for aligning labels, but all others can be freed as soon as they are saved
+            if (mainRep>0) {
+                chains[mainRep].reset();
+            }
+        }
     }
     
     // save Qmatrices
     if (globals.fixLabels_on) {
         for (int i=0; i<globals.geneCopies; i++) {
             for (int k=0; k<K; k++) {
-                globals.Qmatrix_gene[Kindex][i][k] = mean(Qmatrix_gene_allReps[i][k]);
-                globals.QmatrixError_gene[Kindex][i][k] = sqrt(var(Qmatrix_gene_allReps[i][k])/double(globals.mainRepeats));
+                globals.Qmatrix_gene[Kindex][i][k] = Qmatrix_gene_stats.getMean(i,k);
+                globals.QmatrixError_gene[Kindex][i][k] = sqrt(Qmatrix_gene_stats.var(i,k)/double(globals.mainRepeats));
             }
         }
         for (int i=0; i<globals.n; i++) {
             for (int k=0; k<K; k++) {
-                globals.Qmatrix_ind[Kindex][i][k] = mean(Qmatrix_ind_allReps[i][k]);
-                globals.QmatrixError_ind[Kindex][i][k] = sqrt(var(Qmatrix_ind_allReps[i][k]));
+                globals.Qmatrix_ind[Kindex][i][k] = Qmatrix_ind_stats.getMean(i,k);
+                globals.QmatrixError_ind[Kindex][i][k] = sqrt(Qmatrix_ind_stats.var(i,k));
             }
         }
         if (globals.outputQmatrix_pop_on) {
             for (int i=0; i<int(globals.uniquePops.size()); i++) {
                 for (int k=0; k<K; k++) {
-                    globals.Qmatrix_pop[Kindex][i][k] = mean(Qmatrix_pop_allReps[i][k]);
-                    globals.QmatrixError_pop[Kindex][i][k] = sqrt(var(Qmatrix_pop_allReps[i][k]));
+                    globals.Qmatrix_pop[Kindex][i][k] = Qmatrix_pop_stats.getMean(i,k);
+                    globals.QmatrixError_pop[Kindex][i][k] = sqrt(Qmatrix_pop_stats.var(i,k));
                 }
             }
         }
     }
     
+    reportRunLengths(globals, Kindex);
+    
     // calculate grand mean and standard error of harmonic mean estimator
-    globals.logEvidence_harmonic_grandMean[Kindex] = mean(globals.logEvidence_harmonic[Kindex]);
+    globals.logEvidence_harmonic_grandMean[Kindex] = harmonic_stats.mean;
     if (globals.mainRepeats>1) {
-        globals.logEvidence_harmonic_grandSE[Kindex] = sqrt(var(globals.logEvidence_harmonic[Kindex], 0, true)/globals.mainRepeats);
+        globals.logEvidence_harmonic_grandSE[Kindex] = sqrt(harmonic_stats.var()/globals.mainRepeats);
     }
     
     // calculate grand mean and standard error of Structure estimator
-    globals.logEvidence_structure_grandMean[Kindex] = mean(globals.logEvidence_structure[Kindex]);
+    globals.logEvidence_structure_grandMean[Kindex] = structure_stats.mean;
     if (globals.mainRepeats>1) {
-        globals.logEvidence_structure_grandSE[Kindex] = sqrt(var(globals.logEvidence_structure[Kindex], 0, true)/globals.mainRepeats);
+        globals.logEvidence_structure_grandSE[Kindex] = sqrt(structure_stats.var()/globals.mainRepeats);
     }
     
-    // finalise calculation of Evanno's delta K for *previous* iteration
-    if (Kindex>1) {
-        globals.delta_K[Kindex-1] = mean(globals.L_2[Kindex-1])/sqrt(var(globals.logEvidence_structure[Kindex-1], 0, true));
+}
+
+//------------------------------------------------
+// calculate Evanno's delta K from the Structure estimator. Each K depends on its neighbours, so this must be run once the main MCMC has completed for all K.
+void calculateEvanno(globals &globals) {
+    
+    for (int Kindex=1; Kindex<(globals.Kmax-globals.Kmin+1); Kindex++) {
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            globals.L_1[Kindex][mainRep] = globals.logEvidence_structure[Kindex][mainRep]-globals.logEvidence_structure[Kindex-1][mainRep];
+            if (Kindex>1) {
+                globals.L_2[Kindex-1][mainRep] = abs(globals.L_1[Kindex][mainRep]-globals.L_1[Kindex-1][mainRep]);
+            }
+        }
+        if (Kindex>1) {
+            globals.delta_K[Kindex-1] = mean(globals.L_2[Kindex-1])/sqrt(var(globals.logEvidence_structure[Kindex-1], 0, true));
+        }
     }
     
 }
\ No newline at end of file
@@ -19,14 +19,31 @@
 #include "misc.h"
 #include "MCMCobject_noAdmixture.h"
 #include "MCMCobject_admixture.h"
+#include "checkpoint.h"
 
 //------------------------------------------------
-// main Structure MCMC under no-admixture model, repeated multiple times
-void mainMCMC_noAdmixture(globals &globals, int Kindex);
+// find the permutation of labels that best matches the Qmatrix Q to the reference Qmatrix Qref, using the same Kullback-Leibler cost as when fixing labels within the MCMC. Element k of the result gives the new label of group k.
+std::vector<int> alignLabels(globals &globals, std::vector< std::vector<double> > &Qref, std::vector< std::vector<double> > &Q);
 
 //------------------------------------------------
-// main Structure MCMC under admixture model, repeated multiple times
-void mainMCMC_admixture(globals &globals, int Kindex);
+// re-order the columns of a Qmatrix, such that column k moves to column bestPerm[k]
+void permuteColumns(std::vector< std::vector<double> > &Q, std::vector<int> &bestPerm);
+
+//------------------------------------------------
+// report effective sample sizes of all repeats, along with the length of burn-in and sampling phases if these were chosen adaptively
+void reportRunLengths(globals &globals, int Kindex);
+
+//------------------------------------------------
+// main Structure MCMC under no-admixture model, repeated multiple times. If parallelRepeats_on, repeats are run as independent chains spread over the available threads. Progress is saved to the checkpoint of this K, and if the checkpoint has been read back from file then the MCMC carries on from where it left off. If profile is set then the time spent in each phase of the MCMC is added to it.
+void mainMCMC_noAdmixture(globals &globals, int Kindex, checkpointObject &checkpoint, profileObject *profile=0);
+
+//------------------------------------------------
+// main Structure MCMC under admixture model, repeated multiple times. If parallelRepeats_on, repeats are run as independent chains spread over the available threads. Progress is saved to the checkpoint of this K, and if the checkpoint has been read back from file then the MCMC carries on from where it left off. If profile is set then the time spent in each phase of the MCMC is added to it.
+void mainMCMC_admixture(globals &globals, int Kindex, checkpointObject &checkpoint, profileObject *profile=0);
+
+//------------------------------------------------
+// calculate Evanno's delta K from the Structure estimator. Each K depends on its neighbours, so this must be run once the main MCMC has completed for all K.
+void calculateEvanno(globals &globals);
 
 
 #endif
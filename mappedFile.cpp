@@ -0,0 +1,123 @@
+//
+//  MavericK
+//  mappedFile.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include <fstream>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "mappedFile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+//------------------------------------------------
+// mappedFile::
+// constructor
+mappedFile::mappedFile() {
+    data = 0;
+    size = 0;
+    map = 0;
+}
+
+//------------------------------------------------
+// mappedFile::
+// destructor
+mappedFile::~mappedFile() {
+    close();
+}
+
+//------------------------------------------------
+// mappedFile::
+// open file, returning false if it cannot be read. Empty files are valid and give size 0.
+bool mappedFile::open(const string &fileName) {
+    close();
+    
+#ifndef _WIN32
+    // memory-map the file if possible
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd<0) {
+        return(false);
+    }
+    struct stat st;
+    if (fstat(fd, &st)==0 && st.st_size>0) {
+        void *m = mmap(0, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m!=MAP_FAILED) {
+            // the file is read once from start to end
+            madvise(m, size_t(st.st_size), MADV_SEQUENTIAL);
+            ::close(fd);
+            map = m;
+            data = static_cast<const char*>(m);
+            size = size_t(st.st_size);
+            return(true);
+        }
+    }
+    ::close(fd);
+#endif
+    
+    // otherwise read whole file into memory
+    ifstream fileStream(fileName, ios::in | ios::binary);
+    if (!fileStream.is_open()) {
+        return(false);
+    }
+    fileStream.seekg(0, ios::end);
+    streamoff length = fileStream.tellg();
+    fileStream.seekg(0, ios::beg);
+    buffer.resize(size_t(length>0 ? length : 0));
+    if (length>0) {
+        fileStream.read(&buffer[0], length);
+    }
+    data = buffer.data();
+    size = buffer.size();
+    return(true);
+}
+
+//------------------------------------------------
+// mappedFile::
+// release file contents
+void mappedFile::close() {
+#ifndef _WIN32
+    if (map) {
+        munmap(map, size);
+    }
+#endif
+    map = 0;
+    buffer.clear();
+    data = 0;
+    size = 0;
+}
+
+//------------------------------------------------
+// mappedFile::
+// 64-bit hash of the file contents. The contents are read eight bytes at a time, and each word is mixed into the hash by a multiply and shift, which runs at close to memory speed. The size is mixed in at the start so that files differing only by trailing zeros give different hashes, and the result is passed through the finaliser of splitmix64.
+uint64_t mappedFile::hash() const {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ uint64_t(size);
+    size_t words = size/8;
+    for (size_t i=0; i<words; i++) {
+        uint64_t w;
+        memcpy(&w, data+8*i, 8);
+        h = (h ^ w)*0xFF51AFD7ED558CCDULL;
+        h ^= h>>32;
+    }
+    if (size>8*words) {
+        uint64_t w = 0;
+        memcpy(&w, data+8*words, size-8*words);
+        h = (h ^ w)*0xFF51AFD7ED558CCDULL;
+        h ^= h>>32;
+    }
+    h = (h ^ (h>>30))*0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h>>27))*0x94D049BB133111EBULL;
+    return(h ^ (h>>31));
+}
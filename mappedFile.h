@@ -0,0 +1,56 @@
+//
+//  MavericK
+//  mappedFile.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines a class giving read-only access to the entire contents of a file as a single block of memory. On systems that support it the file is memory-mapped, so that it is paged in by the operating system as it is read rather than being copied onto the heap. Elsewhere (e.g. Windows) the file is simply read into memory in one go.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__mappedFile__
+#define __Maverick1_0__mappedFile__
+
+#include <string>
+#include <stdint.h>
+
+//------------------------------------------------
+// class giving read-only access to the contents of a file
+class mappedFile {
+    
+public:
+    
+    // PUBLIC OBJECTS
+    
+    // pointer to the start of the file contents, and size in bytes
+    const char *data;
+    size_t size;
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor and destructor
+    mappedFile();
+    ~mappedFile();
+    
+    // open file, returning false if it cannot be read
+    bool open(const std::string &fileName);
+    void close();
+    
+    // 64-bit hash of the file contents (not cryptographic, but any change to the contents changes the hash with overwhelming probability)
+    uint64_t hash() const;
+    
+private:
+    
+    // PRIVATE OBJECTS
+    
+    // memory map (if used), otherwise copy of file contents
+    void *map;
+    std::string buffer;
+    
+    // prevent copying
+    mappedFile(const mappedFile&);
+    mappedFile& operator=(const mappedFile&);
+    
+};
+
+#endif
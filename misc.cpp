@@ -71,8 +71,8 @@ vector<double> normalise_log(vector<double> x) {
 }
 
 //------------------------------------------------
-// exponentiate and normalise random variables to sum to 1 by simulation. Return mean values, and upper and lower 95% confidence intervals (q0.025 and q0.975).
-void normalise_log_sim(vector<double> &normMean, vector<double> &LL, vector<double> &UL, vector<double> x_mean, vector<double> x_sd, int draws) {
+// exponentiate and normalise random variables to sum to 1 by simulation, drawing random numbers from the stream RNG. Return mean values, and upper and lower 95% confidence intervals (q0.025 and q0.975).
+void normalise_log_sim(vector<double> &normMean, vector<double> &LL, vector<double> &UL, vector<double> x_mean, vector<double> x_sd, int draws, RNGobject &RNG) {
     
     // subtract maximum value from x_mean (this has no effect on final outcome but prevents under/overflow)
     int n = int(x_mean.size());
@@ -89,7 +89,7 @@ void normalise_log_sim(vector<double> &normMean, vector<double> &LL, vector<doub
     for (int i=0; i<draws; i++) {
         Ysum = 0;
         for (int j=0; j<n; j++) {
-            X[j] = rnorm1(x_mean[j], x_sd[j]);
+            X[j] = RNG.rnorm1(x_mean[j], x_sd[j]);
             Y[j] = exp(X[j]);
             Ysum += Y[j];
         }
@@ -276,8 +276,7 @@ void checkBoolean(string param_string, bool &param_final, string param_name, boo
     } else if (param_string=="0" || param_string=="0\r" || param_string=="false" || param_string=="false\r" || param_string=="False" || param_string=="False\r" || param_string=="FALSE" || param_string=="FALSE\r" || param_string=="f" || param_string=="f\r" || param_string=="F" || param_string=="F\r") {
         param_final = false;
     } else {
-        cerrAndLog("\nError: '"+param_name+"' parameter must take on a Boolean value (either 1/t/true/T/True/TRUE or 0/f/false/F/False/FALSE)\n", writeErrorToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: '"+param_name+"' parameter must take on a Boolean value (either 1/t/true/T/True/TRUE or 0/f/false/F/False/FALSE)\n", writeErrorToFile, logFileStream);
     }
 }
 
@@ -289,8 +288,7 @@ void checkInteger(string param_string, int &param_final, string param_name, bool
     if (round(double(param_double))==param_double) {
         param_final = int(param_double);
     } else {
-        cerrAndLog("\nError: '"+param_name+"' parameter must be an integer\n", writeErrorToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: '"+param_name+"' parameter must be an integer\n", writeErrorToFile, logFileStream);
     }
 }
 
@@ -298,14 +296,12 @@ void checkInteger(string param_string, int &param_final, string param_name, bool
 // check that param_value is greater than zero (overloaded for integer and double). If fail test then print error message to screen, and to logFileStream if writeErrorToFile is true. param_name gives the name of the parameter to be used in error message.
 void checkGrZero(string param_name, int param_value, bool writeErrorToFile, ofstream &logFileStream) {
     if (!(param_value>0)) {
-        cerrAndLog("\nError: '"+param_name+"' parameter must be greater than zero\n", writeErrorToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: '"+param_name+"' parameter must be greater than zero\n", writeErrorToFile, logFileStream);
     }
 }
 void checkGrZero(string param_name, double param_value, bool writeErrorToFile, ofstream &logFileStream) {
     if (!(param_value>0)) {
-        cerrAndLog("\nError: '"+param_name+"' parameter must be greater than zero\n", writeErrorToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: '"+param_name+"' parameter must be greater than zero\n", writeErrorToFile, logFileStream);
     }
 }
 
@@ -313,14 +309,12 @@ void checkGrZero(string param_name, double param_value, bool writeErrorToFile, o
 // check that param_value is greater than or equal to zero (overloaded for integer and double). If fail test then print error message to screen, and to logFileStream if writeErrorToFile is true. param_name gives the name of the parameter to be used in error message.
 void checkGrEqZero(string param_name, int param_value, bool writeErrorToFile, ofstream &logFileStream) {
     if (!(param_value>=0)) {
-        cerrAndLog("\nError: '"+param_name+"' parameter must be greater than or equal to zero\n", writeErrorToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: '"+param_name+"' parameter must be greater than or equal to zero\n", writeErrorToFile, logFileStream);
     }
 }
 void checkGrEqZero(string param_name, double param_value, bool writeErrorToFile, ofstream &logFileStream) {
     if (!(param_value>=0)) {
-        cerrAndLog("\nError: '"+param_name+"' parameter must be greater than or equal to zero\n", writeErrorToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: '"+param_name+"' parameter must be greater than or equal to zero\n", writeErrorToFile, logFileStream);
     }
 }
 
@@ -359,68 +353,154 @@ string process_nan(double x) {
 }
 
 //------------------------------------------------
-// calculate total autocorrelation on a vector of values, where total autocorrelation is defined as 1+2*(sum over lags until reach zero). This number is equivalent to the number of iterations needed to obtain one approximately independent draw (1 being the best). Note that this function calculates raw autocorrelation of the vector in increasingly large jumps, leading to fine resolution near lag1 and coarser resolution as we get further away.
-double calculateAutoCorr(vector<double> &v) {
+// in-place radix-2 fast Fourier transform (or inverse transform, without the 1/N scaling). The length of x must be a power of 2.
+void fft(vector< complex<double> > &x, bool inverse) {
+    int N = int(x.size());
     
-    // get basic properties of vector
-    int v_size = int(v.size());
-    double mu = mean(v);
-    double sigma2 = var(v);
-    
-    // calculate x range over which autocorrelation will be calculated
-    vector<int> x;
-    int x_largest = 0;
-    int dx = 1;
-    bool break_on = false;
-    for (int l=0; l<100; l++) {
-        for (int j=0; j<100; j++) {
-            x_largest += dx;
-            if (x_largest>v_size) {
-                break_on = true;
-                break;
-            }
-            x.push_back(x_largest);
+    // bit-reversal permutation
+    for (int i=1, j=0; i<N; i++) {
+        int bit = N>>1;
+        for (; j&bit; bit>>=1) {
+            j ^= bit;
         }
-        if (break_on) {
-            break;
+        j ^= bit;
+        if (i<j) {
+            swap(x[i], x[j]);
         }
-        dx *= 2;
     }
     
-    // calculate raw autocorrelation
-    int x_size = int(x.size());
-    vector<double> yy(x_size);
-    vector<double> n(x_size);
-    for (int i=0; i<v_size; i++) {
-        for (int j=0; j<x_size; j++) {
-            if ((i+x[j])>(v_size-1)) {
-                continue;
+    // butterflies
+    for (int len=2; len<=N; len<<=1) {
+        double theta = 2*acos(-1.0)/len*(inverse ? 1 : -1);
+        complex<double> w_len(cos(theta), sin(theta));
+        for (int i=0; i<N; i+=len) {
+            complex<double> w(1,0);
+            for (int j=0; j<len/2; j++) {
+                complex<double> u = x[i+j];
+                complex<double> v = x[i+j+len/2]*w;
+                x[i+j] = u+v;
+                x[i+j+len/2] = u-v;
+                w *= w_len;
             }
-            yy[j] += (v[i]-mu)*(v[i+x[j]]-mu)/sigma2;
-            n[j]++;
         }
     }
-    for (int j=0; j<x_size; j++) {
-        yy[j] /= double(n[j]);
+}
+
+//------------------------------------------------
+// returns true if the variation in a vector of values is negligible (see NEGLIGIBLE_SD), meaning that it is down to rounding error alone and the values should be treated as constant
+bool negligibleVariance(const vector<double> &v) {
+    int v_size = int(v.size());
+    if (v_size<2) {
+        return(true);
+    }
+    double mu = 0;
+    for (int i=0; i<v_size; i++) {
+        mu += v[i];
+    }
+    mu /= double(v_size);
+    double sumSquares = 0;
+    for (int i=0; i<v_size; i++) {
+        sumSquares += (v[i]-mu)*(v[i]-mu);
+    }
+    return(sqrt(sumSquares/double(v_size-1))<=NEGLIGIBLE_SD*fabs(mu));
+}
+
+//------------------------------------------------
+// calculate total autocorrelation on a vector of values, where total autocorrelation is defined as 1+2*(sum over all lags of the autocorrelation function). This number is equivalent to the number of iterations needed to obtain one approximately independent draw (1 being the best). The autocorrelation function is obtained at every lag by FFT, and the sum is truncated using Geyer's initial monotone sequence rule. Values with negligible variance are treated as constant, and so as independent draws, rather than measuring the autocorrelation of rounding error.
+double calculateAutoCorr(const vector<double> &v) {
+    
+    // get basic properties of vector
+    int v_size = int(v.size());
+    if (v_size<4 || negligibleVariance(v)) {
+        return(1);
+    }
+    double mu = 0;
+    for (int i=0; i<v_size; i++) {
+        mu += v[i];
+    }
+    mu /= double(v_size);
+    
+    // obtain autocovariance at all lags from the power spectrum of the centred values. Zero-padding to at least twice the length of the vector stops values from wrapping around.
+    int N = 1;
+    while (N<2*v_size) {
+        N <<= 1;
+    }
+    vector< complex<double> > x(N);
+    for (int i=0; i<v_size; i++) {
+        x[i] = v[i]-mu;
+    }
+    fft(x, false);
+    for (int i=0; i<N; i++) {
+        x[i] = norm(x[i]);
+    }
+    fft(x, true);
+    double acov0 = x[0].real();
+    if (acov0<=0) {
+        return(1);
     }
     
-    // calculate total autocorrelation
-    double autoCorr = yy[0];
-    for (int i=1; i<x_size; i++) {
-        dx = x[i]-x[i-1];
-        if (yy[i]>0) {
-            autoCorr += dx*yy[i-1] - 0.5*(dx+1)*(yy[i-1]-yy[i]);
-        } else {
-            dx = floor((dx*yy[i-1])/(yy[i-1]-yy[i]));
-            autoCorr += dx*yy[i-1] - 0.5*(dx+1)*(yy[i-1]-yy[i]);
+    // sum autocorrelations in adjacent pairs. The sum of each pair is positive and decreasing for a reversible chain, so stop at the first pair that is not positive, and force pairs to be monotone decreasing up to that point (Geyer 1992)
+    double autoCorr = -1;
+    double pairMin = 2;
+    for (int t=0; t+1<v_size; t+=2) {
+        double pair = (x[t].real() + x[t+1].real())/acov0;
+        if (pair<=0) {
             break;
         }
+        pairMin = min(pairMin, pair);
+        autoCorr += 2*pairMin;
     }
-    autoCorr = 1 + 2*autoCorr;
     
     // correct for possible issues
-    if (sigma2==0 || autoCorr<1)
+    if (autoCorr<1)
         autoCorr = 1;
     
     return(autoCorr);
 }
+
+//------------------------------------------------
+// effective sample size of a vector of values, equal to the number of values divided by the total autocorrelation
+double calculateESS(const vector<double> &v) {
+    return(double(v.size())/calculateAutoCorr(v));
+}
+
+//------------------------------------------------
+// standard error of the mean of a vector of (autocorrelated) MCMC draws, using the effective sample size in place of the number of values
+double standardErrorMCMC(const vector<double> &v) {
+    int v_size = int(v.size());
+    if (v_size<2) {
+        return(INFINITY);
+    }
+    double mu = 0;
+    for (int i=0; i<v_size; i++) {
+        mu += v[i];
+    }
+    mu /= double(v_size);
+    double sumSquares = 0;
+    for (int i=0; i<v_size; i++) {
+        sumSquares += (v[i]-mu)*(v[i]-mu);
+    }
+    return(sqrt(sumSquares/double(v_size-1)/calculateESS(v)));
+}
+
+//------------------------------------------------
+// Geweke convergence diagnostic, comparing the first 10% of values with the last 50%. Values with negligible variance (such as an incrementally updated likelihood whose true value never changes) show no sign of drift, and give zero.
+double gewekeZ(const vector<double> &v) {
+    int v_size = int(v.size());
+    vector<double> first(v.begin(), v.begin()+v_size/10);
+    vector<double> last(v.begin()+v_size/2, v.end());
+    if (first.size()<2 || last.size()<2) {
+        return(INFINITY);
+    }
+    if (negligibleVariance(v)) {
+        return(0);
+    }
+    double diff = mean(first)-mean(last);
+    double SE_first = standardErrorMCMC(first);
+    double SE_last = standardErrorMCMC(last);
+    double SE = sqrt(SE_first*SE_first + SE_last*SE_last);
+    if (SE==0) {
+        return(INFINITY);
+    }
+    return(diff/SE);
+}
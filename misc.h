@@ -16,6 +16,7 @@
 #include <iostream>
 #include <random>
 #include <algorithm>
+#include <complex>
 
 #include "probability.h"
 #include "readIn.h"
@@ -25,6 +26,18 @@
 // define very small number for catching underflow problems
 #define UNDERFLO   1e-100
 
+//------------------------------------------------
+// the marginal likelihood logLikeGroup is updated incrementally within the MCMC each time a gene copy changes group, and is recalculated in full every LOGLIKE_RECOMPUTE iterations to stop rounding errors from building up
+#define LOGLIKE_RECOMPUTE 100
+
+//------------------------------------------------
+// burn-in is judged to have converged (when using adaptive run lengths) once the Geweke z-score of the marginal likelihood is below GEWEKE_Z in absolute value
+#define GEWEKE_Z 1.96
+
+//------------------------------------------------
+// a series of values whose standard deviation is no more than NEGLIGIBLE_SD times the magnitude of their mean is treated as constant. Between full recalculations (see LOGLIKE_RECOMPUTE) the incrementally updated marginal likelihood drifts by rounding error even when its true value never changes (for example at K=1), and this drift is many orders of magnitude below this threshold, while any genuine variation in a log-likelihood is many orders of magnitude above it.
+#define NEGLIGIBLE_SD 1e-9
+
 //------------------------------------------------
 // basic sum over elements in a vector (templated for different data types).
 template<class TYPE>
@@ -72,8 +85,8 @@ double harmonicMean(std::vector<double> &x);
 std::vector<double> normalise_log(std::vector<double> x);
 
 //------------------------------------------------
-// exponentiate and normalise random variables to sum to 1 by simulation. Return median values, and upper and lower 95% confidence intervals (q0.025 and q0.975).
-void normalise_log_sim(std::vector<double> &median, std::vector<double> &LL, std::vector<double> &UL, std::vector<double> x_mean, std::vector<double> x_sd, int draws);
+// exponentiate and normalise random variables to sum to 1 by simulation, drawing random numbers from the stream RNG. Return median values, and upper and lower 95% confidence intervals (q0.025 and q0.975).
+void normalise_log_sim(std::vector<double> &median, std::vector<double> &LL, std::vector<double> &UL, std::vector<double> x_mean, std::vector<double> x_sd, int draws, RNGobject &RNG);
 
 //------------------------------------------------
 // return unique elements in a vector (templated for different data types)
@@ -203,7 +216,27 @@ void increment_restrictedGrowth(std::vector<int> &group, int maxVal);
 std::string process_nan(double x);
 
 //------------------------------------------------
-// calculate total autocorrelation on a vector of values, where total autocorrelation is defined as 1+2*(sum over lags until reach zero). This number is equivalent to the number of iterations needed to obtain one approximately independent draw (1 being the best). Note that this function calculates raw autocorrelation of the vector in increasingly large jumps, leading to fine resolution near lag1 and coarser resolution as we get further away.
-double calculateAutoCorr(std::vector<double> &v);
+// in-place radix-2 fast Fourier transform (or inverse transform, without the 1/N scaling). The length of x must be a power of 2.
+void fft(std::vector< std::complex<double> > &x, bool inverse);
+
+//------------------------------------------------
+// returns true if the variation in a vector of values is negligible (see NEGLIGIBLE_SD), meaning that it is down to rounding error alone and the values should be treated as constant
+bool negligibleVariance(const std::vector<double> &v);
+
+//------------------------------------------------
+// calculate total autocorrelation on a vector of values, where total autocorrelation is defined as 1+2*(sum over all lags of the autocorrelation function). This number is equivalent to the number of iterations needed to obtain one approximately independent draw (1 being the best). The autocorrelation function is obtained at every lag by FFT, and the sum is truncated using Geyer's initial monotone sequence rule. Values with negligible variance are treated as constant, and so as independent draws, rather than measuring the autocorrelation of rounding error.
+double calculateAutoCorr(const std::vector<double> &v);
+
+//------------------------------------------------
+// effective sample size of a vector of values, equal to the number of values divided by the total autocorrelation
+double calculateESS(const std::vector<double> &v);
+
+//------------------------------------------------
+// standard error of the mean of a vector of (autocorrelated) MCMC draws, using the effective sample size in place of the number of values
+double standardErrorMCMC(const std::vector<double> &v);
+
+//------------------------------------------------
+// Geweke convergence diagnostic. Compares the mean of the first 10% of the values with the mean of the last 50%, allowing for autocorrelation within each part. The result is approximately standard normal if the values come from a chain that has converged. Values with negligible variance give zero, as they show no sign of drift.
+double gewekeZ(const std::vector<double> &v);
 
 #endif
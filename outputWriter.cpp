@@ -0,0 +1,321 @@
+//
+//  MavericK
+//  outputWriter.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+#include "outputWriter.h"
+
+using namespace std;
+
+//------------------------------------------------
+// outputWriter::
+// constructor
+outputWriter::outputWriter() {
+    stream = 0;
+    stopping = false;
+}
+
+//------------------------------------------------
+// outputWriter::
+// destructor. Waits for all pending output to be written.
+outputWriter::~outputWriter() {
+    close();
+}
+
+//------------------------------------------------
+// outputWriter::
+// start writing to the given stream
+void outputWriter::open(ofstream &stream_) {
+    stream = &stream_;
+    stopping = false;
+    writerThread = thread(&outputWriter::run, this);
+}
+
+//------------------------------------------------
+// outputWriter::
+// pass a block of output to be written, waiting first if too much output is already pending. The block is emptied.
+void outputWriter::write(string &block) {
+    if (block.empty()) {
+        return;
+    }
+    {
+        unique_lock<mutex> lock(pending_mutex);
+        written_cv.wait(lock, [this]{ return (pending.size()<maxPending); });
+        pending.append(block);
+    }
+    pending_cv.notify_one();
+    block.clear();
+}
+
+//------------------------------------------------
+// outputWriter::
+// write any remaining output and stop the background thread
+void outputWriter::close() {
+    if (!writerThread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        stopping = true;
+    }
+    pending_cv.notify_one();
+    writerThread.join();
+}
+
+//------------------------------------------------
+// outputWriter::
+// loop run by the background thread. Takes everything pending in one go and writes it out while new blocks continue to arrive.
+void outputWriter::run() {
+    string block;
+    while (true) {
+        {
+            unique_lock<mutex> lock(pending_mutex);
+            pending_cv.wait(lock, [this]{ return (!pending.empty() || stopping); });
+            if (pending.empty() && stopping) {
+                break;
+            }
+            swap(block, pending);
+        }
+        written_cv.notify_all();
+        stream->write(block.data(), block.size());
+        stream->flush();
+        block.clear();
+    }
+}
+
+//------------------------------------------------
+// append integer x to string s in decimal form
+void appendInt(string &s, int x) {
+    char buffer[12];
+    char *p = buffer+12;
+    unsigned int u = (x<0) ? -(unsigned int)x : x;
+    do {
+        *--p = char('0' + u%10);
+        u /= 10;
+    } while (u>0);
+    if (x<0) {
+        *--p = '-';
+    }
+    s.append(p, buffer+12-p);
+}
+
+//------------------------------------------------
+// append round(x*10^decimals)/10^decimals to string s in fixed-point form. The rounded value is held as an integer count of units of 10^-decimals, which is exactly what sprintf("%.*f") prints for it, so the digits can be produced directly. Values that are not finite, or too large to be held this way, go through sprintf.
+void appendFixed(string &s, double x, int decimals) {
+    static const double scale[10] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    double r = round(x*scale[decimals]);
+    if (!(fabs(r)<1e15)) {
+        char buffer[400];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, r/scale[decimals]);
+        s.append(buffer);
+        return;
+    }
+    char buffer[32];
+    char *p = buffer+32;
+    unsigned long long u = (unsigned long long)fabs(r);
+    for (int i=0; i<decimals; i++) {
+        *--p = char('0' + u%10);
+        u /= 10;
+    }
+    if (decimals>0) {
+        *--p = '.';
+    }
+    do {
+        *--p = char('0' + u%10);
+        u /= 10;
+    } while (u>0);
+    if (signbit(r)) {
+        *--p = '-';
+    }
+    s.append(p, buffer+32-p);
+}
+
+//------------------------------------------------
+// fileWriter::
+// constructor
+fileWriter::fileWriter() {
+    pendingBytes = 0;
+    stopping = false;
+}
+
+//------------------------------------------------
+// fileWriter::
+// destructor. Waits for all pending output to be written.
+fileWriter::~fileWriter() {
+    close();
+}
+
+//------------------------------------------------
+// fileWriter::
+// start the background thread
+void fileWriter::open() {
+    stopping = false;
+    writerThread = thread(&fileWriter::run, this);
+}
+
+//------------------------------------------------
+// fileWriter::
+// take over an open file stream, to which subsequent blocks are written. The previous file is closed by the background thread once its last block has been written.
+void fileWriter::start(ofstream &stream) {
+    current = make_shared<ofstream>(move(stream));
+}
+
+//------------------------------------------------
+// fileWriter::
+// pass a block of output to be written to the current file, waiting first if too much output is already pending. The block is emptied.
+void fileWriter::write(string &block) {
+    if (block.empty()) {
+        return;
+    }
+    
+    // without a background thread the block is written straight away
+    if (!writerThread.joinable()) {
+        current->write(block.data(), block.size());
+        current->flush();
+        block.clear();
+        return;
+    }
+    
+    {
+        unique_lock<mutex> lock(pending_mutex);
+        written_cv.wait(lock, [this]{ return (pendingBytes<maxPending); });
+        pendingBytes += block.size();
+        pending.push_back(make_pair(current, string()));
+        pending.back().second.swap(block);
+    }
+    pending_cv.notify_one();
+    block.clear();
+}
+
+//------------------------------------------------
+// fileWriter::
+// write any remaining output, close all files and stop the background thread
+void fileWriter::close() {
+    current.reset();
+    if (!writerThread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        stopping = true;
+    }
+    pending_cv.notify_one();
+    writerThread.join();
+}
+
+//------------------------------------------------
+// fileWriter::
+// loop run by the background thread. Blocks are written in the order they arrived, and each file is flushed after every block so that output can be viewed while the program is running. A file is closed when the last reference to its stream (held either by current or by a pending block) is dropped.
+void fileWriter::run() {
+    while (true) {
+        pair< shared_ptr<ofstream>, string > entry;
+        {
+            unique_lock<mutex> lock(pending_mutex);
+            pending_cv.wait(lock, [this]{ return (!pending.empty() || stopping); });
+            if (pending.empty() && stopping) {
+                break;
+            }
+            swap(entry, pending.front());
+            pending.pop_front();
+        }
+        entry.first->write(entry.second.data(), entry.second.size());
+        entry.first->flush();
+        {
+            lock_guard<mutex> lock(pending_mutex);
+            pendingBytes -= entry.second.size();
+        }
+        written_cv.notify_all();
+    }
+}
+
+//------------------------------------------------
+// checkpointWriter::
+// constructor
+checkpointWriter::checkpointWriter() {
+    stopping = false;
+    warned = false;
+}
+
+//------------------------------------------------
+// checkpointWriter::
+// destructor. Waits for all pending files to be written.
+checkpointWriter::~checkpointWriter() {
+    close();
+}
+
+//------------------------------------------------
+// checkpointWriter::
+// start the background thread
+void checkpointWriter::open() {
+    stopping = false;
+    writerThread = thread(&checkpointWriter::run, this);
+}
+
+//------------------------------------------------
+// checkpointWriter::
+// pass the complete contents of the file at filePath to be written. Replaces any version of the same file that is still waiting to be written. The contents are emptied.
+void checkpointWriter::write(const string &filePath, string &contents) {
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        pending[filePath].swap(contents);
+    }
+    pending_cv.notify_one();
+    contents.clear();
+}
+
+//------------------------------------------------
+// checkpointWriter::
+// write any remaining files and stop the background thread
+void checkpointWriter::close() {
+    if (!writerThread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        stopping = true;
+    }
+    pending_cv.notify_one();
+    writerThread.join();
+}
+
+//------------------------------------------------
+// checkpointWriter::
+// loop run by the background thread. Each file is written under a temporary name and renamed into place once complete. Failure to write a checkpoint is not fatal, but is reported once.
+void checkpointWriter::run() {
+    map<string, string> files;
+    while (true) {
+        {
+            unique_lock<mutex> lock(pending_mutex);
+            pending_cv.wait(lock, [this]{ return (!pending.empty() || stopping); });
+            if (pending.empty() && stopping) {
+                break;
+            }
+            swap(files, pending);
+        }
+        for (map<string, string>::iterator it=files.begin(); it!=files.end(); ++it) {
+            string tempPath = it->first + ".tmp";
+            ofstream tempStream(tempPath.c_str(), ios::binary | ios::trunc);
+            tempStream.write(it->second.data(), it->second.size());
+            tempStream.close();
+            bool success = !tempStream.fail();
+            if (success && rename(tempPath.c_str(), it->first.c_str())!=0) {
+                remove(it->first.c_str());
+                success = (rename(tempPath.c_str(), it->first.c_str())==0);
+            }
+            if (!success && !warned) {
+                cerr << "Warning: unable to write checkpoint file " << it->first << "\n";
+                warned = true;
+            }
+        }
+        files.clear();
+    }
+}
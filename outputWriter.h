@@ -0,0 +1,166 @@
+//
+//  MavericK
+//  outputWriter.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines a class for writing large volumes of output (such as the outputLikelihood and outputPosteriorGrouping files, which receive a line on every MCMC iteration) on a background thread. MCMC chains build up blocks of output in memory and pass them over whole, meaning the chains never wait on the disk and the file is touched once per block rather than once per line. Further classes write checkpoint files and a sequence of result files (such as the Qmatrix files) in the same way.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__outputWriter__
+#define __Maverick1_0__outputWriter__
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <deque>
+#include <memory>
+#include <stdint.h>
+
+//------------------------------------------------
+// class that writes blocks of output to an already-open file stream on a background thread. Blocks from any one thread are written in the order they are passed in. If more than maxPending bytes are waiting to be written then write() waits, so that memory use stays bounded however slow the disk.
+class outputWriter {
+    
+public:
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor and destructor. The destructor waits for all pending output to be written.
+    outputWriter();
+    ~outputWriter();
+    
+    // start writing to the given stream
+    void open(std::ofstream &stream);
+    
+    // pass a block of output to be written. The block is emptied.
+    void write(std::string &block);
+    
+    // write any remaining output and stop the background thread
+    void close();
+    
+private:
+    
+    // PRIVATE OBJECTS
+    
+    static const size_t maxPending = 1<<26;
+    
+    std::ofstream *stream;
+    std::string pending;
+    bool stopping;
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
+    std::condition_variable written_cv;
+    std::thread writerThread;
+    
+    // PRIVATE FUNCTIONS
+    
+    // loop run by the background thread
+    void run();
+    
+};
+
+//------------------------------------------------
+// class that writes whole files on a background thread, replacing any previous contents. Each file is first written under a temporary name and then renamed, so that a file on disk is always complete even if the program is killed part way through writing. If a new version of a file arrives before the previous one has been written then only the newest version is kept, so a slow disk never holds up sampling.
+class checkpointWriter {
+    
+public:
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor and destructor. The destructor waits for all pending files to be written.
+    checkpointWriter();
+    ~checkpointWriter();
+    
+    // start the background thread
+    void open();
+    
+    // pass the complete contents of the file at filePath to be written. The contents are emptied.
+    void write(const std::string &filePath, std::string &contents);
+    
+    // write any remaining files and stop the background thread
+    void close();
+    
+private:
+    
+    // PRIVATE OBJECTS
+    
+    std::map<std::string, std::string> pending;
+    bool stopping;
+    bool warned;
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
+    std::thread writerThread;
+    
+    // PRIVATE FUNCTIONS
+    
+    // loop run by the background thread
+    void run();
+    
+};
+
+//------------------------------------------------
+// class that writes a sequence of files on a background thread, each of which is passed over in blocks. Files are opened by the caller (so that any error is reported in the usual way) and handed over with start(), after which blocks passed to write() go to that file until the next call to start(). Each file is closed once its last block is written. If more than maxPending bytes are waiting to be written then write() waits, so that memory use stays bounded however slow the disk.
+class fileWriter {
+    
+public:
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor and destructor. The destructor waits for all pending output to be written.
+    fileWriter();
+    ~fileWriter();
+    
+    // start the background thread
+    void open();
+    
+    // take over an open file stream, to which subsequent blocks are written. The stream is moved from, and so is left closed.
+    void start(std::ofstream &stream);
+    
+    // pass a block of output to be written to the current file. The block is emptied.
+    void write(std::string &block);
+    
+    // write any remaining output, close all files and stop the background thread
+    void close();
+    
+private:
+    
+    // PRIVATE OBJECTS
+    
+    static const size_t maxPending = 1<<26;
+    
+    std::shared_ptr<std::ofstream> current;
+    std::deque< std::pair< std::shared_ptr<std::ofstream>, std::string > > pending;
+    size_t pendingBytes;
+    bool stopping;
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
+    std::condition_variable written_cv;
+    std::thread writerThread;
+    
+    // PRIVATE FUNCTIONS
+    
+    // loop run by the background thread
+    void run();
+    
+};
+
+//------------------------------------------------
+// append integer x to string s in decimal form. Faster than going through a stringstream when writing very many small numbers.
+void appendInt(std::string &s, int x);
+
+//------------------------------------------------
+// append round(x*10^decimals)/10^decimals to string s in fixed-point form with the given number of decimal places (at most 9), giving exactly the same characters as sprintf("%.*f") but many times faster
+void appendFixed(std::string &s, double x, int decimals);
+
+//------------------------------------------------
+// append the raw bytes of value x to string s (used when writing binary files, which are little-endian on all supported platforms)
+template<class TYPE>
+void appendBinary(std::string &s, TYPE x) {
+    s.append(reinterpret_cast<const char*>(&x), sizeof(TYPE));
+}
+
+#endif
@@ -0,0 +1,145 @@
+//
+//  MavericK
+//  parallel.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+#include "parallel.h"
+
+using namespace std;
+
+//------------------------------------------------
+// a single call to parallelFor(), shared between the calling thread and any workers helping it
+struct parallelJob {
+    const vector<int> *tasks;
+    const function<void(int)> *task;
+    int nTasks;
+    atomic<int> nextTask;
+
+    // the first exception thrown by a task is kept, and stops any further tasks being handed out
+    mutex error_mutex;
+    exception_ptr error;
+
+    // true if errors raised by tasks are thrown (see throwErrors in readIn.h)
+    bool throwing;
+
+    // number of workers that have been asked to help but have not yet finished, and a condition signalled when this reaches zero (both protected by pool_mutex)
+    int helping;
+    condition_variable done_cv;
+
+    // take the next task from the list until none remain
+    void work() {
+        int t;
+        while ((t = nextTask++) < nTasks) {
+            try {
+                (*task)((*tasks)[t]);
+            } catch (...) {
+                lock_guard<mutex> lock(error_mutex);
+                if (!error) {
+                    error = current_exception();
+                }
+                nextTask = nTasks;
+            }
+        }
+    }
+};
+
+// the pool of worker threads. Workers are started by setThreads() and live for the rest of the program, waiting for jobs to be placed in pending (one entry per worker wanted). freeThreads is the number of workers not currently claimed by a job. The pool is never destroyed, so that workers are never left waiting on a destroyed mutex when the program exits.
+struct threadPool {
+    mutex pool_mutex;
+    condition_variable pool_cv;
+    deque<parallelJob*> pending;
+    vector<thread> workers;
+    int freeThreads;
+};
+static threadPool &pool = *new threadPool();
+
+//------------------------------------------------
+// loop run by every worker thread. Once a worker runs out of tasks it hands itself back straight away, so that it can be picked up by other (nested) calls.
+static void workerLoop() {
+    unique_lock<mutex> lock(pool.pool_mutex);
+    while (true) {
+        pool.pool_cv.wait(lock, []() { return(!pool.pending.empty()); });
+        parallelJob *job = pool.pending.front();
+        pool.pending.pop_front();
+        lock.unlock();
+        {
+            unique_ptr<throwErrors> guard(job->throwing ? new throwErrors : 0);
+            job->work();
+        }
+        lock.lock();
+        pool.freeThreads++;
+        if (--job->helping==0) {
+            job->done_cv.notify_all();
+        }
+    }
+}
+
+//------------------------------------------------
+// set the total number of threads available to the program (including the main thread), starting any further workers needed
+void setThreads(int threads) {
+    lock_guard<mutex> lock(pool.pool_mutex);
+    int workersNeeded = max(threads-1, 0);
+    while (int(pool.workers.size())<workersNeeded) {
+        pool.workers.push_back(thread(workerLoop));
+        pool.workers.back().detach();
+    }
+    pool.freeThreads = workersNeeded;
+}
+
+//------------------------------------------------
+// carry out task(tasks[0]), task(tasks[1]), ... using the calling thread plus any workers that are currently free. Tasks are handed out in the order given, so the most expensive tasks should come first. Returns once all tasks have completed, throwing the first exception raised by any task.
+void parallelFor(const vector<int> &tasks, const function<void(int)> &task) {
+    parallelJob job;
+    job.tasks = &tasks;
+    job.task = &task;
+    job.nTasks = int(tasks.size());
+    job.nextTask = 0;
+    job.throwing = throwErrors::active();
+
+    // claim as many free workers as can be put to use
+    {
+        lock_guard<mutex> lock(pool.pool_mutex);
+        job.helping = max(min(pool.freeThreads, job.nTasks-1), 0);
+        pool.freeThreads -= job.helping;
+        for (int i=0; i<job.helping; i++) {
+            pool.pending.push_back(&job);
+        }
+    }
+    if (job.helping>0) {
+        pool.pool_cv.notify_all();
+    }
+
+    job.work();
+
+    // once the calling thread runs out of tasks, any workers that have not yet picked up the job are no longer needed. Wait for the rest to finish.
+    {
+        unique_lock<mutex> lock(pool.pool_mutex);
+        for (deque<parallelJob*>::iterator it=pool.pending.begin(); it!=pool.pending.end(); ) {
+            if (*it==&job) {
+                it = pool.pending.erase(it);
+                pool.freeThreads++;
+                job.helping--;
+            } else {
+                ++it;
+            }
+        }
+        job.done_cv.wait(lock, [&]() { return(job.helping==0); });
+    }
+
+    if (job.error) {
+        rethrow_exception(job.error);
+    }
+}
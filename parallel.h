@@ -0,0 +1,27 @@
+//
+//  MavericK
+//  parallel.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines a simple mechanism for spreading independent tasks over multiple threads. A single budget of threads (set by the "threads" parameter) is shared by the whole program, so nested calls only pick up threads that are not already busy, rather than oversubscribing the machine. Worker threads are started once and kept for the whole run, so that handing out tasks costs no more than waking a waiting thread, and parallelFor() can be called on every iteration of an MCMC.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__parallel__
+#define __Maverick1_0__parallel__
+
+#include <vector>
+#include <functional>
+#include <exception>
+#include "readIn.h"
+
+//------------------------------------------------
+// set the total number of threads available to the program (including the main thread), starting any worker threads needed
+void setThreads(int threads);
+
+//------------------------------------------------
+// carry out task(tasks[0]), task(tasks[1]), ... using the calling thread plus any worker threads that are currently free. Tasks are handed out in the order given, so the most expensive tasks should come first. Returns once all tasks have completed. Workers throw errors whenever the calling thread does (see throwErrors in readIn.h). If a task throws then no further tasks are started, and once all running tasks have finished the first exception is thrown again on the calling thread.
+void parallelFor(const std::vector<int> &tasks, const std::function<void(int)> &task);
+
+#endif
@@ -10,41 +10,151 @@
 //
 // ---------------------------------------------------------------------------
 
+#include <random>
+#include <cmath>
+#include <algorithm>
+
 #include "probability.h"
 
 using namespace std;
 
-//-- set random seed --
-random_device rd;
-default_random_engine generator(rd());
-uniform_real_distribution<double> uniform_0_1(0.0,1.0);
+//------------------------------------------------
+// bit rotation used by xoshiro256**
+static inline uint64_t rotl(const uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+//------------------------------------------------
+// RNGobject::
+// constructor for a stream of random numbers. The 256-bit state is filled from the 64-bit seed using the splitmix64 generator, as recommended by the authors of xoshiro256**.
+RNGobject::RNGobject(uint64_t seed) {
+    for (int i=0; i<4; i++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        s[i] = z ^ (z >> 31);
+    }
+    normal_saved = false;
+    normal_spare = 0;
+}
+
+//------------------------------------------------
+// RNGobject::
+// return next raw 64-bit value
+uint64_t RNGobject::next() {
+    const uint64_t result = rotl(s[1]*5, 7)*9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return(result);
+}
 
 //------------------------------------------------
+// RNGobject::
+// jump ahead by 2^128 draws
+void RNGobject::jump() {
+    static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t s0=0, s1=0, s2=0, s3=0;
+    for (int i=0; i<4; i++) {
+        for (int b=0; b<64; b++) {
+            if (JUMP[i] & (uint64_t(1) << b)) {
+                s0 ^= s[0];
+                s1 ^= s[1];
+                s2 ^= s[2];
+                s3 ^= s[3];
+            }
+            next();
+        }
+    }
+    s[0] = s0;
+    s[1] = s1;
+    s[2] = s2;
+    s[3] = s3;
+    normal_saved = false;
+}
+
+//------------------------------------------------
+// RNGobject::
+// jump ahead by 2^192 draws
+void RNGobject::long_jump() {
+    static const uint64_t LONG_JUMP[] = { 0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL };
+    uint64_t s0=0, s1=0, s2=0, s3=0;
+    for (int i=0; i<4; i++) {
+        for (int b=0; b<64; b++) {
+            if (LONG_JUMP[i] & (uint64_t(1) << b)) {
+                s0 ^= s[0];
+                s1 ^= s[1];
+                s2 ^= s[2];
+                s3 ^= s[3];
+            }
+            next();
+        }
+    }
+    s[0] = s0;
+    s[1] = s1;
+    s[2] = s2;
+    s[3] = s3;
+    normal_saved = false;
+}
+
+//------------------------------------------------
+// RNGobject::
+// draw from uniform(0,1) distribution. Uses the top 53 bits of the raw value, offset by half a step so that the value 0 is never returned.
+double RNGobject::runif_0_1() {
+    return((double(next() >> 11) + 0.5) * (1.0/9007199254740992.0));
+}
+
+//------------------------------------------------
+// RNGobject::
 // draw from uniform(a,b) distribution
-double runif1(double a, double b) {
-    uniform_real_distribution<double> uniform_a_b(a,b);
-    return(uniform_a_b(generator));
+double RNGobject::runif1(double a, double b) {
+    return(a + (b-a)*runif_0_1());
 }
 
 //------------------------------------------------
-// draw from gamma(shape,rate) distribution
-double rgamma1(double shape, double rate) {
-    gamma_distribution<double> rgamma(shape,1/rate);
-	double x = rgamma(generator);
+// RNGobject::
+// draw from gamma(shape,rate) distribution, using the method of Marsaglia and Tsang (2000). Shape parameters less than 1 are dealt with by drawing from gamma(shape+1) and multiplying by u^(1/shape).
+double RNGobject::rgamma1(double shape, double rate) {
 
-	// check for zero or infinite values (catches bug present in Visual Studio 2010)
-	if (x==0)
-		x = pow(10.0,-300.0);
-	while ((1.0/x)==0)
-		x = rgamma(generator);
+    double boost = 1.0;
+    if (shape<1.0) {
+        boost = pow(runif_0_1(), 1.0/shape);
+        shape += 1.0;
+    }
+
+    double d = shape - 1.0/3.0;
+    double c = 1.0/sqrt(9.0*d);
+    double x, v, u;
+    while (true) {
+        do {
+            x = rnorm1(0.0, 1.0);
+            v = 1.0 + c*x;
+        } while (v<=0);
+        v = v*v*v;
+        u = runif_0_1();
+        if (u < 1.0 - 0.0331*x*x*x*x)
+            break;
+        if (log(u) < 0.5*x*x + d*(1.0 - v + log(v)))
+            break;
+    }
+    x = boost*d*v/rate;
+
+    // check for zero values (caused by underflow when shape is very small)
+    if (x==0)
+        x = pow(10.0,-300.0);
 
     return(x);
 }
 
 //------------------------------------------------
+// RNGobject::
 // sample from given probability vector that sums to pSum
-int sample1(vector<double> &p, double pSum) {
-    double rand = pSum*uniform_0_1(generator);
+int RNGobject::sample1(vector<double> &p, double pSum) {
+    double rand = pSum*runif_0_1();
     double z = 0;
     for (int i=0; i<int(p.size()); i++) {
         z += p[i];
@@ -55,8 +165,55 @@ int sample1(vector<double> &p, double pSum) {
 }
 
 //------------------------------------------------
-// draw from univariate normal distribution
-double rnorm1(double mean, double sd) {
-    normal_distribution<double> rnorm(mean,sd);
-    return(rnorm(generator));
+// RNGobject::
+// sample from probability vector given in cumulative form, such that cumProb[i] is the sum of the first i+1 probabilities. Returns the same value as sample1() would for the same draw, but in log time.
+int RNGobject::sample1_cumulative(vector<double> &cumProb) {
+    double rand = cumProb.back()*runif_0_1();
+    int i = int(upper_bound(cumProb.begin(), cumProb.end(), rand) - cumProb.begin());
+    
+    // guard against rounding error in the final element
+    if (i==int(cumProb.size()))
+        i--;
+    return(i+1);
+}
+
+//------------------------------------------------
+// RNGobject::
+// draw from univariate normal distribution, using the polar method of Marsaglia and Bray
+double RNGobject::rnorm1(double mean, double sd) {
+    if (normal_saved) {
+        normal_saved = false;
+        return(mean + sd*normal_spare);
+    }
+    double u, v, r2;
+    do {
+        u = 2.0*runif_0_1() - 1.0;
+        v = 2.0*runif_0_1() - 1.0;
+        r2 = u*u + v*v;
+    } while (r2>=1.0 || r2==0);
+    double f = sqrt(-2.0*log(r2)/r2);
+    normal_spare = v*f;
+    normal_saved = true;
+    return(mean + sd*u*f);
+}
+
+//------------------------------------------------
+// return the stream of random numbers allocated to a given part of the program (RNG_MAIN, RNG_TI etc.) and unit of work within K, starting from the master seed. Kindex=-1 can be used for streams that do not belong to any K.
+RNGobject RNGstream(uint64_t seed, int Kindex, int part, int unit) {
+    RNGobject RNG(seed);
+    int major = (Kindex+1)*RNG_BLOCK + part;
+    for (int i=0; i<major; i++) {
+        RNG.long_jump();
+    }
+    for (int i=0; i<unit; i++) {
+        RNG.jump();
+    }
+    return(RNG);
+}
+
+//------------------------------------------------
+// produce a random (strictly positive) seed from the random device, for use when no seed is defined by the user
+int randomSeed() {
+    random_device rd;
+    return(int(rd() % 2147483646) + 1);
 }
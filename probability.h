@@ -6,29 +6,74 @@
 //
 //  Distributed under the MIT software licence - see Notes.c file for details
 //
-//  Functions for sampling from some fairly basic probability mass and density functions.
+//  Functions for sampling from some fairly basic probability mass and density functions. All random numbers are drawn from RNGobject streams, which are owned by whichever part of the program uses them (MCMC chains, EM repeats etc.), so that no generator is ever shared between threads. Every stream is derived from a single master seed, meaning results are reproducible irrespective of the number of threads.
 //
 // ---------------------------------------------------------------------------
 
 #ifndef __Maverick1_0__probability__
 #define __Maverick1_0__probability__
 
-#include <random>
+#include <vector>
+#include <stdint.h>
 
-//------------------------------------------------
-// draw from uniform(a,b) distribution
-double runif1(double a, double b);
+// streams of random numbers are indexed by K and by the part of the program that draws them. Each K is allocated a block of RNG_BLOCK major streams, and within each major stream the units of work (repeats, rungs etc.) are allocated minor streams.
+#define RNG_BLOCK 8
+#define RNG_MAIN 0
+#define RNG_TI 1
+#define RNG_EM 2
+#define RNG_TISWAP 3
 
 //------------------------------------------------
-// draw from gamma(shape,rate) distribution
-double rgamma1(double shape, double rate);
+// class defining a single stream of random numbers. Based on the xoshiro256** generator of Blackman and Vigna, which is fast, has a period of 2^256-1, and can jump ahead by 2^128 or 2^192 draws at little cost, meaning a single seed can be split into a large number of streams that are guaranteed not to overlap.
+class RNGobject {
+
+public:
+
+    // PUBLIC OBJECTS
+
+    // generator state
+    uint64_t s[4];
+
+    // the polar method produces normal draws in pairs, the second of which is saved for the next call
+    bool normal_saved;
+    double normal_spare;
+
+    // PUBLIC FUNCTIONS
+
+    // constructor
+    RNGobject(uint64_t seed=0);
+
+    // raw generator
+    uint64_t next();
+    void jump();
+    void long_jump();
+
+    // draw from uniform(0,1) distribution. The value 0 is never returned.
+    double runif_0_1();
+
+    // draw from uniform(a,b) distribution
+    double runif1(double a, double b);
+
+    // draw from gamma(shape,rate) distribution
+    double rgamma1(double shape, double rate);
+
+    // sample from given probability vector (that sums to pSum)
+    int sample1(std::vector<double> &p, double pSum);
+    
+    // sample from probability vector given in cumulative form, by binary search
+    int sample1_cumulative(std::vector<double> &cumProb);
+
+    // draw from univariate normal distribution
+    double rnorm1(double mean, double sd);
+
+};
 
 //------------------------------------------------
-// sample from given probability vector (that sums to pSum)
-int sample1(std::vector<double> &p, double pSum);
+// return the stream of random numbers allocated to a given part of the program (RNG_MAIN, RNG_TI etc.) and unit of work within K, starting from the master seed. Kindex=-1 can be used for streams that do not belong to any K.
+RNGobject RNGstream(uint64_t seed, int Kindex, int part, int unit);
 
 //------------------------------------------------
-// draw from univariate normal distribution
-double rnorm1(double mean, double sd);
+// produce a random (strictly positive) seed from the random device, for use when no seed is defined by the user
+int randomSeed();
 
 #endif
@@ -0,0 +1,36 @@
+//
+//  MavericK
+//  profile.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include "profile.h"
+
+using namespace std;
+
+//------------------------------------------------
+// profileObject::
+// constructor for profileObject class
+profileObject::profileObject(string _stage, int _rung, double _beta) {
+    stage = _stage;
+    rung = _rung;
+    beta = _beta;
+    seconds = vector<double>(PROFILE_PHASES);
+    counts = vector<double>(PROFILE_COUNTERS);
+}
+
+//------------------------------------------------
+// profileObject::
+// add the times and counts of another profile to this one (for example to combine repeats run on separate chains)
+void profileObject::merge(const profileObject &other) {
+    for (int i=0; i<PROFILE_PHASES; i++) {
+        seconds[i] += other.seconds[i];
+    }
+    for (int i=0; i<PROFILE_COUNTERS; i++) {
+        counts[i] += other.counts[i];
+    }
+}
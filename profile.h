@@ -0,0 +1,106 @@
+//
+//  MavericK
+//  profile.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines objects for timing the main phases of the analysis and counting events such as MCMC sweeps and accepted Metropolis-Hastings moves. Each MCMC object holds a pointer to a profileObject, which is null unless outputProfile_on is true, and the timers and counters do nothing when given a null pointer, so profiling costs nothing when it is switched off. Profiles of each stage of the analysis of each K (and of each rung of the thermodynamic ladder) are written to the outputProfile file.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__profile__
+#define __Maverick1_0__profile__
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+// timed phases
+#define PROFILE_TOTAL 0         // the whole stage
+#define PROFILE_GIBBS 1         // group_update()
+#define PROFILE_INDLEVEL 2      // group_update_indLevel() (admixture model)
+#define PROFILE_ALPHA 3         // alpha_update() (admixture model)
+#define PROFILE_QMATRIX 4       // produceQmatrix() (produceCostMatrix() without admixture)
+#define PROFILE_LABELS 5        // chooseBestLabelPermutation() and updateQmatrix()
+#define PROFILE_LIKELIHOOD 6    // d_logLikeGroup()
+#define PROFILE_FREQS 7         // drawFreqs() and d_logLikeJoint()
+#define PROFILE_OUTPUT 8        // buffering and writing of output produced on every iteration
+#define PROFILE_PHASES 9
+
+// counted events
+#define COUNT_SWEEPS 0              // Gibbs sweeps through all individuals or gene copies
+#define COUNT_INDLEVEL_PROPOSED 1   // individual-level Metropolis-Hastings moves
+#define COUNT_INDLEVEL_ACCEPTED 2
+#define COUNT_ALPHA_PROPOSED 3      // Metropolis-Hastings updates of alpha
+#define COUNT_ALPHA_ACCEPTED 4
+#define COUNT_HUNGARIAN_CALLS 5     // label permutations solved by the Hungarian algorithm
+#define COUNT_HUNGARIAN_ITERATIONS 6
+#define COUNT_RELABELS 7            // label permutations that changed the labelling
+#define COUNT_SWAPS_PROPOSED 8      // exchanges of state with the next rung up the thermodynamic ladder
+#define COUNT_SWAPS_ACCEPTED 9
+#define COUNT_EM_ITERATIONS 10
+#define PROFILE_COUNTERS 11
+
+//------------------------------------------------
+// class holding the time spent in each phase and the number of each event, for one stage of the analysis of a single K
+class profileObject {
+    
+public:
+    
+    // PUBLIC OBJECTS
+    
+    // stage of the analysis ("exhaustive", "main", "TI" or "EM"), and for thermodynamic integration the rung (counted from 1 in order of increasing power) and its power
+    std::string stage;
+    int rung;
+    double beta;
+    
+    std::vector<double> seconds;
+    std::vector<double> counts;
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor
+    profileObject(std::string _stage="", int _rung=0, double _beta=1.0);
+    
+    void merge(const profileObject &other);
+    
+};
+
+//------------------------------------------------
+// adds the time between its construction and destruction to one phase of a profile. Does nothing if the profile is null.
+class profileTimer {
+    
+public:
+    
+    // PUBLIC FUNCTIONS
+    
+    profileTimer(profileObject *_profile, int _phase) {
+        profile = _profile;
+        phase = _phase;
+        if (profile)
+            start = std::chrono::steady_clock::now();
+    }
+    
+    ~profileTimer() {
+        if (profile)
+            profile->seconds[phase] += std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    }
+    
+private:
+    
+    // PRIVATE OBJECTS
+    
+    profileObject *profile;
+    int phase;
+    std::chrono::steady_clock::time_point start;
+    
+};
+
+//------------------------------------------------
+// add x to one counter of a profile, if the profile is not null
+inline void profileCount(profileObject *profile, int counter, double x=1) {
+    if (profile)
+        profile->counts[counter] += x;
+}
+
+#endif
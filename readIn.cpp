@@ -43,13 +43,67 @@ void cerrAndLog(string message, bool writeToFile, ofstream &logFileStream) {
     }
 }
 
+//------------------------------------------------
+// constructor for error thrown by errorExit()
+maverickError::maverickError(const string &message) : runtime_error(message) {}
+
+//------------------------------------------------
+// whether errors raised on this thread are thrown (see throwErrors)
+static thread_local bool throwErrors_on = false;
+
+//------------------------------------------------
+// throwErrors::
+// constructor and destructor, switching on throwing of errors for the lifetime of the object
+throwErrors::throwErrors() {
+    previous = throwErrors_on;
+    throwErrors_on = true;
+}
+throwErrors::~throwErrors() {
+    throwErrors_on = previous;
+}
+bool throwErrors::active() {
+    return(throwErrors_on);
+}
+
+//------------------------------------------------
+// write error to screen and file and exit, or throw error. Surrounding line breaks are dropped from the thrown message.
+void errorExit(string message, bool writeToFile, ofstream &logFileStream) {
+    if (throwErrors_on) {
+        size_t first = message.find_first_not_of("\n");
+        size_t last = message.find_last_not_of("\n");
+        throw maverickError((first==string::npos) ? string() : message.substr(first, last-first+1));
+    }
+    cerrAndLog(message, writeToFile, logFileStream);
+    exit(1);
+}
+
+//------------------------------------------------
+// write message arising from checking parameters or reading the data to screen and file, or add it to dataBuffer if bufferConsole_on is set
+void coutAndLog_data(string message, bool writeToFile, globals &globals) {
+    if (globals.bufferConsole_on) {
+        globals.dataBuffer += message;
+    } else {
+        coutAndLog(message, writeToFile, globals.outputLog_fileStream);
+    }
+}
+
+//------------------------------------------------
+// write message arising from the analysis of a given K to screen and log. If the K loop is running over multiple threads then the message is instead added to the buffer for this K, to be released later in K order.
+void coutAndLog_K(string message, globals &globals, int Kindex) {
+    lock_guard<mutex> lock(globals.log_mutex);
+    if (globals.threads>1 || globals.ranks>1 || globals.bufferConsole_on) {
+        globals.Kbuffer[Kindex] += message;
+    } else {
+        coutAndLog(message, globals.outputLog_on, globals.outputLog_fileStream);
+    }
+}
+
 //------------------------------------------------
 // safely open input file stream, otherwise error. Option to write errors to file if writeErrorToFile is true.
 ifstream safe_ifstream(string fileName, bool writeToFile, ofstream &logFileStream) {
     ifstream fileStream(fileName);
     if (!fileStream.is_open()) {
-        cerrAndLog("\nError: failed to read from file: "+fileName+string("\n"), writeToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: failed to read from file: "+fileName+string("\n"), writeToFile, logFileStream);
     }
     return(fileStream);
 }
@@ -61,8 +115,7 @@ double stringToDouble(string s, bool writeToFile, ofstream &logFileStream) {
     istringstream ss(s);
     ss >> output;
     if (!output) {
-        cerrAndLog("\nError: cannot convert data element '"+s+string("' to type double\n"), writeToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: cannot convert data element '"+s+string("' to type double\n"), writeToFile, logFileStream);
     }
     return(output);
 }
@@ -72,8 +125,7 @@ double stringToDouble(string s, bool writeToFile, ofstream &logFileStream) {
 int doubleToInt(double x, bool writeToFile, ofstream &logFileStream) {
     double intpart;
     if (modf(x, &intpart)!=0.0) {
-        cerrAndLog("\nError: cannot convert data element "+to_string((long long)x)+string(" to type integer\n"), writeToFile, logFileStream);
-        exit(1);
+        errorExit("\nError: cannot convert data element "+to_string((long long)x)+string(" to type integer\n"), writeToFile, logFileStream);
     }
     return(int(intpart));
 }
@@ -199,6 +251,9 @@ void readParameters(globals &globals) {
         if (params[i]=="outputMaxLike_admixFreqs" && i+1<int(params.size()))
             globals.outputMaxLike_admixFreqs_fileName = params[i+1];
         
+        if (params[i]=="outputProfile" && i+1<int(params.size()))
+            globals.outputProfile_fileName = params[i+1];
+        
     }
     
     // extract parameter values (as strings) from file
@@ -219,6 +274,9 @@ void readParameters(globals &globals) {
         if (params[i]=="missingData" && i+1<int(params.size()))
             globals.parameterStrings["missingData"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="dataCache_on" && i+1<int(params.size()))
+            globals.parameterStrings["dataCache_on"] = pair<string,int>(params[i+1],1);
+        
         if (params[i]=="Kmin" && i+1<int(params.size()))
             globals.parameterStrings["Kmin"] = pair<string,int>(params[i+1],1);
         
@@ -237,6 +295,12 @@ void readParameters(globals &globals) {
         if (params[i]=="alphaPropSD" && i+1<int(params.size()))
             globals.parameterStrings["alphaPropSD"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="alphaUpdates" && i+1<int(params.size()))
+            globals.parameterStrings["alphaUpdates"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="alphaAdapt_on" && i+1<int(params.size()))
+            globals.parameterStrings["alphaAdapt_on"] = pair<string,int>(params[i+1],1);
+        
         if (params[i]=="exhaustive_on" && i+1<int(params.size()))
             globals.parameterStrings["exhaustive_on"] = pair<string,int>(params[i+1],1);
         
@@ -252,6 +316,15 @@ void readParameters(globals &globals) {
         if (params[i]=="mainThinning" && i+1<int(params.size()))
             globals.parameterStrings["mainThinning"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="mainAdaptiveBurnin_on" && i+1<int(params.size()))
+            globals.parameterStrings["mainAdaptiveBurnin_on"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="mainTargetSE" && i+1<int(params.size()))
+            globals.parameterStrings["mainTargetSE"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="mainCheckInterval" && i+1<int(params.size()))
+            globals.parameterStrings["mainCheckInterval"] = pair<string,int>(params[i+1],1);
+        
         if (params[i]=="thermodynamic_on" && i+1<int(params.size()))
             globals.parameterStrings["thermodynamic_on"] = pair<string,int>(params[i+1],1);
         
@@ -267,6 +340,21 @@ void readParameters(globals &globals) {
         if (params[i]=="thermodynamicThinning" && i+1<int(params.size()))
             globals.parameterStrings["thermodynamicThinning"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="thermodynamicTempering_on" && i+1<int(params.size()))
+            globals.parameterStrings["thermodynamicTempering_on"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="thermodynamicSwapInterval" && i+1<int(params.size()))
+            globals.parameterStrings["thermodynamicSwapInterval"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="thermodynamicPower" && i+1<int(params.size()))
+            globals.parameterStrings["thermodynamicPower"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="thermodynamicTargetSE" && i+1<int(params.size()))
+            globals.parameterStrings["thermodynamicTargetSE"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="thermodynamicMaxRungs" && i+1<int(params.size()))
+            globals.parameterStrings["thermodynamicMaxRungs"] = pair<string,int>(params[i+1],1);
+        
         if (params[i]=="EMalgorithm_on" && i+1<int(params.size()))
             globals.parameterStrings["EMalgorithm_on"] = pair<string,int>(params[i+1],1);
         
@@ -276,6 +364,9 @@ void readParameters(globals &globals) {
         if (params[i]=="EMiterations" && i+1<int(params.size()))
             globals.parameterStrings["EMiterations"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="EMtolerance" && i+1<int(params.size()))
+            globals.parameterStrings["EMtolerance"] = pair<string,int>(params[i+1],1);
+        
         if (params[i]=="outputLog_on" && i+1<int(params.size()))
             globals.parameterStrings["outputLog_on"] = pair<string,int>(params[i+1],1);
         
@@ -324,15 +415,48 @@ void readParameters(globals &globals) {
         if (params[i]=="outputMaxLike_admixFreqs_on" && i+1<int(params.size()))
             globals.parameterStrings["outputMaxLike_admixFreqs_on"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="outputProfile_on" && i+1<int(params.size()))
+            globals.parameterStrings["outputProfile_on"] = pair<string,int>(params[i+1],1);
+        
         if (params[i]=="outputQmatrix_structureFormat_on" && i+1<int(params.size()))
             globals.parameterStrings["outputQmatrix_structureFormat_on"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="outputPosteriorGrouping_binary_on" && i+1<int(params.size()))
+            globals.parameterStrings["outputPosteriorGrouping_binary_on"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="outputQmatrix_binary_on" && i+1<int(params.size()))
+            globals.parameterStrings["outputQmatrix_binary_on"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="outputFlushInterval" && i+1<int(params.size()))
+            globals.parameterStrings["outputFlushInterval"] = pair<string,int>(params[i+1],1);
+        
         if (params[i]=="suppressWarning1_on" && i+1<int(params.size()))
             globals.parameterStrings["suppressWarning1_on"] = pair<string,int>(params[i+1],1);
         
         if (params[i]=="fixLabels_on" && i+1<int(params.size()))
             globals.parameterStrings["fixLabels_on"] = pair<string,int>(params[i+1],1);
         
+        if (params[i]=="fixLabelsInterval" && i+1<int(params.size()))
+            globals.parameterStrings["fixLabelsInterval"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="QmatrixFloat_on" && i+1<int(params.size()))
+            globals.parameterStrings["QmatrixFloat_on"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="threads" && i+1<int(params.size()))
+            globals.parameterStrings["threads"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="seed" && i+1<int(params.size()))
+            globals.parameterStrings["seed"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="parallelRepeats_on" && i+1<int(params.size()))
+            globals.parameterStrings["parallelRepeats_on"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="gibbsBlocks" && i+1<int(params.size()))
+            globals.parameterStrings["gibbsBlocks"] = pair<string,int>(params[i+1],1);
+        
+        if (params[i]=="checkpointInterval" && i+1<int(params.size()))
+            globals.parameterStrings["checkpointInterval"] = pair<string,int>(params[i+1],1);
+        
     }
     
 }
@@ -374,6 +498,7 @@ void readCommandLine(globals &globals, int argc, const char * argv[]) {
         readPath("-outputEvanno", globals.outputEvanno_fileName, argc, argv, i);
         readPath("-outputMaxLike_alleleFreqs", globals.outputMaxLike_alleleFreqs_fileName, argc, argv, i);
         readPath("-outputMaxLike_admixFreqs", globals.outputMaxLike_admixFreqs_fileName, argc, argv, i);
+        readPath("-outputProfile", globals.outputProfile_fileName, argc, argv, i);
     }
     
     // set file paths
@@ -395,6 +520,7 @@ void readCommandLine(globals &globals, int argc, const char * argv[]) {
     globals.outputEvanno_filePath = globals.outputRoot_filePath + globals.outputEvanno_fileName;
     globals.outputMaxLike_alleleFreqs_filePath = globals.outputRoot_filePath + globals.outputMaxLike_alleleFreqs_fileName;
     globals.outputMaxLike_admixFreqs_filePath = globals.outputRoot_filePath + globals.outputMaxLike_admixFreqs_fileName;
+    globals.outputProfile_filePath = globals.outputRoot_filePath + globals.outputProfile_fileName;
     
     // replace parameter values (as strings) with user-defined arguments
     for (int i=1; i<argc; i++) {
@@ -403,25 +529,37 @@ void readCommandLine(globals &globals, int argc, const char * argv[]) {
         readArgument("ploidyCol_on", globals, argc, argv, i);
         readArgument("ploidy", globals, argc, argv, i);
         readArgument("missingData", globals, argc, argv, i);
+        readArgument("dataCache_on", globals, argc, argv, i);
         readArgument("Kmin", globals, argc, argv, i);
         readArgument("Kmax", globals, argc, argv, i);
         readArgument("admix_on", globals, argc, argv, i);
         readArgument("fixAlpha_on", globals, argc, argv, i);
         readArgument("alpha", globals, argc, argv, i);
         readArgument("alphaPropSD", globals, argc, argv, i);
+        readArgument("alphaUpdates", globals, argc, argv, i);
+        readArgument("alphaAdapt_on", globals, argc, argv, i);
         readArgument("exhaustive_on", globals, argc, argv, i);
         readArgument("mainRepeats", globals, argc, argv, i);
         readArgument("mainBurnin", globals, argc, argv, i);
         readArgument("mainSamples", globals, argc, argv, i);
         readArgument("mainThinning", globals, argc, argv, i);
+        readArgument("mainAdaptiveBurnin_on", globals, argc, argv, i);
+        readArgument("mainTargetSE", globals, argc, argv, i);
+        readArgument("mainCheckInterval", globals, argc, argv, i);
         readArgument("thermodynamic_on", globals, argc, argv, i);
         readArgument("thermodynamicRungs", globals, argc, argv, i);
         readArgument("thermodynamicBurnin", globals, argc, argv, i);
         readArgument("thermodynamicSamples", globals, argc, argv, i);
         readArgument("thermodynamicThinning", globals, argc, argv, i);
+        readArgument("thermodynamicTempering_on", globals, argc, argv, i);
+        readArgument("thermodynamicSwapInterval", globals, argc, argv, i);
+        readArgument("thermodynamicPower", globals, argc, argv, i);
+        readArgument("thermodynamicTargetSE", globals, argc, argv, i);
+        readArgument("thermodynamicMaxRungs", globals, argc, argv, i);
         readArgument("EMalgorithm_on", globals, argc, argv, i);
         readArgument("EMrepeats", globals, argc, argv, i);
         readArgument("EMiterations", globals, argc, argv, i);
+        readArgument("EMtolerance", globals, argc, argv, i);
         readArgument("outputLog_on", globals, argc, argv, i);
         readArgument("outputLikelihood_on", globals, argc, argv, i);
         readArgument("outputQmatrix_ind_on", globals, argc, argv, i);
@@ -439,9 +577,24 @@ void readCommandLine(globals &globals, int argc, const char * argv[]) {
         readArgument("outputEvanno_on", globals, argc, argv, i);
         readArgument("outputMaxLike_alleleFreqs_on", globals, argc, argv, i);
         readArgument("outputMaxLike_admixFreqs_on", globals, argc, argv, i);
+        readArgument("outputProfile_on", globals, argc, argv, i);
         readArgument("outputQmatrix_structureFormat_on", globals, argc, argv, i);
+        readArgument("outputPosteriorGrouping_binary_on", globals, argc, argv, i);
+        readArgument("outputQmatrix_binary_on", globals, argc, argv, i);
+        readArgument("outputFlushInterval", globals, argc, argv, i);
         readArgument("suppressWarning1_on", globals, argc, argv, i);
         readArgument("fixLabels_on", globals, argc, argv, i);
+        readArgument("fixLabelsInterval", globals, argc, argv, i);
+        readArgument("QmatrixFloat_on", globals, argc, argv, i);
+        readArgument("threads", globals, argc, argv, i);
+        readArgument("seed", globals, argc, argv, i);
+        readArgument("parallelRepeats_on", globals, argc, argv, i);
+        readArgument("gibbsBlocks", globals, argc, argv, i);
+        readArgument("checkpointInterval", globals, argc, argv, i);
+        
+        // -resume is a flag, and takes no value
+        if (string(argv[i])=="-resume")
+            globals.resume_on = true;
     }
     
 }
@@ -479,6 +632,10 @@ void checkParameters(globals &globals, int i) {
                 writeToFile("  missingData = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 globals.missingData = it->second.first;
             }
+            if (it->first=="dataCache_on") {
+                writeToFile("  dataCache_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.dataCache_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
             if (it->first=="Kmin") {
                 writeToFile("  Kmin = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 
@@ -486,8 +643,7 @@ void checkParameters(globals &globals, int i) {
                 checkInteger(it->second.first, globals.Kmin, it->first, globals.outputLog_on, globals.outputLog_fileStream);
                 checkGrZero(it->first, globals.Kmin, globals.outputLog_on, globals.outputLog_fileStream);
                 if (globals.Kmin>globals.Kmax) {
-                    cerrAndLog("\nError: 'Kmin' parameter must be less than or equal to 'Kmax' parameter\n", globals.outputLog_on, globals.outputLog_fileStream);
-                    exit(1);
+                    errorExit("\nError: 'Kmin' parameter must be less than or equal to 'Kmax' parameter\n", globals.outputLog_on, globals.outputLog_fileStream);
                 }
             }
             if (it->first=="Kmax") {
@@ -496,8 +652,7 @@ void checkParameters(globals &globals, int i) {
                 // check that integer greater than or equal to Kmin
                 checkInteger(it->second.first, globals.Kmax, it->first, globals.outputLog_on, globals.outputLog_fileStream);
                 if (globals.Kmax<globals.Kmin) {
-                    cerrAndLog("\nError: 'Kmax' parameter must be greater than or equal to 'Kmin' parameter\n", globals.outputLog_on, globals.outputLog_fileStream);
-                    exit(1);
+                    errorExit("\nError: 'Kmax' parameter must be greater than or equal to 'Kmin' parameter\n", globals.outputLog_on, globals.outputLog_fileStream);
                 }
             }
             if (it->first=="admix_on") {
@@ -544,6 +699,17 @@ void checkParameters(globals &globals, int i) {
                 // save vector of values to globals.alphaPropSD
                 globals.alphaPropSD = alphaPropSD;
             }
+            if (it->first=="alphaUpdates") {
+                writeToFile("  alphaUpdates = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that integer greater than 0
+                checkInteger(it->second.first, globals.alphaUpdates, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.alphaUpdates, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="alphaAdapt_on") {
+                writeToFile("  alphaAdapt_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.alphaAdapt_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
             if (it->first=="exhaustive_on") {
                 writeToFile("  exhaustive_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.exhaustive_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
@@ -576,6 +742,24 @@ void checkParameters(globals &globals, int i) {
                 checkInteger(it->second.first, globals.mainThinning, it->first, globals.outputLog_on, globals.outputLog_fileStream);
                 checkGrZero(it->first, globals.mainThinning, globals.outputLog_on, globals.outputLog_fileStream);
             }
+            if (it->first=="mainAdaptiveBurnin_on") {
+                writeToFile("  mainAdaptiveBurnin_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.mainAdaptiveBurnin_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="mainTargetSE") {
+                writeToFile("  mainTargetSE = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that value greater than or equal to 0
+                istringstream(it->second.first) >> globals.mainTargetSE;
+                checkGrEqZero(it->first, globals.mainTargetSE, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="mainCheckInterval") {
+                writeToFile("  mainCheckInterval = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that integer greater than 0
+                checkInteger(it->second.first, globals.mainCheckInterval, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.mainCheckInterval, globals.outputLog_on, globals.outputLog_fileStream);
+            }
             if (it->first=="thermodynamic_on") {
                 writeToFile("  thermodynamic_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.thermodynamic_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
@@ -586,8 +770,7 @@ void checkParameters(globals &globals, int i) {
                 // check that integer greater than or equal to 2
                 checkInteger(it->second.first, globals.thermodynamicRungs, it->first, globals.outputLog_on, globals.outputLog_fileStream);
                 if (globals.thermodynamicRungs<2) {
-                    cerrAndLog("\nError: 'thermodynamicRungs' parameter must be greater than or equal to 2\n", globals.outputLog_on, globals.outputLog_fileStream);
-                    exit(1);
+                    errorExit("\nError: 'thermodynamicRungs' parameter must be greater than or equal to 2\n", globals.outputLog_on, globals.outputLog_fileStream);
                 }
             }
             if (it->first=="thermodynamicBurnin") {
@@ -611,6 +794,38 @@ void checkParameters(globals &globals, int i) {
                 checkInteger(it->second.first, globals.thermodynamicThinning, it->first, globals.outputLog_on, globals.outputLog_fileStream);
                 checkGrZero(it->first, globals.thermodynamicThinning, globals.outputLog_on, globals.outputLog_fileStream);
             }
+            if (it->first=="thermodynamicTempering_on") {
+                writeToFile("  thermodynamicTempering_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.thermodynamicTempering_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="thermodynamicSwapInterval") {
+                writeToFile("  thermodynamicSwapInterval = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that integer greater than 0
+                checkInteger(it->second.first, globals.thermodynamicSwapInterval, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.thermodynamicSwapInterval, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="thermodynamicPower") {
+                writeToFile("  thermodynamicPower = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that value greater than 0
+                istringstream(it->second.first) >> globals.thermodynamicPower;
+                checkGrZero(it->first, globals.thermodynamicPower, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="thermodynamicTargetSE") {
+                writeToFile("  thermodynamicTargetSE = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that value greater than or equal to 0
+                istringstream(it->second.first) >> globals.thermodynamicTargetSE;
+                checkGrEqZero(it->first, globals.thermodynamicTargetSE, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="thermodynamicMaxRungs") {
+                writeToFile("  thermodynamicMaxRungs = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that integer greater than 0
+                checkInteger(it->second.first, globals.thermodynamicMaxRungs, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.thermodynamicMaxRungs, globals.outputLog_on, globals.outputLog_fileStream);
+            }
             if (it->first=="EMalgorithm_on") {
                 writeToFile("  EMalgorithm_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.EMalgorithm_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
@@ -629,6 +844,13 @@ void checkParameters(globals &globals, int i) {
                 checkInteger(it->second.first, globals.EMiterations, it->first, globals.outputLog_on, globals.outputLog_fileStream);
                 checkGrZero(it->first, globals.EMiterations, globals.outputLog_on, globals.outputLog_fileStream);
             }
+            if (it->first=="EMtolerance") {
+                writeToFile("  EMtolerance = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that value greater than or equal to 0
+                istringstream(it->second.first) >> globals.EMtolerance;
+                checkGrEqZero(it->first, globals.EMtolerance, globals.outputLog_on, globals.outputLog_fileStream);
+            }
             if (it->first=="outputLog_on") {
                 writeToFile("  outputLog_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.outputLog_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
@@ -697,10 +919,29 @@ void checkParameters(globals &globals, int i) {
                 writeToFile("  outputMaxLike_admixFreqs_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.outputMaxLike_admixFreqs_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
             }
+            if (it->first=="outputProfile_on") {
+                writeToFile("  outputProfile_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.outputProfile_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
             if (it->first=="outputQmatrix_structureFormat_on") {
                 writeToFile("  outputQmatrix_structureFormat_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.outputQmatrix_structureFormat_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
             }
+            if (it->first=="outputPosteriorGrouping_binary_on") {
+                writeToFile("  outputPosteriorGrouping_binary_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.outputPosteriorGrouping_binary_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="outputQmatrix_binary_on") {
+                writeToFile("  outputQmatrix_binary_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.outputQmatrix_binary_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="outputFlushInterval") {
+                writeToFile("  outputFlushInterval = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that integer greater than 0
+                checkInteger(it->second.first, globals.outputFlushInterval, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.outputFlushInterval, globals.outputLog_on, globals.outputLog_fileStream);
+            }
             if (it->first=="suppressWarning1_on") {
                 writeToFile("  suppressWarning1_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.suppressWarning1_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
@@ -709,6 +950,43 @@ void checkParameters(globals &globals, int i) {
                 writeToFile("  fixLabels_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 checkBoolean(it->second.first, globals.fixLabels_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
             }
+            if (it->first=="fixLabelsInterval") {
+                writeToFile("  fixLabelsInterval = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkInteger(it->second.first, globals.fixLabelsInterval, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.fixLabelsInterval, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="QmatrixFloat_on") {
+                writeToFile("  QmatrixFloat_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.QmatrixFloat_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="threads") {
+                writeToFile("  threads = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that integer greater than 0
+                checkInteger(it->second.first, globals.threads, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.threads, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="seed") {
+                writeToFile("  seed = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                
+                // check that integer greater than or equal to 0 (0 means choose at random)
+                checkInteger(it->second.first, globals.seed, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrEqZero(it->first, globals.seed, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="parallelRepeats_on") {
+                writeToFile("  parallelRepeats_on = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkBoolean(it->second.first, globals.parallelRepeats_on, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="gibbsBlocks") {
+                writeToFile("  gibbsBlocks = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkInteger(it->second.first, globals.gibbsBlocks, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrZero(it->first, globals.gibbsBlocks, globals.outputLog_on, globals.outputLog_fileStream);
+            }
+            if (it->first=="checkpointInterval") {
+                writeToFile("  checkpointInterval = "+it->second.first+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+                checkInteger(it->second.first, globals.checkpointInterval, it->first, globals.outputLog_on, globals.outputLog_fileStream);
+                checkGrEqZero(it->first, globals.checkpointInterval, globals.outputLog_on, globals.outputLog_fileStream);
+            }
         }
     }
 	
@@ -718,165 +996,125 @@ void checkParameters(globals &globals, int i) {
     
     // print to screen number of parameters of each type
     if (i==0)
-        cout << "  " << defined << " parameters set to default values\n";
+        coutAndLog_data("  "+to_string((long long)defined)+" parameters set to default values\n", false, globals);
     else if (i==1)
-        cout << "  " << defined << " parameters read in from file\n";
+        coutAndLog_data("  "+to_string((long long)defined)+" parameters read in from file\n", false, globals);
     else if (i==2)
-        cout << "  " << defined << " parameters defined on command line\n";
+        coutAndLog_data("  "+to_string((long long)defined)+" parameters defined on command line\n", false, globals);
 }
 
 //------------------------------------------------
-// read in data file
-void readData(globals &globals) {
+// parse the data file in a single pass, writing genotypes straight into the packed data array data. The file is split into lines (ending in '\r', '\n' or '\r\n') and tab-separated entries in place, and alleles are recoded to integers as they are read using a hash table for each locus. Missing values are counted in missingDataCount.
+static void parseDataFile(globals &globals, genotypeData &data, int pop_startRead, int ploidy_startRead, int data_startRead, int &missingDataCount) {
     
-    cout << "Loading data file...\n";
-    writeToFile("Data properties\n", globals.outputLog_on, globals.outputLog_fileStream);
+    // open file
+    mappedFile file;
+    if (!file.open(globals.data_filePath)) {
+        errorExit("\nError: failed to read from file: "+globals.data_filePath+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    const char *pos = file.data;
+    const char *fileEnd = file.data + file.size;
     
-    // open file stream
-    globals.data_fileStream = safe_ifstream(globals.data_filePath, globals.outputLog_on, globals.outputLog_fileStream);
+    // objects used when reading each row
+    vector< pair<const char*,int> > entries;
+    string entry;
+    int row = 0;
+    int dataRows = 0;
+    int cols = 0;
+    vector< unordered_map<string,int> > alleleIndex;
     
-    // read in raw data file as matrix of strings. Skip header line if necessary
-    vector< vector<string> > rawEntries;
-    vector<string> rawEntries_line;
-    string line1;
-    int row=0;
-    while (safe_getline(globals.data_fileStream, line1))
-    {
-        if (line1.size()==0)
+    // objects used when checking ploidy and pop values. Ploidy (and similarly pop) must be either defined on the first row of an individual (format 1), or defined equally for all rows of an individual (format 2).
+    int thisPloidy=0, countDown=0, ploidy_format=0, pop_format=0;
+    string thisPop;
+    int ind=-1, gene_copy=0;
+    
+    while (pos<fileEnd) {
+        
+        // find the end of this line, and move pos to the start of the next line
+        const char *lineStart = pos;
+        while (pos<fileEnd && *pos!='\n' && *pos!='\r')
+            pos++;
+        const char *lineEnd = pos;
+        if (pos<fileEnd) {
+            if (*pos=='\r' && pos+1<fileEnd && pos[1]=='\n')
+                pos++;
+            pos++;
+        }
+        
+        // skip empty lines and header line
+        if (lineEnd==lineStart)
             continue;
         row++;
         if (row==1 && globals.headerRow_on)
             continue;
-        rawEntries_line.clear();
-        istringstream ss(line1);
-        string line2;
-        while (getline(ss, line2, '\t'))
-        {
-            string line3 = istringstream(line2).str();
-            rawEntries_line.push_back(line3);
-        }
-        rawEntries.push_back(rawEntries_line);
-    }
-    
-    // close file stream
-    globals.data_fileStream.close();
-    
-    // if no data then abort
-    if (rawEntries.size()==0) {
-        cerrAndLog("\nError: data file appears to be empty\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
-    }
-    
-    // check same number of values in each row
-    int cols = int(rawEntries[0].size());
-    for (int i=0; i<int(rawEntries.size()); i++) {
-        int row = globals.headerRow_on ? i+2 : i+1;
-        if (rawEntries[i].size()!=cols) {
-            cerrAndLog("\nError: row "+to_string((long long)row)+string(" in data file does not contain ")+to_string((long long)cols)+string(" entries\n"), globals.outputLog_on, globals.outputLog_fileStream);
-            exit(1);
+        dataRows++;
+        
+        // split line into tab-separated entries. As with getline(), a trailing tab does not produce an extra empty entry
+        entries.clear();
+        const char *entryStart = lineStart;
+        for (const char *c=lineStart; c<=lineEnd; c++) {
+            if (c==lineEnd || *c=='\t') {
+                entries.push_back(make_pair(entryStart, int(c-entryStart)));
+                entryStart = c+1;
+            }
         }
-    }
-    
-    // check that number of columns is compatible with data format options
-    int minCols = 2;
-    minCols = globals.popCol_on ? minCols+1 : minCols;
-    minCols = globals.ploidyCol_on ? minCols+1 : minCols;
-    if (cols<minCols) {
-        cerrAndLog("\nError: data file must contain at least "+to_string((long long)minCols)+string(" columns under current settings\n"), globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
-    }
-    
-    // find which columns in data file correspond to special values
-    int pop_startRead = -1;
-    int ploidy_startRead = -1;
-    int data_startRead = 1;
-    if (globals.ploidyCol_on) {
-        ploidy_startRead = 1;
-        data_startRead++;
-    }
-    if (globals.popCol_on) {
-        pop_startRead = 1;
-        if (ploidy_startRead!=-1)
-            ploidy_startRead++;
-        data_startRead++;
-    }
-    
-    // print these to screen and file
-    if (globals.headerRow_on)
-        coutAndLog("  row 1 = header line\n", globals.outputLog_on, globals.outputLog_fileStream);
-    coutAndLog("  column 1 = individual labels\n", globals.outputLog_on, globals.outputLog_fileStream);
-    if (pop_startRead!=-1)
-        coutAndLog("  column "+to_string((long long)pop_startRead+1)+" = population of origin\n", globals.outputLog_on, globals.outputLog_fileStream);
-    if (ploidy_startRead!=-1)
-        coutAndLog("  column "+to_string((long long)ploidy_startRead+1)+" = ploidy\n", globals.outputLog_on, globals.outputLog_fileStream);
-    
-    // split rawData into special columns and data matrix
-    vector<string> indLabels_raw, pop_raw, ploidy_raw;
-    vector< vector<string> > rawData;
-    vector<string> rawData_line;
-    for (int i=0; i<int(rawEntries.size()); i++) {
-        rawData_line.clear();
-        for (int j=0; j<int(rawEntries[i].size()); j++) {
-            
-            // read in individual labels
-            if (j==0)
-                indLabels_raw.push_back(rawEntries[i][j]);
-            
-            // read in population labels
-            if (j==pop_startRead)
-                pop_raw.push_back(rawEntries[i][j]);
-            
-            // read in ploidy for each individual
-            if (j==ploidy_startRead)
-                ploidy_raw.push_back(rawEntries[i][j]);
+        if (entries.back().second==0)
+            entries.pop_back();
+        
+        // the first row defines the number of columns and loci
+        if (dataRows==1) {
+            cols = int(entries.size());
             
-            // read in data
-            if (j>=data_startRead)
-                rawData_line.push_back(rawEntries[i][j]);
+            // check that number of columns is compatible with data format options
+            int minCols = 2;
+            minCols = globals.popCol_on ? minCols+1 : minCols;
+            minCols = globals.ploidyCol_on ? minCols+1 : minCols;
+            if (cols<minCols) {
+                errorExit("\nError: data file must contain at least "+to_string((long long)minCols)+string(" columns under current settings\n"), globals.outputLog_on, globals.outputLog_fileStream);
+            }
             
+            globals.loci = cols - data_startRead;
+            globals.J = vector<int>(globals.loci);
+            globals.uniqueAlleles = vector< vector<string> >(globals.loci,vector<string>());
+            alleleIndex = vector< unordered_map<string,int> >(globals.loci);
         }
-        rawData.push_back(rawData_line);
-    }
-    
-    // finally define number of loci
-    globals.loci = int(rawData[0].size());
-    
-    // convert ploidy labels into integer format
-    vector<int> ploidy_raw_int(rawEntries.size(),globals.ploidy);
-    if (globals.ploidyCol_on) {
-        for (int i=0; i<int(ploidy_raw.size()); i++) {
+        
+        // check same number of values in each row
+        if (int(entries.size())!=cols) {
+            errorExit("\nError: row "+to_string((long long)row)+string(" in data file does not contain ")+to_string((long long)cols)+string(" entries\n"), globals.outputLog_on, globals.outputLog_fileStream);
+        }
+        
+        // convert ploidy label into integer format
+        int thisRow_ploidy = globals.ploidy;
+        if (globals.ploidyCol_on) {
             double param_double=0;
-            istringstream(ploidy_raw[i]) >> param_double;
+            istringstream(string(entries[ploidy_startRead].first, entries[ploidy_startRead].second)) >> param_double;
             if (round(double(param_double))==param_double && round(double(param_double))>=0) {
-                ploidy_raw_int[i] = int(param_double);
+                thisRow_ploidy = int(param_double);
             } else {
-                cerrAndLog("\nError: all ploidy values in data file must be positive integers\n", globals.outputLog_on, globals.outputLog_fileStream);
-                exit(1);
+                errorExit("\nError: all ploidy values in data file must be positive integers\n", globals.outputLog_on, globals.outputLog_fileStream);
             }
         }
-    }
-    
-    // check that ploidy values make sense. Ploidy must be either defined on the first row of an individual (ploidy_format==1), or defined equally for all rows of an individual (ploidy_format==2).
-    int thisPloidy=0, countDown=0, ploidy_format=0;
-    bool ploidyError = false;
-    for (int i=0; i<int(rawEntries.size()); i++) {
-        // if new individual
-        if (countDown==0) {
-            if (ploidy_raw_int[i]!=0) {
-                thisPloidy = ploidy_raw_int[i];
+        
+        // check that ploidy value makes sense
+        bool newInd = (countDown==0);
+        bool ploidyError = false;
+        if (newInd) {
+            if (thisRow_ploidy!=0) {
+                thisPloidy = thisRow_ploidy;
                 countDown = thisPloidy-1;
             } else {
                 ploidyError = true;
             }
         } else {
-            if (ploidy_raw_int[i]==0) {
+            if (thisRow_ploidy==0) {
                 if (ploidy_format==0 || ploidy_format==1) {
                     ploidy_format = 1;
                     countDown--;
                 } else {
                     ploidyError = true;
                 }
-            } else if (ploidy_raw_int[i]==thisPloidy) {
+            } else if (thisRow_ploidy==thisPloidy) {
                 if (ploidy_format==0 || ploidy_format==2) {
                     ploidy_format = 2;
                     countDown--;
@@ -888,39 +1126,26 @@ void readData(globals &globals) {
             }
         }
         if (ploidyError) {
-            cerrAndLog("\nError: when reading ploidy for each individual from file (using the ploidyCol_on=true option) the data file must contain a ploidy value on the first row of each individual, or alternatively the same ploidy value for all rows of an individual\n", globals.outputLog_on, globals.outputLog_fileStream);
-            exit(1);
+            errorExit("\nError: when reading ploidy for each individual from file (using the ploidyCol_on=true option) the data file must contain a ploidy value on the first row of each individual, or alternatively the same ploidy value for all rows of an individual\n", globals.outputLog_on, globals.outputLog_fileStream);
         }
-    }
-    if (countDown!=0) {
-        cerrAndLog("\nError: data file does not contain sufficient rows to account for ploidy values (also check that headerRow_on is specified correctly)\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
-    }
-    
-    // similarly for pop values. Pop values must be either defined on the first row of an individual (pop_format==1), or defined equally for all rows of an individual (pop_format==2).
-    if (globals.popCol_on) {
-        countDown=0;
-        string thisPop;
-        int pop_format=0;
-        bool popError = false;
-        for (int i=0; i<int(rawEntries.size()); i++) {
-            // if new individual
-            if (countDown==0) {
-                thisPop = pop_raw[i];
-                countDown = ploidy_raw_int[i]-1;
-            // if not new individual
+        
+        // similarly check that pop value makes sense
+        string thisRow_pop;
+        if (globals.popCol_on) {
+            thisRow_pop = string(entries[pop_startRead].first, entries[pop_startRead].second);
+            bool popError = false;
+            if (newInd) {
+                thisPop = thisRow_pop;
             } else {
-                if (pop_raw[i]=="") {
+                if (thisRow_pop=="") {
                     if (pop_format==0 || pop_format==1) {
                         pop_format = 1;
-                        countDown--;
                     } else {
                         popError = true;
                     }
-                } else if (pop_raw[i]==thisPop) {
+                } else if (thisRow_pop==thisPop) {
                     if (pop_format==0 || pop_format==2) {
                         pop_format = 2;
-                        countDown--;
                     } else {
                         popError = true;
                     }
@@ -929,73 +1154,313 @@ void readData(globals &globals) {
                 }
             }
             if (popError) {
-                cerrAndLog("\nError: when reading population of origin for each individual from file (using the popCol_on=true option) the data file must contain a population value on the first row of each individual, or alternatively the same population value for all rows of an individual\n", globals.outputLog_on, globals.outputLog_fileStream);
-                exit(1);
+                errorExit("\nError: when reading population of origin for each individual from file (using the popCol_on=true option) the data file must contain a population value on the first row of each individual, or alternatively the same population value for all rows of an individual\n", globals.outputLog_on, globals.outputLog_fileStream);
             }
         }
-    }
-    
-    // find all unique alleles, and count number of missing values
-    globals.J = vector<int>(globals.loci);
-    globals.uniqueAlleles = vector< vector<string> >(globals.loci,vector<string>());
-    int missingDataCount = 0;
-    for (int j=0; j<globals.loci; j++) {
-        for (int i=0; i<int(rawData.size()); i++) {
-            if (rawData[i][j]==globals.missingData) {
-                missingDataCount++;
-            } else {
-                if (find(globals.uniqueAlleles[j].begin(), globals.uniqueAlleles[j].end(), rawData[i][j]) == globals.uniqueAlleles[j].end()) {
-                    globals.uniqueAlleles[j].push_back(rawData[i][j]);
-                }
-            }
-        }
-        globals.J[j] = int(globals.uniqueAlleles[j].size());
-    }
-    
-    // reformat data into simple list: data[individual][locus][gene copy]. Recode values to simple list of integers, with 0 meaning missing data. Keep record of missing data elements in data_missing (1=missing, 0=present). Store indLabels_vec, pop_vec, ploidy_vec and missing_vec values.
-    countDown=0;
-    int ind=-1, gene_copy=0;
-    for (int i=0; i<int(rawEntries.size()); i++) {
-        // if new individual
-        if (countDown==0) {
+        
+        // if new individual then store indLabels_vec, pop_vec, ploidy_vec and missing_vec values, and make room for genotypes
+        if (newInd) {
             ind++;
-            globals.indLabels_vec.push_back(indLabels_raw[i]);
+            globals.indLabels_vec.push_back(string(entries[0].first, entries[0].second));
             if (globals.popCol_on) {
-                globals.pop_vec.push_back(pop_raw[i]);
+                globals.pop_vec.push_back(thisRow_pop);
             } else {
                 globals.pop_vec.push_back("NA");
             }
-            globals.ploidy_vec.push_back(ploidy_raw_int[i]);
+            globals.ploidy_vec.push_back(thisPloidy);
             globals.missing_vec.push_back(0);
-            countDown = globals.ploidy_vec[ind]-1;
             gene_copy = 0;
-            
-            globals.data.push_back(vector< vector<int> >(globals.loci,vector<int>(globals.ploidy_vec[ind])));
-            for (int l=0; l<globals.loci; l++) {
-                if (rawData[i][l]==globals.missingData) {
-                    globals.data[ind][l][gene_copy] = 0;
-                    globals.missing_vec[ind]++;
-                } else {
-                    globals.data[ind][l][gene_copy] = whichFirst(globals.uniqueAlleles[l],rawData[i][l])+1;
-                }
-            }
-        // if not new individual
+            globals.data_indStart.push_back(int(data.values.size()));
+            data.values.resize(data.values.size() + globals.loci*thisPloidy);
         } else {
-            countDown--;
             gene_copy++;
-            for (int l=0; l<globals.loci; l++) {
-                if (rawData[i][l]==globals.missingData) {
-                    globals.data[ind][l][gene_copy] = 0;
-                    globals.missing_vec[ind]++;
-                } else {
-                    globals.data[ind][l][gene_copy] = whichFirst(globals.uniqueAlleles[l],rawData[i][l])+1;
+        }
+        
+        // recode alleles to simple list of integers, with 0 meaning missing data
+        uint16_t *data_ind = &data.values[globals.data_indStart[ind]];
+        int ploidy = globals.ploidy_vec[ind];
+        for (int l=0; l<globals.loci; l++) {
+            entry.assign(entries[data_startRead+l].first, entries[data_startRead+l].second);
+            if (entry==globals.missingData) {
+                data_ind[l*ploidy + gene_copy] = 0;
+                globals.missing_vec[ind]++;
+                missingDataCount++;
+                continue;
+            }
+            unordered_map<string,int>::iterator it = alleleIndex[l].find(entry);
+            if (it==alleleIndex[l].end()) {
+                
+                // alleles are stored as 16-bit integers
+                if (globals.J[l]==65535) {
+                    errorExit("\nError: locus "+to_string((long long)l+1)+string(" contains more than 65535 unique alleles\n"), globals.outputLog_on, globals.outputLog_fileStream);
                 }
+                globals.uniqueAlleles[l].push_back(entry);
+                globals.J[l]++;
+                it = alleleIndex[l].insert(make_pair(entry, globals.J[l])).first;
             }
+            data_ind[l*ploidy + gene_copy] = uint16_t(it->second);
         }
     }
     
+    // if no data then abort
+    if (dataRows==0) {
+        errorExit("\nError: data file appears to be empty\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    
+    if (countDown!=0) {
+        errorExit("\nError: data file does not contain sufficient rows to account for ploidy values (also check that headerRow_on is specified correctly)\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+}
+
+//------------------------------------------------
+// cursor for reading values back out of a binary cache file, keeping track of whether the end of the file has been overrun
+struct cacheReader {
+    const char *pos;
+    const char *end;
+    bool ok;
+    
+    template<class TYPE>
+    TYPE get() {
+        TYPE x = TYPE();
+        if (pos+sizeof(TYPE)>end) {
+            ok = false;
+            return(x);
+        }
+        memcpy(&x, pos, sizeof(TYPE));
+        pos += sizeof(TYPE);
+        return(x);
+    }
+    
+    string getString() {
+        uint32_t length = get<uint32_t>();
+        if (!ok || pos+length>end) {
+            ok = false;
+            return(string());
+        }
+        string x(pos, length);
+        pos += length;
+        return(x);
+    }
+};
+
+//------------------------------------------------
+// append string to binary cache, preceded by its length
+static void appendString(string &s, const string &x) {
+    appendBinary(s, uint32_t(x.size()));
+    s += x;
+}
+
+//------------------------------------------------
+// append the header of the binary cache file. The cache is only valid for the data file (identified by its size and a hash of its contents) and data format options that were used to create it.
+static void appendCacheHeader(globals &globals, string &s, int64_t fileSize, uint64_t fileHash) {
+    s.append("MVKDAT2", 8);
+    appendBinary(s, fileSize);
+    appendBinary(s, fileHash);
+    appendBinary(s, uint8_t(globals.headerRow_on));
+    appendBinary(s, uint8_t(globals.popCol_on));
+    appendBinary(s, uint8_t(globals.ploidyCol_on));
+    appendBinary(s, int32_t(globals.ploidy));
+    appendString(s, globals.missingData);
+}
+
+//------------------------------------------------
+// append parsed data in binary form. Used both for the cache file and for passing the data between processes.
+static void appendDataBody(globals &globals, const genotypeData &data, string &s, int missingDataCount) {
+    appendBinary(s, int32_t(globals.indLabels_vec.size()));
+    appendBinary(s, int32_t(globals.loci));
+    for (int i=0; i<int(globals.indLabels_vec.size()); i++) {
+        appendString(s, globals.indLabels_vec[i]);
+        appendString(s, globals.pop_vec[i]);
+        appendBinary(s, int32_t(globals.ploidy_vec[i]));
+        appendBinary(s, int32_t(globals.missing_vec[i]));
+    }
+    for (int l=0; l<globals.loci; l++) {
+        appendBinary(s, int32_t(globals.J[l]));
+        for (int j=0; j<globals.J[l]; j++) {
+            appendString(s, globals.uniqueAlleles[l][j]);
+        }
+    }
+    appendBinary(s, int32_t(missingDataCount));
+    appendBinary(s, uint64_t(data.values.size()));
+    s.append(reinterpret_cast<const char*>(data.values.data()), data.values.size()*sizeof(uint16_t));
+}
+
+//------------------------------------------------
+// write parsed data to binary cache file (see Notes.c). Failure to write the cache is not an error, as it only affects the speed of later runs.
+static void writeDataCache(globals &globals, const genotypeData &data, const string &cachePath, int missingDataCount) {
+    
+    mappedFile dataFile;
+    if (!dataFile.open(globals.data_filePath))
+        return;
+    int64_t fileSize = int64_t(dataFile.size);
+    uint64_t fileHash = dataFile.hash();
+    dataFile.close();
+    
+    string s;
+    appendCacheHeader(globals, s, fileSize, fileHash);
+    appendDataBody(globals, data, s, missingDataCount);
+    
+    ofstream cacheStream(cachePath, ios::out | ios::binary);
+    if (!cacheStream.is_open())
+        return;
+    cacheStream.write(s.data(), s.size());
+    cacheStream.close();
+    coutAndLog_data("  data cached to: "+cachePath+string("\n"), globals.outputLog_on, globals);
+}
+
+//------------------------------------------------
+// read back data written by appendDataBody(), with genotypes going into data. Returns false (leaving the globals object and data untouched) if the data are damaged.
+static bool readDataBody(globals &globals, cacheReader &r, genotypeData &data, int &missingDataCount) {
+    
+    // read individual-level values
+    int n = r.get<int32_t>();
+    int loci = r.get<int32_t>();
+    if (!r.ok || n<=0 || loci<=0)
+        return(false);
+    vector<string> indLabels_vec(n), pop_vec(n);
+    vector<int> ploidy_vec(n), missing_vec(n);
+    for (int i=0; i<n && r.ok; i++) {
+        indLabels_vec[i] = r.getString();
+        pop_vec[i] = r.getString();
+        ploidy_vec[i] = r.get<int32_t>();
+        missing_vec[i] = r.get<int32_t>();
+    }
+    
+    // read alleles
+    vector<int> J(loci);
+    vector< vector<string> > uniqueAlleles(loci);
+    for (int l=0; l<loci && r.ok; l++) {
+        J[l] = r.get<int32_t>();
+        if (J[l]<0 || J[l]>65535)
+            return(false);
+        uniqueAlleles[l] = vector<string>(J[l]);
+        for (int j=0; j<J[l] && r.ok; j++) {
+            uniqueAlleles[l][j] = r.getString();
+        }
+    }
+    
+    // read genotypes
+    int missing = r.get<int32_t>();
+    uint64_t dataSize = r.get<uint64_t>();
+    if (!r.ok || uint64_t(r.end-r.pos)!=dataSize*sizeof(uint16_t))
+        return(false);
+    vector<uint16_t> values(dataSize);
+    memcpy(values.data(), r.pos, dataSize*sizeof(uint16_t));
+    
+    // everything read successfully, so store in globals object
+    globals.indLabels_vec = indLabels_vec;
+    globals.pop_vec = pop_vec;
+    globals.ploidy_vec = ploidy_vec;
+    globals.missing_vec = missing_vec;
+    globals.loci = loci;
+    globals.J = J;
+    globals.uniqueAlleles = uniqueAlleles;
+    data.values.swap(values);
+    globals.data_indStart.clear();
+    int start = 0;
+    for (int i=0; i<n; i++) {
+        globals.data_indStart.push_back(start);
+        start += loci*ploidy_vec[i];
+    }
+    missingDataCount = missing;
+    
+    return(true);
+}
+
+//------------------------------------------------
+// read parsed data from binary cache file. Returns false (leaving the globals object untouched) if the cache does not exist, was created from a different version of the data file or with different data format options, or is damaged.
+static bool readDataCache(globals &globals, const string &cachePath, genotypeData &data, int &missingDataCount) {
+    
+    // hashing the data file is much quicker than parsing it, and means that the cache is never used for a data file with different contents
+    mappedFile dataFile;
+    if (!dataFile.open(globals.data_filePath))
+        return(false);
+    int64_t fileSize = int64_t(dataFile.size);
+    uint64_t fileHash = dataFile.hash();
+    dataFile.close();
+    
+    mappedFile file;
+    if (!file.open(cachePath))
+        return(false);
+    
+    // check header
+    string header;
+    appendCacheHeader(globals, header, fileSize, fileHash);
+    if (file.size<header.size() || memcmp(file.data, header.data(), header.size())!=0)
+        return(false);
+    cacheReader r = {file.data+header.size(), file.data+file.size, true};
+    if (!readDataBody(globals, r, data, missingDataCount))
+        return(false);
+    
+    coutAndLog_data("  data read from cache: "+cachePath+string("\n"), globals.outputLog_on, globals);
+    return(true);
+}
+
+//------------------------------------------------
+// read in data file
+void readData(globals &globals) {
+    
+    coutAndLog_data("Loading data file...\n", false, globals);
+    writeToFile("Data properties\n", globals.outputLog_on, globals.outputLog_fileStream);
+    
+    // find which columns in data file correspond to special values
+    int pop_startRead = -1;
+    int ploidy_startRead = -1;
+    int data_startRead = 1;
+    if (globals.ploidyCol_on) {
+        ploidy_startRead = 1;
+        data_startRead++;
+    }
+    if (globals.popCol_on) {
+        pop_startRead = 1;
+        if (ploidy_startRead!=-1)
+            ploidy_startRead++;
+        data_startRead++;
+    }
+    
+    // print these to screen and file
+    if (globals.headerRow_on)
+        coutAndLog_data("  row 1 = header line\n", globals.outputLog_on, globals);
+    coutAndLog_data("  column 1 = individual labels\n", globals.outputLog_on, globals);
+    if (pop_startRead!=-1)
+        coutAndLog_data("  column "+to_string((long long)pop_startRead+1)+" = population of origin\n", globals.outputLog_on, globals);
+    if (ploidy_startRead!=-1)
+        coutAndLog_data("  column "+to_string((long long)ploidy_startRead+1)+" = ploidy\n", globals.outputLog_on, globals);
+    
+    // read from binary cache if available, otherwise parse data file (and optionally create cache)
+    int missingDataCount = 0;
+    shared_ptr<genotypeData> data(new genotypeData);
+    string cachePath = globals.data_filePath + ".mvkbin";
+    if (globals.rank==0) {
+        if (!globals.dataCache_on || !readDataCache(globals, cachePath, *data, missingDataCount)) {
+            parseDataFile(globals, *data, pop_startRead, ploidy_startRead, data_startRead, missingDataCount);
+            if (globals.dataCache_on)
+                writeDataCache(globals, *data, cachePath, missingDataCount);
+        }
+    }
+    
+    // when running over several processes only the first reads the data, which is then passed to all others
+    if (globals.ranks>1) {
+        string s;
+        if (globals.rank==0)
+            appendDataBody(globals, *data, s, missingDataCount);
+        distributed_broadcast(s);
+        if (globals.rank>0) {
+            cacheReader r = {s.data(), s.data()+s.size(), true};
+            if (!readDataBody(globals, r, *data, missingDataCount)) {
+                errorExit("\nError: data received from process 0 are damaged\n", globals.outputLog_on, globals.outputLog_fileStream);
+            }
+        }
+    }
+    
+    globals.J_offset = vector<int>(globals.loci+1);
+    for (int l=0; l<globals.loci; l++) {
+        globals.J_offset[l+1] = globals.J_offset[l] + globals.J[l];
+    }
+    
     // finally define number of individuals and gene copies
     globals.n = int(globals.indLabels_vec.size());
+    globals.data_indStart.push_back(int(data->size()));
     globals.geneCopies = sum(globals.ploidy_vec)*globals.loci;
     
     // check that there is at least one allele at every locus
@@ -1003,16 +1468,25 @@ void readData(globals &globals) {
         bool tmp = true;
         for (int i=0; i<globals.n; i++) {
             for (int p=0; p<globals.ploidy_vec[i]; p++) {
-                if (globals.data[i][l][p]!=0)
+                if ((*data)[globals.data_indStart[i] + l*globals.ploidy_vec[i] + p]!=0)
                     tmp = false;
             }
         }
         if (tmp) {
-            coutAndLog("\nError: there must be at least one non-missing observation at every locus\n", globals.outputLog_on, globals.outputLog_fileStream);
-            exit(1);
+            errorExit("\nError: there must be at least one non-missing observation at every locus\n", globals.outputLog_on, globals.outputLog_fileStream);
         }
     }
     
+    // if all loci are biallelic then pack the data down to 2 bits per gene copy
+    globals.biallelic = true;
+    for (int l=0; l<globals.loci; l++) {
+        if (globals.J[l]>2)
+            globals.biallelic = false;
+    }
+    if (globals.biallelic)
+        globals.biallelic = data->pack();
+    globals.data = data;
+    
     // find number of unique populations and store pop index of each individual
     if (globals.popCol_on) {
         globals.pop_index = vector<int>(globals.n);
@@ -1032,10 +1506,10 @@ void readData(globals &globals) {
     
     // print basic properties to screen and file
     if (globals.popCol_on)
-        coutAndLog("  unique populations = "+to_string((long long)globals.uniquePops.size())+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+        coutAndLog_data("  unique populations = "+to_string((long long)globals.uniquePops.size())+string("\n"), globals.outputLog_on, globals);
     
-    coutAndLog("  individuals = "+to_string((long long)globals.n)+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
-    coutAndLog("  loci = "+to_string((long long)globals.loci)+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+    coutAndLog_data("  individuals = "+to_string((long long)globals.n)+string("\n"), globals.outputLog_on, globals);
+    coutAndLog_data("  loci = "+to_string((long long)globals.loci)+string("\n"), globals.outputLog_on, globals);
     
     stringstream alleles;
     alleles << "  alleles per locus = {" << globals.J[0];
@@ -1043,9 +1517,11 @@ void readData(globals &globals) {
         alleles << "," << globals.J[l];
     }
     alleles << "}\n";
-    coutAndLog(alleles.str(), globals.outputLog_on, globals.outputLog_fileStream);
+    coutAndLog_data(alleles.str(), globals.outputLog_on, globals);
+    if (globals.biallelic)
+        coutAndLog_data("  all loci biallelic (genotypes packed to 2 bits per gene copy)\n", globals.outputLog_on, globals);
     
-    coutAndLog("  missing observations = "+to_string((long long)missingDataCount)+string(" of ")+to_string((long long)sum(globals.ploidy_vec)*globals.loci)+string("\n\n"), globals.outputLog_on, globals.outputLog_fileStream);    
+    coutAndLog_data("  missing observations = "+to_string((long long)missingDataCount)+string(" of ")+to_string((long long)sum(globals.ploidy_vec)*globals.loci)+string("\n\n"), globals.outputLog_on, globals);    
     
 }
 
@@ -1072,60 +1548,70 @@ void checkOptions(globals &globals) {
     
     // force fixLabels_on=true if producing any Qmatrix output
     if (!globals.fixLabels_on && (globals.outputQmatrix_ind_on || globals.outputQmatrix_pop_on || globals.outputQmatrix_gene_on)) {
-        cerrAndLog("\nError: the label switching problem must be solved in order to produce Qmatrix output. Either set fixLabels_on to true, or turn off all Qmatrix output.\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: the label switching problem must be solved in order to produce Qmatrix output. Either set fixLabels_on to true, or turn off all Qmatrix output.\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force popCol_on=true if producing Qmatrix_pop files
     if (!globals.popCol_on && globals.outputQmatrix_pop_on) {
-        cerrAndLog("\nError: unable to produce population level Qmatrix, as population data not currently being used. Either read in population data (by setting popCol_on to true), or stop producing population level Qmatrix output (by setting outputQmatrix_pop_on to false and outputQmatrixError_pop_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: unable to produce population level Qmatrix, as population data not currently being used. Either read in population data (by setting popCol_on to true), or stop producing population level Qmatrix output (by setting outputQmatrix_pop_on to false and outputQmatrixError_pop_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force admix_on=true if producing Qmatrix_gene files
     if (!globals.admix_on && globals.outputQmatrix_gene_on) {
-        cerrAndLog("\nError: admixture model must be turned on in order to produce gene level Qmatrix. Either switch to the admixture model (by setting admix_on to true) or stop producing gene level Qmatrix output (by setting outputQmatrix_gene_on and outputQmatrixError_gene_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: admixture model must be turned on in order to produce gene level Qmatrix. Either switch to the admixture model (by setting admix_on to true) or stop producing gene level Qmatrix output (by setting outputQmatrix_gene_on and outputQmatrixError_gene_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    
+    // force thermodynamicMaxRungs>=thermodynamicRungs if adding rungs adaptively
+    if (globals.thermodynamicTargetSE>0 && globals.thermodynamicMaxRungs<globals.thermodynamicRungs) {
+        errorExit("\nError: thermodynamicMaxRungs must be greater than or equal to thermodynamicRungs when thermodynamicTargetSE is used.\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    
+    // output written on every MCMC iteration cannot be rolled back to the last checkpoint, so do not allow it when checkpointing or resuming
+    if ((globals.checkpointInterval>0 || globals.resume_on) && (globals.outputLikelihood_on || globals.outputPosteriorGrouping_on)) {
+        errorExit("\nError: outputLikelihood_on and outputPosteriorGrouping_on must be false when checkpointInterval is used or when resuming from a checkpoint.\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    
+    // output written on every MCMC iteration goes to a single file in order of K and repeat, which cannot be kept when several chains write to it at the same time
+    if (globals.threads>1 && (globals.Kmax>globals.Kmin || (globals.parallelRepeats_on && globals.mainRepeats>1)) && (globals.outputLikelihood_on || globals.outputPosteriorGrouping_on)) {
+        errorExit("\nError: outputLikelihood_on and outputPosteriorGrouping_on must be false when more than one MCMC chain runs at a time. Either set threads to 1, or analyse a single value of K (with parallelRepeats_on set to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    
+    // output written on every MCMC iteration goes to a single file, which cannot be shared between processes
+    if (globals.ranks>1 && (globals.outputLikelihood_on || globals.outputPosteriorGrouping_on)) {
+        errorExit("\nError: outputLikelihood_on and outputPosteriorGrouping_on must be false when running over multiple processes.\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force admix_on=true if producing maximum likelihood admixture frequencies
     if (!globals.admix_on && globals.outputMaxLike_admixFreqs_on) {
-        cerrAndLog("\nError: admixture model must be turned on in order to produce maximum likelihood admixture frequency output. Either switch to the admixture model (by setting admix_on to true) or stop producing maximum likelihood admixture frequency output (by setting outputMaxLike_admixFreqs_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: admixture model must be turned on in order to produce maximum likelihood admixture frequency output. Either switch to the admixture model (by setting admix_on to true) or stop producing maximum likelihood admixture frequency output (by setting outputMaxLike_admixFreqs_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force outputQmatrix_?_on=true if outputQmatrixError_?_on=true for all Qmatrix types
     if ((globals.outputQmatrixError_ind_on && !globals.outputQmatrix_ind_on) || (globals.outputQmatrixError_pop_on && !globals.outputQmatrix_pop_on) || (globals.outputQmatrixError_gene_on && !globals.outputQmatrix_gene_on)) {
-        cerrAndLog("\nError: if outputQmatrixError options are turned on then the corresponding outputQmatrix options must also be turned on.\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: if outputQmatrixError options are turned on then the corresponding outputQmatrix options must also be turned on.\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force mainRepeats>1 if outputQmatrixError_?_on=true for all Qmatrix types
     if (globals.mainRepeats==1 && (globals.outputQmatrixError_ind_on || globals.outputQmatrixError_pop_on || globals.outputQmatrixError_gene_on)) {
-        cerrAndLog("\nError: mainRepeats must be greater than 1 when any outputQmatrixError options are turned on.\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: mainRepeats must be greater than 1 when any outputQmatrixError options are turned on.\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force EMalgorithm_on=true if producing model comparison statistics
     if (!globals.EMalgorithm_on && globals.outputComparisonStatistics_on) {
-        cerrAndLog("\nError: EM algorithm must be turned on in order to compute model comparison statistics. Either turn on the EM algorithm (by setting EMalgorithm_on to true) or stop producing model comparison statistics (by setting outputComparisonStatistics_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: EM algorithm must be turned on in order to compute model comparison statistics. Either turn on the EM algorithm (by setting EMalgorithm_on to true) or stop producing model comparison statistics (by setting outputComparisonStatistics_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force EMalgorithm_on=true if producing maximum likelihood output
     if (!globals.EMalgorithm_on && (globals.outputMaxLike_alleleFreqs_on || globals.outputMaxLike_admixFreqs_on)) {
-        cerrAndLog("\nError: EM algorithm must be turned on in order to produce maximum likelihood output files. Either turn on the EM algorithm (by setting EMalgorithm_on to true) or stop producing maximum likelihood output (by setting outputMaxLike_alleleFreqs_on and outputMaxLike_admixFreqs_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: EM algorithm must be turned on in order to produce maximum likelihood output files. Either turn on the EM algorithm (by setting EMalgorithm_on to true) or stop producing maximum likelihood output (by setting outputMaxLike_alleleFreqs_on and outputMaxLike_admixFreqs_on to false).\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // force (Kmax-Kmin)>=2 and mainRepeats>1 if outputEvanno_on=true
     if ((globals.Kmax-globals.Kmin)<2 && globals.outputEvanno_on) {
-        cerrAndLog("\nError: Kmax must be at least 2 greater than Kmin when calculating Evanno's delta K.\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: Kmax must be at least 2 greater than Kmin when calculating Evanno's delta K.\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     if (globals.mainRepeats==1 && globals.outputEvanno_on) {
-        cerrAndLog("\nError: mainRepeats must be greater than 1 when calculating Evanno's delta K.\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nError: mainRepeats must be greater than 1 when calculating Evanno's delta K.\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     // if using exhaustive approach, check that number of partitions required to sum over is reasonable. Otherwise throw warning
@@ -1142,12 +1628,10 @@ void checkOptions(globals &globals) {
         
         // if very large then error
         if (log_partitions>180) {
-            cerrAndLog("\nWarning: for this combination of data and parameters the number of partitions explored in the exhaustive approach is greater than the number of protons in the observable universe, and the program is unlikely to finish within your lifetime. Either turn off the exhaustive approach, or to override this warning and continue with the analysis insert the optional parameter \"suppressWarning1_on\" with value \"true\" in the parameters file.\n", globals.outputLog_on, globals.outputLog_fileStream);
-            exit(1);
+            errorExit("\nWarning: for this combination of data and parameters the number of partitions explored in the exhaustive approach is greater than the number of protons in the observable universe, and the program is unlikely to finish within your lifetime. Either turn off the exhaustive approach, or to override this warning and continue with the analysis insert the optional parameter \"suppressWarning1_on\" with value \"true\" in the parameters file.\n", globals.outputLog_on, globals.outputLog_fileStream);
         }
         if (log_partitions>log(double(1e7))) {
-            cerrAndLog("\nWarning: for this combination of data and parameters the number of partitions explored in the exhaustive approach is extremely large (greater than 1e7 in total), and the program may take a very long time to execute. Either turn off the exhaustive approach, or to override this warning and continue with the analysis insert the optional parameter \"suppressWarning1_on\" with value \"true\" in the parameters file.\n", globals.outputLog_on, globals.outputLog_fileStream);
-            exit(1);
+            errorExit("\nWarning: for this combination of data and parameters the number of partitions explored in the exhaustive approach is extremely large (greater than 1e7 in total), and the program may take a very long time to execute. Either turn off the exhaustive approach, or to override this warning and continue with the analysis insert the optional parameter \"suppressWarning1_on\" with value \"true\" in the parameters file.\n", globals.outputLog_on, globals.outputLog_fileStream);
         }
         
     }
@@ -1156,15 +1640,13 @@ void checkOptions(globals &globals) {
     if (int(globals.alpha.size())==1) {
         globals.alpha = vector<double>(globals.Kmax-globals.Kmin+1, globals.alpha[0]);
     } else if (int(globals.alpha.size())!=(globals.Kmax-globals.Kmin+1)) {
-        cerrAndLog("\nWarning: alpha must contain either a single value to apply to all K, or a comma-separated list of values of length (Kmax-Kmin+1) to apply to each K individually.\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nWarning: alpha must contain either a single value to apply to all K, or a comma-separated list of values of length (Kmax-Kmin+1) to apply to each K individually.\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
     if (int(globals.alphaPropSD.size())==1) {
         globals.alphaPropSD = vector<double>(globals.Kmax-globals.Kmin+1, globals.alphaPropSD[0]);
     } else if (int(globals.alphaPropSD.size())!=(globals.Kmax-globals.Kmin+1)) {
-        cerrAndLog("\nWarning: alphaPropSD must contain either a single value to apply to all K, or a comma-separated list of values of length (Kmax-Kmin+1).\n", globals.outputLog_on, globals.outputLog_fileStream);
-        exit(1);
+        errorExit("\nWarning: alphaPropSD must contain either a single value to apply to all K, or a comma-separated list of values of length (Kmax-Kmin+1).\n", globals.outputLog_on, globals.outputLog_fileStream);
     }
     
 }
@@ -15,10 +15,16 @@
 
 #include <iostream>
 #include <sstream>
+#include <unordered_map>
+#include <cstring>
+#include <stdexcept>
 
 #include "globals.h"
 #include "misc.h"
 #include "OSfunctions.h"
+#include "mappedFile.h"
+#include "outputWriter.h"
+#include "distributed.h"
 
 //------------------------------------------------
 // write to file if condition is true
@@ -32,6 +38,38 @@ void coutAndLog(std::string message, bool writeToFile, std::ofstream &fileStream
 // write error to screen, and to file if writeToFile is true
 void cerrAndLog(std::string message, bool writeToFile, std::ofstream &logFileStream);
 
+//------------------------------------------------
+// error thrown by errorExit() in place of ending the program, holding the error message
+class maverickError : public std::runtime_error {
+public:
+    maverickError(const std::string &message);
+};
+
+//------------------------------------------------
+// while an object of this class exists, errors raised on the same thread by errorExit() are thrown as a maverickError instead of ending the program. Used by the library (see library.h), so that invalid settings or data are reported to the calling program rather than ending it.
+class throwErrors {
+public:
+    throwErrors();
+    ~throwErrors();
+
+    // true if errors raised on this thread are currently thrown
+    static bool active();
+private:
+    bool previous;
+};
+
+//------------------------------------------------
+// write error to screen, and to file if writeToFile is true, and exit. Within the scope of a throwErrors object the error is instead thrown as a maverickError, and nothing is written.
+void errorExit(std::string message, bool writeToFile, std::ofstream &logFileStream);
+
+//------------------------------------------------
+// write message arising from checking parameters or reading the data to screen, and to file if writeToFile is true. If bufferConsole_on is set then the message is instead added to dataBuffer, and nothing is written.
+void coutAndLog_data(std::string message, bool writeToFile, globals &globals);
+
+//------------------------------------------------
+// write message arising from the analysis of a given K to screen and log. If the K loop is running over multiple threads then the message is instead added to the buffer for this K, to be released later in K order (and likewise if bufferConsole_on is set).
+void coutAndLog_K(std::string message, globals &globals, int Kindex);
+
 //------------------------------------------------
 // safely open input file stream, otherwise error. Option to write errors to file if writeErrorToFile is true.
 std::ifstream safe_ifstream(std::string fileName, bool writeToFile, std::ofstream &logFileStream);
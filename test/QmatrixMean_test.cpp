@@ -0,0 +1,83 @@
+//
+//  MavericK
+//  QmatrixMean_test.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Checks that a Qmatrix mean accumulated in single precision with compensation (as used for the stored Qmatrix when QmatrixFloat_on) agrees with the same mean accumulated in double precision to well within the 3 decimal places written to the output files. Run with "make test".
+//
+// ---------------------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include "../QmatrixMean.h"
+
+using namespace std;
+
+int main() {
+    
+    // largest difference allowed, a tenth of the half unit in the last decimal written out
+    const double tolerance = 0.00005;
+    
+    const int rows = 40;
+    const int K = 6;
+    const int iterations = 2000000;
+    
+    QmatrixMean mean_double, mean_float;
+    mean_double.reset(rows, K, false, false, 0);
+    mean_float.reset(rows, K, true, true, 0);
+    
+    // each row has its own underlying distribution over demes, around which new Qmatrices are drawn, so that some values sit close to 0 or 1 and others in between
+    default_random_engine generator(1);
+    uniform_real_distribution<double> runif(0,1);
+    vector<double> centre(rows*K);
+    for (int i=0; i<rows; i++) {
+        double sum = 0;
+        for (int k=0; k<K; k++) {
+            centre[i*K+k] = pow(runif(generator), 4);
+            sum += centre[i*K+k];
+        }
+        for (int k=0; k<K; k++) {
+            centre[i*K+k] /= sum;
+        }
+    }
+    
+    vector<double> Qnew(rows*K);
+    vector<int> labelMap(K);
+    for (int k=0; k<K; k++) {
+        labelMap[k] = k;
+    }
+    for (int rep=0; rep<iterations; rep++) {
+        for (int i=0; i<rows; i++) {
+            double sum = 0;
+            for (int k=0; k<K; k++) {
+                Qnew[i*K+k] = centre[i*K+k]*(0.5+runif(generator));
+                sum += Qnew[i*K+k];
+            }
+            for (int k=0; k<K; k++) {
+                Qnew[i*K+k] /= sum;
+            }
+        }
+        mean_double.add(Qnew, labelMap);
+        mean_float.add(Qnew, labelMap);
+    }
+    
+    double maxDiff = 0;
+    for (int i=0; i<rows; i++) {
+        for (int k=0; k<K; k++) {
+            maxDiff = max(maxDiff, fabs(mean_float.get(i,k)-mean_double.get(i,k)));
+        }
+    }
+    
+    cout << "largest difference between float and double Qmatrix means: " << maxDiff << "\n";
+    if (maxDiff>tolerance) {
+        cout << "FAILED: difference is greater than " << tolerance << "\n";
+        return(1);
+    }
+    cout << "passed\n";
+    return(0);
+}
@@ -0,0 +1,132 @@
+//
+//  MavericK
+//  welford.cpp
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Further details (if any) of this set of functions can be found in the corresponding header file.
+//
+// ---------------------------------------------------------------------------
+
+#include "welford.h"
+
+using namespace std;
+
+//------------------------------------------------
+// welford::
+// constructor
+welford::welford() {
+    reset();
+}
+
+//------------------------------------------------
+// welford::
+// remove all values
+void welford::reset() {
+    n = 0;
+    mean = 0;
+    M2 = 0;
+}
+
+//------------------------------------------------
+// welford::
+// add a single value
+void welford::add(double x) {
+    n++;
+    double delta = x - mean;
+    mean += delta/n;
+    M2 += delta*(x - mean);
+}
+
+//------------------------------------------------
+// welford::
+// merge in values from another accumulator (Chan et al. 1979)
+void welford::merge(const welford &other) {
+    if (other.n==0)
+        return;
+    double n_new = n + other.n;
+    double delta = other.mean - mean;
+    mean += delta*other.n/n_new;
+    M2 += other.M2 + delta*delta*n*other.n/n_new;
+    n = n_new;
+}
+
+//------------------------------------------------
+// welford::
+// sample variance (dividing by n-1), or population variance (dividing by n) if sampleVar is false. Zero if there are too few values.
+double welford::var(bool sampleVar) const {
+    if (n<2)
+        return(0);
+    double output = sampleVar ? M2/(n-1) : M2/n;
+    return((output<0) ? 0 : output);
+}
+
+//------------------------------------------------
+// welfordMatrix::
+// constructor
+welfordMatrix::welfordMatrix() {
+    rows = 0;
+    cols = 0;
+    n = 0;
+}
+
+//------------------------------------------------
+// welfordMatrix::
+// resize and remove all values
+void welfordMatrix::reset(int _rows, int _cols) {
+    rows = _rows;
+    cols = _cols;
+    n = 0;
+    mean = vector<double>(rows*cols);
+    M2 = vector<double>(rows*cols);
+}
+
+//------------------------------------------------
+// welfordMatrix::
+// add a single matrix of values
+void welfordMatrix::add(const vector< vector<double> > &x) {
+    n++;
+    double weight = 1.0/n;
+    for (int i=0; i<rows; i++) {
+        double *mean_i = &mean[i*cols];
+        double *M2_i = &M2[i*cols];
+        const double *x_i = &x[i][0];
+        for (int j=0; j<cols; j++) {
+            double delta = x_i[j] - mean_i[j];
+            mean_i[j] += delta*weight;
+            M2_i[j] += delta*(x_i[j] - mean_i[j]);
+        }
+    }
+}
+
+//------------------------------------------------
+// welfordMatrix::
+// merge in values from another accumulator of the same size
+void welfordMatrix::merge(const welfordMatrix &other) {
+    if (other.n==0)
+        return;
+    double n_new = n + other.n;
+    for (int i=0; i<rows*cols; i++) {
+        double delta = other.mean[i] - mean[i];
+        mean[i] += delta*other.n/n_new;
+        M2[i] += other.M2[i] + delta*delta*n*other.n/n_new;
+    }
+    n = n_new;
+}
+
+//------------------------------------------------
+// welfordMatrix::
+// return mean of element (i,j)
+double welfordMatrix::getMean(int i, int j) const {
+    return(mean[i*cols+j]);
+}
+
+//------------------------------------------------
+// welfordMatrix::
+// sample variance (dividing by n-1), or population variance (dividing by n) if sampleVar is false, of element (i,j). Zero if there are too few values.
+double welfordMatrix::var(int i, int j, bool sampleVar) const {
+    if (n<2)
+        return(0);
+    double output = sampleVar ? M2[i*cols+j]/(n-1) : M2[i*cols+j]/n;
+    return((output<0) ? 0 : output);
+}
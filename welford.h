@@ -0,0 +1,69 @@
+//
+//  MavericK
+//  welford.h
+//
+//  Distributed under the MIT software licence - see Notes.c file for details
+//
+//  Defines classes for calculating the mean and variance of a stream of values in a single pass (Welford's algorithm). Values are added one at a time and then discarded, so memory use does not grow with the number of values, and the variance does not suffer from the loss of precision that comes from subtracting a large sum of squares. Two accumulators built from separate streams (for example separate chains) can be merged into one, giving the same result as if all values had been added to a single accumulator.
+//
+// ---------------------------------------------------------------------------
+
+#ifndef __Maverick1_0__welford__
+#define __Maverick1_0__welford__
+
+#include <vector>
+
+//------------------------------------------------
+// running mean and variance of a single value
+class welford {
+    
+public:
+    
+    // PUBLIC OBJECTS
+    
+    double n;
+    double mean;
+    double M2;      // sum of squared deviations from the mean
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor
+    welford();
+    
+    void reset();
+    void add(double x);
+    void merge(const welford &other);
+    double var(bool sampleVar=true) const;
+    
+};
+
+//------------------------------------------------
+// running mean and variance of every element of a matrix
+class welfordMatrix {
+    
+public:
+    
+    // PUBLIC OBJECTS
+    
+    int rows;
+    int cols;
+    double n;
+    
+    // flat arrays, with element (i,j) found at i*cols+j
+    std::vector<double> mean;
+    std::vector<double> M2;
+    
+    // PUBLIC FUNCTIONS
+    
+    // constructor
+    welfordMatrix();
+    
+    void reset(int _rows, int _cols);
+    void add(const std::vector< std::vector<double> > &x);
+    void merge(const welfordMatrix &other);
+    double getMean(int i, int j) const;
+    double var(int i, int j, bool sampleVar=true) const;
+    
+};
+
+#endif
@@ -25,18 +25,24 @@ ofstream safe_ofstream(string fileName, bool writeToFile, ofstream &logFileStrea
     return(fileStream);
 }
 
+//------------------------------------------------
+// create lookup tables for log and lgamma functions
+void initialiseLookups(globals &globals) {
+    
+    // counts at a locus can be no larger than the total ploidy of all individuals, plus the gene copies of one individual added on top when it is scored against its own deme
+    int maxPloidy = *max_element(begin(globals.ploidy_vec),end(globals.ploidy_vec));
+    shared_ptr<lookupTable> lookup(new lookupTable);
+    lookup->build(sum(globals.ploidy_vec)+maxPloidy, globals.J, globals.lambda);
+    globals.lookup = lookup;
+}
+
 //------------------------------------------------
 // initialise global objects with empty values
 void initialiseGlobals(globals &globals) {
     
-    // create lookup table for log function
-    int Jmax = *max_element(begin(globals.J),end(globals.J));
-    globals.log_lookup = vector< vector<double> >(int(1e4),vector<double>(Jmax+1));
-    for (int i=0; i<int(1e4); i++) {
-        for (int j=0; j<(Jmax+1); j++) {
-            globals.log_lookup[i][j] = log(double(i+j*globals.lambda));
-        }
-    }
+    // create lookup tables for log and lgamma functions (already shared with a datasetObject if the data came from one, see library.h)
+    if (!globals.lookup)
+        initialiseLookups(globals);
     
     // Qmatrices
     globals.Qmatrix_gene = vector< vector< vector<double> > >(globals.Kmax-globals.Kmin+1);
@@ -70,9 +76,16 @@ void initialiseGlobals(globals &globals) {
     globals.logEvidence_structure_grandMean = nanVec;
     globals.logEvidence_structure_grandSE = nanVec;
     
-    globals.TIpoint_mean = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.thermodynamicRungs,-sqrt(-1.0)));
-    globals.TIpoint_var = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.thermodynamicRungs,-sqrt(-1.0)));
-    globals.TIpoint_SE = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.thermodynamicRungs,-sqrt(-1.0)));
+    globals.logLikeGroup_ESS = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.mainRepeats));
+    globals.mainBurnin_used = vector< vector<int> >(globals.Kmax-globals.Kmin+1,vector<int>(globals.mainRepeats,globals.mainBurnin));
+    globals.mainSamples_used = vector< vector<int> >(globals.Kmax-globals.Kmin+1,vector<int>(globals.mainRepeats,globals.mainSamples));
+    
+    globals.TIrungsMax = (globals.thermodynamicTargetSE>0) ? globals.thermodynamicMaxRungs : globals.thermodynamicRungs;
+    globals.TIrungs = vector<int>(globals.Kmax-globals.Kmin+1,globals.thermodynamicRungs);
+    globals.TIpoint_beta = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.TIrungsMax,-sqrt(-1.0)));
+    globals.TIpoint_mean = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.TIrungsMax,-sqrt(-1.0)));
+    globals.TIpoint_var = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.TIrungsMax,-sqrt(-1.0)));
+    globals.TIpoint_SE = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.TIrungsMax,-sqrt(-1.0)));
     globals.logEvidence_TI = nanVec;
     globals.logEvidence_TI_SE = nanVec;
     
@@ -87,6 +100,10 @@ void initialiseGlobals(globals &globals) {
     globals.posterior_TI_LL = nanVec;
     globals.posterior_TI_UL = nanVec;
     
+    globals.maxLike = nanVec;
+    globals.max_alleleFreqs = vector< vector< vector< vector<double> > > >(globals.Kmax-globals.Kmin+1);
+    globals.max_admixFreqs = vector< vector< vector<double> > >(globals.Kmax-globals.Kmin+1);
+    
     globals.AIC = nanVec;
     globals.BIC = nanVec;
     globals.DIC_Gelman = nanVec;
@@ -96,6 +113,11 @@ void initialiseGlobals(globals &globals) {
     globals.L_2 = vector< vector<double> >(globals.Kmax-globals.Kmin+1,vector<double>(globals.mainRepeats));
     globals.delta_K = vector<double>(globals.Kmax-globals.Kmin+1);
     
+    // buffers for console and log output of each K
+    globals.Kbuffer = vector<string>(globals.Kmax-globals.Kmin+1);
+    
+    globals.profile = vector< vector<profileObject> >(globals.Kmax-globals.Kmin+1);
+    
 }
 
 //------------------------------------------------
@@ -114,6 +136,9 @@ void openFileStreams(globals &globals) {
         
         globals.outputLikelihood_fileStream << "\n";
         globals.outputLikelihood_fileStream.flush();
+        
+        // subsequent lines are written from the MCMC on a background thread
+        globals.outputLikelihood_writer.open(globals.outputLikelihood_fileStream);
     }
     
     // Evidence
@@ -164,6 +189,20 @@ void openFileStreams(globals &globals) {
         
     }
     
+    // profile
+    if (globals.outputProfile_on) {
+        // open file stream
+        globals.outputProfile_fileStream = safe_ofstream(globals.outputProfile_filePath, globals.outputLog_on, globals.outputLog_fileStream);
+        // fixed headers
+        globals.outputProfile_fileStream << "K,stage,rung,beta";
+        globals.outputProfile_fileStream << ",time_total,time_Gibbs,time_indLevel,time_alpha,time_Qmatrix,time_labels,time_likelihood,time_freqs,time_output";
+        globals.outputProfile_fileStream << ",sweeps,sweeps_per_second,indLevel_proposed,indLevel_acceptance,alpha_proposed,alpha_acceptance,Hungarian_calls,Hungarian_iterations,relabels,swaps_proposed,swaps_acceptance,EM_iterations";
+        
+        globals.outputProfile_fileStream << "\n";
+        globals.outputProfile_fileStream.flush();
+        
+    }
+    
     // EvidenceDetails
     if (globals.outputEvidenceDetails_on) {
         // open file stream
@@ -177,12 +216,28 @@ void openFileStreams(globals &globals) {
         for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
             globals.outputEvidenceDetails_fileStream << ",structure_loglike_var_rep" << mainRep+1;
         }
-        // TI mean and standard error
+        // length of burn-in and sampling phases, if chosen adaptively
+        if (globals.mainAdaptiveBurnin_on) {
+            for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+                globals.outputEvidenceDetails_fileStream << ",burnin_rep" << mainRep+1;
+            }
+        }
+        if (globals.mainTargetSE>0) {
+            for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+                globals.outputEvidenceDetails_fileStream << ",samples_rep" << mainRep+1;
+            }
+        }
+        // TI mean and standard error. The power of each rung is only needed if rungs are not equally spaced
         if (globals.thermodynamic_on) {
-            for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
+            if (globals.thermodynamicPower!=1 || globals.thermodynamicTargetSE>0) {
+                for (int TIrep=0; TIrep<globals.TIrungsMax; TIrep++) {
+                    globals.outputEvidenceDetails_fileStream << ",TIpoint_beta_rung" << TIrep+1;
+                }
+            }
+            for (int TIrep=0; TIrep<globals.TIrungsMax; TIrep++) {
                 globals.outputEvidenceDetails_fileStream << ",TIpoint_mean_rung" << TIrep+1;
             }
-            for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
+            for (int TIrep=0; TIrep<globals.TIrungsMax; TIrep++) {
                 globals.outputEvidenceDetails_fileStream << ",TIpoint_SE_rung" << TIrep+1;
             }
         }
@@ -193,7 +248,39 @@ void openFileStreams(globals &globals) {
     }
     
     // PosteriorGrouping
-    if (globals.outputPosteriorGrouping_on) {
+    if (globals.outputPosteriorGrouping_on && globals.outputPosteriorGrouping_binary_on) {
+        
+        // binary version. Swap the file extension for .bin
+        string &filePath = globals.outputPosteriorGrouping_filePath;
+        if (filePath.size()>=4 && filePath.substr(filePath.size()-4)==".csv") {
+            filePath = filePath.substr(0, filePath.size()-4);
+        }
+        filePath += ".bin";
+        
+        // open file stream
+        globals.outputPosteriorGrouping_fileStream.open(filePath, ios::out | ios::binary);
+        if (!globals.outputPosteriorGrouping_fileStream.is_open()) {
+            errorExit("\nError: failed to write to file: "+filePath+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+        }
+        
+        // fixed header (see Notes.c for the full layout)
+        string header = "MVKPG1";
+        header.append(2, '\0');
+        appendBinary(header, uint32_t(globals.n));
+        appendBinary(header, uint32_t(globals.loci));
+        appendBinary(header, uint32_t(globals.admix_on ? 1 : 0));
+        appendBinary(header, uint32_t(globals.admix_on ? globals.geneCopies : globals.n));
+        appendBinary(header, uint32_t(globals.Kmax>255 ? 2 : 1));
+        for (int i=0; i<globals.n; i++) {
+            appendBinary(header, uint32_t(globals.ploidy_vec[i]));
+        }
+        globals.outputPosteriorGrouping_fileStream.write(header.data(), header.size());
+        globals.outputPosteriorGrouping_fileStream.flush();
+        
+        // subsequent records are written from the MCMC on a background thread
+        globals.outputPosteriorGrouping_writer.open(globals.outputPosteriorGrouping_fileStream);
+        
+    } else if (globals.outputPosteriorGrouping_on) {
         // open file stream
         globals.outputPosteriorGrouping_fileStream = safe_ofstream(globals.outputPosteriorGrouping_filePath, globals.outputLog_on, globals.outputLog_fileStream);
         // fixed headers
@@ -216,6 +303,9 @@ void openFileStreams(globals &globals) {
         }
         globals.outputPosteriorGrouping_fileStream << "\n";
         globals.outputPosteriorGrouping_fileStream.flush();
+        
+        // subsequent lines are written from the MCMC on a background thread
+        globals.outputPosteriorGrouping_writer.open(globals.outputPosteriorGrouping_fileStream);
     }
     
     // MaxLike_alleleFreqs
@@ -287,12 +377,29 @@ void printEvidenceDetails(globals &globals, int Kindex) {
         globals.outputEvidenceDetails_fileStream << "," << process_nan(globals.structure_loglike_var[Kindex][mainRep]);
     }
     
+    // length of burn-in and sampling phases, if chosen adaptively
+    if (globals.mainAdaptiveBurnin_on) {
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            globals.outputEvidenceDetails_fileStream << "," << globals.mainBurnin_used[Kindex][mainRep];
+        }
+    }
+    if (globals.mainTargetSE>0) {
+        for (int mainRep=0; mainRep<globals.mainRepeats; mainRep++) {
+            globals.outputEvidenceDetails_fileStream << "," << globals.mainSamples_used[Kindex][mainRep];
+        }
+    }
+    
     // thermodynamic integral estimator details
     if (globals.thermodynamic_on) {
-        for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
+        if (globals.thermodynamicPower!=1 || globals.thermodynamicTargetSE>0) {
+            for (int TIrep=0; TIrep<globals.TIrungsMax; TIrep++) {
+                globals.outputEvidenceDetails_fileStream << "," << process_nan(globals.TIpoint_beta[Kindex][TIrep]);
+            }
+        }
+        for (int TIrep=0; TIrep<globals.TIrungsMax; TIrep++) {
             globals.outputEvidenceDetails_fileStream << "," << process_nan(globals.TIpoint_mean[Kindex][TIrep]);
         }
-        for (int TIrep=0; TIrep<globals.thermodynamicRungs; TIrep++) {
+        for (int TIrep=0; TIrep<globals.TIrungsMax; TIrep++) {
             globals.outputEvidenceDetails_fileStream << "," << process_nan(globals.TIpoint_SE[Kindex][TIrep]);
         }
     }
@@ -311,23 +418,26 @@ void printEvidenceNormalised(globals &globals) {
     if (globals.exhaustive_on)
         globals.posterior_exhaustive = normalise_log(globals.logEvidence_exhaustive);
     
+    // simulation draws random numbers from a stream that does not belong to any K
+    RNGobject RNG = RNGstream(globals.seed, -1, 0, 0);
+    
     // normalise harmonic mean results
     if (globals.mainRepeats==1) {
         globals.posterior_harmonic_mean = normalise_log(globals.logEvidence_harmonic_grandMean);
     } else {
-        normalise_log_sim(globals.posterior_harmonic_mean, globals.posterior_harmonic_LL, globals.posterior_harmonic_UL, globals.logEvidence_harmonic_grandMean, globals.logEvidence_harmonic_grandSE, int(1e6));
+        normalise_log_sim(globals.posterior_harmonic_mean, globals.posterior_harmonic_LL, globals.posterior_harmonic_UL, globals.logEvidence_harmonic_grandMean, globals.logEvidence_harmonic_grandSE, int(1e6), RNG);
     }
     
     // normalise structure estimator results
     if (globals.mainRepeats==1) {
         globals.posterior_structure_mean = normalise_log(globals.logEvidence_structure_grandMean);
     } else {
-        normalise_log_sim(globals.posterior_structure_mean, globals.posterior_structure_LL, globals.posterior_structure_UL, globals.logEvidence_structure_grandMean, globals.logEvidence_structure_grandSE, int(1e6));
+        normalise_log_sim(globals.posterior_structure_mean, globals.posterior_structure_LL, globals.posterior_structure_UL, globals.logEvidence_structure_grandMean, globals.logEvidence_structure_grandSE, int(1e6), RNG);
     }
     
     // normalise thermodynamic integral estimator results
     if (globals.thermodynamic_on)
-        normalise_log_sim(globals.posterior_TI_mean, globals.posterior_TI_LL, globals.posterior_TI_UL, globals.logEvidence_TI, globals.logEvidence_TI_SE, int(1e6));
+        normalise_log_sim(globals.posterior_TI_mean, globals.posterior_TI_LL, globals.posterior_TI_UL, globals.logEvidence_TI, globals.logEvidence_TI_SE, int(1e6), RNG);
     
     // open file stream
     globals.outputEvidenceNormalised_fileStream = safe_ofstream(globals.outputEvidenceNormalised_filePath, globals.outputLog_on, globals.outputLog_fileStream);
@@ -375,7 +485,7 @@ void printMaxLike_alleleFreqs(globals &globals, int Kindex) {
     for (int k=0; k<K; k++) {
         for (int l=0; l<globals.loci; l++) {
             for (int j=0; j<globals.J[l]; j++) {
-                globals.outputMaxLike_alleleFreqs_fileStream << K << "," << k+1 << "," << l+1 << "," << globals.uniqueAlleles[l][j] << "," << process_nan(globals.max_alleleFreqs[k][l][j]) << "\n";
+                globals.outputMaxLike_alleleFreqs_fileStream << K << "," << k+1 << "," << l+1 << "," << globals.uniqueAlleles[l][j] << "," << process_nan(globals.max_alleleFreqs[Kindex][k][l][j]) << "\n";
             }
         }
     }
@@ -391,7 +501,7 @@ void printMaxLike_admixFreqs(globals &globals, int Kindex) {
     // print values
     for (int i=0; i<globals.n; i++) {
         for (int k=0; k<K; k++) {
-            globals.outputMaxLike_admixFreqs_fileStream << K << "," << i+1 << "," << k+1 << "," << process_nan(globals.max_admixFreqs[i][k]) << "\n";
+            globals.outputMaxLike_admixFreqs_fileStream << K << "," << i+1 << "," << k+1 << "," << process_nan(globals.max_admixFreqs[Kindex][i][k]) << "\n";
         }
     }
     globals.outputMaxLike_alleleFreqs_fileStream.flush();
@@ -426,24 +536,89 @@ void printEvanno(globals &globals, int Kindex) {
 }
 
 //------------------------------------------------
-// write gene-level Qmatrix file (MCMCobject_admixture only)
-void printQmatrix_gene(globals &globals, int Kindex) {
+// write timings and event counts of each stage to Profile file. Times are in seconds, and acceptance rates are the proportion of proposed moves that were accepted. The total time of the main MCMC is wall-clock time, while the time spent in each phase is summed over all repeats (which may have run in parallel).
+void printProfile(globals &globals, int Kindex) {
     int K = globals.Kmin+Kindex;
     
-    // open outputQmatrix_gene filestream for this K
-    string s = globals.outputQmatrix_gene_filePath;
-    s.erase(end(s)-4,end(s));
-    s = s + "_K" + to_string((long long)K) + ".csv";
-    globals.outputQmatrix_gene_fileStream = safe_ofstream(s,globals.outputLog_on, globals.outputLog_fileStream);
+    for (int i=0; i<int(globals.profile[Kindex].size()); i++) {
+        profileObject &p = globals.profile[Kindex][i];
+        ofstream &s = globals.outputProfile_fileStream;
+        
+        s << K << "," << p.stage;
+        if (p.rung>0) {
+            s << "," << p.rung << "," << p.beta;
+        } else {
+            s << ",NA,NA";
+        }
+        for (int j=0; j<PROFILE_PHASES; j++) {
+            s << "," << p.seconds[j];
+        }
+        
+        // counts are written as integers, and rates are NA if there is nothing to divide by
+        const vector<double> &c = p.counts;
+        double NaN = -sqrt(-1.0);
+        s << "," << (long long)c[COUNT_SWEEPS] << "," << process_nan((p.seconds[PROFILE_GIBBS]>0) ? c[COUNT_SWEEPS]/p.seconds[PROFILE_GIBBS] : NaN);
+        s << "," << (long long)c[COUNT_INDLEVEL_PROPOSED] << "," << process_nan((c[COUNT_INDLEVEL_PROPOSED]>0) ? c[COUNT_INDLEVEL_ACCEPTED]/c[COUNT_INDLEVEL_PROPOSED] : NaN);
+        s << "," << (long long)c[COUNT_ALPHA_PROPOSED] << "," << process_nan((c[COUNT_ALPHA_PROPOSED]>0) ? c[COUNT_ALPHA_ACCEPTED]/c[COUNT_ALPHA_PROPOSED] : NaN);
+        s << "," << (long long)c[COUNT_HUNGARIAN_CALLS] << "," << (long long)c[COUNT_HUNGARIAN_ITERATIONS] << "," << (long long)c[COUNT_RELABELS];
+        s << "," << (long long)c[COUNT_SWAPS_PROPOSED] << "," << process_nan((c[COUNT_SWAPS_PROPOSED]>0) ? c[COUNT_SWAPS_ACCEPTED]/c[COUNT_SWAPS_PROPOSED] : NaN);
+        s << "," << (long long)c[COUNT_EM_ITERATIONS];
+        s << "\n";
+    }
+    globals.outputProfile_fileStream.flush();
+}
+
+//------------------------------------------------
+// open the file for a Qmatrix (or Qmatrix error) of a single K, named by adding "_K" and the value of K to filePath, with the extension swapped for .csv, or for .bin when writing in binary form. Returns true if the file is to be written in binary form.
+static bool openQmatrixFile(globals &globals, string filePath, int K, ofstream &stream) {
+    if (stream.is_open())
+        stream.close();
+    filePath.erase(end(filePath)-4,end(filePath));
+    filePath = filePath + "_K" + to_string((long long)K);
+    if (globals.outputQmatrix_binary_on) {
+        filePath += ".bin";
+        stream.open(filePath, ios::out | ios::binary);
+        if (!stream.is_open()) {
+            errorExit("\nError: failed to write to file: "+filePath+string("\n"), globals.outputLog_on, globals.outputLog_fileStream);
+        }
+    } else {
+        stream = safe_ofstream(filePath+".csv", globals.outputLog_on, globals.outputLog_fileStream);
+    }
+    return(globals.outputQmatrix_binary_on);
+}
+
+//------------------------------------------------
+// write a Qmatrix (or Qmatrix error) in binary form, one deme at a time (see Notes.c for the layout), via the background writer
+static void printQmatrix_binary(globals &globals, const vector< vector<double> > &Qmatrix, int K) {
+    int rows = int(Qmatrix.size());
+    string out = "MVKQM1";
+    out.append(2, '\0');
+    appendBinary(out, uint32_t(rows));
+    appendBinary(out, uint32_t(K));
+    for (int k=0; k<K; k++) {
+        for (int i=0; i<rows; i++) {
+            appendBinary(out, float(Qmatrix[i][k]));
+            if (out.size()>=OUTPUT_BLOCK)
+                globals.Qmatrix_writer.write(out);
+        }
+    }
+    globals.Qmatrix_writer.write(out);
+}
+
+//------------------------------------------------
+// write a gene-level Qmatrix (or Qmatrix error) in csv form, with values rounded to the given number of decimal places, via the background writer
+static void printQmatrix_gene_csv(globals &globals, const vector< vector<double> > &Qmatrix, int K, int decimals) {
     
     // write headers
-    globals.outputQmatrix_gene_fileStream << "index,label";
+    string out = "index,label";
     if (globals.popCol_on)
-        globals.outputQmatrix_gene_fileStream << ",given_population";
-    globals.outputQmatrix_gene_fileStream << ",locus,gene_copy";
-    for (int k=0; k<K; k++)
-        globals.outputQmatrix_gene_fileStream << ",deme" << k+1;
-    globals.outputQmatrix_gene_fileStream << "\n";
+        out += ",given_population";
+    out += ",locus,gene_copy";
+    for (int k=0; k<K; k++) {
+        out += ",deme";
+        appendInt(out, k+1);
+    }
+    out += '\n';
     
     // write results
     int groupIndex=-1;
@@ -452,101 +627,131 @@ void printQmatrix_gene(globals &globals, int Kindex) {
             for (int p=0; p<globals.ploidy_vec[ind]; p++) {
                 groupIndex++;
                 
-                // individual index
-                globals.outputQmatrix_gene_fileStream << ind+1 << ",";
-                
-                // individual label
-                globals.outputQmatrix_gene_fileStream << globals.indLabels_vec[ind] << ",";
-                
-                // population data
-                if (globals.popCol_on)
-                    globals.outputQmatrix_gene_fileStream << globals.pop_vec[ind] << ",";
-                
-                // locus
-                globals.outputQmatrix_gene_fileStream << l+1 << ",";
-                
-                // gene copy
-                globals.outputQmatrix_gene_fileStream << p+1 << ",";
+                // individual index and label, population data, locus and gene copy
+                appendInt(out, ind+1);
+                out += ',';
+                out += globals.indLabels_vec[ind];
+                out += ',';
+                if (globals.popCol_on) {
+                    out += globals.pop_vec[ind];
+                    out += ',';
+                }
+                appendInt(out, l+1);
+                out += ',';
+                appendInt(out, p+1);
+                out += ',';
                 
                 // probabilities
                 for (int k=0; k<K; k++) {
-                    char * buffer = new char[256];
-                    sprintf(buffer, "%.3f", round(globals.Qmatrix_gene[Kindex][groupIndex][k]*1000)/1000.0);
-                    string s = buffer;
-                    delete [] buffer;
-                    globals.outputQmatrix_gene_fileStream << s;
+                    appendFixed(out, Qmatrix[groupIndex][k], decimals);
                     if (k<(K-1))
-                        globals.outputQmatrix_gene_fileStream << ",";
+                        out += ',';
                 }
+                out += '\n';
                 
-                globals.outputQmatrix_gene_fileStream << "\n";
-                
+                if (out.size()>=OUTPUT_BLOCK)
+                    globals.Qmatrix_writer.write(out);
             }
         }
     }
-    globals.outputQmatrix_gene_fileStream.flush();
+    globals.Qmatrix_writer.write(out);
 }
 
 //------------------------------------------------
-// write standard error of gene-level Qmatrix (MCMCobject_admixture only)
-void printQmatrixError_gene(globals &globals, int Kindex) {
-    int K = globals.Kmin+Kindex;
-    
-    // open outputQmatrixError_gene filestream for this K
-    string s = globals.outputQmatrixError_gene_filePath;
-    s.erase(end(s)-4,end(s));
-    s = s + "_K" + to_string((long long)K) + ".csv";
-    globals.outputQmatrixError_gene_fileStream = safe_ofstream(s,globals.outputLog_on, globals.outputLog_fileStream);
+// write an individual-level Qmatrix (or Qmatrix error) in csv form, with values rounded to the given number of decimal places, via the background writer
+static void printQmatrix_ind_csv(globals &globals, const vector< vector<double> > &Qmatrix, int K, int decimals) {
     
     // write headers
-    globals.outputQmatrixError_gene_fileStream << "index,label";
+    string out = "index,label";
     if (globals.popCol_on)
-        globals.outputQmatrixError_gene_fileStream << ",given_population";
-    globals.outputQmatrixError_gene_fileStream << ",locus,gene_copy";
-    for (int k=0; k<K; k++)
-        globals.outputQmatrixError_gene_fileStream << ",deme" << k+1;
-    globals.outputQmatrixError_gene_fileStream << "\n";
+        out += ",given_population";
+    for (int k=0; k<K; k++) {
+        out += ",deme";
+        appendInt(out, k+1);
+    }
+    out += '\n';
     
     // write results
-    int groupIndex=-1;
-    for (int ind=0; ind<globals.n; ind++) {
-        for (int l=0; l<globals.loci; l++) {
-            for (int p=0; p<globals.ploidy_vec[ind]; p++) {
-                groupIndex++;
-                
-                // individual index
-                globals.outputQmatrixError_gene_fileStream << ind+1 << ",";
-                
-                // individual label
-                globals.outputQmatrixError_gene_fileStream << globals.indLabels_vec[ind] << ",";
-                
-                // population data
-                if (globals.popCol_on)
-                    globals.outputQmatrixError_gene_fileStream << globals.pop_vec[ind] << ",";
-                
-                // locus
-                globals.outputQmatrixError_gene_fileStream << l+1 << ",";
-                
-                // gene copy
-                globals.outputQmatrixError_gene_fileStream << p+1 << ",";
-                
-                // probabilities
-                for (int k=0; k<K; k++) {
-                    char * buffer = new char[256];
-                    sprintf(buffer, "%.3f", round(globals.QmatrixError_gene[Kindex][groupIndex][k]*1000)/1000.0);
-                    string s = buffer;
-                    delete [] buffer;
-                    globals.outputQmatrixError_gene_fileStream << s;
-                    if (k<(K-1))
-                        globals.outputQmatrixError_gene_fileStream << ",";
-                }
-                
-                globals.outputQmatrixError_gene_fileStream << "\n";
-                
-            }
+    for (int i=0; i<globals.n; i++) {
+        
+        // individual index and label, and population data
+        appendInt(out, i+1);
+        out += ',';
+        out += globals.indLabels_vec[i];
+        out += ',';
+        if (globals.popCol_on) {
+            out += globals.pop_vec[i];
+            out += ',';
+        }
+        
+        // probabilities
+        for (int k=0; k<K; k++) {
+            appendFixed(out, Qmatrix[i][k], decimals);
+            if (k<(K-1))
+                out += ',';
         }
+        out += '\n';
+        
+        if (out.size()>=OUTPUT_BLOCK)
+            globals.Qmatrix_writer.write(out);
+    }
+    globals.Qmatrix_writer.write(out);
+}
+
+//------------------------------------------------
+// write a population-level Qmatrix (or Qmatrix error) in csv form, with values rounded to the given number of decimal places, via the background writer. countName is the heading of the column giving the number of individuals in each population.
+static void printQmatrix_pop_csv(globals &globals, const vector< vector<double> > &Qmatrix, int K, int decimals, string countName) {
+    
+    // write headers
+    string out = "given_population," + countName;
+    for (int k=0; k<K; k++) {
+        out += ",deme";
+        appendInt(out, k+1);
+    }
+    out += '\n';
+    
+    // write results
+    for (int i=0; i<int(globals.uniquePops.size()); i++) {
+        
+        // given population and number of individuals
+        out += globals.uniquePops[i];
+        out += ',';
+        appendInt(out, globals.uniquePop_counts[i]);
+        
+        // probabilities
+        for (int k=0; k<K; k++) {
+            out += ',';
+            appendFixed(out, Qmatrix[i][k], decimals);
+        }
+        out += '\n';
+    }
+    globals.Qmatrix_writer.write(out);
+}
+
+//------------------------------------------------
+// write gene-level Qmatrix file (MCMCobject_admixture only)
+void printQmatrix_gene(globals &globals, int Kindex) {
+    int K = globals.Kmin+Kindex;
+    bool binary = openQmatrixFile(globals, globals.outputQmatrix_gene_filePath, K, globals.outputQmatrix_gene_fileStream);
+    globals.Qmatrix_writer.start(globals.outputQmatrix_gene_fileStream);
+    if (binary) {
+        printQmatrix_binary(globals, globals.Qmatrix_gene[Kindex], K);
+    } else {
+        printQmatrix_gene_csv(globals, globals.Qmatrix_gene[Kindex], K, 3);
+    }
+}
+
+//------------------------------------------------
+// write standard error of gene-level Qmatrix (MCMCobject_admixture only)
+void printQmatrixError_gene(globals &globals, int Kindex) {
+    int K = globals.Kmin+Kindex;
+    bool binary = openQmatrixFile(globals, globals.outputQmatrixError_gene_filePath, K, globals.outputQmatrixError_gene_fileStream);
+    globals.Qmatrix_writer.start(globals.outputQmatrixError_gene_fileStream);
+    if (binary) {
+        printQmatrix_binary(globals, globals.QmatrixError_gene[Kindex], K);
+    } else {
+        printQmatrix_gene_csv(globals, globals.QmatrixError_gene[Kindex], K, 3);
     }
-    globals.outputQmatrixError_gene_fileStream.flush();
 }
 
 //------------------------------------------------
@@ -622,106 +827,26 @@ void printQmatrix_ind(globals &globals, int Kindex) {
         
     } // end of if outputQmatrix_structureFormat_on=true
     
-    // open outputQmatrix_ind filestream for this K
-    string s = globals.outputQmatrix_ind_filePath;
-    s.erase(end(s)-4,end(s));
-    s = s + "_K" + to_string((long long)K) + ".csv";
-    globals.outputQmatrix_ind_fileStream = safe_ofstream(s,globals.outputLog_on, globals.outputLog_fileStream);
-    
-    // write headers
-    globals.outputQmatrix_ind_fileStream << "index,label";
-    if (globals.popCol_on)
-        globals.outputQmatrix_ind_fileStream << ",given_population";
-    for (int k=0; k<K; k++)
-        globals.outputQmatrix_ind_fileStream << ",deme" << k+1;
-    globals.outputQmatrix_ind_fileStream << "\n";
-    
-    // write results
-    for (int i=0; i<globals.n; i++) {
-        
-        // individual index
-        globals.outputQmatrix_ind_fileStream << i+1;
-        globals.outputQmatrix_ind_fileStream << ",";
-        
-        // individual label
-        globals.outputQmatrix_ind_fileStream << globals.indLabels_vec[i];
-        globals.outputQmatrix_ind_fileStream << ",";
-        
-        // population data
-        if (globals.popCol_on) {
-            globals.outputQmatrix_ind_fileStream << globals.pop_vec[i];
-            globals.outputQmatrix_ind_fileStream << ",";
-        }
-        
-        // probabilities
-        for (int k=0; k<K; k++) {
-            char * buffer = new char[256];
-            sprintf(buffer, "%.3f", round(globals.Qmatrix_ind[Kindex][i][k]*1000)/1000.0);
-            string s = buffer;
-            delete [] buffer;
-            globals.outputQmatrix_ind_fileStream << s;
-            if (k<(K-1))
-                globals.outputQmatrix_ind_fileStream << ",";
-        }
-        
-        globals.outputQmatrix_ind_fileStream << "\n";
-        
+    bool binary = openQmatrixFile(globals, globals.outputQmatrix_ind_filePath, K, globals.outputQmatrix_ind_fileStream);
+    globals.Qmatrix_writer.start(globals.outputQmatrix_ind_fileStream);
+    if (binary) {
+        printQmatrix_binary(globals, globals.Qmatrix_ind[Kindex], K);
+    } else {
+        printQmatrix_ind_csv(globals, globals.Qmatrix_ind[Kindex], K, 3);
     }
-    
-    globals.outputQmatrix_ind_fileStream.flush();
 }
 
 //------------------------------------------------
 // write standard error of individual-level Qmatrix (overloaded for MCMCobject_noAdmixture and MCMCobject_admixture)
 void printQmatrixError_ind(globals &globals, int Kindex) {
     int K = globals.Kmin+Kindex;
-    
-    // open outputQmatrixError_ind filestream for this K
-    string s = globals.outputQmatrixError_ind_filePath;
-    s.erase(end(s)-4,end(s));
-    s = s + "_K" + to_string((long long)K) + ".csv";
-    globals.outputQmatrixError_ind_fileStream = safe_ofstream(s,globals.outputLog_on, globals.outputLog_fileStream);
-    
-    // write headers
-    globals.outputQmatrixError_ind_fileStream << "index,label";
-    if (globals.popCol_on)
-        globals.outputQmatrixError_ind_fileStream << ",given_population";
-    for (int k=0; k<K; k++)
-        globals.outputQmatrixError_ind_fileStream << ",deme" << k+1;
-    globals.outputQmatrixError_ind_fileStream << "\n";
-    
-    // write results
-    for (int i=0; i<globals.n; i++) {
-        
-        // individual index
-        globals.outputQmatrixError_ind_fileStream << i+1;
-        globals.outputQmatrixError_ind_fileStream << ",";
-        
-        // individual label
-        globals.outputQmatrixError_ind_fileStream << globals.indLabels_vec[i];
-        globals.outputQmatrixError_ind_fileStream << ",";
-        
-        // population data
-        if (globals.popCol_on) {
-            globals.outputQmatrixError_ind_fileStream << globals.pop_vec[i];
-            globals.outputQmatrixError_ind_fileStream << ",";
-        }
-        
-        // standard errors
-        for (int k=0; k<K; k++) {
-            char * buffer = new char[256];
-            sprintf(buffer, "%.6f", round(globals.QmatrixError_ind[Kindex][i][k]*1e6)/1e6);
-            string s = buffer;
-            delete [] buffer;
-            globals.outputQmatrixError_ind_fileStream << s;
-            if (k<(K-1))
-                globals.outputQmatrixError_ind_fileStream << ",";
-        }
-        
-        globals.outputQmatrixError_ind_fileStream << "\n";      
+    bool binary = openQmatrixFile(globals, globals.outputQmatrixError_ind_filePath, K, globals.outputQmatrixError_ind_fileStream);
+    globals.Qmatrix_writer.start(globals.outputQmatrixError_ind_fileStream);
+    if (binary) {
+        printQmatrix_binary(globals, globals.QmatrixError_ind[Kindex], K);
+    } else {
+        printQmatrix_ind_csv(globals, globals.QmatrixError_ind[Kindex], K, 6);
     }
-    
-    globals.outputQmatrixError_ind_fileStream.flush();
 }
 
 //------------------------------------------------
@@ -780,77 +905,25 @@ void printQmatrix_pop(globals &globals, int Kindex) {
         }
         
     } // end of if outputQmatrix_structureFormat_on=true
-        
-    // open outputQmatrix_pop filestream for this K
-    string s = globals.outputQmatrix_pop_filePath;
-    s.erase(end(s)-4,end(s));
-    s = s + "_K" + to_string((long long)K) + ".csv";
-    globals.outputQmatrix_pop_fileStream = safe_ofstream(s,globals.outputLog_on, globals.outputLog_fileStream);
-    
-    // write headers
-    globals.outputQmatrix_pop_fileStream << "given_population,members";
-    for (int k=0; k<K; k++)
-        globals.outputQmatrix_pop_fileStream << ",deme" << k+1;
-    globals.outputQmatrix_pop_fileStream << "\n";
     
-    // write results
-    for (int i=0; i<int(globals.uniquePops.size()); i++) {
-        
-        // given population and number of individuals
-        globals.outputQmatrix_pop_fileStream << globals.uniquePops[i] << "," << globals.uniquePop_counts[i];
-        
-        // probabilities
-        for (int k=0; k<K; k++) {
-            char * buffer = new char[256];
-            sprintf(buffer, "%.3f", round(globals.Qmatrix_pop[Kindex][i][k]*1000)/1000.0);
-            string s = buffer;
-            delete [] buffer;
-            globals.outputQmatrix_pop_fileStream << "," << s;
-        }
-        
-        globals.outputQmatrix_pop_fileStream << "\n";
-        
+    bool binary = openQmatrixFile(globals, globals.outputQmatrix_pop_filePath, K, globals.outputQmatrix_pop_fileStream);
+    globals.Qmatrix_writer.start(globals.outputQmatrix_pop_fileStream);
+    if (binary) {
+        printQmatrix_binary(globals, globals.Qmatrix_pop[Kindex], K);
+    } else {
+        printQmatrix_pop_csv(globals, globals.Qmatrix_pop[Kindex], K, 3, "members");
     }
-    
-    globals.outputQmatrix_pop_fileStream.flush();
 }
 
 //------------------------------------------------
 // write standard error of population-level Qmatrix (overloaded for MCMCobject_noAdmixture and MCMCobject_admixture)
 void printQmatrixError_pop(globals &globals, int Kindex) {
     int K = globals.Kmin+Kindex;
-    
-    // open outputQmatrixError_pop filestream for this K
-    string s = globals.outputQmatrixError_pop_filePath;
-    s.erase(end(s)-4,end(s));
-    s = s + "_K" + to_string((long long)K) + ".csv";
-    globals.outputQmatrixError_pop_fileStream = safe_ofstream(s,globals.outputLog_on, globals.outputLog_fileStream);
-    
-    // write headers
-    globals.outputQmatrixError_pop_fileStream << "given_population,individuals";
-    for (int k=0; k<K; k++)
-        globals.outputQmatrixError_pop_fileStream << ",deme" << k+1;
-    globals.outputQmatrixError_pop_fileStream << "\n";
-    
-    // write results
-    for (int i=0; i<int(globals.uniquePops.size()); i++) {
-        
-        // given population and number of individuals
-        globals.outputQmatrixError_pop_fileStream << globals.uniquePops[i] << "," << globals.uniquePop_counts[i];
-        
-        // standard errors
-        for (int k=0; k<K; k++) {
-            char * buffer = new char[256];
-            sprintf(buffer, "%.6f", round(globals.QmatrixError_pop[Kindex][i][k]*1e6)/1e6);
-            string s = buffer;
-            delete [] buffer;
-            globals.outputQmatrixError_pop_fileStream << "," << s;
-        }
-        
-        globals.outputQmatrixError_pop_fileStream << "\n";
-        
+    bool binary = openQmatrixFile(globals, globals.outputQmatrixError_pop_filePath, K, globals.outputQmatrixError_pop_fileStream);
+    globals.Qmatrix_writer.start(globals.outputQmatrixError_pop_fileStream);
+    if (binary) {
+        printQmatrix_binary(globals, globals.QmatrixError_pop[Kindex], K);
+    } else {
+        printQmatrix_pop_csv(globals, globals.QmatrixError_pop[Kindex], K, 6, "individuals");
     }
-    
-    globals.outputQmatrixError_pop_fileStream.flush();
-    
 }
@@ -18,12 +18,19 @@
 #include "misc.h"
 #include "OSfunctions.h"
 
+// Qmatrix files are built up in memory and passed to the background writer in blocks of roughly this many bytes
+#define OUTPUT_BLOCK (1<<20)
+
 //------------------------------------------------
 // safely open output file stream, otherwise error. Option to write errors to file if writeErrorToFile is true.
 std::ofstream safe_ofstream(std::string fileName, bool writeToFile, std::ofstream &logFileStream);
 
 //------------------------------------------------
-// initialise global objects with empty values
+// create lookup tables for log and lgamma functions, which depend only on the data and lambda
+void initialiseLookups(globals &globals);
+
+//------------------------------------------------
+// initialise global objects with empty values. Lookup tables are also created, unless they already exist.
 void initialiseGlobals(globals &globals);
 
 //------------------------------------------------
@@ -57,6 +64,10 @@ void printComparisonStatistics(globals &globals, int Kindex);
 // write Evanno's delta K to file
 void printEvanno(globals &globals, int Kindex);
 
+//------------------------------------------------
+// write timings and event counts of each stage to Profile file
+void printProfile(globals &globals, int Kindex);
+
 
 //------------------------------------------------
 // write gene-level Qmatrix file (MCMCobject_admixture only)